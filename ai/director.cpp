@@ -132,6 +132,24 @@ bool Director::SectorIsEvil(const grinliz::Vector2I& sector)
 }
 
 
+bool Director::SectorInPlay(const grinliz::Vector2I& sector)
+{
+	if (plot) {
+		return plot->SectorInPlay(sector);
+	}
+	return false;
+}
+
+
+bool Director::ChitInPlay(Chit* chit)
+{
+	if (plot && chit->GetItem()) {
+		return !plot->ShouldSendHerd(chit).IsZero() || !plot->PrioritySendHerd(chit).IsZero();
+	}
+	return false;
+}
+
+
 void Director::OnChitMsg(Chit* chit, const ChitMsg& msg)
 {
 	Vector2I playerSector = Context()->chitBag->GetHomeSector();
@@ -218,9 +236,9 @@ void Director::StartRandomPlot()
 	float odds[NPLOTS] = { 0 };
 	const char* plotName[NPLOTS] = { "SWARM", "GREAT_BATTLE", "EVIL_RISING" };
 
-	float fractionLesser = float(lesser) / float(TYPICAL_LESSER);
+	float fractionLesser = float(lesser) / float(TypicalLesser());
 	odds[SWARM] = fractionLesser * fractionLesser;
-	float fractionGreater = float(greater) / float(TYPICAL_GREATER);
+	float fractionGreater = float(greater) / float(TypicalGreater());
 	odds[GREAT_BATTLE] = fractionGreater * fractionGreater;
 	odds[EVIL_RISING] = fractionLesser * fractionLesser * (target ? 1.0f : 0.5f);
 
@@ -231,8 +249,8 @@ void Director::StartRandomPlot()
 		GLOUTPUT(("Director: %s %f\n", plotName[i], odds[i]));
 	}
 
-	Vector2I start = { parentChit->random.Rand(NUM_SECTORS), parentChit->random.Rand(NUM_SECTORS) };
-	Vector2I end   = { parentChit->random.Rand(NUM_SECTORS), parentChit->random.Rand(NUM_SECTORS) };
+	Vector2I start = { parentChit->random.Rand(NumSectors()), parentChit->random.Rand(NumSectors()) };
+	Vector2I end   = { parentChit->random.Rand(NumSectors()), parentChit->random.Rand(NumSectors()) };
 
 	if (plotIndex == SWARM) {
 		int green	  = Context()->chitBag->census.NumOf(ISC::mantis, 0);
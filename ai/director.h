@@ -29,6 +29,11 @@ public:
 	grinliz::Vector2I PrioritySendHerd(Chit* herd);
 	grinliz::Vector2I ShouldSendHerd(Chit* herd);
 	bool SectorIsEvil(const grinliz::Vector2I& sector);
+	// For the SectorPager: true if the plot is happening in the
+	// sector, or would send 'chit' somewhere. Unlike
+	// ShouldSendHerd(), doesn't change any state.
+	bool SectorInPlay(const grinliz::Vector2I& sector);
+	bool ChitInPlay(Chit* chit);
 
 	void Swarm(const grinliz::IString& critter, const grinliz::Vector2I& start, const grinliz::Vector2I& end);
 	void GreatBattle(const grinliz::Vector2I& pos);
@@ -37,6 +37,7 @@ void Plot::ToChaos(const grinliz::Vector2I& sector, const grinliz::IString& crit
 	context->chitBag->QuerySpatialHash(&arr, bounds, 0, &filter);
 	for (Chit* c : arr) {
 		c->GetItem()->SetTeam(TEAM_CHAOS);
+		context->chitBag->UpdateSpatialFlags(c);
 	}
 }
 
@@ -281,7 +282,7 @@ bool EvilRisingPlot::DoTick(U32 time)
 		Rectangle2I bounds, mapBounds;
 		bounds.min = bounds.max = destSector;
 		bounds.Outset(2);
-		mapBounds.Set(1, 1, NUM_SECTORS - 2, NUM_SECTORS - 2);
+		mapBounds.Set(1, 1, NumSectors() - 2, NumSectors() - 2);
 
 		CArray<Vector2I, 10> sector;
 		CArray<float, 10> score;
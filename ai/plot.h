@@ -45,6 +45,8 @@ public:
 
 	void SetContext(const ChitContext* _context) { context = _context; }
 	virtual bool SectorIsEvil(const grinliz::Vector2I& sector) { return false;  }
+	// The plot is happening here (or heading here.)
+	virtual bool SectorInPlay(const grinliz::Vector2I& sector) { return false; }
 
 protected:
 	void ToChaos(const grinliz::Vector2I& sector, const grinliz::IString& critter);
@@ -70,6 +72,7 @@ public:
 	virtual grinliz::Vector2I ShouldSendHerd(Chit* chit);
 	virtual void Serialize(XStream*);
 	virtual bool DoTick(U32 time);
+	virtual bool SectorInPlay(const grinliz::Vector2I& sector) { return sector == current || sector == end; }
 
 private:
 	bool AdvancePlot();
@@ -93,6 +96,7 @@ public:
 	virtual grinliz::Vector2I ShouldSendHerd(Chit* chit);
 	virtual void Serialize(XStream*);
 	virtual bool DoTick(U32 time);
+	virtual bool SectorInPlay(const grinliz::Vector2I& sector) { return sector == dest; }
 
 private:
 	bool AdvancePlot();
@@ -123,6 +127,7 @@ public:
 	virtual bool DoTick(U32 time);
 
 	virtual bool SectorIsEvil(const grinliz::Vector2I& sector);
+	virtual bool SectorInPlay(const grinliz::Vector2I& sector) { return sector == destSector || SectorIsEvil(sector); }
 
 private:
 	enum {
@@ -26,7 +26,8 @@ public:
 	void SetAudio(bool on);
 	bool IsAudioOn() const { return audioOn;  }
 
-	static XenoAudio* Instance()	{ GLASSERT(instance); return instance; }
+	// Null if there is no audio; callers check.
+	static XenoAudio* Instance()	{ return instance; }
 
 	void PlayVariation(const grinliz::IString& sound, int seed, const grinliz::Vector3F* pos);
 	void Play(const grinliz::IString& sound, const grinliz::Vector3F* pos);
@@ -127,13 +127,18 @@ void AnimationResourceManager::Load( const gamedb::Reader* reader )
 	{
 		const gamedb::Item* node = parent->ChildAt( i );
 		
-		AnimationResource* ar = new AnimationResource( node );
-		GLASSERT( !resArr.Query( ar->ResourceName(), 0 ));
-		resArr.Add( ar->ResourceName(), ar );
+		Add( new AnimationResource( node ));
 	}
 }
 
 
+void AnimationResourceManager::Add( AnimationResource* ar )
+{
+	GLASSERT( !resArr.Query( ar->ResourceName(), 0 ));
+	resArr.Add( ar->ResourceName(), ar );
+}
+
+
 const AnimationResource* AnimationResourceManager::GetResource( const char* name )
 {
 	if ( !name || !(*name) ) {
@@ -49,6 +49,7 @@ enum {
 
 class AnimationResource
 {
+	friend class AnimationBatch;
 public:
 	AnimationResource( const gamedb::Item* animationItem );
 	~AnimationResource()	{}
@@ -66,7 +67,8 @@ public:
 	
 	U32			Duration( int name ) const;
 
-	// Compute the bones, with optional cross fade.
+	// Compute the bones, with optional cross fade. The Models use
+	// AnimationBatch, which does the same thing for many at once.
 	void GetTransform(	int typeA,					// which animation to play: "reference", "gunrun", etc.
 						U32 timeA,					// time for this animation
 						int typeB,					// 2nd animation
@@ -120,6 +122,8 @@ public:
 	static void Destroy();
 
 	void Load( const gamedb::Reader* reader );
+	// Takes ownership. For resources constructed off the main thread.
+	void Add( AnimationResource* ar );
 
 	const AnimationResource* GetResource( const char* name );
 	bool HasResource( const char* name );
@@ -0,0 +1,449 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "animationbatch.h"
+#include "animation.h"
+#include "model.h"
+#include "simd.h"
+
+#include "../grinliz/glutil.h"
+#include "../grinliz/gljobsystem.h"
+#include "../grinliz/glrandom.h"
+#include "../grinliz/glstringutil.h"
+
+using namespace grinliz;
+using namespace simd;
+
+
+// acos(x) for x in [0,1]. Abramowitz and Stegun 4.4.46, |error| <= 2e-8
+static F4 ACos( F4 x )
+{
+	F4 p = Splat( -0.0012624911f );
+	p = MulAdd( p, x, Splat(  0.0066700901f ));
+	p = MulAdd( p, x, Splat( -0.0170881256f ));
+	p = MulAdd( p, x, Splat(  0.0308918810f ));
+	p = MulAdd( p, x, Splat( -0.0501743046f ));
+	p = MulAdd( p, x, Splat(  0.0889789874f ));
+	p = MulAdd( p, x, Splat( -0.2145988016f ));
+	p = MulAdd( p, x, Splat(  1.5707963050f ));
+	return Mul( p, Sqrt( Sub( Splat( 1.0f ), x )));
+}
+
+
+// sin(x) for x in [0,pi/2]. Taylor series to x^11, |error| < 1e-7
+static F4 Sin( F4 x )
+{
+	F4 x2 = Mul( x, x );
+	F4 p = Splat( -1.0f / 39916800.0f );
+	p = MulAdd( p, x2, Splat(  1.0f / 362880.0f ));
+	p = MulAdd( p, x2, Splat( -1.0f / 5040.0f ));
+	p = MulAdd( p, x2, Splat(  1.0f / 120.0f ));
+	p = MulAdd( p, x2, Splat( -1.0f / 6.0f ));
+	p = MulAdd( p, x2, Splat(  1.0f ));
+	return Mul( p, x );
+}
+
+
+// Quaternion::SLERP() on 4 lanes. q0, q1, and r are x,y,z,w.
+static void Slerp( const F4* q0, const F4* q1, F4 t, F4* r )
+{
+	static const float EPSILON = 0.0001f;
+	const F4 one = Splat( 1.0f );
+
+	F4 cosOmega = Mul( q0[0], q1[0] );
+	cosOmega = MulAdd( q0[1], q1[1], cosOmega );
+	cosOmega = MulAdd( q0[2], q1[2], cosOmega );
+	cosOmega = MulAdd( q0[3], q1[3], cosOmega );
+
+	// Take the short way around.
+	F4 sign = Select( LessEqual( Splat( 0 ), cosOmega ), one, Splat( -1.0f ));
+	cosOmega = Mul( cosOmega, sign );
+
+	// Close to the same rotation, the lerp is used, which also
+	// keeps the divide away from zero.
+	F4 linear = LessEqual( Sub( one, cosOmega ), Splat( EPSILON ));
+	F4 omega = ACos( cosOmega );
+	F4 sinOmega = Select( linear, one, Sin( omega ));
+
+	F4 scale0 = Select( linear, Sub( one, t ), Div( Sin( Mul( Sub( one, t ), omega )), sinOmega ));
+	F4 scale1 = Select( linear, t,             Div( Sin( Mul( t, omega )), sinOmega ));
+	scale1 = Mul( scale1, sign );
+
+	for( int i=0; i<4; ++i ) {
+		r[i] = MulAdd( scale0, q0[i], Mul( scale1, q1[i] ));
+	}
+}
+
+
+void AnimationBatch::SetLane( const AnimationResource* res, int typeA, U32 timeA, int typeB, U32 timeB, float cross, Lane* lane )
+{
+	res->ComputeFrame( typeA, timeA, &lane->frameA0, &lane->frameA1, &lane->fractionA );
+	lane->boneA = &res->sequence[typeA].boneData;
+	if ( cross > 0 ) {
+		res->ComputeFrame( typeB, timeB, &lane->frameB0, &lane->frameB1, &lane->fractionB );
+		lane->boneB = &res->sequence[typeB].boneData;
+		lane->cross = cross;
+	}
+	else {
+		lane->boneB = lane->boneA;
+		lane->frameB0 = lane->frameA0;
+		lane->frameB1 = lane->frameA1;
+		lane->fractionB = lane->fractionA;
+		lane->cross = 0;
+	}
+}
+
+
+bool AnimationBatch::SetModelLane( Model* model, Lane* lane )
+{
+	GLASSERT( model->HasAnimation() );
+	GLASSERT( model->auxBone );
+	if ( !model->auxBone || model->AnimationCached() ) 
+		return false;
+
+	lane->model = model;
+	lane->boneMats = model->auxBone->boneMats;
+	lane->animToModelMap = model->auxBone->animToModelMap;
+
+	if ( model->CrossFading() ) {
+		float cross = (float)model->crossFadeTime / (float)model->totalCrossFadeTime;
+		SetLane( model->animationResource, model->prevAnim.id, model->prevAnim.time, model->currentAnim.id, model->currentAnim.time, cross, lane );
+	}
+	else {
+		SetLane( model->animationResource, model->currentAnim.id, model->currentAnim.time, model->currentAnim.id, model->currentAnim.time, 0, lane );
+	}
+	return true;
+}
+
+
+void AnimationBatch::Add( Model* model )
+{
+	Lane lane;
+	if ( SetModelLane( model, &lane )) {
+		lanes.Push( lane );
+	}
+	else {
+		++nCached;
+	}
+}
+
+
+void AnimationBatch::EvaluateModel( Model* model )
+{
+	// A group of one, on the stack.
+	Lane lane;
+	if ( SetModelLane( model, &lane )) {
+		EvaluateGroup( &lane, 1 );
+	}
+}
+
+
+void AnimationBatch::Evaluate( bool parallel )
+{
+	int nGroups = ( lanes.Size() + LANES - 1 ) / LANES;
+	if ( parallel && nGroups > GROUPS_PER_JOB ) {
+		JobSystem::Instance()->ParallelFor( nGroups, GROUPS_PER_JOB, EvaluateJob, this );
+	}
+	else {
+		EvaluateJob( this, 0, nGroups );
+	}
+}
+
+
+void AnimationBatch::EvaluateJob( void* data, int start, int end )
+{
+	const AnimationBatch* batch = (const AnimationBatch*)data;
+	for( int g=start; g<end; ++g ) {
+		int first = g * LANES;
+		EvaluateGroup( batch->lanes.Mem() + first, Min( int(LANES), batch->lanes.Size() - first ));
+	}
+}
+
+
+void AnimationBatch::EvaluateGroup( const Lane* lanes, int n )
+{
+	GLASSERT( n > 0 && n <= LANES );
+
+	// The affine transforms are stored as 3x4, column major:
+	// (index = col*3 + row), with a float per lane.
+	static const float IDENTITY[12] = { 1, 0, 0,  0, 1, 0,  0, 0, 1,  0, 0, 0 };
+	static const float ZERO_EPSILON = 0.0001f;
+	float concat[EL_MAX_BONES][12][LANES];
+
+	// Unused lanes repeat the last model and aren't written.
+	const Lane* lane[LANES];
+	for( int l=0; l<LANES; ++l ) {
+		lane[l] = &lanes[Min( l, n-1 )];
+	}
+	float in[3][LANES];
+	for( int l=0; l<LANES; ++l ) {
+		in[0][l] = lane[l]->fractionA;
+		in[1][l] = lane[l]->fractionB;
+		in[2][l] = lane[l]->cross;
+	}
+	const F4 fractionA = Load( in[0] );
+	const F4 fractionB = Load( in[1] );
+	const F4 cross     = Load( in[2] );
+
+	for( int b=0; b<EL_MAX_BONES; ++b ) {
+		// Gather: the A and B keyframes, the reference values, and
+		// the parent. Bones that don't exist get identity inputs.
+		float qIn[4][4][LANES];		// A0, A1, B0, B1 : x,y,z,w
+		float pIn[4][3][LANES];		// A0, A1, B0, B1 : x,y,z
+		float refPos[3][LANES], refConcat[3][LANES], valid[LANES];
+		int parent[LANES];
+		bool sameParent = true;
+
+		for( int l=0; l<LANES; ++l ) {
+			const Lane& ln = *lane[l];
+			const BoneData::Bone& boneA = ln.boneA->bone[b];
+			const BoneData::Bone& boneB = ln.boneB->bone[b];
+			const Quaternion* q[4] = { &boneA.rotation[ln.frameA0], &boneA.rotation[ln.frameA1], &boneB.rotation[ln.frameB0], &boneB.rotation[ln.frameB1] };
+			const Vector3F*   p[4] = { &boneA.position[ln.frameA0], &boneA.position[ln.frameA1], &boneB.position[ln.frameB0], &boneB.position[ln.frameB1] };
+
+			valid[l] = boneA.name.empty() ? 0.0f : 1.0f;
+			parent[l] = boneA.name.empty() ? -1 : boneA.parent;
+			sameParent = sameParent && parent[l] == parent[0];
+
+			for( int k=0; k<4; ++k ) {
+				if ( boneA.name.empty() ) {
+					qIn[k][0][l] = qIn[k][1][l] = qIn[k][2][l] = 0;
+					qIn[k][3][l] = 1;
+					pIn[k][0][l] = pIn[k][1][l] = pIn[k][2][l] = 0;
+				}
+				else {
+					qIn[k][0][l] = q[k]->x;	qIn[k][1][l] = q[k]->y;	qIn[k][2][l] = q[k]->z;	qIn[k][3][l] = q[k]->w;
+					pIn[k][0][l] = p[k]->x;	pIn[k][1][l] = p[k]->y;	pIn[k][2][l] = p[k]->z;
+				}
+			}
+			for( int k=0; k<3; ++k ) {
+				refPos[k][l] = boneA.refPos.X(k);
+				refConcat[k][l] = boneA.refConcat.X(k);
+			}
+		}
+
+		// Position: lerp each sequence, then the cross fade.
+		// If the position isn't set, use the reference position.
+		F4 t[3];
+		for( int k=0; k<3; ++k ) {
+			F4 a = Lerp( Load( pIn[0][k] ), Load( pIn[1][k] ), fractionA );
+			F4 c = Lerp( Load( pIn[2][k] ), Load( pIn[3][k] ), fractionB );
+			t[k] = Lerp( a, c, cross );
+		}
+		const F4 epsilon = Splat( ZERO_EPSILON );
+		F4 zero = And( And( LessEqual( Abs( t[0] ), epsilon ), LessEqual( Abs( t[1] ), epsilon )), LessEqual( Abs( t[2] ), epsilon ));
+		for( int k=0; k<3; ++k ) {
+			t[k] = Select( zero, Load( refPos[k] ), t[k] );
+		}
+
+		// Rotation: the same, with slerp.
+		F4 q0[4], q1[4], qA[4], qB[4], q[4];
+		for( int k=0; k<4; ++k ) { q0[k] = Load( qIn[0][k] ); q1[k] = Load( qIn[1][k] ); }
+		Slerp( q0, q1, fractionA, qA );
+		for( int k=0; k<4; ++k ) { q0[k] = Load( qIn[2][k] ); q1[k] = Load( qIn[3][k] ); }
+		Slerp( q0, q1, fractionB, qB );
+		Slerp( qA, qB, cross, q );
+
+		// Quaternion::ToMatrix(), and the translation.
+		const F4 two = Splat( 2.0f );
+		const F4 one = Splat( 1.0f );
+		const F4 xx = Mul( q[0], q[0] ), yy = Mul( q[1], q[1] ), zz = Mul( q[2], q[2] );
+		const F4 xy = Mul( q[0], q[1] ), xz = Mul( q[0], q[2] ), yz = Mul( q[1], q[2] );
+		const F4 xw = Mul( q[0], q[3] ), yw = Mul( q[1], q[3] ), zw = Mul( q[2], q[3] );
+		F4 m[12];
+		m[0]  = Sub( one, Mul( two, simd::Add( yy, zz )));
+		m[1]  = Mul( two, simd::Add( xy, zw ));
+		m[2]  = Mul( two, Sub( xz, yw ));
+		m[3]  = Mul( two, Sub( xy, zw ));
+		m[4]  = Sub( one, Mul( two, simd::Add( xx, zz )));
+		m[5]  = Mul( two, simd::Add( yz, xw ));
+		m[6]  = Mul( two, simd::Add( xz, yw ));
+		m[7]  = Mul( two, Sub( yz, xw ));
+		m[8]  = Sub( one, Mul( two, simd::Add( xx, yy )));
+		m[9]  = t[0];
+		m[10] = t[1];
+		m[11] = t[2];
+
+		// Concatenate with the parent. (Bones come after their parents.)
+		F4 c[12];
+		if ( sameParent && parent[0] < 0 ) {
+			for( int k=0; k<12; ++k ) c[k] = m[k];
+		}
+		else {
+			F4 p[12];
+			for( int k=0; k<12; ++k ) {
+				if ( sameParent ) {
+					p[k] = Load( concat[parent[0]][k] );
+				}
+				else {
+					float g[LANES];
+					for( int l=0; l<LANES; ++l ) {
+						GLASSERT( parent[l] < b );
+						g[l] = parent[l] >= 0 ? concat[parent[l]][k][l] : IDENTITY[k];
+					}
+					p[k] = Load( g );
+				}
+			}
+			for( int col=0; col<4; ++col ) {
+				for( int row=0; row<3; ++row ) {
+					F4 sum = col == 3 ? p[9+row] : Splat( 0 );
+					for( int j=0; j<3; ++j ) {
+						sum = MulAdd( p[j*3+row], m[col*3+j], sum );
+					}
+					c[col*3+row] = sum;
+				}
+			}
+		}
+
+		// The output is concat * inverse reference, where the
+		// inverse is the translation -refConcat.
+		F4 out[12];
+		const F4 isValid = LessEqual( Splat( 0.5f ), Load( valid ));
+		for( int k=0; k<9; ++k ) {
+			out[k] = c[k];
+		}
+		for( int row=0; row<3; ++row ) {
+			F4 sum = c[9+row];
+			for( int j=0; j<3; ++j ) {
+				sum = Sub( sum, Mul( c[j*3+row], Load( refConcat[j] )));
+			}
+			out[9+row] = sum;
+		}
+		for( int k=0; k<12; ++k ) {
+			Store( concat[b][k], Select( isValid, c[k], Splat( IDENTITY[k] )));
+			out[k] = Select( isValid, out[k], Splat( IDENTITY[k] ));
+		}
+
+		// Scatter to the models, in Model bone order.
+		float o[12][LANES];
+		for( int k=0; k<12; ++k ) {
+			Store( o[k], out[k] );
+		}
+		for( int l=0; l<n; ++l ) {
+			int index = lane[l]->animToModelMap[b];
+			if ( index < 0 ) continue;
+
+			float* x = lane[l]->boneMats[index].Mem();
+			for( int col=0; col<4; ++col ) {
+				for( int row=0; row<3; ++row ) {
+					x[col*4+row] = o[col*3+row][l];
+				}
+				x[col*4+3] = ( col == 3 ) ? 1.0f : 0.0f;
+			}
+		}
+	}
+	for( int l=0; l<n; ++l ) {
+		if ( lanes[l].model ) {
+			lanes[l].model->SetAnimationCached();
+		}
+	}
+}
+
+
+// Made up bones, for one sequence. Variant 1 has different
+// parents, so a group has lanes that don't agree on the parent.
+static const int TEST_BONES = 12;
+static const int TEST_FRAMES = 5;
+
+static void TestBones( BoneData* boneData, int variant, Random* random )
+{
+	for( int i=0; i<TEST_BONES; ++i ) {
+		BoneData::Bone& bone = boneData->bone[i];
+		CStr<16> name;
+		name.Format( "bone%d", i );
+		bone.name = StringPool::Intern( name.c_str() );
+		bone.parent = ( i == 0 ) ? -1 : ( variant ? (i-1)/2 : i-1 );
+		bone.refPos.Set( random->Uniform() - 0.5f, random->Uniform(), random->Uniform() - 0.5f );
+		bone.refConcat.Set( random->Uniform() - 0.5f, random->Uniform() - 0.5f, random->Uniform() );
+
+		for( int f=0; f<TEST_FRAMES; ++f ) {
+			Quaternion& q = bone.rotation[f];
+			if ( f > 0 && i % 3 == 0 ) {
+				// Nearly the same rotation: the lerp path.
+				q = bone.rotation[f-1];
+				q.x += 0.001f;
+			}
+			else {
+				q.x = random->Uniform() - 0.5f;
+				q.y = random->Uniform() - 0.5f;
+				q.z = random->Uniform() - 0.5f;
+				q.w = random->Uniform() - 0.5f;
+			}
+			q.Normalize();
+
+			// Bones with no position use the reference position.
+			if ( i % 4 == 1 ) 
+				bone.position[f].Zero();
+			else
+				bone.position[f].Set( random->Uniform() - 0.5f, random->Uniform() - 0.5f, random->Uniform() - 0.5f );
+		}
+	}
+}
+
+
+void AnimationBatch::Test()
+{
+	Random random( 17 );
+	AnimationResource* res[2] = { new AnimationResource( 0 ), new AnimationResource( 0 ) };
+	for( int r=0; r<2; ++r ) {
+		for( int type=ANIM_STAND; type<=ANIM_WALK; ++type ) {
+			res[r]->sequence[type].totalDuration = 1000 + 200*type;
+			res[r]->sequence[type].nFrames = TEST_FRAMES;
+			res[r]->sequence[type].nBones = TEST_BONES;
+			TestBones( &res[r]->sequence[type].boneData, r, &random );
+		}
+	}
+
+	static const int N = 11;	// leaves a partial group
+	static const float CROSS[N] = { 0, 0, 0.5f, 0, 0.1f, 0.9f, 0, 0.33f, 1.0f, 0, 0.75f };
+	int map[EL_MAX_BONES];
+	for( int i=0; i<EL_MAX_BONES; ++i ) {
+		map[i] = i;
+	}
+
+	CDynArray< Lane > lanes;
+	CDynArray< Matrix4 > boneMats;
+	boneMats.PushArr( N*EL_MAX_BONES );
+	for( int i=0; i<N; ++i ) {
+		Lane* lane = lanes.PushArr( 1 );
+		lane->model = 0;
+		lane->boneMats = boneMats.Mem() + i*EL_MAX_BONES;
+		lane->animToModelMap = map;
+		SetLane( res[i&1], ANIM_STAND + (i%3 == 2), 137*i + 11, ANIM_WALK, 291*i + 50, CROSS[i], lane );
+	}
+	for( int i=0; i<N; i+=LANES ) {
+		EvaluateGroup( lanes.Mem() + i, Min( int(LANES), N - i ));
+	}
+
+	// The batch uses polynomial acos and sin in the slerp,
+	// so it isn't exact.
+	float maxError = 0;
+	for( int i=0; i<N; ++i ) {
+		Matrix4 expected[EL_MAX_BONES];
+		res[i&1]->GetTransform( ANIM_STAND + (i%3 == 2), 137*i + 11, ANIM_WALK, 291*i + 50, CROSS[i], expected );
+		for( int b=0; b<EL_MAX_BONES; ++b ) {
+			for( int k=0; k<16; ++k ) {
+				float e = expected[b].Mem()[k];
+				float err = fabsf( lanes[i].boneMats[b].Mem()[k] - e ) / Max( 1.0f, fabsf( e ));
+				maxError = Max( maxError, err );
+			}
+		}
+	}
+	GLOUTPUT(( "AnimationBatch::Test maxError=%g\n", maxError ));
+	GLTEST( maxError < 1e-5f );
+
+	delete res[0];
+	delete res[1];
+}
@@ -0,0 +1,88 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANIMATIONBATCH_INCLUDED
+#define ANIMATIONBATCH_INCLUDED
+
+#include "../grinliz/gldebug.h"
+#include "../grinliz/gltypes.h"
+#include "../grinliz/glcontainer.h"
+
+class Model;
+class AnimationResource;
+struct BoneData;
+
+namespace grinliz {
+	class Matrix4;
+};
+
+/*
+	Computes the bone matrices for all the visible animated models
+	of a frame at once. Models are evaluated 4 at a time, one per
+	SIMD lane, walking the bones in skeleton order: keyframe lerp
+	and slerp, the cross fade, rotation to matrix, and concatenation
+	with the parent bone are all done on SoA data.
+
+	The results are written to each model's bone matrices (that the
+	RenderQueue copies per instance), and the model remembers the
+	animation state they are for. Models whose animation hasn't
+	advanced since then aren't added.
+*/
+class AnimationBatch
+{
+public:
+	AnimationBatch() : nCached(0) {}
+
+	void Clear()			{ lanes.Clear(); nCached = 0; }
+	// Add an animated model; does nothing if its bones are current.
+	void Add( Model* model );
+	// Compute and write out the bones. Optionally on the JobSystem.
+	void Evaluate( bool parallel );
+	// Compute the bones of one model (if they aren't current),
+	// without a batch. Used by Model::CalcAnimation().
+	static void EvaluateModel( Model* model );
+
+	int NumModels() const	{ return lanes.Size(); }
+	int NumCached() const	{ return nCached; }
+
+	// Checks the batch against AnimationResource::GetTransform().
+	static void Test();
+
+private:
+	enum { LANES = 4, GROUPS_PER_JOB = 8 };
+
+	// The inputs and outputs for one model. A model that isn't
+	// cross fading uses the A sequence for B, with cross=0.
+	struct Lane {
+		Model*				model;			// null if not for a Model
+		grinliz::Matrix4*	boneMats;		// written in model bone order
+		const int*			animToModelMap;
+		const BoneData*		boneA;			// also the skeleton
+		const BoneData*		boneB;
+		int					frameA0, frameA1, frameB0, frameB1;
+		float				fractionA, fractionB, cross;
+	};
+
+	// Returns false if the model's bones are current.
+	static bool SetModelLane( Model* model, Lane* lane );
+	static void SetLane( const AnimationResource* res, int typeA, U32 timeA, int typeB, U32 timeB, float cross, Lane* lane );
+	static void EvaluateGroup( const Lane* lanes, int n );
+	static void EvaluateJob( void* data, int start, int end );
+
+	grinliz::CDynArray< Lane > lanes;
+	int nCached;
+};
+
+#endif // ANIMATIONBATCH_INCLUDED
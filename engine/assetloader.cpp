@@ -0,0 +1,215 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "assetloader.h"
+#include "model.h"
+#include "animation.h"
+#include "texture.h"
+#include "gpustatemanager.h"
+
+#include "../grinliz/gljobsystem.h"
+
+#include <chrono>
+
+using namespace grinliz;
+
+typedef std::chrono::steady_clock Clock;
+
+static double MSecSince( Clock::time_point start )
+{
+	return std::chrono::duration<double, std::milli>( Clock::now() - start ).count();
+}
+
+/*static*/ bool AssetLoader::profileStartup = false;
+
+
+AssetLoader::AssetLoader( const gamedb::Reader* db ) : database( db )
+{
+}
+
+
+AssetLoader::~AssetLoader()
+{
+	for( int i=0; i<textures.Size(); ++i ) {
+		delete [] textures[i].pixels;
+	}
+}
+
+
+void AssetLoader::Load()
+{
+	LoadModels();
+	LoadAnimations();
+	if ( !GPUDevice::Headless() ) {
+		LoadTextures();
+	}
+}
+
+
+void AssetLoader::AddStage( const char* name, int count, double msec )
+{
+	Stage s = { name, count, msec };
+	stages.Push( s );
+}
+
+
+void AssetLoader::Report() const
+{
+	double total = 0;
+	printf( "Startup profile (%d threads):\n", JobSystem::Instance()->NumThreads() );
+	for( int i=0; i<stages.Size(); ++i ) {
+		printf( "  %-22s %5d %9.2f ms\n", stages[i].name, stages[i].count, stages[i].msec );
+		total += stages[i].msec;
+	}
+	printf( "  %-22s %5s %9.2f ms\n", "total", "", total );
+}
+
+
+/*static*/ void AssetLoader::DecodeModelsJob( void* data, int start, int end )
+{
+	AssetLoader* loader = (AssetLoader*)data;
+	ModelLoader modelLoader;	// scratch buffers are per job
+	for( int i=start; i<end; ++i ) {
+		modelLoader.Decode( loader->items[i], loader->models[i] );
+	}
+}
+
+
+void AssetLoader::LoadModels()
+{
+	Clock::time_point start = Clock::now();
+
+	const gamedb::Item* parent = database->Root()->Child( "models" );
+	GLASSERT( parent );
+
+	items.Clear();
+	models.Clear();
+	for( int i=0; i<parent->NumChildren(); ++i ) {
+		items.Push( parent->ChildAt( i ));
+		models.Push( new ModelResource() );
+	}
+	JobSystem::Instance()->ParallelFor( items.Size(), 1, DecodeModelsJob, this );
+	AddStage( "models: decode", items.Size(), MSecSince( start ));
+
+	start = Clock::now();
+	for( int i=0; i<items.Size(); ++i ) {
+		ModelLoader::Resolve( items[i], models[i] );
+		ModelResourceManager::Instance()->AddModelResource( models[i] );
+	}
+	AddStage( "models: register", items.Size(), MSecSince( start ));
+	models.Clear();
+}
+
+
+/*static*/ void AssetLoader::DecodeAnimationsJob( void* data, int start, int end )
+{
+	AssetLoader* loader = (AssetLoader*)data;
+	for( int i=start; i<end; ++i ) {
+		loader->animations[i] = new AnimationResource( loader->items[i] );
+	}
+}
+
+
+void AssetLoader::LoadAnimations()
+{
+	Clock::time_point start = Clock::now();
+
+	const gamedb::Item* parent = database->Root()->Child( "animations" );
+	GLASSERT( parent );
+
+	items.Clear();
+	animations.Clear();
+	for( int i=0; i<parent->NumChildren(); ++i ) {
+		items.Push( parent->ChildAt( i ));
+		animations.Push( 0 );
+	}
+	JobSystem::Instance()->ParallelFor( items.Size(), 1, DecodeAnimationsJob, this );
+	AddStage( "animations: decode", items.Size(), MSecSince( start ));
+
+	start = Clock::now();
+	for( int i=0; i<animations.Size(); ++i ) {
+		AnimationResourceManager::Instance()->Add( animations[i] );
+	}
+	AddStage( "animations: register", animations.Size(), MSecSince( start ));
+	animations.Clear();
+}
+
+
+/*static*/ void AssetLoader::DecodeTexturesJob( void* data, int start, int end )
+{
+	AssetLoader* loader = (AssetLoader*)data;
+	for( int i=start; i<end; ++i ) {
+		TextureJob* job = &loader->textures[i];
+		const gamedb::Item* item = job->texture->DBItem();
+
+		int offset = 0;
+		bool compressed = false;
+		item->GetDataInfo( "pixels", &offset, &job->size, &compressed );
+		if ( compressed ) {
+			job->pixels = new U8[job->size];
+			item->GetData( "pixels", job->pixels, job->size );
+		}
+	}
+}
+
+
+void AssetLoader::LoadTextures()
+{
+	// The textures the models asked for. (The UI textures are
+	// still loaded when first used.) They go in batches so that
+	// all the pixels aren't in memory at once.
+	static const int BATCH = 16;
+	TextureManager* texman = TextureManager::Instance();
+	CDynArray< Texture* > pending;
+	for( int i=0; i<(int)texman->NumTextures(); ++i ) {
+		Texture* t = texman->TextureAt( i );
+		if ( t->DBItem() && t->Pending() ) {
+			pending.Push( t );
+		}
+	}
+
+	double decode = 0, upload = 0;
+	for( int b=0; b<pending.Size(); b += BATCH ) {
+		Clock::time_point start = Clock::now();
+		textures.Clear();
+		for( int i=b; i<pending.Size() && i<b+BATCH; ++i ) {
+			TextureJob job = { pending[i], 0, 0 };
+			textures.Push( job );
+		}
+		JobSystem::Instance()->ParallelFor( textures.Size(), 1, DecodeTexturesJob, this );
+		decode += MSecSince( start );
+
+		start = Clock::now();
+		for( int i=0; i<textures.Size(); ++i ) {
+			TextureJob* job = &textures[i];
+			if ( job->pixels ) {
+				job->texture->Upload( job->pixels, job->size );
+				delete [] job->pixels;
+				job->pixels = 0;
+			}
+			else {
+				// Not compressed: upload straight from the mapping.
+				const gamedb::Item* item = job->texture->DBItem();
+				int size = 0;
+				const void* pixels = gamedb::Reader::GetContext( item )->AccessData( item, "pixels", &size );
+				job->texture->Upload( pixels, size );
+			}
+		}
+		upload += MSecSince( start );
+	}
+	textures.Clear();
+	AddStage( "textures: decode", pending.Size(), decode );
+	AddStage( "textures: upload", pending.Size(), upload );
+}
@@ -0,0 +1,86 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef XENOENGINE_ASSET_LOADER_INCLUDED
+#define XENOENGINE_ASSET_LOADER_INCLUDED
+
+#include "../grinliz/gltypes.h"
+#include "../grinliz/gldebug.h"
+#include "../grinliz/glcontainer.h"
+#include "../shared/gamedbreader.h"
+
+class ModelResource;
+class AnimationResource;
+class Texture;
+
+/*	Loads the models, animations, and database textures at startup.
+	The reading and unpacking - decompression, expanding the vertices
+	and indices per instance, the animation bone walks, and texture
+	pixels - runs on the JobSystem. Adding resources to the managers,
+	and the GL upload, happen on the calling thread, which needs to be
+	the render thread. Headless, the textures are neither decoded nor
+	uploaded.
+*/
+class AssetLoader
+{
+public:
+	AssetLoader( const gamedb::Reader* database );
+	~AssetLoader();
+
+	// The managers need to exist, and the host created textures
+	// that models use need to be created, before Load().
+	void Load();
+
+	// Prints the time of each stage.
+	void Report() const;
+
+	// Set by --profile-startup
+	static void SetProfileStartup( bool p )	{ profileStartup = p; }
+	static bool ProfileStartup()			{ return profileStartup; }
+
+private:
+	struct Stage {
+		const char* name;
+		int count;
+		double msec;
+	};
+
+	struct TextureJob {
+		Texture* texture;
+		U8* pixels;		// null if the pixels can be used straight from the database
+		int size;
+	};
+
+	void LoadModels();
+	void LoadAnimations();
+	void LoadTextures();
+	void AddStage( const char* name, int count, double msec );
+
+	static void DecodeModelsJob( void* data, int start, int end );
+	static void DecodeAnimationsJob( void* data, int start, int end );
+	static void DecodeTexturesJob( void* data, int start, int end );
+
+	const gamedb::Reader* database;
+
+	grinliz::CDynArray< const gamedb::Item* >	items;
+	grinliz::CDynArray< ModelResource* >		models;
+	grinliz::CDynArray< AnimationResource* >	animations;
+	grinliz::CDynArray< TextureJob >			textures;
+	grinliz::CDynArray< Stage >					stages;
+
+	static bool profileStartup;
+};
+
+#endif // XENOENGINE_ASSET_LOADER_INCLUDED
@@ -18,6 +18,7 @@
 #include "../grinliz/glmatrix.h"
 #include "../grinliz/glvector.h"
 #include "../grinliz/glgeometry.h"
+#include "../grinliz/gljobsystem.h"
 #include "../Shiny/include/Shiny.h"
 
 #include "../audio/xenoaudio.h"
@@ -68,12 +69,14 @@ Engine::Engine( Screenport* port, const gamedb::Reader* database, Map* m )
 	map = m;
 	temperature = 0;
 	frame = 0;
+	parallelPrep = true;
 	if ( map ) 
 		spaceTree = new SpaceTree( -0.1f, 3.1f, Max( m->Width(), m->Height() ) );
 	else
 		spaceTree = new SpaceTree( -0.1f, 3.1f, 64 );
 
 	renderQueue = new RenderQueue();
+	spaceTree->SetParallel(parallelPrep);
 	for( int i=0; i<RT_COUNT; ++i )
 		renderTarget[i] = 0;
 	ShaderManager::Instance()->AddDeviceLossHandler( this );
@@ -93,6 +96,8 @@ Engine::~Engine()
 	delete particleSystem;
 	ShaderManager::Instance()->RemoveDeviceLossHandler( this );
 	delete renderQueue;
+	for (int i = 0; i < chunkQueues.Size(); ++i)
+		delete chunkQueues[i];
 	delete spaceTree;
 	for( int i=0; i<RT_COUNT; ++i )
 		delete renderTarget[i];
@@ -211,24 +216,191 @@ Texture* Engine::GetMiniMapTexture()
 }
 
 
-void Engine::QueueSet(	EngineShaders* engineShaders, 
-					    const CDynArray<Model*>& models,
-						int requiredModelFlag, int excludedModelFlag,						
-						int requiredShaderFlag, int excludedShaderFlag )
+void Engine::SetParallelPrep( bool p )
 {
-	renderQueue->Clear();
-	for (int i = 0; i < models.Size(); ++i) {
+	parallelPrep = p;
+	spaceTree->SetParallel(p);
+	particleSystem->SetParallel(p);
+}
+
+
+static void QueueModels(RenderQueue* queue, EngineShaders* engineShaders,
+						Model* const* models, int nModels,
+						int requiredModelFlag, int excludedModelFlag,
+						int requiredShaderFlag, int excludedShaderFlag)
+{
+	for (int i = 0; i < nModels; ++i) {
 		Model* model = models[i];
 		int flag = model->Flags();
 		if (    (( requiredModelFlag & flag ) == requiredModelFlag )
 			 && (( excludedModelFlag & flag ) == 0 ) )
 		{
-			model->Queue( renderQueue, engineShaders, requiredShaderFlag, excludedShaderFlag );
+			model->Queue( queue, engineShaders, requiredShaderFlag, excludedShaderFlag );
 		}
 	}
 }
 
 
+struct QueueSetData
+{
+	EngineShaders* engineShaders;
+	const CDynArray<Model*>* models;
+	RenderQueue* const* queues;
+	int requiredModelFlag, excludedModelFlag;
+	int requiredShaderFlag, excludedShaderFlag;
+};
+
+
+void Engine::QueueJob(void* _data, int start, int end)
+{
+	const QueueSetData* data = (const QueueSetData*)_data;
+	for (int chunk = start; chunk < end; ++chunk) {
+		RenderQueue* queue = data->queues[chunk];
+		int first = chunk * QUEUE_CHUNK;
+		int n = Min(int(QUEUE_CHUNK), data->models->Size() - first);
+
+		queue->Clear();
+		QueueModels(queue, data->engineShaders, data->models->Mem() + first, n,
+					data->requiredModelFlag, data->excludedModelFlag,
+					data->requiredShaderFlag, data->excludedShaderFlag);
+	}
+}
+
+
+void Engine::QueueSet(	EngineShaders* engineShaders, 
+					    const CDynArray<Model*>& models,
+						int requiredModelFlag, int excludedModelFlag,						
+						int requiredShaderFlag, int excludedShaderFlag )
+{
+	renderQueue->Clear();
+
+	const int nChunks = (models.Size() + QUEUE_CHUNK - 1) / QUEUE_CHUNK;
+	if (!parallelPrep || nChunks < 2) {
+		QueueModels(renderQueue, engineShaders, models.Mem(), models.Size(),
+					requiredModelFlag, excludedModelFlag, requiredShaderFlag, excludedShaderFlag);
+		return;
+	}
+
+	// Model::Queue() only writes to its own model (including the
+	// bone matrices from CalcAnimation) so the models can be queued
+	// in parallel, a chunk per queue. The queues are appended in
+	// order, so the result is the same as the serial fill.
+	while (chunkQueues.Size() < nChunks) {
+		chunkQueues.Push(new RenderQueue());
+	}
+	QueueSetData data = { engineShaders, &models, chunkQueues.Mem(),
+						  requiredModelFlag, excludedModelFlag, requiredShaderFlag, excludedShaderFlag };
+	JobSystem::Instance()->ParallelFor(nChunks, 1, QueueJob, &data);
+
+	for (int i = 0; i < nChunks; ++i) {
+		renderQueue->Append(*chunkQueues[i]);
+	}
+}
+
+
+void Engine::CullModels(Plane* planes)
+{
+	// Compute the frustum planes and query the tree.
+	CalcFrustumPlanes(planes);
+
+	// Get the working set of models.
+	modelCache.Clear();
+	spaceTree->Query(&modelCache, planes, 6, 0, true, 0, Model::MODEL_INVISIBLE);
+
+	// Track the UI relevant ones:
+	trackedModels.Clear();
+	for (int i = 0; i < modelCache.Size(); ++i) {
+		Model* m = modelCache[i];
+		if (m->Flags() & Model::MODEL_UI_TRACK) {
+			trackedModels.Push(m);
+		}
+	}
+}
+
+
+void Engine::AnimateModels()
+{
+	// All the bones in view, batched, before the queues are
+	// filled. Model::Queue() then finds them cached.
+	animationBatch.Clear();
+	for (int i = 0; i < modelCache.Size(); ++i) {
+		Model* m = modelCache[i];
+		if (m->HasAnimation()) {
+			animationBatch.Add(m);
+		}
+	}
+	animationBatch.Evaluate(parallelPrep);
+}
+
+
+static void PushLightShaders(EngineShaders* engineShaders)
+{
+	int flag = ShaderManager::LIGHTING;
+	LightShader light( flag );
+	LightShader em( flag );
+	em.SetShaderFlag( ShaderManager::EMISSIVE );
+	LightShader blend( flag, BLEND_NORMAL );
+
+	engineShaders->Push( EngineShaders::LIGHT, light );
+	engineShaders->Push( EngineShaders::EMISSIVE, em );
+	engineShaders->Push( EngineShaders::BLEND, blend );
+}
+
+
+static void SetGlowShader(FlatShader* emEx)
+{
+	//emEx->SetColor(1, 0, 0);
+	emEx->SetShaderFlag(ShaderManager::EMISSIVE);			// Interpret alpha as emissive.
+	emEx->SetShaderFlag(ShaderManager::EMISSIVE_EXCLUSIVE);	// Render emmissive colors or black.
+}
+
+
+static void SetShadowShader(FlatShader* shadowShader)
+{
+	shadowShader->SetStencilMode( STENCIL_WRITE );
+	shadowShader->SetDepthTest( false );	// flat plane. 1st pass.
+	shadowShader->SetDepthWrite( false );
+	shadowShader->SetColorWrite( false );
+}
+
+
+int Engine::PrepFrame()
+{
+	screenport->SetViewMatrices(camera.ViewMatrix());
+	screenport->SetPerspective(0);
+
+	Plane planes[6];
+	CullModels(planes);
+	AnimateModels();
+
+	EngineShaders engineShaders;
+	PushLightShaders(&engineShaders);
+	int nItems = 0;
+
+	// The same queues as the glow, shadow, and model passes of Draw().
+	FlatShader emEx;
+	SetGlowShader(&emEx);
+	engineShaders.PushAll(emEx);
+	QueueSet(&engineShaders, modelCache, 0, 0, 0, 0);
+	nItems += renderQueue->Size();
+	engineShaders.PopAll();
+
+	FlatShader shadowShader;
+	SetShadowShader(&shadowShader);
+	engineShaders.PushAll(shadowShader);
+	QueueSet(&engineShaders, modelCache, 0, Model::MODEL_NO_SHADOW, 0, EngineShaders::BLEND);
+	nItems += renderQueue->Size();
+	engineShaders.PopAll();
+
+	QueueSet(&engineShaders, modelCache, 0, 0, 0, 0);
+	nItems += renderQueue->Size();
+
+	engineShaders.PopAll();
+	renderQueue->Clear();
+	return nItems;
+}
+
+
 void Engine::Draw(U32 deltaTime, const Bolt* bolts, int nBolts, IUITracker* tracker)
 {
 	PROFILE_FUNC();
@@ -277,22 +449,9 @@ void Engine::Draw(U32 deltaTime, const Bolt* bolts, int nBolts, IUITracker* trac
 #endif
 #endif
 
-	// Compute the frustum planes and query the tree.
 	Plane planes[6];
-	CalcFrustumPlanes(planes);
-
-	// Get the working set of models.
-	modelCache.Clear();
-	spaceTree->Query(&modelCache, planes, 6, 0, true, 0, Model::MODEL_INVISIBLE);
-
-	// Track the UI relevant ones:
-	trackedModels.Clear();
-	for (int i = 0; i < modelCache.Size(); ++i) {
-		Model* m = modelCache[i];
-		if (m->Flags() & Model::MODEL_UI_TRACK) {
-			trackedModels.Push(m);
-		}
-	}
+	CullModels(planes);
+	AnimateModels();
 
 	if ( map && (stages & STAGE_VOXEL) ) {
 		ENGINE_DETAILED_PROFILE(MapPrep);
@@ -310,17 +469,7 @@ void Engine::Draw(U32 deltaTime, const Bolt* bolts, int nBolts, IUITracker* trac
 	device->diffuse = diffuse;
 
 	EngineShaders engineShaders;
-	{
-		int flag = ShaderManager::LIGHTING;
-		LightShader light( flag );
-		LightShader em( flag );
-		em.SetShaderFlag( ShaderManager::EMISSIVE );
-		LightShader blend( flag, BLEND_NORMAL );
-
-		engineShaders.Push( EngineShaders::LIGHT, light );
-		engineShaders.Push( EngineShaders::EMISSIVE, em );
-		engineShaders.Push( EngineShaders::BLEND, blend );
-	}
+	PushLightShaders(&engineShaders);
 	Rectangle2I mapBounds( 0, 0, MAX_MAP_SIZE-1, MAX_MAP_SIZE-1 );
 	if ( map ) {
 		mapBounds = map->Bounds();
@@ -341,9 +490,7 @@ void Engine::Draw(U32 deltaTime, const Bolt* bolts, int nBolts, IUITracker* trac
 		{
 			// Tweak the shaders for glow-only rendering.
 			FlatShader emEx;
-			//emEx.SetColor(1, 0, 0);
-			emEx.SetShaderFlag(ShaderManager::EMISSIVE);			// Interpret alpha as emissive.
-			emEx.SetShaderFlag(ShaderManager::EMISSIVE_EXCLUSIVE);	// Render emmissive colors or black.
+			SetGlowShader(&emEx);
 
 			// Replace all kinds of lighting with emissive:
 			engineShaders.PushAll(emEx);
@@ -374,10 +521,7 @@ void Engine::Draw(U32 deltaTime, const Bolt* bolts, int nBolts, IUITracker* trac
 		if ( shadowAmount > 0.0f && (stages & STAGE_SHADOW) ) {
 
 			FlatShader shadowShader;
-			shadowShader.SetStencilMode( STENCIL_WRITE );
-			shadowShader.SetDepthTest( false );	// flat plane. 1st pass.
-			shadowShader.SetDepthWrite( false );
-			shadowShader.SetColorWrite( false );
+			SetShadowShader(&shadowShader);
 
 			engineShaders.PushAll( shadowShader );
 			QueueSet( &engineShaders, modelCache, 0, Model::MODEL_NO_SHADOW, 0, EngineShaders::BLEND );
@@ -696,6 +840,44 @@ ModelVoxel Engine::IntersectModelVoxel( const Vector3F& origin,
 }
 
 
+void Engine::IntersectModelVoxel( const ModelRay* rays, int nRays, ModelVoxel* result )
+{
+	rayCache.Clear();
+	rayHit.Clear();
+	rayAt.Clear();
+	rayHit.PushArr( nRays );
+	rayAt.PushArr( nRays );
+
+	// The voxels are per ray; they limit the length of the model test.
+	for( int i=0; i<nRays; ++i ) {
+		ModelRay* ray = rayCache.PushArr( 1 );
+		*ray = rays[i];
+		ray->dir.Normalize();
+
+		result[i] = ModelVoxel();
+		if ( map ) {
+			result[i].voxel = map->IntersectVoxel( ray->origin, ray->dir, ray->length, &result[i].at );
+			if ( result[i].voxel.x >= 0 ) {
+				float voxelLength = ( ray->origin - result[i].at ).Length();
+				ray->length = Min( ray->length, voxelLength );
+			}
+		}
+		rayAt[i] = result[i].at;
+	}
+
+	spaceTree->QueryRays( rayCache.Mem(), nRays, rayHit.Mem(), rayAt.Mem() );
+
+	for( int i=0; i<nRays; ++i ) {
+		if ( rayHit[i] ) {
+			// Clear the voxel! can only have one state.
+			result[i].model = rayHit[i];
+			result[i].at = rayAt[i];
+			result[i].voxel.Set( -1, -1, -1 );
+		}
+	}
+}
+
+
 void Engine::RestrictCamera( const grinliz::Rectangle2F* bounds )
 {
 	const Vector3F* eyeDir = camera.EyeDir3();
@@ -32,6 +32,8 @@
 #include "lighting.h"
 #include "shadermanager.h"
 #include "uirendering.h"
+#include "animationbatch.h"
+#include "modelbvh.h"
 
 #include "../gamui/gamui.h"
 
@@ -95,6 +97,15 @@ public:
 	// Send everything to the GPU
 	void Draw( U32 deltaTime, const Bolt* bolts=0, int nBolts=0, IUITracker* tracker=0 );
 
+	// The CPU side of Draw(): culls and fills the render queue for
+	// each model pass, but doesn't submit. Makes no GL calls, so it
+	// can be run headless. Returns the number of items queued.
+	int PrepFrame();
+
+	// Cull and fill the render queues on the JobSystem. (Default on.)
+	void SetParallelPrep( bool p );
+	bool ParallelPrep() const		{ return parallelPrep; }
+
 	enum {
 		GLOW_EMISSIVE,
 		SHADOW,
@@ -141,6 +152,10 @@ public:
 									HitTestMethod testMethod,
 									int required, int exclude, const Model* const * ignore );
 
+	// IntersectModelVoxel() for many rays at once, which is much
+	// faster than one at a time for the model tests.
+	void IntersectModelVoxel( const ModelRay* rays, int nRays, ModelVoxel* result );
+
 	enum {
 		PLANE_NEAR,
 		PLANE_FAR,
@@ -200,6 +215,9 @@ private:
 	void CalcCameraRotation( grinliz::Matrix4* );
 
 	void Blur();
+	void CullModels( grinliz::Plane* planes );
+	void AnimateModels();
+	static void QueueJob( void* data, int start, int end );
 	void QueueSet(	EngineShaders* engineShaders, 
 					const grinliz::CDynArray<Model*>& models,
 					int requiredModelFlag,  int excludedModelFlag,
@@ -211,16 +229,24 @@ private:
 	int		stages;
 	float	temperature;
 	int		frame;
+	bool	parallelPrep;
 	
 	Map*			map;
 	SpaceTree*		spaceTree;
 	RenderQueue*	renderQueue;
 	BoltRenderer*	boltRenderer;
 
+	enum { QUEUE_CHUNK = 64 };		// models per job when filling the queue
+	grinliz::CDynArray<RenderQueue*> chunkQueues;
+	AnimationBatch animationBatch;
+
 	RenderTarget* renderTarget[RT_COUNT];
 
 	grinliz::CDynArray<const Model*> trackedModels;
 	grinliz::CDynArray<Model*> modelCache;
+	grinliz::CDynArray<ModelRay> rayCache;
+	grinliz::CDynArray<Model*> rayHit;
+	grinliz::CDynArray<grinliz::Vector3F> rayAt;
 	UIRenderer uiRenderer;
 };
 
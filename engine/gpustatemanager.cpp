@@ -29,6 +29,8 @@ using namespace grinliz;
 GPUVertexBuffer::GPUVertexBuffer( const void* vertex, int size )
 {
 	this->sizeInBytes = size;
+	id = 0;
+	if ( GPUDevice::Headless() ) return;
 
 	CHECK_GL_ERROR;
 	glGenBuffersX( 1, (GLuint*) &id );
@@ -41,12 +43,15 @@ GPUVertexBuffer::GPUVertexBuffer( const void* vertex, int size )
 
 GPUVertexBuffer::~GPUVertexBuffer() 
 {
-	glDeleteBuffersX( 1, (GLuint*) &id );
+	if ( id ) {
+		glDeleteBuffersX( 1, (GLuint*) &id );
+	}
 }
 
 
 void GPUVertexBuffer::Upload( const void* data, int nBytes, int start )
 {
+	if ( !id ) return;
 	CHECK_GL_ERROR;
 	glBindBufferX( GL_ARRAY_BUFFER, id );
 	glBufferSubDataX( GL_ARRAY_BUFFER, start, nBytes, data );
@@ -59,6 +64,8 @@ GPUIndexBuffer::GPUIndexBuffer( const U16* index, int nIndex )
 {
 	this->nIndex = nIndex;
 	U32 dataSize  = sizeof(U16)*nIndex;
+	id = 0;
+	if ( GPUDevice::Headless() ) return;
 
 	CHECK_GL_ERROR;
 	glGenBuffersX( 1, (GLuint*) &id );
@@ -80,6 +87,7 @@ GPUIndexBuffer::~GPUIndexBuffer()
 
 void GPUIndexBuffer::Upload( const uint16_t* data, int count, int start )
 {
+	if ( !id ) return;
 	CHECK_GL_ERROR;
 	glBindBufferX( GL_ELEMENT_ARRAY_BUFFER, id );
 	glBufferSubDataX( GL_ELEMENT_ARRAY_BUFFER, start*sizeof(uint16_t), count*sizeof(uint16_t), data );
@@ -128,6 +136,7 @@ void MatrixStack::Multiply( const grinliz::Matrix4& m )
 
 
 GPUDevice* GPUDevice::instance = 0;
+bool GPUDevice::headless = false;
 
 GPUDevice::GPUDevice()
 {
@@ -182,6 +191,8 @@ GPUDevice::~GPUDevice()
 
 void GPUDevice::ResetState()
 {
+	if ( headless ) return;
+
 	// Texture unit 0
 	glActiveTexture( GL_TEXTURE0 );
 
@@ -236,6 +236,12 @@ public:
 	static GPUDevice* Instance()	{ if ( !instance ) instance = new GPUDevice(); return instance; }
 	~GPUDevice();
 
+	// Headless: there is no GL context. Buffers and textures are
+	// never created on the GPU, and nothing may be drawn. Must
+	// be set before any resources are loaded.
+	static void SetHeadless( bool h )	{ headless = h; }
+	static bool Headless()				{ return headless; }
+
 	void ResetState();
 	void Clear( float r, float g, float b, float a );
 
@@ -295,6 +301,7 @@ public:
 
 private:
 	static GPUDevice* instance;
+	static bool headless;
 	GPUDevice();
 
 	enum { NUM_QUAD_BUFFERS = 64 };
@@ -18,6 +18,7 @@
 #include "gpustatemanager.h"
 
 #include "../grinliz/glutil.h"
+#include "../grinliz/gljobsystem.h"
 #include "model.h"
 
 #include <float.h>
@@ -40,6 +41,12 @@ SpaceTree::SpaceTree( float yMin, float yMax, int _size )
 	treeBounds.Set( 0, yMin, 0, (float)size, yMax, (float)size );
 	lightXPerY = 0;
 	lightZPerY = 0;
+	parallel = false;
+	queryPlanes = 0;
+	queryNPlanes = 0;
+	queryRect = 0;
+	queryShadow = false;
+	nTasks = 0;
 	InitNode();
 }
 
@@ -123,6 +130,7 @@ void SpaceTree::Update( Model* model )
 		Node* node = (Node*)model->spaceTreeNode;
 		node->Remove(model);
 	}
+	bvh.Update(model);
 	GLASSERT(model->spaceTreeNext == 0);
 	GLASSERT(model->spaceTreePrev == 0);
 	GLASSERT(model->spaceTreeNode == 0);
@@ -154,6 +162,17 @@ void SpaceTree::Update( Model* model )
 
 
 
+void SpaceTree::Remove( Model* model )
+{
+	GLASSERT(model->spaceTree == this);
+	if (model->spaceTreeNode) {
+		Node* node = (Node*)model->spaceTreeNode;
+		node->Remove(model);
+	}
+	bvh.Remove(model);
+}
+
+
 SpaceTree::Node* SpaceTree::GetNode( int depth, int x, int z )
 {
 	GLASSERT( depth >=0 && depth < DEPTH );
@@ -180,7 +199,68 @@ void SpaceTree::Query(grinliz::CDynArray<Model*>* models, const Plane* planes, i
 	excludedFlags = excluded;
 	zones.Clear();
 
-	QueryPlanesRec(models, planes, nPlanes, clipRect, includeShadow, grinliz::INTERSECT, &nodeArr[0], 0);
+	// Ray and rectangle queries are small; only split the frustum query.
+	if (parallel && nPlanes && nodeArr[0].nModels >= PARALLEL_MODELS) {
+		QueryParallel(models, planes, nPlanes, clipRect, includeShadow);
+		return;
+	}
+
+	rootTask.Begin(models);
+	QueryPlanesRec(&rootTask, planes, nPlanes, clipRect, includeShadow, grinliz::INTERSECT, &nodeArr[0], 0, DEPTH);
+	EndTask(rootTask);
+}
+
+
+void SpaceTree::QueryParallel(grinliz::CDynArray<Model*>* models, const Plane* planes, int nPlanes, const Rectangle3F* clipRect, bool includeShadow)
+{
+	// The top of the tree is walked here, and queues up the
+	// nodes at SPLIT_DEPTH that weren't culled. Each of those
+	// sub-trees is a job with its own output, which is appended
+	// in tree order so the result doesn't depend on the threads.
+	nTasks = 0;
+	rootTask.Begin(models);
+	QueryPlanesRec(&rootTask, planes, nPlanes, clipRect, includeShadow, grinliz::INTERSECT, &nodeArr[0], 0, SPLIT_DEPTH);
+	EndTask(rootTask);
+
+	queryPlanes = planes;
+	queryNPlanes = nPlanes;
+	queryRect = clipRect;
+	queryShadow = includeShadow;
+	JobSystem::Instance()->ParallelFor(nTasks, 1, QueryJob, this);
+	queryPlanes = 0;
+	queryRect = 0;
+
+	for (int i = 0; i < nTasks; ++i) {
+		const QueryTask& task = tasks[i];
+		Model** dst = models->PushArr(task.modelStore.Size());
+		for (int j = 0; j < task.modelStore.Size(); ++j) {
+			dst[j] = task.modelStore[j];
+		}
+		EndTask(task);
+	}
+}
+
+
+void SpaceTree::QueryJob(void* data, int start, int end)
+{
+	SpaceTree* tree = (SpaceTree*)data;
+	for (int i = start; i < end; ++i) {
+		QueryTask* task = &tree->tasks[i];
+		task->modelStore.Clear();
+		task->Begin(&task->modelStore);
+		tree->QueryPlanesRec(task, tree->queryPlanes, tree->queryNPlanes, tree->queryRect, tree->queryShadow,
+							 task->intersection, task->node, task->positive, DEPTH);
+	}
+}
+
+
+void SpaceTree::EndTask(const QueryTask& task)
+{
+	nodesVisited += task.nodesVisited;
+	planesComputed += task.planesComputed;
+	for (int i = 0; i < task.zones.Size(); ++i) {
+		zones.Push(task.zones[i]);
+	}
 }
 
 
@@ -244,19 +324,30 @@ void SpaceTree::Dump( Node* node )
 #endif
 
 
-void SpaceTree::QueryPlanesRec(grinliz::CDynArray<Model*>* models,
+void SpaceTree::QueryPlanesRec(QueryTask* task,
 							   const Plane* planes, int nPlanes,
 							   const Rectangle3F* clipRect,
 							   bool includeShadow,
-							   int intersection, const Node* node, U32 positive)
+							   int intersection, const Node* node, U32 positive,
+							   int splitDepth)
 {
 #define IS_POSITIVE( pos, i ) ( pos & (1<<i) )
 	const U32 allPositive = (1 << nPlanes) - 1;
 
+	if (node->depth == splitDepth) {
+		// Hand the sub-tree off to a job.
+		GLASSERT(nTasks < NUM_TASKS);
+		QueryTask* split = &tasks[nTasks++];
+		split->node = node;
+		split->intersection = intersection;
+		split->positive = positive;
+		return;
+	}
+
 	if (intersection == grinliz::POSITIVE)
 	{
 		// we are fully inside, and don't need to check.
-		++nodesVisited;
+		++task->nodesVisited;
 	}
 	else if (intersection == grinliz::INTERSECT)
 	{
@@ -279,7 +370,7 @@ void SpaceTree::QueryPlanesRec(grinliz::CDynArray<Model*>* models,
 				int comp = grinliz::POSITIVE;
 				if (IS_POSITIVE(positive, i) == 0) {
 					comp = ComparePlaneAABB(planes[i], aabb);
-					++planesComputed;
+					++task->planesComputed;
 				}
 
 				// If the aabb is negative of any plane, it is culled.
@@ -302,7 +393,7 @@ void SpaceTree::QueryPlanesRec(grinliz::CDynArray<Model*>* models,
 				intersection = grinliz::POSITIVE;
 			}
 		}
-		++nodesVisited;
+		++task->nodesVisited;
 	}
 	if (intersection != grinliz::NEGATIVE)
 	{
@@ -314,7 +405,7 @@ void SpaceTree::QueryPlanesRec(grinliz::CDynArray<Model*>* models,
 			int c = (size >> (node->depth));
 			voxel.max.x += c - 1;
 			voxel.max.y += c - 1;
-			zones.Push(voxel);
+			task->zones.Push(voxel);
 		}
 
 		const int _requiredFlags = requiredFlags;
@@ -351,7 +442,7 @@ void SpaceTree::QueryPlanesRec(grinliz::CDynArray<Model*>* models,
 					}
 				}
 				//GLOUTPUT(( "...yes\n" ));
-				models->Push(m);
+				task->models->Push(m);
 			}
 		}
 
@@ -359,7 +450,7 @@ void SpaceTree::QueryPlanesRec(grinliz::CDynArray<Model*>* models,
 			// We could, in theory, early out using the number of models. But this makes the
 			// zones for the voxel system super-big, which is a big problem.
 			for (int i = 0; i < 4; ++i) {
-				QueryPlanesRec(models, planes, nPlanes, clipRect, includeShadow, intersection, node->child[i], positive);
+				QueryPlanesRec(task, planes, nPlanes, clipRect, includeShadow, intersection, node->child[i], positive, splitDepth);
 			}
 		}
 	}
@@ -367,87 +458,157 @@ void SpaceTree::QueryPlanesRec(grinliz::CDynArray<Model*>* models,
 }
 
 
-Model* SpaceTree::QueryRay( const Vector3F& _origin, 
-							const Vector3F& _direction, 
+Model* SpaceTree::QueryRay( const Vector3F& origin, 
+							const Vector3F& direction, 
 							float length,
 							int required, int excluded, const Model* const * ignore,
 							HitTestMethod testType,
 							Vector3F* intersection ) 
 {
-	//GLOUTPUT(( "query ray\n" ));
-	nodesVisited = 0;
-	requiredFlags = required;
-	excludedFlags = excluded;
-
-	Vector3F dummy;
-	if ( !intersection ) {
-		intersection = &dummy;
-	}
-
-	Vector3F dir = _direction;
-	dir.Normalize();
-
-	Rectangle3F aabb = treeBounds;
-
-	// Where does this ray enter and leave the spaceTree?
-	// It enters at 'p0' and leaves at 'p1'
-	int p0Test, p1Test;
-	Vector3F p0, p1;
-	int test = IntersectRayAllAABB( _origin, dir, aabb, &p0Test, &p0, &p1Test, &p1 );
-	if ( test != grinliz::INTERSECT ) {
-		// Can click outside of AABB pretty commonly, actually.
-		return 0;
-	}
-	Rectangle3F worldBounds;
-	worldBounds.FromPair( p0, p1 );
-
-	Rectangle3F rayBounds;
-	rayBounds.FromPair( _origin, _origin+dir*length );
-
-	Rectangle3F pathBounds = rayBounds;
-	pathBounds.DoIntersection( worldBounds );
-
-	queryCache.Clear();
-	Query( &queryCache, 0, 0, &pathBounds, false, required, excluded );
-
-	// We now have a batch of models. Are any of them a hit??
-	GLASSERT( testType == TEST_HIT_AABB || testType == TEST_TRI );
-
-	float close = length;
-	Model* closeModel = 0;
-	Vector3F testInt;
-	float t;
+	ModelRay ray;
+	ray.origin = origin;
+	ray.dir = direction;
+	ray.length = length;
+	ray.method = testType;
+	ray.required = required;
+	ray.excluded = excluded;
+	ray.ignore = ignore;
+
+	Model* model = 0;
+	QueryRays( &ray, 1, &model, intersection );
+	return model;
+}
 
-	for (int i = 0; i < queryCache.Size(); ++i) {
-		Model* root = queryCache[i];
 
-		if ( Ignore( root, ignore ) )
+void SpaceTree::QueryRays( const ModelRay* rays, int nRays, Model** hit, Vector3F* intersection )
+{
+	rayCache.Clear();
+	rayIndex.Clear();
+
+	for( int i=0; i<nRays; ++i ) {
+		hit[i] = 0;
+		GLASSERT( rays[i].method == TEST_HIT_AABB || rays[i].method == TEST_TRI );
+
+		Vector3F dir = rays[i].dir;
+		dir.Normalize();
+
+		// Where does this ray enter and leave the spaceTree?
+		// It enters at 'p0' and leaves at 'p1'
+		int p0Test, p1Test;
+		Vector3F p0 = rays[i].origin, p1 = p0;
+		int test = IntersectRayAllAABB( rays[i].origin, dir, treeBounds, &p0Test, &p0, &p1Test, &p1 );
+		if ( test != grinliz::INTERSECT ) {
+			// Can click outside of AABB pretty commonly, actually.
 			continue;
-
-		//GLOUTPUT(( "Consider: %s\n", root->GetResource()->header.name ));
-		t = FLT_MAX;
-		int result = root->IntersectRay((testType == TEST_TRI), p0, dir, &testInt);
-
-		if ( result == grinliz::INTERSECT ) {
-			Vector3F delta = p0 - testInt;
-			t = delta.Length();
-			//GLOUTPUT(( "Hit: %s t=%.2f\n", root->GetResource()->header.name, t ));
-		}	
-
-		if ( result == grinliz::INTERSECT ) {
-			// Ugly little bug: check for t>=0, else could collide with objects
-			// that touch the bounding box but are before the ray starts.
-			if ( t >= 0.0f && t <= close ) {
-				closeModel = root;
-				*intersection = testInt;
-				close = t;
+		}
+		// The distance is from where the ray enters the tree.
+		ModelRay* ray = rayCache.PushArr( 1 );
+		*ray = rays[i];
+		ray->origin = p0;
+		ray->dir = dir;
+		rayIndex.Push( i );
+	}
+	if ( rayCache.Empty() )
+		return;
+
+	rayHit.Clear();
+	rayAt.Clear();
+	rayHit.PushArr( rayCache.Size() );
+	rayAt.PushArr( rayCache.Size() );
+	bvh.QueryRays( rayCache.Mem(), rayCache.Size(), rayHit.Mem(), rayAt.Mem() );
+
+	for( int i=0; i<rayCache.Size(); ++i ) {
+		if ( rayHit[i] ) {
+			int index = rayIndex[i];
+			hit[index] = rayHit[i];
+			if ( intersection ) {
+				intersection[index] = rayAt[i];
 			}
 		}
 	}
-	if ( closeModel ) {
-		return closeModel;
+}
+
+
+/*static*/ void SpaceTree::Test()
+{
+	SpaceTree* tree = new SpaceTree(-0.1f, 3.1f, 64);
+
+	ModelResource res;
+	res.header.bounds.Set(-0.5f, 0, -0.5f, 0.5f, 1.0f, 0.5f);
+	res.hitBounds = res.header.bounds;
+	res.invariantBounds = res.header.bounds;
+
+	Model* m0 = new Model(&res, tree);
+	Model* m1 = new Model(&res, tree);
+	Model* m2 = new Model(&res, tree);
+	m0->SetPos(10, 0, 10);
+	m1->SetPos(20, 0, 10);
+	m2->SetPos(30, 0, 10);
+	m2->SetFlag(Model::MODEL_INVISIBLE);
+
+	static const Vector3F RIGHT = { 1, 0, 0 };
+	static const Vector3F DOWN = { 0, -1, 0 };
+	const Vector3F start = { 5, 0.5f, 10 };
+	const Model* ignore[2] = { m0, 0 };
+	Vector3F at = { 0, 0, 0 };
+
+	// The first model along the ray.
+	GLTEST(tree->QueryRay(start, RIGHT, 100, 0, 0, 0, TEST_HIT_AABB, &at) == m0);
+	GLTEST(Equal(at.x, 9.5f, 0.01f));
+	GLTEST(tree->QueryRay(start, RIGHT, 100, 0, 0, ignore, TEST_HIT_AABB, &at) == m1);
+	GLTEST(tree->QueryRay(start, RIGHT, 4.0f, 0, 0, 0, TEST_HIT_AABB, &at) == 0);
+	ignore[1] = m1;
+	GLTEST(tree->QueryRay(start, RIGHT, 100, 0, 0, ignore, TEST_HIT_AABB, &at) == m2);
+	GLTEST(tree->QueryRay(start, RIGHT, 100, 0, Model::MODEL_INVISIBLE, ignore, TEST_HIT_AABB, &at) == 0);
+	GLTEST(tree->QueryRay(start, RIGHT, 100, Model::MODEL_INVISIBLE, 0, 0, TEST_HIT_AABB, &at) == m2);
+
+	// From the sky, in to the tree: hits. Beside the tree: misses,
+	// and doesn't write the intersection.
+	const Vector3F sky = { 20, 50, 10 };
+	GLTEST(tree->QueryRay(sky, DOWN, 1000, 0, 0, 0, TEST_HIT_AABB, &at) == m1);
+	GLTEST(Equal(at.y, 1.0f, 0.01f));
+	const Vector3F outside = { -10, 50, 10 };
+	at.Set(1, 2, 3);
+	GLTEST(tree->QueryRay(outside, DOWN, 1000, 0, 0, 0, TEST_HIT_AABB, &at) == 0);
+	GLTEST(at.x == 1 && at.y == 2 && at.z == 3);
+	// A model out of the tree bounds is in the BVH, but a
+	// ray that misses the tree still doesn't find it.
+	Model* m3 = new Model(&res, tree);
+	m3->SetPos(-5, 0, 10);
+	const Vector3F besideStart = { -5, 0.5f, 5 };
+	static const Vector3F FORWARD = { 0, 0, 1 };
+	GLTEST(tree->QueryRay(besideStart, FORWARD, 100, 0, 0, 0, TEST_HIT_AABB, &at) == 0);
+	delete m3;
+
+	// The batch is the same as one at a time.
+	ModelRay rays[3];
+	rays[0].origin = start;		rays[0].dir = RIGHT;	rays[0].length = 100;
+	rays[1].origin = outside;	rays[1].dir = DOWN;		rays[1].length = 1000;
+	rays[2].origin = sky;		rays[2].dir = DOWN;		rays[2].length = 1000;
+	for (int i = 0; i < 3; ++i) {
+		rays[i].method = TEST_HIT_AABB;
+		rays[i].required = 0;
+		rays[i].excluded = Model::MODEL_INVISIBLE;
+		rays[i].ignore = 0;
 	}
-	return 0;
+	Model* hit[3] = { m2, m2, m2 };
+	tree->QueryRays(rays, 3, hit, 0);
+	GLTEST(hit[0] == m0);
+	GLTEST(hit[1] == 0);
+	GLTEST(hit[2] == m1);
+
+	// Moves are picked up.
+	m0->SetPos(40, 0, 40);
+	GLTEST(tree->QueryRay(start, RIGHT, 100, 0, 0, 0, TEST_HIT_AABB, &at) == m1);
+	m0->SetPos(15, 0, 10);
+	GLTEST(tree->QueryRay(start, RIGHT, 100, 0, 0, 0, TEST_HIT_AABB, &at) == m0);
+
+	delete m0;
+	delete m1;
+	GLTEST(tree->QueryRay(start, RIGHT, 100, 0, 0, 0, TEST_HIT_AABB, &at) == m2);
+	delete m2;
+	GLTEST(tree->BVH().NumModels() == 0);
+	delete tree;
 }
 
 
@@ -17,6 +17,7 @@
 #define LOOSEQUADTREE_INCLUDED
 
 #include "enginelimits.h"
+#include "modelbvh.h"
 #include "../grinliz/glvector.h"
 #include "../grinliz/glcontainer.h"
 #include "../grinliz/glgeometry.h"
@@ -29,6 +30,10 @@ class Model;
 	debugging.
 
 	May need a future tweak.
+
+	Ray queries don't use the quadtree: the models are
+	also kept in a ModelBVH, which is much tighter for
+	rays.
 */
 class SpaceTree
 {
@@ -36,16 +41,29 @@ public:
 	enum {
 		DEPTH = 6,
 		MAX_ZONES = 1024,
-		NUM_NODES = 1+4+16+64+256+1024
+		NUM_NODES = 1+4+16+64+256+1024,
+
+		// Frustum queries of big trees are split in to a
+		// job per node at SPLIT_DEPTH.
+		SPLIT_DEPTH = 3,
+		NUM_TASKS = 64,
+		PARALLEL_MODELS = 256
 	};
 
 	SpaceTree( float yMin, float yMax, int size );
 	~SpaceTree();
 
 	void SetLightDir( const grinliz::Vector3F& light );
+
+	// Run frustum (plane) queries on the JobSystem. The results
+	// are the same set as the serial query, in a different order.
+	void SetParallel( bool p )	{ parallel = p; }
+	bool Parallel() const		{ return parallel; }
 	
 	// Called whenever a model moves. (Usually called automatically be the model.)
 	void   Update( Model* );
+	// Called when a model is deleted.
+	void   Remove( Model* );
 
 	// Returns all the models in the planes.
 	// Limits to BOTH planes and rectangle. Only one
@@ -67,6 +85,17 @@ public:
 					 HitTestMethod method,
 					 grinliz::Vector3F* intersection );
 
+	// QueryRay() for many rays at once; they walk the BVH together.
+	// The intersection is only written for the rays that hit, and
+	// may be null.
+	void QueryRays( const ModelRay* rays, int nRays, 
+					Model** hit, grinliz::Vector3F* intersection );
+
+	const ModelBVH& BVH() const	{ return bvh; }
+
+	// Needs the AnimationResourceManager, for the Models.
+	static void Test();
+
 #ifdef DEBUG
 	// Draws debugging info about the spacetree.
 	void Draw();
@@ -106,26 +135,45 @@ private:
 
 	void Dump( Node* node );
 
-	bool Ignore( const Model* m, const Model* const * ignore ) {
-		if ( ignore ) {
-			while ( *ignore ) {
-				if ( *ignore == m )
-					return true;
-				++ignore;
-			}
+	// The output of (part of) a query. A sub-tree that is
+	// split off to a job starts at 'node', with the culling
+	// state of its parent.
+	struct QueryTask {
+		const Node* node;
+		int intersection;
+		U32 positive;
+
+		grinliz::CDynArray<Model*>* models;
+		grinliz::CDynArray<Model*> modelStore;
+		grinliz::CDynArray<grinliz::Rectangle2I> zones;
+		int nodesVisited;
+		int planesComputed;
+
+		void Begin( grinliz::CDynArray<Model*>* m ) {
+			models = m;
+			zones.Clear();
+			nodesVisited = 0;
+			planesComputed = 0;
 		}
-		return false;
-	}
+	};
 
 	void InitNode();
-	void QueryPlanesRec(grinliz::CDynArray<Model*>* models,
+	void QueryParallel( grinliz::CDynArray<Model*>* models,
+						const grinliz::Plane* planes,
+						int nPlanes,
+						const grinliz::Rectangle3F* rect,
+						bool includeShadow );
+	void QueryPlanesRec(QueryTask* task,
 						const grinliz::Plane* planes,
 						int nPlanes,
 						const grinliz::Rectangle3F* rect,
 						bool includeShadow,
 						int intersection,
 						const Node* node,
-						U32 positive);
+						U32 positive,
+						int splitDepth);
+	void EndTask( const QueryTask& task );
+	static void QueryJob( void* data, int start, int end );
 
 	Node* GetNode( int depth, int x, int z );
 
@@ -141,8 +189,23 @@ private:
 	int requiredFlags;
 	int excludedFlags;
 
+	bool parallel;
+	const grinliz::Plane* queryPlanes;		// the current parallel query
+	int queryNPlanes;
+	const grinliz::Rectangle3F* queryRect;
+	bool queryShadow;
+
 	grinliz::CArray<grinliz::Rectangle2I, MAX_ZONES> zones;
-	grinliz::CDynArray<Model*> queryCache;
+
+	ModelBVH bvh;
+	grinliz::CDynArray<ModelRay> rayCache;		// the rays that are in the tree bounds
+	grinliz::CDynArray<int> rayIndex;
+	grinliz::CDynArray<Model*> rayHit;
+	grinliz::CDynArray<grinliz::Vector3F> rayAt;
+
+	int nTasks;
+	QueryTask rootTask;
+	QueryTask tasks[NUM_TASKS];
 
 	Node nodeArr[NUM_NODES];
 };
@@ -20,6 +20,7 @@
 #include "engineshaders.h"
 #include "shadermanager.h"
 #include "animation.h"
+#include "animationbatch.h"
 #include "serialize.h"
 #include "particle.h"
 
@@ -31,6 +32,8 @@
 
 using namespace grinliz;
 
+static const U32 NO_CROSS_FADE = U32(-1);
+
 static const char* gMetaName[EL_NUM_METADATA] = {
 	"target",
 	"trigger",
@@ -111,6 +114,13 @@ int ModelResource::Intersect(	const grinliz::Vector3F& point,
 
 
 void ModelLoader::Load( const gamedb::Item* item, ModelResource* res )
+{
+	Decode( item, res );
+	Resolve( item, res );
+}
+
+
+void ModelLoader::Decode( const gamedb::Item* item, ModelResource* res )
 {
 	res->header.Load( item );
 
@@ -139,9 +149,12 @@ void ModelLoader::Load( const gamedb::Item* item, ModelResource* res )
 
 	for( U32 i=0; i<res->header.nAtoms; ++i )
 	{
-		const gamedb::Item* groupItem = item->Child( i );
-		LoadAtom( groupItem, i, res );
-		//GLOUTPUT(( "  '%s' vertices=%d tris=%d\n", textureName, (int)res->atom[i].nVertex, (int)(res->atom[i].nIndex/3) ));
+		ModelGroup group;
+		group.Load( item->Child( i ) );
+
+		res->atom[i].Init();
+		res->atom[i].nVertex = group.nVertex;
+		res->atom[i].nIndex = group.nIndex;
 	}
 
 	vBuffer.Clear();	
@@ -221,25 +234,24 @@ void ModelLoader::Load( const gamedb::Item* item, ModelResource* res )
 }
 
 
-void ModelLoader::LoadAtom( const gamedb::Item* item, int i, ModelResource* res )
+/*static*/ void ModelLoader::Resolve( const gamedb::Item* item, ModelResource* res )
 {	
-	ModelGroup group;
-	group.Load( item );
+	for( U32 i=0; i<res->header.nAtoms; ++i ) {
+		ModelGroup group;
+		group.Load( item->Child( i ) );
 
-	const char* textureName = group.textureName.c_str();
-	if ( !textureName[0] ) {
-		textureName = "white";
-	}
+		const char* textureName = group.textureName.c_str();
+		if ( !textureName[0] ) {
+			textureName = "white";
+		}
 
-	GLString base, texname, extension;
-	StrSplitFilename( GLString( textureName ), &base, &texname, &extension );
-	Texture* t = TextureManager::Instance()->GetTexture( texname.c_str() );
+		GLString base, texname, extension;
+		StrSplitFilename( GLString( textureName ), &base, &texname, &extension );
+		Texture* t = TextureManager::Instance()->GetTexture( texname.c_str() );
 
-	GLASSERT( t );        
-	res->atom[i].Init();
-	res->atom[i].texture = t;
-	res->atom[i].nVertex = group.nVertex;
-	res->atom[i].nIndex = group.nIndex;
+		GLASSERT( t );        
+		res->atom[i].texture = t;
+	}
 }
 
 
@@ -260,6 +272,7 @@ void Model::Init(const ModelResource* resource, SpaceTree* st)
 	this->spaceTreeNode = 0;
 	this->spaceTreeNext = 0;
 	this->spaceTreePrev = 0;
+	this->spaceTreeLeaf = -1;
 	this->resource = resource;
 	this->tree = st;
 	this->auxBone = 0;
@@ -317,6 +330,8 @@ void Model::Init(const ModelResource* resource, SpaceTree* st)
 	currentAnim.Init();
 	prevAnim.Init();
 	cachedAnim.Init();
+	cachedPrevAnim.Init();
+	cachedCrossFade = NO_CROSS_FADE;
 
 	hasParticles = false;
 	if (resource) {
@@ -331,11 +346,11 @@ void Model::Init(const ModelResource* resource, SpaceTree* st)
 
 Model::~Model()	
 {	
-	if (this->spaceTreeNode) {
-		SpaceTree::Node* node = (SpaceTree::Node*)this->spaceTreeNode;
-		node->Remove(this);
+	if (this->spaceTree) {
+		((SpaceTree*)this->spaceTree)->Remove(this);
 	}
 	GLASSERT(this->spaceTreeNode == 0);
+	GLASSERT(this->spaceTreeLeaf < 0);
 	GLASSERT(this->spaceTreeNext == 0);
 	GLASSERT(this->spaceTreePrev == 0);
 	delete auxBone;
@@ -399,15 +414,13 @@ void Model::Serialize( XStream* xs)
 		}
 		if ( auxBone ) {
 			save->OpenElement( "auxBone" );
-			XARC_SER_ARR(xs, auxBone->animToModelMap, EL_MAX_BONES);
-			XARC_SER_ARR(xs, auxBone->boneMats[0].Mem(), EL_MAX_BONES * 16);
+			XARC_SER_BULK(xs, auxBone->animToModelMap, EL_MAX_BONES);
+			XARC_SER_BULK(xs, auxBone->boneMats, EL_MAX_BONES);
 			save->CloseElement();
 		}
 		if (auxTex) {
 			save->OpenElement("auxTex");
-			XARC_SER(xs, auxTex->texture0XForm);
-			XARC_SER(xs, auxTex->texture0Clip);
-			XARC_SER(xs, auxTex->texture0ColorMap);
+			XARC_SER_BULK(xs, auxTex, 1);
 			save->CloseElement();
 		}
 	}
@@ -426,16 +439,14 @@ void Model::Serialize( XStream* xs)
 		if (hasAuxBone) {
 			load->OpenElement();	// aux
 			if (!auxBone) auxBone = new ModelAuxBone();
-			XARC_SER_ARR(xs, auxBone->animToModelMap, EL_MAX_BONES);
-			XARC_SER_ARR(xs, auxBone->boneMats[0].Mem(), EL_MAX_BONES * 16);
+			XARC_SER_BULK(xs, auxBone->animToModelMap, EL_MAX_BONES);
+			XARC_SER_BULK(xs, auxBone->boneMats, EL_MAX_BONES);
 			load->CloseElement();
 		}
 		if (hasAuxTex) {
 			load->OpenElement();
 			if (!auxTex) auxTex = new ModelAuxTex();
-			XARC_SER(xs, auxTex->texture0XForm);
-			XARC_SER(xs, auxTex->texture0Clip);
-			XARC_SER(xs, auxTex->texture0ColorMap);
+			XARC_SER_BULK(xs, auxTex, 1);
 			load->CloseElement();
 		}
 	}
@@ -501,6 +512,9 @@ void Model::SetScale( float s )
 	if ( debugScale != s ) {
 		debugScale = s;
 		Modify();
+		if ( tree ) {
+			tree->Update( this );	// the bounds scale too
+		}
 	}
 }
 
@@ -672,45 +686,38 @@ void Model::CalcHitAABB( Rectangle3F* aabb ) const
 }
 
 
-void Model::CalcAnimation()
+bool Model::AnimationCached() const
 {
-	GLASSERT( HasAnimation() );
-	GLASSERT( auxBone );
+	if ( !(cachedAnim == currentAnim) )
+		return false;
+	if ( CrossFading() )
+		return cachedPrevAnim == prevAnim && cachedCrossFade == crossFadeTime;
+	return cachedCrossFade == NO_CROSS_FADE;
+}
 
-	Matrix4 animMats[EL_MAX_BONES];
-	bool cached = false;
 
-	if ( (crossFadeTime < totalCrossFadeTime) && (prevAnim.id >= 0) ) {
-		float fraction = (float)crossFadeTime / (float)totalCrossFadeTime;
-		animationResource->GetTransform( prevAnim.id,    prevAnim.time,
-										 currentAnim.id, currentAnim.time,
-										 fraction,
-										 animMats );
+void Model::SetAnimationCached()
+{
+	cachedAnim = currentAnim;
+	if ( CrossFading() ) {
+		cachedPrevAnim = prevAnim;
+		cachedCrossFade = crossFadeTime;
 	}
 	else {
-		if ( cachedAnim == currentAnim ) {
-			cached = true;
-		}
-		else {
-			animationResource->GetTransform( currentAnim.id, currentAnim.time,
-											 0, 0, 0,
-											 animMats );
-			cachedAnim = currentAnim;
-		}
+		cachedPrevAnim.Init();
+		cachedCrossFade = NO_CROSS_FADE;
 	}
+}
 
-	if ( !cached ) {
-		GLASSERT(auxBone);
-		if (auxBone) {
-			// The animationResource returns boneMats in armature order.
-			// They need to be submitted in Model order.
-			for (int i = 0; i < EL_MAX_BONES; ++i) {
-				if (auxBone->animToModelMap[i] >= 0) {
-					auxBone->boneMats[auxBone->animToModelMap[i]] = animMats[i];
-				}
-			}
-		}
-	}
+
+void Model::CalcAnimation()
+{
+	GLASSERT( HasAnimation() );
+	GLASSERT( auxBone );
+
+	// Usually the Engine has already done this model, in the
+	// batch of everything in view, and the bones are cached.
+	AnimationBatch::EvaluateModel( this );
 }
 
 
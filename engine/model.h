@@ -234,10 +234,16 @@ public:
 	ModelLoader() 	{}
 	~ModelLoader()	{}
 
+	// Decode() and then Resolve().
 	void Load( const gamedb::Item*, ModelResource* res );
 
+	// Reads and unpacks the model; doesn't use the resource managers,
+	// so loaders on different threads can Decode() at the same time.
+	void Decode( const gamedb::Item*, ModelResource* res );
+	// Looks up the textures of the atoms. Main thread.
+	static void Resolve( const gamedb::Item*, ModelResource* res );
+
 private:
-	void LoadAtom( const gamedb::Item* item, int index, ModelResource* res );
 	grinliz::CDynArray<Vertex> vBuffer;
 	grinliz::CDynArray<U16> iBuffer;
 };
@@ -246,10 +252,13 @@ private:
 class Model final
 {
 	friend class SpaceTree;
+	friend class ModelBVH;
+	friend class AnimationBatch;
 	void* spaceTree;
 	void* spaceTreeNode;
 	Model* spaceTreeNext;
 	Model* spaceTreePrev;
+	int spaceTreeLeaf;		// in the ModelBVH of the spaceTree
 
 public:
 	// If spacetree is null, need to Attach
@@ -321,6 +330,9 @@ public:
 	void SetAnimationRate( float rate )						{ animationRate = rate; }
 	float GetAnimationRate() const							{ return animationRate; }
 	bool HasAnimation() const								{ return animationResource && (currentAnim.id>=0); }
+	// Computes the bones for the current animation state, if they
+	// aren't cached. Only writes to this model.
+	void CalcAnimation();
 
 	// WARNING: not really supported. Just for debug rendering. May break:
 	// normals, lighting, bounds, picking, etc. etc.
@@ -424,7 +436,11 @@ public:
 private:
 	void Init(const ModelResource* res, SpaceTree* tree);
 	const grinliz::Matrix4& InvXForm() const;
-	void CalcAnimation();
+
+	bool CrossFading() const { return (crossFadeTime < totalCrossFadeTime) && (prevAnim.id >= 0); }
+	// True if the bone matrices are for the current animation state.
+	bool AnimationCached() const;
+	void SetAnimationCached();
 
 	SpaceTree* tree;
 	const ModelResource* resource;
@@ -443,7 +459,9 @@ private:
 	};
 	AnimationState	currentAnim;
 	AnimationState	prevAnim;
-	AnimationState	cachedAnim;
+	AnimationState	cachedAnim;			// the state of the bone matrices
+	AnimationState	cachedPrevAnim;
+	U32				cachedCrossFade;	// NO_CROSS_FADE if not fading
 
 	float animationRate;
 	U32 totalCrossFadeTime;	// how much time the crossfade will use
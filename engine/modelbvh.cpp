@@ -0,0 +1,501 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "modelbvh.h"
+#include "model.h"
+#include "simd.h"
+
+#include "../grinliz/glutil.h"
+
+#include <string.h>
+#include <math.h>
+
+using namespace grinliz;
+using namespace simd;
+
+const float ModelBVH::MARGIN = 0.5f;
+
+
+static bool IgnoreModel( const Model* m, const Model* const * ignore )
+{
+	if ( ignore ) {
+		while ( *ignore ) {
+			if ( *ignore == m )
+				return true;
+			++ignore;
+		}
+	}
+	return false;
+}
+
+
+ModelBVH::ModelBVH() : root( NULL_NODE ), freeList( NULL_NODE ), nModels( 0 )
+{
+	// The node tests read groups of 4 rays; keep the unused ones defined.
+	memset( &batch, 0, sizeof(batch) );
+}
+
+
+ModelBVH::~ModelBVH()
+{
+	GLASSERT( nModels == 0 );
+}
+
+
+int ModelBVH::AllocNode()
+{
+	int index = freeList;
+	if ( index != NULL_NODE ) {
+		freeList = nodes[index].parent;
+	}
+	else {
+		index = nodes.Size();
+		nodes.PushArr( 1 );
+	}
+	Node& node = nodes[index];
+	node.aabb.Zero();
+	node.model = 0;
+	node.parent = NULL_NODE;
+	node.child[0] = node.child[1] = NULL_NODE;
+	node.height = 0;
+	node.inTree = false;
+	node.dirty = false;
+	return index;
+}
+
+
+void ModelBVH::FreeNode( int index )
+{
+	Node& node = nodes[index];
+	node.model = 0;
+	node.parent = freeList;
+	node.child[0] = node.child[1] = NULL_NODE;
+	node.height = -1;
+	node.inTree = false;
+	node.dirty = false;		// in case it is still on the dirty list
+	freeList = index;
+}
+
+
+void ModelBVH::Update( Model* model )
+{
+	int leaf = model->spaceTreeLeaf;
+	if ( leaf == NULL_NODE ) {
+		leaf = AllocNode();
+		nodes[leaf].model = model;
+		model->spaceTreeLeaf = leaf;
+		++nModels;
+	}
+	if ( !nodes[leaf].dirty ) {
+		nodes[leaf].dirty = true;
+		dirty.Push( leaf );
+	}
+}
+
+
+void ModelBVH::Remove( Model* model )
+{
+	int leaf = model->spaceTreeLeaf;
+	if ( leaf == NULL_NODE )
+		return;
+
+	GLASSERT( nodes[leaf].model == model );
+	if ( nodes[leaf].inTree ) {
+		RemoveLeaf( leaf );
+	}
+	FreeNode( leaf );
+	model->spaceTreeLeaf = NULL_NODE;
+	--nModels;
+}
+
+
+void ModelBVH::Refit()
+{
+	for( int i=0; i<dirty.Size(); ++i ) {
+		int leaf = dirty[i];
+		if ( !nodes[leaf].dirty )
+			continue;	// removed since
+		nodes[leaf].dirty = false;
+
+		// The same bounds Model::IntersectRay tests first.
+		const Rectangle3F& bounds = nodes[leaf].model->AABB();
+		if ( nodes[leaf].inTree ) {
+			if ( nodes[leaf].aabb.Contains( bounds ))
+				continue;	// still in the fat box
+			RemoveLeaf( leaf );
+		}
+		Rectangle3F fat = bounds;
+		fat.EdgeAdd( MARGIN );
+		nodes[leaf].aabb = fat;
+		InsertLeaf( leaf );
+	}
+	dirty.Clear();
+}
+
+
+void ModelBVH::InsertLeaf( int leaf )
+{
+	nodes[leaf].inTree = true;
+	nodes[leaf].height = 0;
+	if ( root == NULL_NODE ) {
+		root = leaf;
+		nodes[leaf].parent = NULL_NODE;
+		return;
+	}
+
+	// Walk down to the cheapest sibling, by the surface area
+	// the tree would grow.
+	const Rectangle3F leafAABB = nodes[leaf].aabb;
+	int index = root;
+	while ( !nodes[index].IsLeaf() ) {
+		const Node& node = nodes[index];
+		float area = Cost( node.aabb );
+		float combined = Cost( Union( node.aabb, leafAABB ));
+
+		// Cost of a new parent for this node and the leaf, and the
+		// cost pushed down to the children if we descend.
+		float cost = 2.0f * combined;
+		float inherited = 2.0f * ( combined - area );
+
+		float childCost[2];
+		for( int i=0; i<2; ++i ) {
+			const Node& child = nodes[node.child[i]];
+			float c = Cost( Union( leafAABB, child.aabb ));
+			if ( !child.IsLeaf() ) {
+				c -= Cost( child.aabb );
+			}
+			childCost[i] = c + inherited;
+		}
+		if ( cost < childCost[0] && cost < childCost[1] )
+			break;
+		index = ( childCost[0] < childCost[1] ) ? node.child[0] : node.child[1];
+	}
+
+	const int sibling = index;
+	const int oldParent = nodes[sibling].parent;
+	const int newParent = AllocNode();	// can move the nodes
+
+	Node& parent = nodes[newParent];
+	parent.parent = oldParent;
+	parent.aabb = Union( leafAABB, nodes[sibling].aabb );
+	parent.height = nodes[sibling].height + 1;
+	parent.inTree = true;
+	parent.child[0] = sibling;
+	parent.child[1] = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if ( oldParent != NULL_NODE ) {
+		Node& p = nodes[oldParent];
+		if ( p.child[0] == sibling )
+			p.child[0] = newParent;
+		else
+			p.child[1] = newParent;
+	}
+	else {
+		root = newParent;
+	}
+	FixUpwards( newParent );
+}
+
+
+void ModelBVH::RemoveLeaf( int leaf )
+{
+	nodes[leaf].inTree = false;
+	if ( leaf == root ) {
+		root = NULL_NODE;
+		return;
+	}
+
+	const int parent = nodes[leaf].parent;
+	const int grandParent = nodes[parent].parent;
+	const int sibling = ( nodes[parent].child[0] == leaf ) ? nodes[parent].child[1] : nodes[parent].child[0];
+	nodes[leaf].parent = NULL_NODE;
+
+	// The sibling takes the place of the parent.
+	nodes[sibling].parent = grandParent;
+	FreeNode( parent );
+	if ( grandParent != NULL_NODE ) {
+		Node& g = nodes[grandParent];
+		if ( g.child[0] == parent )
+			g.child[0] = sibling;
+		else
+			g.child[1] = sibling;
+		FixUpwards( grandParent );
+	}
+	else {
+		root = sibling;
+	}
+}
+
+
+void ModelBVH::FixUpwards( int index )
+{
+	while ( index != NULL_NODE ) {
+		index = Balance( index );
+
+		Node& node = nodes[index];
+		const Node& c0 = nodes[node.child[0]];
+		const Node& c1 = nodes[node.child[1]];
+		node.height = 1 + Max( c0.height, c1.height );
+		node.aabb = Union( c0.aabb, c1.aabb );
+
+		index = node.parent;
+	}
+}
+
+
+int ModelBVH::Balance( int iA )
+{
+	// If one side of A is 2 or more taller than the other, rotate
+	// the taller child up to replace A. Returns the new sub-root.
+	Node* A = &nodes[iA];
+	if ( A->IsLeaf() || A->height < 2 )
+		return iA;
+
+	const int iB = A->child[0];
+	const int iC = A->child[1];
+	Node* B = &nodes[iB];
+	Node* C = &nodes[iC];
+	const int balance = C->height - B->height;
+
+	if ( balance > 1 ) {
+		// Rotate C up.
+		const int iF = C->child[0];
+		const int iG = C->child[1];
+		Node* F = &nodes[iF];
+		Node* G = &nodes[iG];
+
+		C->child[0] = iA;
+		C->parent = A->parent;
+		A->parent = iC;
+		if ( C->parent != NULL_NODE ) {
+			Node& p = nodes[C->parent];
+			if ( p.child[0] == iA ) p.child[0] = iC;
+			else					p.child[1] = iC;
+		}
+		else {
+			root = iC;
+		}
+
+		// The taller of F and G stays with C.
+		if ( F->height > G->height ) {
+			C->child[1] = iF;
+			A->child[1] = iG;
+			G->parent = iA;
+			A->aabb = Union( B->aabb, G->aabb );
+			C->aabb = Union( A->aabb, F->aabb );
+			A->height = 1 + Max( B->height, G->height );
+			C->height = 1 + Max( A->height, F->height );
+		}
+		else {
+			C->child[1] = iG;
+			A->child[1] = iF;
+			F->parent = iA;
+			A->aabb = Union( B->aabb, F->aabb );
+			C->aabb = Union( A->aabb, G->aabb );
+			A->height = 1 + Max( B->height, F->height );
+			C->height = 1 + Max( A->height, G->height );
+		}
+		return iC;
+	}
+	if ( balance < -1 ) {
+		// Rotate B up.
+		const int iD = B->child[0];
+		const int iE = B->child[1];
+		Node* D = &nodes[iD];
+		Node* E = &nodes[iE];
+
+		B->child[0] = iA;
+		B->parent = A->parent;
+		A->parent = iB;
+		if ( B->parent != NULL_NODE ) {
+			Node& p = nodes[B->parent];
+			if ( p.child[0] == iA ) p.child[0] = iB;
+			else					p.child[1] = iB;
+		}
+		else {
+			root = iB;
+		}
+
+		if ( D->height > E->height ) {
+			B->child[1] = iD;
+			A->child[0] = iE;
+			E->parent = iA;
+			A->aabb = Union( C->aabb, E->aabb );
+			B->aabb = Union( A->aabb, D->aabb );
+			A->height = 1 + Max( C->height, E->height );
+			B->height = 1 + Max( A->height, D->height );
+		}
+		else {
+			B->child[1] = iE;
+			A->child[0] = iD;
+			D->parent = iA;
+			A->aabb = Union( C->aabb, D->aabb );
+			B->aabb = Union( A->aabb, E->aabb );
+			A->height = 1 + Max( C->height, D->height );
+			B->height = 1 + Max( A->height, E->height );
+		}
+		return iB;
+	}
+	return iA;
+}
+
+
+void ModelBVH::QueryRays( const ModelRay* rays, int nRays, Model** hit, Vector3F* intersection )
+{
+	Refit();
+	for( int i=0; i<nRays; i+=MAX_RAYS ) {
+		QueryBatch( rays + i, Min( int(MAX_RAYS), nRays - i ), 
+					hit + i, intersection ? intersection + i : 0 );
+	}
+}
+
+
+U64 ModelBVH::TestNode( const Rectangle3F& aabb, U64 mask ) const
+{
+	// Slab test of 4 rays at a time, against the part
+	// of each ray that is still interesting.
+	const F4 zero = Splat( 0 );
+	const F4 minX = Splat( aabb.min.x ), minY = Splat( aabb.min.y ), minZ = Splat( aabb.min.z );
+	const F4 maxX = Splat( aabb.max.x ), maxY = Splat( aabb.max.y ), maxZ = Splat( aabb.max.z );
+
+	U64 result = 0;
+	for( int g=0; g<MAX_RAYS && (mask >> g); g+=4 ) {
+		int bits = int(( mask >> g ) & 0xf);
+		if ( !bits )
+			continue;
+
+		const F4 ox = Load( batch.ox + g ), oy = Load( batch.oy + g ), oz = Load( batch.oz + g );
+		const F4 ix = Load( batch.ix + g ), iy = Load( batch.iy + g ), iz = Load( batch.iz + g );
+
+		F4 t0 = Mul( Sub( minX, ox ), ix );
+		F4 t1 = Mul( Sub( maxX, ox ), ix );
+		F4 tNear = Min( t0, t1 );
+		F4 tFar  = Max( t0, t1 );
+
+		t0 = Mul( Sub( minY, oy ), iy );
+		t1 = Mul( Sub( maxY, oy ), iy );
+		tNear = Max( tNear, Min( t0, t1 ));
+		tFar  = Min( tFar,  Max( t0, t1 ));
+
+		t0 = Mul( Sub( minZ, oz ), iz );
+		t1 = Mul( Sub( maxZ, oz ), iz );
+		tNear = Max( tNear, Min( t0, t1 ));
+		tFar  = Min( tFar,  Max( t0, t1 ));
+
+		F4 in = And( LessEqual( tNear, tFar ), 
+					 And( LessEqual( zero, tFar ), LessEqual( tNear, Load( batch.tMax + g ))));
+		result |= U64( MoveMask( in ) & bits ) << g;
+	}
+	return result;
+}
+
+
+void ModelBVH::QueryBatch( const ModelRay* rays, int nRays, Model** hit, Vector3F* intersection )
+{
+	GLASSERT( nRays <= MAX_RAYS );
+	// A direction of 0 on an axis is nudged, so 1/dir is finite
+	// and the slab test never sees 0*inf.
+	static const float EPS = 1.0e-12f;
+
+	U64 mask = 0;
+	for( int i=0; i<nRays; ++i ) {
+		const ModelRay& ray = rays[i];
+		hit[i] = 0;
+
+		Vector3F dir = ray.dir;
+		dir.Normalize();
+		batch.dir[i] = dir;
+		for( int k=0; k<3; ++k ) {
+			if ( fabsf( dir.X(k) ) < EPS ) {
+				dir.X(k) = ( dir.X(k) < 0 ) ? -EPS : EPS;
+			}
+		}
+		batch.ox[i] = ray.origin.x;
+		batch.oy[i] = ray.origin.y;
+		batch.oz[i] = ray.origin.z;
+		batch.ix[i] = 1.0f / dir.x;
+		batch.iy[i] = 1.0f / dir.y;
+		batch.iz[i] = 1.0f / dir.z;
+		batch.tMax[i] = ray.length;
+		mask |= U64(1) << i;
+	}
+	if ( root == NULL_NODE )
+		return;
+
+	stack.Clear();
+	StackEntry start = { root, mask };
+	stack.Push( start );
+
+	while ( !stack.Empty() ) {
+		const StackEntry e = stack.Pop();
+		const Node& node = nodes[e.node];
+
+		// Re-tested even though the parent passed: the rays
+		// may have hit something closer since this was pushed.
+		U64 m = TestNode( node.aabb, e.mask );
+		if ( !m ) 
+			continue;
+
+		if ( node.IsLeaf() ) {
+			Model* model = node.model;
+			const int flags = model->Flags();
+
+			for( int i=0; m; ++i, m >>= 1 ) {
+				if ( !( m & 1 ))
+					continue;
+				const ModelRay& ray = rays[i];
+				if (    (( ray.required & flags ) != ray.required )
+					 || ( ray.excluded & flags )
+					 || IgnoreModel( model, ray.ignore ))
+				{
+					continue;
+				}
+
+				Vector3F at;
+				if ( model->IntersectRay( ray.method == TEST_TRI, ray.origin, batch.dir[i], &at ) == grinliz::INTERSECT ) {
+					float t = ( ray.origin - at ).Length();
+					if ( t <= batch.tMax[i] ) {
+						batch.tMax[i] = t;
+						hit[i] = model;
+						if ( intersection ) {
+							intersection[i] = at;
+						}
+					}
+				}
+			}
+		}
+		else {
+			// Push the far child first, so the near one is walked
+			// first and shortens the rays. Near to the first ray.
+			int i = 0;
+			while ( !( m & ( U64(1) << i )))
+				++i;
+			const Vector3F origin = { batch.ox[i], batch.oy[i], batch.oz[i] };
+			int c0 = node.child[0];
+			int c1 = node.child[1];
+			float d0 = ( nodes[c0].aabb.Center() - origin ).LengthSquared();
+			float d1 = ( nodes[c1].aabb.Center() - origin ).LengthSquared();
+			if ( d0 < d1 ) {
+				Swap( &c0, &c1 );
+			}
+			StackEntry farEntry  = { c0, m };
+			StackEntry nearEntry = { c1, m };
+			stack.Push( farEntry );
+			stack.Push( nearEntry );
+		}
+	}
+}
@@ -0,0 +1,138 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MODELBVH_INCLUDED
+#define MODELBVH_INCLUDED
+
+#include "enginelimits.h"
+#include "../grinliz/gldebug.h"
+#include "../grinliz/gltypes.h"
+#include "../grinliz/glvector.h"
+#include "../grinliz/glgeometry.h"
+#include "../grinliz/glcontainer.h"
+
+class Model;
+
+// A ray to test against the models. The ignore list is null
+// terminated (or null), like SpaceTree::QueryRay.
+struct ModelRay
+{
+	grinliz::Vector3F	origin;
+	grinliz::Vector3F	dir;			// does not need to be unit length, will be normalized
+	float				length;			// maximum distance from origin to intersection or FLT_MAX
+	HitTestMethod		method;
+	int					required;
+	int					excluded;
+	const Model* const*	ignore;
+};
+
+/*
+	A dynamic bounding volume hierarchy over the model bounds,
+	for ray casts. (The SpaceTree quadtree is a good fit for
+	the frustum, not for thin rays.) It is a binary tree of
+	AABBs, balanced with rotations as leaves are inserted.
+
+	Leaves are "fat": the model bounds plus a margin. A model
+	that moves is only re-inserted when it leaves its fat
+	box. Moves are queued, and the tree is refit before the
+	next query, so a model that moves many times a frame
+	costs one update.
+
+	QueryRays() walks the tree once for a batch of rays, with
+	a mask of the rays still alive at each node, and tests
+	the node bounds against 4 rays at a time.
+*/
+class ModelBVH
+{
+public:
+	ModelBVH();
+	~ModelBVH();
+
+	// Queue the model to be (re)inserted. Cheap.
+	void Update( Model* model );
+	// Remove the model from the tree. Called when it is deleted.
+	void Remove( Model* model );
+	// Apply the queued moves; called by the queries.
+	void Refit();
+
+	// Returns the FIRST model hit by each ray (or null), and where
+	// it was hit. 'intersection' may be null.
+	void QueryRays( const ModelRay* rays, int nRays, Model** hit, grinliz::Vector3F* intersection );
+
+	int NumModels() const	{ return nModels; }
+	int Height() const		{ return root >= 0 ? nodes[root].height : 0; }
+
+private:
+	enum {
+		NULL_NODE = -1,
+		MAX_RAYS = 64		// rays per walk of the tree; one bit each
+	};
+	static const float MARGIN;
+
+	struct Node {
+		grinliz::Rectangle3F aabb;
+		Model* model;		// null if not a leaf
+		int parent;			// or the next free node
+		int child[2];
+		int height;			// leaf is 0, free is -1
+		bool inTree;
+		bool dirty;
+
+		bool IsLeaf() const { return child[0] == NULL_NODE; }
+	};
+
+	// The batch being queried, SoA for the node tests.
+	struct RayBatch {
+		float ox[MAX_RAYS], oy[MAX_RAYS], oz[MAX_RAYS];
+		float ix[MAX_RAYS], iy[MAX_RAYS], iz[MAX_RAYS];	// 1 / direction
+		float tMax[MAX_RAYS];								// shrinks as models are hit
+		grinliz::Vector3F dir[MAX_RAYS];
+	};
+
+	struct StackEntry {
+		int node;
+		U64 mask;
+	};
+
+	int AllocNode();
+	void FreeNode( int index );
+	void InsertLeaf( int leaf );
+	void RemoveLeaf( int leaf );
+	int Balance( int index );
+	void FixUpwards( int index );
+	void QueryBatch( const ModelRay* rays, int nRays, Model** hit, grinliz::Vector3F* intersection );
+	U64 TestNode( const grinliz::Rectangle3F& aabb, U64 mask ) const;
+
+	static float Cost( const grinliz::Rectangle3F& r ) {
+		// Surface area (well, half of it.)
+		grinliz::Vector3F s = r.max - r.min;
+		return s.x*s.y + s.y*s.z + s.z*s.x;
+	}
+	static grinliz::Rectangle3F Union( const grinliz::Rectangle3F& a, const grinliz::Rectangle3F& b ) {
+		grinliz::Rectangle3F r = a;
+		r.DoUnion( b );
+		return r;
+	}
+
+	int root;
+	int freeList;
+	int nModels;
+	grinliz::CDynArray< Node > nodes;
+	grinliz::CDynArray< int > dirty;
+	grinliz::CDynArray< StackEntry > stack;
+	RayBatch batch;
+};
+
+#endif // MODELBVH_INCLUDED
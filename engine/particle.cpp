@@ -23,16 +23,24 @@
 #include "texture.h"
 #include "shadermanager.h"
 #include "serialize.h"
+#include "simd.h"
+
+#include "../grinliz/gljobsystem.h"
 
 #include <cfloat>
+#include <string.h>
 
 using namespace grinliz;
+using namespace simd;
 
-ParticleSystem::ParticleSystem() : texture( 0 ), time( 0 ), nParticles( 0 )
+ParticleSystem::ParticleSystem() : texture( 0 ), time( 0 ), parallel( true ), nParticles( 0 ), nStream( 0 )
 {
 	ShaderManager::Instance()->AddDeviceLossHandler( this );
 	vbo = 0;
 	clip.Zero();
+	// The updates work on groups of 4, and can read past the last particle.
+	memset( particleData, 0, sizeof(particleData) );
+	memset( &frame, 0, sizeof(frame) );
 }
 
 
@@ -46,6 +54,7 @@ ParticleSystem::~ParticleSystem()
 void ParticleSystem::Clear()
 {
 	nParticles = 0;
+	nStream = 0;
 	delete vbo;
 	vbo = 0;
 }
@@ -60,96 +69,187 @@ void ParticleSystem::DeviceLoss()
 void ParticleSystem::Process( U32 delta, Camera* camera )
 {
 	// 8.4 ms (debug) in process. 0.8 in release (wow.)
+	// Now SoA and SSE: integrate and cull, compact, then write the vertices.
 	PROFILE_FUNC();
 
 	const Vector3F* eyeDir = camera->EyeDir3();
-	const Vector3F origin = camera->PosWC();
-	float RAD2 = EL_FAR*EL_FAR;
-	float alphaCutoff = 0.0f;
+	frame.origin = camera->PosWC();
+	frame.up = eyeDir[1];
+	frame.right = eyeDir[2];
+	frame.rad2 = EL_FAR*EL_FAR;
+	frame.alphaCutoff = 0.0f;
 
 	if (nParticles > MAX_PARTICLES * 7 / 8) {
-		alphaCutoff = 0.10f;
-		RAD2 /= 2;
+		frame.alphaCutoff = 0.10f;
+		frame.rad2 /= 2;
 	}
 	else if ( nParticles > MAX_PARTICLES*3/4 ) {
-		alphaCutoff = 0.08f;
-		RAD2 /= 2;
+		frame.alphaCutoff = 0.08f;
+		frame.rad2 /= 2;
 	}
 	else if ( nParticles > MAX_PARTICLES/2 ) {
-		alphaCutoff = 0.05f;
+		frame.alphaCutoff = 0.05f;
 	}
 
 	time += delta;
-	float deltaF = (float)delta * 0.001f;	// convert to seconds.
-	const Vector3F& up = eyeDir[1];
-	const Vector3F& right = eyeDir[2];
-	const Vector3F xaxis = { 1, 0, 0 };
-	const Vector3F zaxis = { 0, 0, 1 };
-
-	ParticleData*   pd = particleData;
-	ParticleStream* ps = vertexBuffer;
-	ParticleData*	end = particleData + nParticles;
-	ParticleData*   srcPD = particleData;
-	ParticleStream* srcPS = vertexBuffer;
-
-	while( srcPD < end ) {
-
-		*pd = *srcPD;
-		Vector4F color = srcPS->color + pd->colorVel * deltaF;
-
-		if (    (pd->colorVel.w < 0 && color.w <= alphaCutoff)
-			 || ((pd->pos - origin).LengthSquared() > RAD2)
-			 || (pd->velocity.y < 0 && pd->pos.y < 0 )
-			 || (pd->velocity.y > 0 && pd->pos.y > EL_CAMERA_MAX) )
-		{
-			// don't advance pd & ps. This will
-			// be overwritten
+	frame.deltaF = (float)delta * 0.001f;	// convert to seconds.
+
+	int nChunks = (nParticles + CHUNK - 1) / CHUNK;
+	bool useJobs = parallel && nParticles >= PARALLEL_PARTICLES;
+
+	if ( useJobs )
+		JobSystem::Instance()->ParallelFor( nChunks, 1, IntegrateJob, this );
+	else
+		IntegrateJob( this, 0, nChunks );
+
+	Compact();
+
+	nChunks = (nParticles + CHUNK - 1) / CHUNK;
+	if ( useJobs )
+		JobSystem::Instance()->ParallelFor( nChunks, 1, StreamJob, this );
+	else
+		StreamJob( this, 0, nChunks );
+	nStream = nParticles;
+}
+
+
+void ParticleSystem::IntegrateJob( void* data, int start, int end )
+{
+	ParticleSystem* system = (ParticleSystem*)data;
+	const Frame& frame = system->frame;
+	float (*f)[MAX_PARTICLES] = system->particleData;
+
+	const F4 dt = Splat( frame.deltaF );
+	const F4 zero = Splat( 0 );
+	const F4 one = Splat( 1.0f );
+	const F4 alphaCutoff = Splat( frame.alphaCutoff );
+	const F4 rad2 = Splat( frame.rad2 );
+	const F4 cameraMax = Splat( EL_CAMERA_MAX );
+	const F4 ox = Splat( frame.origin.x ), oy = Splat( frame.origin.y ), oz = Splat( frame.origin.z );
+
+	// MAX_PARTICLES is a multiple of 4, so the last group
+	// can run past nParticles; it just won't be kept.
+	const int first = start * CHUNK;
+	const int last = Min( end * CHUNK, system->nParticles );
+
+	for( int i=first; i<last; i+=4 ) {
+		F4 color[4], colorVel[4];
+		for( int c=0; c<4; ++c ) {
+			colorVel[c] = Load( &f[ParticleData::COLOR_VEL_R + c][i] );
+			color[c] = MulAdd( colorVel[c], dt, Load( &f[ParticleData::COLOR_R + c][i] ));
+		}
+		const F4 px = Load( &f[ParticleData::POS_X][i] );
+		const F4 py = Load( &f[ParticleData::POS_Y][i] );
+		const F4 pz = Load( &f[ParticleData::POS_Z][i] );
+		const F4 vx = Load( &f[ParticleData::VEL_X][i] );
+		const F4 vy = Load( &f[ParticleData::VEL_Y][i] );
+		const F4 vz = Load( &f[ParticleData::VEL_Z][i] );
+
+		F4 dx = Sub( px, ox ), dy = Sub( py, oy ), dz = Sub( pz, oz );
+		F4 dist2 = MulAdd( dx, dx, MulAdd( dy, dy, Mul( dz, dz )));
+
+		// Faded out, too far away, or moved out of the world.
+		F4 dead = And( Less( colorVel[3], zero ), LessEqual( color[3], alphaCutoff ));
+		dead = Or( dead, Less( rad2, dist2 ));
+		dead = Or( dead, And( Less( vy, zero ), Less( py, zero )));
+		dead = Or( dead, And( Less( zero, vy ), Less( cameraMax, py )));
+
+		int mask = ~MoveMask( dead );
+		for( int k=0; k<4; ++k ) {
+			system->alive[i+k] = ( mask >> k ) & 1;
 		}
-		else { 
-			if ( color.w > 1 ) {
-				GLASSERT( pd->colorVel1.w < 0.f );
-				color.w = 1.f;
-				pd->colorVel = pd->colorVel1;
-				GLASSERT( pd->colorVel.w < 0 );
-			}
 
-			pd->pos  += pd->velocity * deltaF;
-			pd->size += pd->sizeVel * deltaF;
-			const Vector3F pos  = pd->pos;
-			const Vector2F size = pd->size;
+		// Done fading in: switch to the 2nd color velocity.
+		F4 over = Less( one, color[3] );
+		color[3] = Select( over, one, color[3] );
+		for( int c=0; c<4; ++c ) {
+			Store( &f[ParticleData::COLOR_R + c][i], color[c] );
+			Store( &f[ParticleData::COLOR_VEL_R + c][i], Select( over, Load( &f[ParticleData::COLOR_VEL1_R + c][i] ), colorVel[c] ));
+		}
+
+		Store( &f[ParticleData::POS_X][i], MulAdd( vx, dt, px ));
+		Store( &f[ParticleData::POS_Y][i], MulAdd( vy, dt, py ));
+		Store( &f[ParticleData::POS_Z][i], MulAdd( vz, dt, pz ));
+		for( int k=0; k<2; ++k ) {
+			F4 size = Load( &f[ParticleData::SIZE_X + k][i] );
+			Store( &f[ParticleData::SIZE_X + k][i], MulAdd( Load( &f[ParticleData::SIZE_VEL_X + k][i] ), dt, size ));
+		}
+	}
+}
 
-			if ( pd->alignment == ParticleDef::ALIGN_CAMERA ) {
-				ps[0].pos = pos - up*size.y - right*size.x;
-				ps[1].pos = pos - up*size.y + right*size.x;
-				ps[2].pos = pos + up*size.y + right*size.x;
-				ps[3].pos = pos + up*size .y- right*size.x;
-			}
-			else {
-				ps[0].pos = pos - xaxis*size.y - zaxis*size.x;
-				ps[1].pos = pos - xaxis*size.y + zaxis*size.x;
-				ps[2].pos = pos + xaxis*size.y + zaxis*size.x;
-				ps[3].pos = pos + xaxis*size .y- zaxis*size.x;
-			}
 
-			ps[0].color = color;
-			ps[0].uv = srcPS[0].uv;
+void ParticleSystem::Compact()
+{
+	int n = 0;
+	for( int i=0; i<nParticles; ++i ) {
+		if ( alive[i] ) {
+			compactIndex[n++] = i;
+		}
+	}
+	if ( n == nParticles ) 
+		return;
 
-			ps[1].color = color;
-			ps[1].uv = srcPS[1].uv;
+	// Field by field, so each is a linear pass. Order is kept.
+	for( int field=0; field<ParticleData::NUM_FIELDS; ++field ) {
+		float* f = particleData[field];
+		for( int i=0; i<n; ++i ) {
+			f[i] = f[compactIndex[i]];
+		}
+	}
+	nParticles = n;
+}
 
-			ps[2].color = color;
-			ps[2].uv = srcPS[2].uv;
 
-			ps[3].color = color;
-			ps[3].uv = srcPS[3].uv;
+void ParticleSystem::StreamJob( void* data, int start, int end )
+{
+	ParticleSystem* system = (ParticleSystem*)data;
+	const Frame& frame = system->frame;
+	const float (*f)[MAX_PARTICLES] = system->particleData;
+
+	static const float TEXTURE_SIZE = ParticleDef::NUM_TEX;
+	static const float U[4] = { 0, 1.f/TEXTURE_SIZE, 1.f/TEXTURE_SIZE, 0 };
+	static const float V[4] = { 0, 0, 1, 1 };
+	// The corners, as signs of the 'a' (up) and 'b' (right) axes.
+	static const float SIGN_A[4] = { -1, -1, 1,  1 };
+	static const float SIGN_B[4] = { -1,  1, 1, -1 };
+
+	const F4 half = Splat( 0.5f );
+	const float axisA[2][3] = { { frame.up.x, frame.up.y, frame.up.z },			{ 1, 0, 0 } };
+	const float axisB[2][3] = { { frame.right.x, frame.right.y, frame.right.z },	{ 0, 0, 1 } };
+
+	const int first = start * CHUNK;
+	const int last = Min( end * CHUNK, system->nParticles );
+
+	for( int i=first; i<last; i+=4 ) {
+		// Offsets of the corners, along the axes of the alignment.
+		F4 alignY = Less( half, Load( &f[ParticleData::ALIGN_Y][i] ));
+		F4 sizeX = Load( &f[ParticleData::SIZE_X][i] );
+		F4 sizeY = Load( &f[ParticleData::SIZE_Y][i] );
+		float da[3][4], db[3][4];
+		for( int c=0; c<3; ++c ) {
+			F4 a = Select( alignY, Splat( axisA[1][c] ), Splat( axisA[0][c] ));
+			F4 b = Select( alignY, Splat( axisB[1][c] ), Splat( axisB[0][c] ));
+			Store( da[c], Mul( a, sizeY ));
+			Store( db[c], Mul( b, sizeX ));
+		}
 
-			pd++;
-			ps += 4;
+		const int n = Min( 4, last - i );
+		for( int k=0; k<n; ++k ) {
+			const int index = i + k;
+			ParticleStream* ps = &system->vertexBuffer[index*4];
+			const Vector4F color = { f[ParticleData::COLOR_R][index], f[ParticleData::COLOR_G][index], f[ParticleData::COLOR_B][index], f[ParticleData::COLOR_A][index] };
+			const float uOffset = f[ParticleData::U_OFFSET][index];
+
+			for( int v=0; v<4; ++v ) {
+				ps[v].color = color;
+				ps[v].pos.x = f[ParticleData::POS_X][index] + SIGN_A[v]*da[0][k] + SIGN_B[v]*db[0][k];
+				ps[v].pos.y = f[ParticleData::POS_Y][index] + SIGN_A[v]*da[1][k] + SIGN_B[v]*db[1][k];
+				ps[v].pos.z = f[ParticleData::POS_Z][index] + SIGN_A[v]*da[2][k] + SIGN_B[v]*db[2][k];
+				ps[v].uv.x = U[v] + uOffset;
+				ps[v].uv.y = V[v];
+			}
 		}
-		srcPD++;
-		srcPS += 4;
 	}
-	nParticles = pd - particleData;
 }
 
 
@@ -223,7 +323,6 @@ void ParticleSystem::EmitPD(	const ParticleDef& def,
 	Vector3F velocity = normal * def.velocity;
 
 	static const float TEXTURE_SIZE = ParticleDef::NUM_TEX;
-	static const Vector2F uv[4] = {{0,0},{1.f/TEXTURE_SIZE,0},{1.f/TEXTURE_SIZE,1},{0,1}};
 	int count = def.count;
 
 	if ( def.time == ParticleDef::CONTINUOUS ) {
@@ -236,8 +335,6 @@ void ParticleSystem::EmitPD(	const ParticleDef& def,
 
 	for( int i=0; i<count; ++i ) {
 		if ( nParticles < MAX_PARTICLES ) {
-			ParticleData* pd = &particleData[nParticles];
-
 			Vector3F pos = region->CalcPoint( &random );
 
 			// Don't even emit if we'll never see it.
@@ -259,17 +356,10 @@ void ParticleSystem::EmitPD(	const ParticleDef& def,
 			// There is potentially both an increasing alpha
 			// and decreasing alpha velocity.
 			GLASSERT( def.colorVelocity0.w < -0.001f || def.colorVelocity1.w < -0.001f );
-			pd->colorVel  = def.colorVelocity0;
-			pd->colorVel1 = def.colorVelocity1;
-
 			Vector3F vFuzz;
 			random.NormalVector3D( &vFuzz.x );
-			pd->velocity = velocity + vFuzz*def.velocityFuzz;
+			Vector3F vel = velocity + vFuzz*def.velocityFuzz;
 
-			pd->alignment	= def.alignment;
-			pd->size		= def.size;
-			pd->sizeVel		= def.sizeVelocity;
-			
 			Vector4F cFuzz = { 0, 0, 0, 0 };
 			random.NormalVector3D( &cFuzz.x );
 			Vector4F color = def.color + cFuzz*def.colorFuzz;
@@ -277,22 +367,27 @@ void ParticleSystem::EmitPD(	const ParticleDef& def,
 			Vector3F pFuzz;
 			random.NormalVector3D( &pFuzz.x );
 			pos = pos + pFuzz*def.posFuzz;
-			pd->pos = pos;
 
 			int texOffset = (def.texMax > def.texMin) ? random.Rand( def.texMax - def.texMin + 1 ) : 0;
 			float uOffset = (float)(def.texMin + texOffset) / TEXTURE_SIZE;
 
-			ParticleStream* ps = &vertexBuffer[nParticles*4];
+			float (*f)[MAX_PARTICLES] = particleData;
+			const int n = nParticles;
+			for( int k=0; k<3; ++k ) {
+				f[ParticleData::POS_X + k][n] = pos.X(k);
+				f[ParticleData::VEL_X + k][n] = vel.X(k);
+			}
+			for( int k=0; k<2; ++k ) {
+				f[ParticleData::SIZE_X + k][n] = def.size.X(k);
+				f[ParticleData::SIZE_VEL_X + k][n] = def.sizeVelocity.X(k);
+			}
 			for( int k=0; k<4; ++k ) {
-				ps[k].color = color;
-				ps[k].uv = uv[k];
-				ps[k].uv.x += uOffset;
-			};
-
-			ps[0].pos = pos;
-			ps[1].pos = pos;
-			ps[2].pos = pos;
-			ps[3].pos = pos;
+				f[ParticleData::COLOR_R + k][n] = color.X(k);
+				f[ParticleData::COLOR_VEL_R + k][n] = def.colorVelocity0.X(k);
+				f[ParticleData::COLOR_VEL1_R + k][n] = def.colorVelocity1.X(k);
+			}
+			f[ParticleData::U_OFFSET][n] = uOffset;
+			f[ParticleData::ALIGN_Y][n] = ( def.alignment == ParticleDef::ALIGN_Y ) ? 1.0f : 0.0f;
 
 			++nParticles;
 		}
@@ -305,7 +400,7 @@ void ParticleSystem::Draw()
 {
 	//GRINLIZ_PERFTRACK
 
-	if ( nParticles == 0 ) {
+	if ( nStream == 0 ) {
 		return;
 	}
 	if ( !texture ) {
@@ -314,7 +409,7 @@ void ParticleSystem::Draw()
 	if ( !vbo ) {
 		vbo = new GPUVertexBuffer( 0, sizeof( ParticleStream )*MAX_PARTICLES*4 );
 	}
-	vbo->Upload( vertexBuffer, sizeof(ParticleStream)*nParticles*4, 0 );
+	vbo->Upload( vertexBuffer, sizeof(ParticleStream)*nStream*4, 0 );
 	
 	GPUStream stream;
 	stream.stride = sizeof( ParticleStream );
@@ -329,7 +424,7 @@ void ParticleSystem::Draw()
 	data.texture0 = texture;
 
 	ParticleShader shader;
-	GPUDevice::Instance()->DrawQuads( shader, stream, data, nParticles );
+	GPUDevice::Instance()->DrawQuads( shader, stream, data, nStream );
 }
 
 
@@ -50,16 +50,22 @@ struct Particle
 
 
 // Mixed system. *much* simpler.
-// CPU part.
+// CPU part. Stored SoA: a float array per field, so that
+// 4 particles are updated at once.
 struct ParticleData
 {
-	int					alignment;
-	grinliz::Vector2F	size;
-	grinliz::Vector2F	sizeVel;
-	grinliz::Vector4F	colorVel;		// units / second added to color. particle dead when a<=0
-	grinliz::Vector4F	colorVel1;
-	grinliz::Vector3F	velocity;		// units / second added to origin
-	grinliz::Vector3F	pos;
+	enum {
+		POS_X, POS_Y, POS_Z,
+		VEL_X, VEL_Y, VEL_Z,			// units / second added to pos
+		SIZE_X, SIZE_Y,
+		SIZE_VEL_X, SIZE_VEL_Y,
+		COLOR_R, COLOR_G, COLOR_B, COLOR_A,
+		COLOR_VEL_R, COLOR_VEL_G, COLOR_VEL_B, COLOR_VEL_A,		// units / second added to color. particle dead when a<=0
+		COLOR_VEL1_R, COLOR_VEL1_G, COLOR_VEL1_B, COLOR_VEL1_A,	// replaces COLOR_VEL once alpha reaches 1
+		U_OFFSET,						// texture offset
+		ALIGN_Y,						// 1 if ALIGN_Y, 0 if ALIGN_CAMERA
+		NUM_FIELDS
+	};
 };
 
 
@@ -218,27 +224,50 @@ public:
 	void Clear();
 	int NumParticles() const { return nParticles; }
 
+	// Update big systems in chunks on the JobSystem. (Default on.)
+	void SetParallel( bool p )	{ parallel = p; }
+
 	void LoadParticleDefs( const char* filename );
 	virtual void DeviceLoss();
 
 private:
 
 	void Process( unsigned msec, Camera* camera );
+	void Compact();
+	static void IntegrateJob( void* data, int start, int end );
+	static void StreamJob( void* data, int start, int end );
 
 	enum {
-		MAX_PARTICLES = 2000	// don't want to re-allocate vertex buffers
+		MAX_PARTICLES = 8000,		// don't want to re-allocate vertex buffers. multiple of 4.
+		CHUNK = 1024,				// particles per job
+		PARALLEL_PARTICLES = 2048	// don't use the JobSystem for fewer
+	};
+
+	// The per frame values, for the jobs.
+	struct Frame {
+		float deltaF;
+		float rad2;
+		float alphaCutoff;
+		grinliz::Vector3F origin;
+		grinliz::Vector3F up;
+		grinliz::Vector3F right;
 	};
 
 	grinliz::Random random;
 	Texture* texture;
 	U32 time;
 	grinliz::Rectangle3F clip;
+	bool parallel;
+	Frame frame;
 
 	GPUVertexBuffer* vbo;
 
 	int nParticles;
+	int nStream;					// particles in the vertexBuffer; the rest were emitted since
 	grinliz::CDynArray<ParticleDef> particleDefArr;
-	ParticleData	particleData[MAX_PARTICLES];
+	float			particleData[ParticleData::NUM_FIELDS][MAX_PARTICLES];
+	U8				alive[MAX_PARTICLES];
+	U16				compactIndex[MAX_PARTICLES];
 	ParticleStream	vertexBuffer[MAX_PARTICLES*4];
 
 };
@@ -21,10 +21,11 @@
 //#include "../grinliz/glperformance.h"
 #include "../grinliz/glgeometry.h"
 #include <limits.h>
+#include <string.h>
 
 using namespace grinliz;
 
-RenderQueue::RenderQueue()
+RenderQueue::RenderQueue() : lastState(0), sharedKeys(false)
 {
 }
 
@@ -33,22 +34,103 @@ RenderQueue::~RenderQueue()
 {
 }
 
-bool RenderQueue::CompareItem::Less( const Item* s0, const Item* s1 )
+
+void RenderQueue::Clear()
+{
+	itemPool.Clear();
+	sortArr.Clear();
+	states.Clear();
+	textureIndex.Clear();
+	atomIndex.Clear();
+	lastState = 0;
+	sharedKeys = false;
+}
+
+
+int RenderQueue::Intern( HashTable<SPTR, int, CompPtr>* table, const void* ptr, int max )
 {
-	// Priority list:
+	int index = 0;
+	if ( !table->Query( (SPTR)ptr, &index )) {
+		index = table->Size();
+		if ( index >= max ) {
+			// Shares the last number. Submit() then checks the
+			// atom and state at the batch boundary.
+			index = max - 1;
+			sharedKeys = true;
+		}
+		table->Add( (SPTR)ptr, index );
+	}
+	return index;
+}
 
+
+U64 RenderQueue::SortKey( const ModelAtom* atom, const GPUState& state )
+{
 	GLASSERT( sizeof(Item) < 200 );	// just a sanity check.	
-	int result = s1->state.StateFlags() - s0->state.StateFlags();
-	if ( result ) return result > 0;
 
-	result = (int)((SPTR)s1->atom - (SPTR)s0->atom);
-	if ( result ) return result > 0;
+	// There are only ever a few distinct states in a frame;
+	// and they tend to come in runs.
+	if ( lastState >= states.Size() || !(states[lastState] == state) ) {
+		lastState = 0;
+		while ( lastState < states.Size() && !(states[lastState] == state) ) {
+			++lastState;
+		}
+		if ( lastState == states.Size() ) {
+			states.Push( state );
+		}
+	}
+	int stateI = lastState;
+	if ( stateI >= (1 << KEY_STATE_BITS) ) {
+		stateI = (1 << KEY_STATE_BITS) - 1;
+		sharedKeys = true;
+	}
+	U64 pass   = U64( state.StateFlags() );
+	U64 shader = U64( state.ShaderFlags() );
+	U64 tex    = U64( Intern( &textureIndex, atom->texture, 1 << KEY_TEX_BITS ));
+	U64 atomI  = U64( Intern( &atomIndex, atom, 1 << KEY_ATOM_BITS ));
+	GLASSERT( pass < (1 << KEY_PASS_BITS) );
+	GLASSERT( shader < (1 << KEY_SHADER_BITS) );
+
+	return	  ( pass << KEY_PASS_SHIFT )
+			| ( shader << KEY_SHADER_SHIFT )
+			| ( U64( stateI ) << KEY_STATE_SHIFT )
+			| ( tex << KEY_TEX_SHIFT )
+			| atomI;
+}
 
-	result = s1->state.ShaderFlags() - s0->state.ShaderFlags();
-	if ( result ) return result > 0;
 
-	result = (int)((SPTR)s1->atom->texture - (SPTR)s0->atom->texture);
-	return result > 0;
+void RenderQueue::RadixSort( SortItem* items, SortItem* tmp, int n )
+{
+	if ( n < 2 ) return;
+
+	// Most of the key is the same for every item; only
+	// sort on the bytes that differ. LSD, so it is stable.
+	U64 diff = 0;
+	for( int i=1; i<n; ++i ) {
+		diff |= items[i].key ^ items[0].key;
+	}
+
+	SortItem* src = items;
+	SortItem* dst = tmp;
+	for( int shift=0; shift<64; shift += 8 ) {
+		if ( ((diff >> shift) & 0xff) == 0 ) 
+			continue;
+
+		int count[257] = { 0 };
+		for( int i=0; i<n; ++i ) {
+			++count[ ((src[i].key >> shift) & 0xff) + 1 ];
+		}
+		for( int i=1; i<257; ++i ) {
+			count[i] += count[i-1];
+		}
+		for( int i=0; i<n; ++i ) {
+			dst[ count[ (src[i].key >> shift) & 0xff ]++ ] = src[i];
+		}
+		Swap( &src, &dst );
+	}
+	if ( src != items ) {
+		memcpy( items, src, sizeof(SortItem)*n );
+	}
 }
 
 
@@ -73,32 +155,49 @@ void RenderQueue::Add(	Model* model,
 	item->control = control;
 	item->auxBone = auxBone;
 	item->auxTex = auxTex;
+	item->key = SortKey( atom, state );
 
 	GLASSERT( itemPool.Size() < 10*1000 );	// sanity, infinite loop detection
 }
 
 
+void RenderQueue::Append( const RenderQueue& other )
+{
+	// The keys use this queue's numbering of states,
+	// textures, and atoms, so they are re-computed.
+	Item* items = itemPool.PushArr( other.itemPool.Size() );
+	for( int i=0; i<other.itemPool.Size(); ++i ) {
+		items[i] = other.itemPool[i];
+		items[i].key = SortKey( items[i].atom, items[i].state );
+	}
+	GLASSERT( itemPool.Size() < 10*1000 );
+}
+
+
 void RenderQueue::Submit(	int modelRequired, 
 							int modelExcluded, 
 							const Matrix4* xform )
 {
 	//GRINLIZ_PERFTRACK
-	itemArr.Clear();
+	sortArr.Clear();
 
 	for( int i=0; i<itemPool.Size(); ++i ) {
 
-		Item* item = &itemPool[i];
-		Model* model = item->model;
-		int modelFlags = model->Flags();
+		const Item* item = &itemPool[i];
+		int modelFlags = item->model->Flags();
 
 		if (    ( (modelRequired & modelFlags) == modelRequired)
 			 && ( (modelExcluded & modelFlags) == 0 ) )
 		{
-			itemArr.Push( item );
+			SortItem* si = sortArr.PushArr(1);
+			si->key = item->key;
+			si->item = item;
 		}
 	}
 
-	Sort( itemArr.Mem(), itemArr.Size(), CompareItem::Less );
+	sortTmp.Clear();
+	sortTmp.PushArr( sortArr.Size() );
+	RadixSort( sortArr.Mem(), sortTmp.Mem(), sortArr.Size() );
 
 	int start = 0;
 	int end = 0;
@@ -115,17 +214,19 @@ void RenderQueue::Submit(	int modelRequired,
 	Matrix4		instanceBone[EL_MAX_INSTANCE*EL_MAX_BONES];
 
 	//GLOUTPUT(( "Batch:\n" ));
-	while( start < itemArr.Size() ) {
-		// Get a range;
+	while( start < sortArr.Size() ) {
+		// Get a range: the same key is the same state and atom,
+		// unless keys were shared.
+		const ModelAtom* atom = sortArr[start].item->atom;
+		const GPUState* state = &sortArr[start].item->state;
 		end = start + 1;
-		while(    end < itemArr.Size() 
-			   && itemArr[end]->IsInstance( itemArr[start] ) ) 
+		while(    end < sortArr.Size() 
+			   && sortArr[end].key == sortArr[start].key 
+			   && ( !sharedKeys || ( sortArr[end].item->atom == atom && sortArr[end].item->state == *state )))
 		{
 			++end;
 		}
 		//int delta = end - start;
-		const ModelAtom* atom = itemArr[start]->atom;
-		GPUState* state = &itemArr[start]->state;
 
 		//GLOUTPUT(( "  n=%d state=%d shader=%d texture=%s atom=%x\n", 
 		//			delta, state->StateFlags(), state->ShaderFlags(),
@@ -152,7 +253,7 @@ void RenderQueue::Submit(	int modelRequired,
 				int delta = Min( end-k, (int)EL_MAX_INSTANCE );
 
 				for( int index=0; index<delta; ++index ) {
-					const Item* item = itemArr[k+index];
+					const Item* item = sortArr[k+index].item;
 					if ( xform ) {
 						instanceMatrix[index] = (*xform) * item->model->XForm();
 					}
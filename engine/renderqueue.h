@@ -32,12 +32,20 @@ struct ModelAuxBone;
 struct ModelAuxTex;
 
 /* 
-	A simple grouping queue. States are ordered (see CompareState) in prioritizing:
-	- pass (opaque, blend)
-	- state (which defines the fixed state)
+	A simple grouping queue. Each item gets a 64 bit sort key when
+	it is added, ordered (high bits to low) by:
+	- pass and fixed state (opaque, blend: GPUState::StateFlags)
+	- shader flags
+	- the rest of the GPUState
 	- texture
-
-	Within a run of items, ModelAtoms are grouped together and rendererd via instancing.
+	- atom
+	The states, textures and atoms are numbered in the order they
+	are first added. Submit() radix sorts the keys.
+
+	A run of items with the same key is the same state and atom,
+	and is rendered via instancing. If a field runs out of bits,
+	the overflow shares the last number; then the run is also
+	split where the atom or state changes.
 */
 class RenderQueue
 {
@@ -60,8 +68,13 @@ public:
 					int modelExcluded,
 					const grinliz::Matrix4* xform );
 
+	// Add all the items of 'other', in order. Used to merge
+	// the queues that are filled in parallel.
+	void Append( const RenderQueue& other );
+
 	bool Empty() { return itemPool.Empty(); }
-	void Clear() { itemPool.Clear(); itemArr.Clear(); }
+	int Size() const { return itemPool.Size(); }
+	void Clear();
 
 private:
 	struct Item {
@@ -73,21 +86,48 @@ private:
 		GPUControlParam			control;		// per instance data 
 		const ModelAuxBone*		auxBone;
 		const ModelAuxTex*		auxTex;
+		U64						key;
+	};
 
-		bool IsInstance( const Item* item ) {
-			return    state == item->state 
-				   && atom == item->atom;
-		}
+	struct SortItem {
+		U64 key;
+		const Item* item;
 	};
 
-	class CompareItem
-	{
+	// Bits of the sort key, from the low end.
+	enum {
+		KEY_ATOM_BITS	= 16,
+		KEY_TEX_BITS	= 12,
+		KEY_STATE_BITS	= 8,
+		KEY_SHADER_BITS	= 15,
+		KEY_PASS_BITS	= 9,
+
+		KEY_TEX_SHIFT		= KEY_ATOM_BITS,
+		KEY_STATE_SHIFT		= KEY_TEX_SHIFT + KEY_TEX_BITS,
+		KEY_SHADER_SHIFT	= KEY_STATE_SHIFT + KEY_STATE_BITS,
+		KEY_PASS_SHIFT		= KEY_SHADER_SHIFT + KEY_SHADER_BITS
+	};
+
+	// Pointers are aligned; spread the bits.
+	class CompPtr {
 	public:
-		static bool Less( const Item* s0, const Item* s1 );
+		static U32 Hash(SPTR v)					{ return U32(U64(v) >> 4) * 2654435761U; }
+		static bool Equal(SPTR v0, SPTR v1)		{ return v0 == v1; }
 	};
 
+	U64 SortKey( const ModelAtom* atom, const GPUState& state );
+	int Intern( grinliz::HashTable<SPTR, int, CompPtr>* table, const void* ptr, int max );
+	static void RadixSort( SortItem* items, SortItem* tmp, int n );
+
 	grinliz::CDynArray< Item >  itemPool;
-	grinliz::CDynArray< Item* > itemArr;
+	grinliz::CDynArray< SortItem > sortArr, sortTmp;
+
+	// Numbering of what has been added, for the keys.
+	grinliz::CDynArray< GPUState > states;
+	grinliz::HashTable< SPTR, int, CompPtr > textureIndex;
+	grinliz::HashTable< SPTR, int, CompPtr > atomIndex;
+	int lastState;
+	bool sharedKeys;	// some key was clamped: the key alone doesn't identify a batch
 };
 
 
@@ -111,10 +111,11 @@ void Screenport::SetPerspective(GPUDevice* device)
 			h = orthoHeight;
 		}
 		projection3D.SetOrtho( -w/2, w/2, -h/2, h/2, frustum.zNear, frustum.zFar );
-		device->SetPerspectiveTransform( projection3D );
 	}
 	else {
 		projection3D.SetFrustum( frustum.left, frustum.right, frustum.bottom, frustum.top, frustum.zNear, frustum.zFar );
+	}
+	if ( device ) {
 		device->SetPerspectiveTransform( projection3D );
 	}
 }
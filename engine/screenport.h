@@ -77,7 +77,8 @@ public:
 	// it would be nice to be able to have a lower left origin.
 	void SetUI(GPUDevice* device);
 
-	// Set the perspective PROJECTION.
+	// Set the perspective PROJECTION. A null device only
+	// computes the matrix. (Headless.)
 	void SetPerspective(GPUDevice* device);
 	float Near() const { return near; }
 	float Far() const { return far; }
@@ -17,6 +17,7 @@
 #include "../tinyxml2/tinyxml2.h"
 #include "../engine/serialize.h"
 #include "../xegame/cgame.h"
+#include "../xegame/xegamelimits.h"
 
 using namespace grinliz;
 using namespace tinyxml2;
@@ -108,6 +109,16 @@ float SettingsManager::WorldGenDone() const
 	return Read("Game", "worldGenDone", 1.0f);
 }
 
+int SettingsManager::MapSize() const
+{
+	int size = Read("Game", "mapSize", int(DEFAULT_MAP_SIZE));
+	if (size != 512 && size != 1024 && size != 2048) {
+		GLOUTPUT(("Settings: mapSize=%d not supported.\n", size));
+		size = DEFAULT_MAP_SIZE;
+	}
+	return size;
+}
+
 
 bool SettingsManager::DebugGLCalls() const
 {
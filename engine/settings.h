@@ -42,6 +42,8 @@ public:
 	float DenizenDate() const;
 	float SpawnDate() const;
 	float WorldGenDone() const;
+	// Edge of a newly generated world: 512, 1024, or 2048.
+	int MapSize() const;
 
 	bool DebugGLCalls() const;
 	bool DebugUI() const;
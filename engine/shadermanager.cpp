@@ -16,6 +16,7 @@
 #include "shadermanager.h"
 #include "platformgl.h"
 #include "texture.h"
+#include "gpustatemanager.h"
 #include "../grinliz/glrandom.h"
 #include "../xegame/cgame.h"
 #include "../xegame/platformpath.h"
@@ -97,10 +98,13 @@ ShaderManager::ShaderManager() : active(0), totalCompileTime(0)
 
 	U32 hash0 = Random::Hash( fixedpipeVert.c_str(), fixedpipeVert.size() );
 	U32 hash1 = Random::Hash( fixedpipeFrag.c_str(), fixedpipeFrag.size() );
-	U32 hash2 = Random::Hash( glGetString( GL_VENDOR ), -1 );
-	U32 hash3 = Random::Hash( glGetString( GL_RENDERER ), -1 );
-	U32 hash4 = Random::Hash( glGetString( GL_VERSION ), -1 );
-	U32 hash = hash0 ^ hash1 ^ hash2 ^ hash3 ^ hash4;
+	U32 hash = hash0 ^ hash1;
+	if ( !GPUDevice::Headless() ) {
+		U32 hash2 = Random::Hash( glGetString( GL_VENDOR ), -1 );
+		U32 hash3 = Random::Hash( glGetString( GL_RENDERER ), -1 );
+		U32 hash4 = Random::Hash( glGetString( GL_VERSION ), -1 );
+		hash = hash ^ hash2 ^ hash3 ^ hash4;
+	}
 
 	hashStr.Format( "%x", hash );
 	vertexArrayID = 0;
@@ -0,0 +1,81 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINE_SIMD_INCLUDED
+#define ENGINE_SIMD_INCLUDED
+
+#include <math.h>
+
+#if defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 ) || defined( __SSE__ )
+#define ENGINE_SSE
+#include <xmmintrin.h>
+#endif
+
+/*
+	F4 is 4 floats that are operated on together, for SoA code.
+	SSE if the compiler targets it, else plain floats with the same
+	interface. A mask is the result of a compare, and is used with
+	And, Or, Select, and MoveMask.
+*/
+namespace simd {
+
+#ifdef ENGINE_SSE
+typedef __m128 F4;
+
+inline F4 Splat( float v )						{ return _mm_set1_ps( v ); }
+inline F4 Load( const float* p )				{ return _mm_loadu_ps( p ); }
+inline void Store( float* p, F4 a )				{ _mm_storeu_ps( p, a ); }
+inline F4 Add( F4 a, F4 b )						{ return _mm_add_ps( a, b ); }
+inline F4 Sub( F4 a, F4 b )						{ return _mm_sub_ps( a, b ); }
+inline F4 Mul( F4 a, F4 b )						{ return _mm_mul_ps( a, b ); }
+inline F4 Div( F4 a, F4 b )						{ return _mm_div_ps( a, b ); }
+inline F4 Sqrt( F4 a )							{ return _mm_sqrt_ps( a ); }
+inline F4 Min( F4 a, F4 b )						{ return _mm_min_ps( a, b ); }
+inline F4 Max( F4 a, F4 b )						{ return _mm_max_ps( a, b ); }
+inline F4 Abs( F4 a )							{ return _mm_andnot_ps( _mm_set1_ps( -0.0f ), a ); }
+inline F4 Less( F4 a, F4 b )					{ return _mm_cmplt_ps( a, b ); }
+inline F4 LessEqual( F4 a, F4 b )				{ return _mm_cmple_ps( a, b ); }
+inline F4 And( F4 a, F4 b )						{ return _mm_and_ps( a, b ); }
+inline F4 Or( F4 a, F4 b )						{ return _mm_or_ps( a, b ); }
+inline F4 Select( F4 mask, F4 a, F4 b )			{ return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b )); }
+inline int MoveMask( F4 mask )					{ return _mm_movemask_ps( mask ); }
+#else
+struct F4 { float v[4]; };
+
+inline F4 Splat( float v )						{ F4 r = { { v, v, v, v } }; return r; }
+inline F4 Load( const float* p )				{ F4 r = { { p[0], p[1], p[2], p[3] } }; return r; }
+inline void Store( float* p, F4 a )				{ for( int i=0; i<4; ++i ) p[i] = a.v[i]; }
+inline F4 Add( F4 a, F4 b )						{ for( int i=0; i<4; ++i ) a.v[i] += b.v[i]; return a; }
+inline F4 Sub( F4 a, F4 b )						{ for( int i=0; i<4; ++i ) a.v[i] -= b.v[i]; return a; }
+inline F4 Mul( F4 a, F4 b )						{ for( int i=0; i<4; ++i ) a.v[i] *= b.v[i]; return a; }
+inline F4 Div( F4 a, F4 b )						{ for( int i=0; i<4; ++i ) a.v[i] /= b.v[i]; return a; }
+inline F4 Sqrt( F4 a )							{ for( int i=0; i<4; ++i ) a.v[i] = sqrtf( a.v[i] ); return a; }
+inline F4 Min( F4 a, F4 b )						{ for( int i=0; i<4; ++i ) a.v[i] = ( a.v[i] < b.v[i] ) ? a.v[i] : b.v[i]; return a; }
+inline F4 Max( F4 a, F4 b )						{ for( int i=0; i<4; ++i ) a.v[i] = ( a.v[i] > b.v[i] ) ? a.v[i] : b.v[i]; return a; }
+inline F4 Abs( F4 a )							{ for( int i=0; i<4; ++i ) a.v[i] = fabsf( a.v[i] ); return a; }
+inline F4 Less( F4 a, F4 b )					{ for( int i=0; i<4; ++i ) a.v[i] = ( a.v[i] < b.v[i] ) ? 1.0f : 0.0f; return a; }
+inline F4 LessEqual( F4 a, F4 b )				{ for( int i=0; i<4; ++i ) a.v[i] = ( a.v[i] <= b.v[i] ) ? 1.0f : 0.0f; return a; }
+inline F4 And( F4 a, F4 b )						{ for( int i=0; i<4; ++i ) a.v[i] = ( a.v[i] != 0 && b.v[i] != 0 ) ? 1.0f : 0.0f; return a; }
+inline F4 Or( F4 a, F4 b )						{ for( int i=0; i<4; ++i ) a.v[i] = ( a.v[i] != 0 || b.v[i] != 0 ) ? 1.0f : 0.0f; return a; }
+inline F4 Select( F4 mask, F4 a, F4 b )			{ for( int i=0; i<4; ++i ) a.v[i] = ( mask.v[i] != 0 ) ? a.v[i] : b.v[i]; return a; }
+inline int MoveMask( F4 mask )					{ int m = 0; for( int i=0; i<4; ++i ) if ( mask.v[i] != 0 ) m |= 1 << i; return m; }
+#endif
+
+inline F4 MulAdd( F4 a, F4 b, F4 c )			{ return Add( Mul( a, b ), c ); }
+inline F4 Lerp( F4 a, F4 b, F4 t )				{ return MulAdd( Sub( b, a ), t, a ); }
+
+};	// namespace simd
+
+#endif // ENGINE_SIMD_INCLUDED
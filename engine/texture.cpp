@@ -16,6 +16,7 @@
 #include "texture.h"
 #include "platformgl.h"
 #include "surface.h"
+#include "gpustatemanager.h"
 
 #include "../grinliz/glstringutil.h"
 using namespace grinliz;
@@ -289,6 +290,8 @@ void TextureManager::CalcOpenGL( int format, int* glFormat, int* glType )
 
 U32 TextureManager::CreateGLTexture( int w, int h, int format, int flags )
 {
+	if ( GPUDevice::Headless() ) return 0;
+
 	int glFormat, glType;
 	CalcOpenGL( format, &glFormat, &glType );
 
@@ -356,6 +359,7 @@ void Texture::Upload( const void* pixels, int size )
 {
 	GLASSERT( pixels );
 	GLASSERT( size == BytesInImage() );
+	if ( GPUDevice::Headless() ) return;
 
 	if ( glID == 0 ) {
 		// Make sure we have on OpenGL ID
@@ -76,6 +76,10 @@ public:
 	int BytesPerPixel() const	{ return TextureBytesPerPixel(format); }
 
 	U32 GLID();
+	// The database item the pixels come from; null if host created.
+	const gamedb::Item* DBItem() const	{ return item; }
+	// True if the texture needs an Upload().
+	bool Pending() const		{ return glID == 0; }
 
 	void SetEmissive(bool on)	{
 		if (on)
@@ -139,6 +143,7 @@ public:
 	void TextureCreatorInvalid( ITextureCreator* create );
 
 	unsigned NumTextures() const			{ return textureArr.Size(); }
+	Texture* TextureAt( int i )				{ return &textureArr[i]; }
 	U32 CalcTextureMem() const;
 
 	static void Create( const gamedb::Reader* );
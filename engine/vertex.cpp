@@ -42,8 +42,8 @@ void BoneData::Bone::Serialize( XStream* xs )
 	XARC_SER( xs, refPos );
 	XARC_SER( xs, refConcat );
 
-	XARC_SER_ARR( xs, &rotation[0].x, EL_MAX_ANIM_FRAMES*4 );
-	XARC_SER_ARR( xs, &position[0].x, EL_MAX_ANIM_FRAMES*3 );
+	XARC_SER_BULK( xs, rotation, EL_MAX_ANIM_FRAMES );
+	XARC_SER_BULK( xs, position, EL_MAX_ANIM_FRAMES );
 	XarcClose( xs );
 }
 
@@ -126,6 +126,7 @@ AIComponent::AIComponent() : feTicker( 750 ), needsTicker( 1000 )
 	wanderTime = 0;
 	rethink = 0;
 	fullSectorAware = false;
+	sensed = false;
 	visitorIndex = -1;
 	destinationBlocked = 0;
 	lastTargetID = 0;
@@ -166,7 +167,7 @@ bool AIComponent::Log()
 {
 	if (!parentChit) return false;
 	CameraComponent* cc = Context()->chitBag->GetCamera();
-	return Context()->game->AIDebugLog() && (cc->Tracking() == this->ParentChit()->ID());
+	return Context()->game && Context()->game->AIDebugLog() && (cc->Tracking() == this->ParentChit()->ID());
 }
 
 
@@ -187,61 +188,95 @@ void AIComponent::OnRemove()
 }
 
 
-bool AIComponent::LineOfSight(Chit* target, const RangedWeapon* weapon)
+void AIComponent::LineOfSight(const bool* check, bool* los)
 {
-	Vector3F origin, dest;
-	GLASSERT(weapon);
-
+	for (int k = 0; k < enemyList2.Size(); ++k) {
+		los[k] = false;
+	}
 	RenderComponent* thisRender = parentChit->GetRenderComponent();
-	if (!thisRender) return false;
-
-	thisRender->GetMetaData(HARDPOINT_TRIGGER, &origin);
-	dest = EnemyPos(target->ID(), true);
+	if (!thisRender) return;
 
-	Vector3F dir = dest - origin;
-	float length = dir.Length() + 0.01f;	// a little extra just in case
 	CArray<const Model*, RenderComponent::NUM_MODELS + 1> ignore, targetModels;
 	thisRender->GetModelList(&ignore);
 
-	const ChitContext* context = Context();
-	// FIXME: was TEST_TRI, which is less accurate. But also fundamentally incorrect, since
-	// the TEST_TRI doesn't account for bone xforms. Deep bug - but surprisingly hard to see
-	// in the game. Switched to the faster TEST_HIT_AABB, but it would be nice to clean
-	// up TEST_TRI and just make it fast.
-	ModelVoxel mv = context->engine->IntersectModelVoxel(origin, dir, length, TEST_HIT_AABB, 0, 0, ignore.Mem());
-	if (mv.model) {
-		RenderComponent* targetRender = target->GetRenderComponent();
-		if (targetRender) {
-			targetRender->GetModelList(&targetModels);
-			return targetModels.Find(mv.model) >= 0;
-		}
-	}
-	return false;
-}
-
-
-bool AIComponent::LineOfSight(const grinliz::Vector2I& mapPos )
-{
-	RenderComponent* thisRender = ParentChit()->GetRenderComponent();
-	GLASSERT(thisRender);
-	if (!thisRender) return false;
-
-	Vector3F origin;
-	thisRender->CalcTrigger(&origin, 0);
-
-	CArray<const Model*, RenderComponent::NUM_MODELS+1> ignore;
-	thisRender->GetModelList( &ignore );
-
-	Vector3F dest = { (float)mapPos.x+0.5f, 0.5f, (float)mapPos.y+0.5f };
-	Vector3F dir = dest - origin;
-	float length = dir.Length() + 0.01f;	// a little extra just in case
+	// Chits are shot at from the trigger hardpoint; voxels from the
+	// computed trigger. Only look them up if needed.
+	Vector3F hardpoint = { 0, 0, 0 }, trigger = { 0, 0, 0 };
+	bool hasHardpoint = false, hasTrigger = false;
 
 	const ChitContext* context = Context();
-	ModelVoxel mv = context->engine->IntersectModelVoxel( origin, dir, length, TEST_TRI, 0, 0, ignore.Mem() );
+	CArray<ModelRay, MAX_TRACK> rays;
+	CArray<int, MAX_TRACK> rayTarget;		// index into the enemyList2
+	CArray<Vector2I, MAX_TRACK> rayMapPos;
+
+	for (int k = 0; k < enemyList2.Size(); ++k) {
+		if (!check[k]) continue;
 
-	// A little tricky; we hit the 'mapPos' if nothing is hit (which gets to the center)
-	// or if voxel at that pos is hit.
-    return !mv.Hit() || ( mv.Hit() && mv.Voxel2() == mapPos );
+		int targetID = enemyList2[k];
+		Chit* enemyChit = context->chitBag->GetChit(targetID);
+		const Vector3F enemyPos = EnemyPos(targetID, true);
+		const Vector2F enemyPos2 = { enemyPos.x, enemyPos.z };
+		Vector2I mapPos = { 0, 0 };
+
+		ModelRay ray;
+		Vector3F dest;
+		if (enemyChit) {
+			if (!hasHardpoint) {
+				thisRender->GetMetaData(HARDPOINT_TRIGGER, &hardpoint);
+				hasHardpoint = true;
+			}
+			ray.origin = hardpoint;
+			dest = enemyPos;
+			// FIXME: was TEST_TRI, which is less accurate. But also fundamentally incorrect, since
+			// the TEST_TRI doesn't account for bone xforms. Deep bug - but surprisingly hard to see
+			// in the game. Switched to the faster TEST_HIT_AABB, but it would be nice to clean
+			// up TEST_TRI and just make it fast.
+			ray.method = TEST_HIT_AABB;
+		}
+		else {
+			mapPos = ToWorld2I(enemyPos2);
+			if (mapPos.IsZero()) continue;
+			if (!hasTrigger) {
+				thisRender->CalcTrigger(&trigger, 0);
+				hasTrigger = true;
+			}
+			ray.origin = trigger;
+			dest.Set((float)mapPos.x + 0.5f, 0.5f, (float)mapPos.y + 0.5f);
+			ray.method = TEST_TRI;
+		}
+		ray.dir = dest - ray.origin;
+		ray.length = ray.dir.Length() + 0.01f;	// a little extra just in case
+		ray.required = 0;
+		ray.excluded = 0;
+		ray.ignore = ignore.Mem();
+
+		rays.Push(ray);
+		rayTarget.Push(k);
+		rayMapPos.Push(mapPos);
+	}
+	if (rays.Empty()) return;
+
+	ModelVoxel mv[MAX_TRACK];
+	context->engine->IntersectModelVoxel(rays.Mem(), rays.Size(), mv);
+
+	for (int i = 0; i < rays.Size(); ++i) {
+		int k = rayTarget[i];
+		Chit* enemyChit = context->chitBag->GetChit(enemyList2[k]);
+		if (enemyChit) {
+			if (mv[i].model) {
+				RenderComponent* targetRender = enemyChit->GetRenderComponent();
+				if (targetRender) {
+					targetRender->GetModelList(&targetModels);
+					los[k] = targetModels.Find(mv[i].model) >= 0;
+				}
+			}
+		}
+		else {
+			// A little tricky; we hit the 'mapPos' if nothing is hit (which gets to the center)
+			// or if voxel at that pos is hit.
+			los[k] = !mv[i].Hit() || mv[i].Voxel2() == rayMapPos[i];
+		}
+	}
 }
 
 
@@ -1268,7 +1303,7 @@ bool AIComponent::SectorHerd(bool focus)
 
 		// Are we at a deity location? If so, travel far.
 		if (deityCS && (ToSector(deityCS->ParentChit()->Position()) == ToSector(parentChit->Position()))) {
-			Vector2I destSector = { int(parentChit->random.Rand(NUM_SECTORS)), int(parentChit->random.Rand(NUM_SECTORS)) };
+			Vector2I destSector = { int(parentChit->random.Rand(NumSectors())), int(parentChit->random.Rand(NumSectors())) };
 			if (DoSectorHerd(focus, destSector))
 				return true;
 		}
@@ -1305,7 +1340,7 @@ bool AIComponent::SectorHerd(bool focus)
 	// First pass: filter on attract / repel choices.
 	// This is game difficulty logic!
 	Rectangle2I sectorBounds;
-	sectorBounds.Set(0, 0, NUM_SECTORS - 1, NUM_SECTORS - 1);
+	sectorBounds.Set(0, 0, NumSectors() - 1, NumSectors() - 1);
 	IString mob = gameItem->keyValues.GetIString(ISC::mob);
 
 	float rank[NDELTA] = { 0 };
@@ -2319,6 +2354,33 @@ void AIComponent::ThinkBattle()
 		}
 	}
 
+	// 1.5f gives spacing for bolt to start.
+	// The HasRound() && !Reloading() is really important: if the gun
+	// is in cooldown, don't give up on shooting and do something else!
+	auto InShootingRange = [&](float range) {
+		return range > 1.5f
+			&& ((rangedWeapon->HasRound() && !rangedWeapon->Reloading())		// we have ammod
+			|| (nRangedEnemies == 0 && range > 2.0f));	// we have a gun and they don't
+	};
+
+	// The line of sight to everything we could shoot at is cast at once.
+	// Out of view, skip the ray casts and assume the shot is clear.
+	bool lineOfSight[MAX_TRACK] = { false };
+	if (rangedWeapon) {
+		if (parentChit->LOD() != LOD_FULL) {
+			for (int k = 0; k < enemyList2.Size(); ++k) {
+				lineOfSight[k] = true;
+			}
+		}
+		else {
+			bool check[MAX_TRACK] = { false };
+			for (int k = 0; k < enemyList2.Size(); ++k) {
+				check[k] = InShootingRange((EnemyPos(enemyList2[k], true) - pos).Length());
+			}
+			LineOfSight(check, lineOfSight);
+		}
+	}
+
 	BuildingFilter buildingFilter;
 
 	for (int k = 0; k < enemyList2.Size(); ++k) {
@@ -2329,8 +2391,6 @@ void AIComponent::ThinkBattle()
 		//Vector2I voxelTarget = ToWG(targetID);					// zero if there isn't a voxel target
 
 		const Vector3F	enemyPos = EnemyPos(targetID, true);
-		const Vector2F	enemyPos2 = { enemyPos.x, enemyPos.z };
-		const Vector2I  enemyPos2I = ToWorld2I(enemyPos2);
 		float			range = (enemyPos - pos).Length();
 		Vector3F		toEnemy = (enemyPos - pos);
 		Vector2F		normalToEnemy = { toEnemy.x, toEnemy.z };
@@ -2367,12 +2427,7 @@ void AIComponent::ThinkBattle()
 
 			float effectiveRange = BattleMechanics::EffectiveRange(radAt1);
 
-			// 1.5f gives spacing for bolt to start.
-			// The HasRound() && !Reloading() is really important: if the gun
-			// is in cooldown, don't give up on shooting and do something else!
-			if (range > 1.5f
-				&& ((rangedWeapon->HasRound() && !rangedWeapon->Reloading())		// we have ammod
-				|| (nRangedEnemies == 0 && range > 2.0f)))	// we have a gun and they don't
+			if (InShootingRange(range))
 			{
 				float u = 1.0f - (range - effectiveRange) / effectiveRange;
 				u = Clamp(u, 0.0f, 2.0f);	// just to keep the point blank shooting down.
@@ -2396,15 +2451,11 @@ void AIComponent::ThinkBattle()
 					}
 				}
 
-				bool lineOfSight = false;
-				if (enemyChit) lineOfSight = LineOfSight(enemyChit, rangedWeapon);
-				else if (!enemyPos2I.IsZero()) lineOfSight = LineOfSight(enemyPos2I);
-
 				if (Log()) {
 					GLOUTPUT(("r=%.1f ", u));
 				}
 
-				if (u > utility[OPTION_SHOOT] && lineOfSight) {
+				if (u > utility[OPTION_SHOOT] && lineOfSight[k]) {
 					utility[OPTION_SHOOT] = u;
 					target[OPTION_SHOOT] = targetID;
 				}
@@ -2600,6 +2651,7 @@ void AIComponent::DoMoraleZero(  )
 
 	case BLOODRAGE:
 		gameItem->SetChaos();
+		Context()->chitBag->UpdateSpatialFlags(parentChit);
 		Context()->chitBag->GetNewsHistory()->Add(NewsEvent(NewsEvent::BLOOD_RAGE, pos2, parentChit->GetItemID(), 0));
 		break;
 
@@ -2609,7 +2661,7 @@ void AIComponent::DoMoraleZero(  )
 			const SectorData* sd = 0;
 			Vector2I sector = { 0, 0 };
 			for( int i=0; i<16; ++i ) {
-				sector.Set( parentChit->random.Rand( NUM_SECTORS ), parentChit->random.Rand( NUM_SECTORS ));
+				sector.Set( parentChit->random.Rand( NumSectors() ), parentChit->random.Rand( NumSectors() ));
 				sd = &Context()->worldMap->GetSectorData( sector );
 				if ( sd->HasCore() ) {
 					break;
@@ -2627,6 +2679,7 @@ void AIComponent::DoMoraleZero(  )
 				this->Move( sectorPort, true );
 				Context()->chitBag->GetNewsHistory()->Add(NewsEvent(NewsEvent::VISION_QUEST, pos2, parentChit->GetItemID(), 0));
 				gameItem->SetRogue();
+				Context()->chitBag->UpdateSpatialFlags(parentChit);
 			}
 		}
 		break;
@@ -2733,7 +2786,7 @@ void AIComponent::EnterNewGrid()
 		// A squad can takeover a neutral core
 		CoreScript* myCore = CoreScript::GetCoreFromTeam(parentChit->Team());
 
-		if (Team::IsRogue(parentChit->Team()) && Context()->chitBag->census.NumCoresInUse() < TYPICAL_AI_DOMAINS) {
+		if (Team::IsRogue(parentChit->Team()) && Context()->chitBag->census.NumCoresInUse() < TypicalAIDomains()) {
 			// Need some team. And some cash.
 			Rectangle2I inner = InnerSectorBounds(sector);
 			CChitArray arr;
@@ -2885,8 +2938,6 @@ bool AIComponent::ThinkWaypoints()
 
 int AIComponent::DoTick(U32 deltaTime)
 {
-	PROFILE_FUNC();
-
 	// If we are in some action, do nothing and return.
 	if (parentChit->GetRenderComponent()
 		&& !parentChit->GetRenderComponent()->AnimationReady())
@@ -2894,13 +2945,31 @@ int AIComponent::DoTick(U32 deltaTime)
 		return 0;
 	}
 
-	AIAction oldAction = currentAction;
-
 	GameItem* gameItem = parentChit->GetItem();
 	if (!gameItem) return VERY_LONG_TICK;
 
 	// Clean up the enemy/friend lists so they are valid for this call stack.
-	ProcessFriendEnemyLists(feTicker.Delta(deltaTime) != 0);
+	// Statistical chits don't look for enemies; they are told (MakeAware)
+	// when something hits them.
+	bool statistical = parentChit->LOD() == LOD_STATISTICAL;
+	if (ChitBag::ParallelTicking()) {
+		// Looking around only reads the world, and is most of the
+		// cost. Everything after it changes other chits, so it
+		// runs when DoTick() is called again, serially.
+		// (No PROFILE_FUNC here: the profiler isn't thread safe.)
+		ProcessFriendEnemyLists(feTicker.Delta(deltaTime) != 0 && !statistical);
+		sensed = true;
+		Context()->chitBag->DeferTick(this, deltaTime);
+		return VERY_LONG_TICK;
+	}
+
+	PROFILE_FUNC();
+	AIAction oldAction = currentAction;
+
+	// After the parallel part this only filters the lists again:
+	// the serial ticks before this one may have removed chits.
+	ProcessFriendEnemyLists(!sensed && feTicker.Delta(deltaTime) != 0 && !statistical);
+	sensed = false;
 
 	// High level mode switch, in/out of battle?
 	if (focus != FOCUS_MOVE &&  !taskList.UsingBuilding()) {
@@ -2952,7 +3021,7 @@ int AIComponent::DoTick(U32 deltaTime)
 	// This is complex; HAS_NEEDS and USES_BUILDINGS aren't orthogonal. See aineeds.h
 	// for an explanation.
 	// FIXME: remove "lower difficulty" from needs.DoTick()
-	if (gameItem->flags & (GameItem::HAS_NEEDS | GameItem::AI_USES_BUILDINGS)) {
+	if (!statistical && (gameItem->flags & (GameItem::HAS_NEEDS | GameItem::AI_USES_BUILDINGS))) {
 		if (needsTicker.Delta(deltaTime)) {
 			CoreScript* cs = CoreScript::GetCore(ToSector(parentChit->Position()));
 			CoreScript* homeCore = CoreScript::GetCoreFromTeam(parentChit->Team());
@@ -53,6 +53,8 @@ public:
 	virtual void OnRemove();
 
 	virtual int  DoTick( U32 delta );
+	// Looks around on the parallel tick; thinks and acts serially.
+	virtual bool ParallelTickSafe() const { return true; }
 	virtual void DebugStr( grinliz::GLString* str );
 	virtual void OnChitMsg( Chit* chit, const ChitMsg& msg );
 	virtual void OnChitEvent( const ChitEvent& event );
@@ -122,9 +124,9 @@ private:
 	// Process the lists, makes sure they only include valid targets.
 	void ProcessFriendEnemyLists(bool tick);
 
-	// Compute the line of site
-	bool LineOfSight(Chit* target, const RangedWeapon* weapon );
-	bool LineOfSight(const grinliz::Vector2I& voxel );
+	// Compute the line of sight to the enemies, all the rays cast
+	// together. 'check' and 'los' are parallel to the enemyList2.
+	void LineOfSight(const bool* check, bool* los);
 
 	bool Log();
 
@@ -199,6 +201,7 @@ private:
 	U32					wanderTime;
 	int					rethink;
 	bool				fullSectorAware;
+	bool				sensed;			// the lists were updated on the parallel part of this tick
 	int					visitorIndex;
 	int					destinationBlocked;
 	ai::TaskList		taskList;
@@ -0,0 +1,382 @@
+#include "backgroundsave.h"
+
+#include "../version.h"
+#include "../grinliz/glperformance.h"
+#include "../grinliz/glrandom.h"
+#include "../xarchive/glstreamer.h"
+#include "../xegame/chitbag.h"
+#include "../xegame/chit.h"
+#include "../xegame/chitcontext.h"
+#include "../xegame/platformpath.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace grinliz;
+
+SaveFile::SaveFile(const char* p) : path(p)
+{
+	temp = path;
+	temp.append(".tmp");
+	fp = fopen(temp.c_str(), "wb");
+	GLASSERT(fp);
+}
+
+
+SaveFile::~SaveFile()
+{
+	if (fp) {
+		// Never committed.
+		fclose(fp);
+		remove(temp.c_str());
+	}
+}
+
+
+bool SaveFile::Commit()
+{
+	if (!fp) return false;
+
+	bool okay = (fflush(fp) == 0) && !ferror(fp);
+#ifndef _WIN32
+	// Make sure the data is on disk before the rename is.
+	if (okay) {
+		fsync(fileno(fp));
+	}
+#endif
+	okay = (fclose(fp) == 0) && okay;
+	fp = 0;
+
+	if (okay) {
+#ifdef _WIN32
+		// rename() won't replace an existing file on Windows.
+		okay = MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		okay = rename(temp.c_str(), path.c_str()) == 0;
+#endif
+	}
+	if (!okay) {
+		GLOUTPUT(("Save of '%s' failed.\n", path.c_str()));
+		remove(temp.c_str());
+	}
+	return okay;
+}
+
+
+DeltaReader::~DeltaReader()
+{
+	Close();
+}
+
+
+void DeltaReader::Close()
+{
+	delete reader;
+	reader = 0;
+	if (fp) {
+		fclose(fp);
+		fp = 0;
+	}
+}
+
+
+StreamReader* DeltaReader::Open(const char* basePath, StreamReader* base, const char* element)
+{
+	GLASSERT(!reader);
+	U32 baseID = 0;
+	XarcGet(base, "baseID", baseID);
+	if (!baseID) return 0;
+
+	GLString path;
+	BackgroundSave::DeltaPath(basePath, &path);
+	fp = fopen(path.c_str(), "rb");
+	if (!fp) return 0;
+
+	reader = new StreamReader(fp);
+	if (reader->Version() == CURRENT_FILE_VERSION) {
+		const char* name = reader->OpenElement();
+		U32 deltaBaseID = 0;
+		bool delta = false;
+		XarcGet(reader, "baseID", deltaBaseID);
+		XarcGet(reader, "delta", delta);
+		if (StrEqual(name, element) && delta && deltaBaseID == baseID) {
+			return reader;
+		}
+	}
+	GLOUTPUT(("Delta save '%s' doesn't match its base; ignored.\n", path.c_str()));
+	Close();
+	return 0;
+}
+
+
+BackgroundSave::BackgroundSave() : busy(false), baseID(0), nDeltas(0), baseBytes(0), deltaBytes(0)
+{
+	memset(changed, 0, sizeof(changed));
+}
+
+
+void BackgroundSave::DeltaPath(const char* path, GLString* delta)
+{
+	*delta = path;
+	delta->append(".delta");
+}
+
+
+U32 BackgroundSave::NewBaseID()
+{
+	// Only has to differ from the base it replaces.
+	static U32 id = 0;
+	if (!id) {
+		Random random;
+		random.SetSeedFromTime();
+		id = random.Rand();
+	}
+	++id;
+	if (!id) ++id;
+	return id;
+}
+
+
+BackgroundSave::~BackgroundSave()
+{
+	Wait();
+}
+
+
+void BackgroundSave::Wait()
+{
+	if (thread.joinable()) {
+		thread.join();
+	}
+	GLASSERT(!busy);
+}
+
+
+SimSnapshot* BackgroundSave::GetSnapshot(const char* _mapPath, const char* _gamePath)
+{
+	if (busy) return 0;
+	// The last thread is done, but may not have been joined.
+	Wait();
+
+	mapPath = _mapPath;
+	gamePath = _gamePath;
+
+	// Compact (write a new base) when the delta is getting to be
+	// as much work as the base.
+	bool delta = baseID
+		&& baseMapPath == mapPath
+		&& baseGamePath == gamePath
+		&& nDeltas < MAX_DELTAS
+		&& deltaBytes * 2 < baseBytes;
+
+	snapshot.delta = delta;
+	snapshot.baseID = delta ? baseID : NewBaseID();
+	snapshot.chits.Clear();
+	return &snapshot;
+}
+
+
+void BackgroundSave::Start()
+{
+	GLASSERT(!busy);
+	GLASSERT(!thread.joinable());
+	busy = true;
+	thread = std::thread([this] { this->ThreadMain(); });
+}
+
+
+void BackgroundSave::ThreadMain()
+{
+	Write();
+	// What the next snapshot compares against, whether or not
+	// the write worked.
+	lastChits.Clear();
+	for (int i = 0; i < snapshot.chits.Size(); ++i) {
+		lastChits.Add(snapshot.chits.GetKey(i), snapshot.chits.GetValue(i));
+	}
+	busy = false;
+}
+
+
+bool BackgroundSave::Write()
+{
+	QuickProfile qp("BackgroundSave::Write");
+
+	GLString mapOut = mapPath;
+	GLString gameOut = gamePath;
+	if (snapshot.delta) {
+		DeltaPath(mapPath.c_str(), &mapOut);
+		DeltaPath(gamePath.c_str(), &gameOut);
+	}
+
+	// The map and the game go together; if either fails,
+	// keep the old pair.
+	SaveFile mapFile(mapOut.c_str());
+	SaveFile gameFile(gameOut.c_str());
+	if (!mapFile.FP() || !gameFile.FP()) {
+		return false;
+	}
+	WorldMap::WriteSnapshot(snapshot.map, mapFile.FP(), snapshot.delta ? changed : 0);
+	fwrite(snapshot.game.Mem(), snapshot.game.Size(), 1, gameFile.FP());
+	long bytes = ftell(mapFile.FP()) + ftell(gameFile.FP());
+
+	// The last rename is the only window where the pair can
+	// mismatch, which is as close as two files get.
+	if (!(mapFile.Commit() && gameFile.Commit())) {
+		// The last good base (and delta) are still on disk,
+		// so the base state is still correct.
+		return false;
+	}
+
+	if (snapshot.delta) {
+		++nDeltas;
+		deltaBytes = bytes;
+		GLOUTPUT(("Delta save %d: %ld bytes (base %ld).\n", nDeltas, deltaBytes, baseBytes));
+	}
+	else {
+		// The deltas were for the old base.
+		GLString path;
+		DeltaPath(mapPath.c_str(), &path);
+		remove(path.c_str());
+		DeltaPath(gamePath.c_str(), &path);
+		remove(path.c_str());
+
+		baseID = snapshot.baseID;
+		nDeltas = 0;
+		baseBytes = bytes;
+		deltaBytes = 0;
+		baseMapPath = mapPath;
+		baseGamePath = gamePath;
+		memset(changed, 0, sizeof(changed));
+		baseChits.Clear();
+		for (int i = 0; i < snapshot.chits.Size(); ++i) {
+			baseChits.Add(snapshot.chits.GetKey(i), snapshot.chits.GetValue(i));
+		}
+	}
+	return true;
+}
+
+
+// The part of Sim::SaveInBackground() the test needs.
+static void TestSave(BackgroundSave* save, WorldMap* map, ChitBag* bag, const char* mapPath, const char* gamePath)
+{
+	SimSnapshot* snapshot = save->GetSnapshot(mapPath, gamePath);
+	GLTEST(snapshot);
+	U32 baseID = snapshot->baseID;
+	bool delta = snapshot->delta;
+	map->Snapshot(&snapshot->map, baseID, delta, save->ChangedChunks());
+
+	StreamWriter writer(0, CURRENT_FILE_VERSION);
+	XarcOpen(&writer, "Sim");
+	XARC_SER(&writer, baseID);
+	XARC_SER(&writer, delta);
+	bag->SetSaveDelta(delta ? save->BaseChits() : 0, save->LastChits(), &snapshot->chits);
+	bag->Serialize(&writer);
+	bag->SetSaveDelta(0, 0, 0);
+	XarcClose(&writer);
+
+	snapshot->game.Clear();
+	U8* p = snapshot->game.PushArr(writer.Data().Size());
+	memcpy(p, writer.Data().Mem(), writer.Data().Size());
+	save->Start();
+	save->Wait();
+}
+
+
+/*static*/ void BackgroundSave::Test()
+{
+	// A full save, then two deltas (the second replaces the first),
+	// loaded back and checked against the map and chits saved.
+	static const char* MAP = "savetest_map.dat";
+	static const char* GAME = "savetest_game.dat";
+	const int mapSize = MapSize();
+	GLString mapPath, gamePath;
+	GetSystemPath(GAME_SAVE_DIR, MAP, &mapPath);
+	GetSystemPath(GAME_SAVE_DIR, GAME, &gamePath);
+
+	ChitContext context;
+	WorldMap* map = new WorldMap(128, 128);
+	map->InitCircle();
+	ChitBag* bag = new ChitBag(context);
+	BackgroundSave* save = new BackgroundSave();
+
+	Chit* moved0 = bag->NewChit();
+	Chit* moved1 = bag->NewChit();
+	Chit* deleted = bag->NewChit();
+	Chit* untouched = bag->NewChit();
+	moved0->SetPosition(60, 0, 60);
+	moved1->SetPosition(61, 0, 60);
+	deleted->SetPosition(62, 0, 60);
+	untouched->SetPosition(63, 0, 60);
+	const int moved0ID = moved0->ID(), moved1ID = moved1->ID(), deletedID = deleted->ID(), untouchedID = untouched->ID();
+
+	TestSave(save, map, bag, mapPath.c_str(), gamePath.c_str());	// base
+
+	map->SetPave(60, 60, 1);
+	moved0->SetPosition(70, 0, 70);
+	bag->DeleteChit(deleted);
+	TestSave(save, map, bag, mapPath.c_str(), gamePath.c_str());	// delta 1
+
+	map->SetPave(70, 70, 2);
+	moved1->SetPosition(71, 0, 70);
+	Chit* added = bag->NewChit();
+	added->SetPosition(72, 0, 70);
+	const int addedID = added->ID();
+	TestSave(save, map, bag, mapPath.c_str(), gamePath.c_str());	// delta 2
+	GLTEST(save->nDeltas == 2);
+
+	// The untouched chit wasn't serialized for either delta.
+	GLTEST(!untouched->saveDirty);
+
+	delete save;
+	delete bag;
+	delete map;
+
+	map = new WorldMap(128, 128);
+	map->Load(MAP);
+	GLTEST(map->GetWorldGrid(60, 60).Pave() == 1);
+	GLTEST(map->GetWorldGrid(70, 70).Pave() == 2);
+	GLTEST(map->GetWorldGrid(64, 64).IsLand());
+	GLTEST(!map->GetWorldGrid(1, 1).IsLand());
+
+	bag = new ChitBag(context);
+	FILE* fp = fopen(gamePath.c_str(), "rb");
+	GLTEST(fp);
+	if (fp) {
+		StreamReader base(fp);
+		XarcOpen(&base, "Sim");
+		DeltaReader delta;
+		StreamReader* deltaReader = delta.Open(gamePath.c_str(), &base, "Sim");
+		GLTEST(deltaReader);
+		StreamReader& reader = deltaReader ? *deltaReader : base;
+		bag->SetLoadBase(deltaReader ? &base : 0);
+		bag->Serialize(&reader);
+		bag->SetLoadBase(0);
+		XarcClose(&reader);
+		fclose(fp);
+	}
+	const Chit* c = bag->GetChit(moved0ID);
+	GLTEST(c && c->Position().x == 70 && c->Position().z == 70);
+	c = bag->GetChit(moved1ID);
+	GLTEST(c && c->Position().x == 71 && c->Position().z == 70);
+	c = bag->GetChit(untouchedID);
+	GLTEST(c && c->Position().x == 63 && c->Position().z == 60);
+	c = bag->GetChit(addedID);
+	GLTEST(c && c->Position().x == 72 && c->Position().z == 70);
+	GLTEST(bag->GetChit(deletedID) == 0);
+
+	delete bag;
+	delete map;
+	SetMapSize(mapSize);
+
+	GLString path;
+	remove(mapPath.c_str());
+	remove(gamePath.c_str());
+	DeltaPath(mapPath.c_str(), &path);
+	remove(path.c_str());
+	DeltaPath(gamePath.c_str(), &path);
+	remove(path.c_str());
+}
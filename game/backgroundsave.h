@@ -0,0 +1,155 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LUMOS_BACKGROUND_SAVE_INCLUDED
+#define LUMOS_BACKGROUND_SAVE_INCLUDED
+
+#include "../grinliz/gltypes.h"
+#include "../grinliz/gldebug.h"
+#include "../grinliz/glcontainer.h"
+#include "../grinliz/glstringutil.h"
+#include "worldmap.h"
+#include "gridstore.h"
+
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+
+class StreamReader;
+
+/*	Writes a file by way of a temporary that is renamed over the
+	target in Commit(). A crash (or a failed write) while saving
+	leaves the last good save in place. If Commit() isn't called,
+	the temporary is removed.
+*/
+class SaveFile
+{
+public:
+	SaveFile(const char* path);
+	~SaveFile();
+
+	FILE* FP() { return fp; }
+	bool Commit();
+
+private:
+	grinliz::GLString path;
+	grinliz::GLString temp;
+	FILE* fp;
+};
+
+
+/*	The delta save that goes with a full save. Open() is called
+	with the top element of the full save open, and only returns
+	a reader if the delta was written against that save.
+*/
+class DeltaReader
+{
+public:
+	DeltaReader() : fp(0), reader(0) {}
+	~DeltaReader();
+
+	// Returns the reader of the delta with its top element, which
+	// must be 'element', open. Null if there is no (matching) delta.
+	StreamReader* Open(const char* basePath, StreamReader* base, const char* element);
+	FILE* FP() { return fp; }
+
+private:
+	void Close();
+
+	FILE* fp;
+	StreamReader* reader;
+};
+
+
+// Everything the Sim saves, copied out at a tick boundary.
+struct SimSnapshot
+{
+	SimSnapshot() : delta(false), baseID(0) {}
+
+	bool					delta;		// only what changed since the full save 'baseID'
+	U32						baseID;
+	MapSnapshot				map;
+	grinliz::CDynArray<U8>	game;		// the "Sim" stream
+	grinliz::HashTable<int, U32> chits;	// checksum of every chit, from ChitBag::SetSaveDelta()
+};
+
+
+/*	Saves on a thread. The Sim fills in the snapshot on the main
+	thread, and the compression and file writes happen here. The
+	snapshot's copy of the grid is kept between saves, so a save
+	only copies the chunks written since the last one; the chits
+	that weren't touched since the last save, and were the same
+	as the base then, aren't serialized at all.
+
+	Saves are deltas where possible: a full save is the base, and
+	after that the map chunks and chits that changed since the base
+	are written to the delta files (see DeltaPath()), which replace
+	the last delta. When the deltas get big, or every MAX_DELTAS
+	saves, the next save is a full one and the deltas are removed.
+*/
+class BackgroundSave
+{
+public:
+	BackgroundSave();
+	~BackgroundSave();	// waits for the save to finish
+
+	bool Busy() const { return busy; }
+	void Wait();
+
+	// Snapshot to fill in for a save to the (full) paths; null if
+	// Busy(). Decides if the save is a delta.
+	SimSnapshot* GetSnapshot(const char* mapPath, const char* gamePath);
+	// The chit checksums of the base, and of the last snapshot,
+	// for ChitBag::SetSaveDelta().
+	grinliz::HashTable<int, U32>* BaseChits() { return &baseChits; }
+	grinliz::HashTable<int, U32>* LastChits() { return &lastChits; }
+	// The grid chunks changed since the base, for WorldMap::Snapshot().
+	U8* ChangedChunks() { return changed; }
+	// Start writing GetSnapshot().
+	void Start();
+
+	// The file a delta of the save at 'path' goes to.
+	static void DeltaPath(const char* path, grinliz::GLString* delta);
+	// Identifies a full save.
+	static U32 NewBaseID();
+
+	static void Test();
+
+private:
+	enum { MAX_DELTAS = 12 };
+
+	void ThreadMain();
+	bool Write();
+
+	std::thread thread;
+	std::atomic<bool> busy;
+	SimSnapshot snapshot;
+	grinliz::GLString mapPath;
+	grinliz::GLString gamePath;
+
+	// The full save the deltas are written against. Only
+	// touched by the thread while Busy().
+	U32 baseID;
+	int nDeltas;
+	long baseBytes;
+	long deltaBytes;
+	grinliz::GLString baseMapPath;
+	grinliz::GLString baseGamePath;
+	grinliz::HashTable<int, U32> baseChits;
+	grinliz::HashTable<int, U32> lastChits;
+	U8 changed[GridStore::NUM_CHUNKS];
+};
+
+#endif // LUMOS_BACKGROUND_SAVE_INCLUDED
@@ -69,25 +69,12 @@ void CircuitSim::Connection::Serialize(XStream* xs)
 }
 
 
-void CircuitSim::Particle::Serialize(XStream* xs)
-{
-	XarcOpen(xs, "Particle");
-	XARC_SER_ENUM(xs, EParticleType, type);
-	XARC_SER(xs, powerRequest);
-	XARC_SER(xs, origin);
-	XARC_SER(xs, pos);
-	XARC_SER(xs, dest);
-	XARC_SER(xs, delay);
-	XarcClose(xs);
-}
-
-
 void CircuitSim::Serialize(XStream* xs)
 {
 	XarcOpen(xs, "CircuitSim");
 	XARC_SER(xs, enableOverlay);
 	XARC_SER_CARRAY(xs, connections);
-	XARC_SER_CARRAY(xs, particles);
+	XARC_SER_POD_CARRAY(xs, particles);
 
 	// FIXME: serialize hashtable general solution?
 
@@ -181,7 +168,9 @@ void CircuitSim::DeviceOn(Chit* building)
 		Vector3F trigger = { 0, 0, 0 };
 		rc->CalcTrigger(&trigger, 0);
 
-		XenoAudio::Instance()->PlayVariation(ISC::blasterWAV, building->ID(), &trigger);
+		if (XenoAudio::Instance()) {
+			XenoAudio::Instance()->PlayVariation(ISC::blasterWAV, building->ID(), &trigger);
+		}
 
 		DamageDesc dd(15, GameItem::EFFECT_SHOCK);
 		context->chitBag->NewBolt(trigger, straight, dd.effects, building->ID(),
@@ -41,6 +41,12 @@ public:
 
 	void EnableOverlay(bool enable) { enableOverlay = enable; ticker.SetReady(); }
 
+	// Nothing in flight: the sim can be serialized, freed, and
+	// re-created without losing anything.
+	bool Idle() const {
+		return particles.Empty() && newQueue.Empty() && gateTimers.Empty() && !enableOverlay && dragStart.IsZero();
+	}
+
 private:
 
 	struct Connection {
@@ -64,8 +70,6 @@ private:
 		grinliz::Vector2F pos;
 		grinliz::Vector2F dest;
 		int delay;
-
-		void Serialize(XStream* xs);
 	};
 
 	void CalcGroups();
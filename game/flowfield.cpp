@@ -0,0 +1,197 @@
+#include "flowfield.h"
+#include "worldmap.h"
+#include "lumosmath.h"
+
+#include "../Shiny/include/Shiny.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace grinliz;
+
+static const Vector2I FLOW_DIR[8] = {
+	{ 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 },
+	{ 1, 1 }, { -1, 1 }, { -1, -1 }, { 1, -1 }
+};
+
+FlowFields::FlowFields(WorldMap* map) : worldMap(map), clock(0), nComputed(0)
+{
+	memset(sectorVersion, 0, sizeof(sectorVersion));
+}
+
+
+FlowFields::~FlowFields()
+{
+	while (!fields.Empty()) {
+		delete fields.Pop();
+	}
+}
+
+
+void FlowFields::InvalidateAll()
+{
+	for (int i = 0; i < NUM_SECTORS_2; ++i) {
+		sectorVersion[i]++;
+	}
+}
+
+
+FlowFields::Field* FlowFields::GetField(const Vector2I& sector, const Rectangle2I& dest)
+{
+	++clock;
+	U32 version = sectorVersion[sector.y * NUM_SECTORS + sector.x];
+	Field* field = 0;
+	for (int i = 0; i < fields.Size(); ++i) {
+		if (fields[i]->sector == sector && fields[i]->dest == dest) {
+			field = fields[i];
+			break;
+		}
+	}
+	if (!field) {
+		if (fields.Size() < MAX_FIELDS) {
+			field = new Field();
+			fields.Push(field);
+		}
+		else {
+			// Re-use the least recently used.
+			field = fields[0];
+			for (int i = 1; i < fields.Size(); ++i) {
+				if (fields[i]->lastUsed < field->lastUsed) {
+					field = fields[i];
+				}
+			}
+		}
+		field->sector = sector;
+		field->dest = dest;
+		field->version = version + 1;	// force compute
+	}
+	if (field->version != version) {
+		field->version = version;
+		Compute(field);
+	}
+	field->lastUsed = clock;
+	return field;
+}
+
+
+bool FlowFields::CanStep(const Field& field, const Vector2I& pos, const Vector2I& dir) const
+{
+	Rectangle2I bounds = SectorBounds(field.sector);
+	Vector2I next = pos + dir;
+	if (!bounds.Contains(next) || !worldMap->IsPassable(next.x, next.y))
+		return false;
+	if (dir.x && dir.y) {
+		// Don't cut corners; same as the zone pather.
+		if (!worldMap->IsPassable(pos.x + dir.x, pos.y) || !worldMap->IsPassable(pos.x, pos.y + dir.y))
+			return false;
+	}
+	return true;
+}
+
+
+void FlowFields::Compute(Field* field)
+{
+	PROFILE_FUNC();
+	++nComputed;
+	const Rectangle2I bounds = SectorBounds(field->sector);
+	for (int i = 0; i < SECTOR_SIZE_2; ++i) {
+		field->cost[i] = UNREACHABLE;
+	}
+
+	// Dijkstra out from the destination. The moves are symmetric,
+	// so the cost from the destination is the cost to it.
+	heap.Clear();
+	std::greater<U32> cmp;
+	Rectangle2I dest = field->dest;
+	dest.DoIntersection(bounds);
+	for (Rectangle2IIterator it(dest); !it.Done(); it.Next()) {
+		Vector2I p = it.Pos();
+		if (worldMap->IsPassable(p.x, p.y)) {
+			int tile = (p.y - bounds.min.y) * SECTOR_SIZE + (p.x - bounds.min.x);
+			field->cost[tile] = 0;
+			heap.Push(U32(tile));
+			std::push_heap(heap.Mem(), heap.Mem() + heap.Size(), cmp);
+		}
+	}
+
+	while (!heap.Empty()) {
+		std::pop_heap(heap.Mem(), heap.Mem() + heap.Size(), cmp);
+		U32 top = heap.Pop();
+		int tile = int(top & 0xfff);
+		int cost = int(top >> 12);
+		if (cost > field->cost[tile]) continue;	// stale entry
+
+		Vector2I pos = { bounds.min.x + (tile % SECTOR_SIZE), bounds.min.y + (tile / SECTOR_SIZE) };
+		for (int d = 0; d < 8; ++d) {
+			if (!CanStep(*field, pos, FLOW_DIR[d]))
+				continue;
+			int nCost = cost + (d < 4 ? COST_STRAIGHT : COST_DIAGONAL);
+			if (nCost >= UNREACHABLE) continue;
+			Vector2I next = pos + FLOW_DIR[d];
+			int nTile = (next.y - bounds.min.y) * SECTOR_SIZE + (next.x - bounds.min.x);
+			if (nCost < field->cost[nTile]) {
+				field->cost[nTile] = U16(nCost);
+				heap.Push((U32(nCost) << 12) | U32(nTile));
+				std::push_heap(heap.Mem(), heap.Mem() + heap.Size(), cmp);
+			}
+		}
+	}
+}
+
+
+bool FlowFields::CalcPath(const Vector2F& start, const Vector2F& end, const Rectangle2I& dest, CDynArray<Vector2F>* path, float* cost)
+{
+	path->Clear();
+	Vector2I pos = ToWorld2I(start);
+	Vector2I sector = ToSector(pos);
+	if (sector != ToSector(dest.min) || sector != ToSector(dest.max) || !dest.Contains(ToWorld2I(end)))
+		return false;
+
+	const Field* field = GetField(sector, dest);
+	const Rectangle2I bounds = SectorBounds(sector);
+	int c = field->cost[(pos.y - bounds.min.y) * SECTOR_SIZE + (pos.x - bounds.min.x)];
+	if (c == UNREACHABLE)
+		return false;
+	*cost = float(c) / float(COST_STRAIGHT);
+
+	// Walk down the field, then pull the string: keep a point
+	// only when the straight line to the next one is blocked.
+	steps.Clear();
+	steps.Push(pos);
+	while (c > 0 && steps.Size() < SECTOR_SIZE_2) {
+		int best = -1;
+		int bestCost = c;
+		for (int d = 0; d < 8; ++d) {
+			if (CanStep(*field, pos, FLOW_DIR[d])) {
+				Vector2I next = pos + FLOW_DIR[d];
+				int nc = field->cost[(next.y - bounds.min.y) * SECTOR_SIZE + (next.x - bounds.min.x)];
+				if (nc < bestCost) {
+					bestCost = nc;
+					best = d;
+				}
+			}
+		}
+		if (best < 0)
+			return false;	// can't happen, if the field is good
+		pos = pos + FLOW_DIR[best];
+		c = bestCost;
+		steps.Push(pos);
+	}
+	if (c > 0)
+		return false;
+
+	// Like RegionsToPath(), the path starts at 'start' and finishes
+	// at 'end'; 'end' is in the destination, so is close by.
+	path->Push(start);
+	Vector2F anchor = start;
+	for (int i = 1; i < steps.Size(); ++i) {
+		Vector2F next = ToWorld2F(steps[i]);
+		Vector2F after = (i + 1 < steps.Size()) ? ToWorld2F(steps[i + 1]) : end;
+		if (worldMap->GridPath(anchor, after, false))
+			continue;
+		path->Push(next);
+		anchor = next;
+	}
+	path->Push(end);
+	return true;
+}
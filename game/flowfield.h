@@ -0,0 +1,72 @@
+#ifndef FLOW_FIELD_INCLUDED
+#define FLOW_FIELD_INCLUDED
+
+#include "../grinliz/gldebug.h"
+#include "../grinliz/glvector.h"
+#include "../grinliz/glrectangle.h"
+#include "../grinliz/glcontainer.h"
+#include "gamelimits.h"
+
+class WorldMap;
+
+/*	Flow fields for group moves. A field holds the cost to reach a
+	destination from every tile of a sector, so any number of chits
+	heading to the same place (a herd to a port) walk down the field
+	instead of each running a search. Fields are cached per sector
+	and destination until something in the sector changes.
+*/
+class FlowFields
+{
+public:
+	FlowFields(WorldMap* worldMap);
+	~FlowFields();
+
+	// Path from 'start' to 'end', where 'end' is in the 'dest' rectangle
+	// that the field is built for. Everything must be in the same sector.
+	// Returns false if the destination can't be reached.
+	bool CalcPath(const grinliz::Vector2F& start,
+				  const grinliz::Vector2F& end,
+				  const grinliz::Rectangle2I& dest,
+				  grinliz::CDynArray<grinliz::Vector2F>* path,
+				  float* cost);
+
+	// Called when the passability of a tile in the sector changes.
+	void Invalidate(const grinliz::Vector2I& sector) {
+		sectorVersion[sector.y * NUM_SECTORS + sector.x]++;
+	}
+	void InvalidateAll();
+
+	int NumFields() const	{ return fields.Size(); }
+	int NumComputed() const { return nComputed; }
+
+private:
+	enum {
+		MAX_FIELDS = 64,
+		UNREACHABLE = 0xffff,
+		COST_STRAIGHT = 10,
+		COST_DIAGONAL = 14
+	};
+
+	struct Field {
+		grinliz::Vector2I	sector;
+		grinliz::Rectangle2I dest;
+		U32					version;
+		int					lastUsed;
+		U16					cost[SECTOR_SIZE_2];
+	};
+
+	Field* GetField(const grinliz::Vector2I& sector, const grinliz::Rectangle2I& dest);
+	void Compute(Field* field);
+	// Can we step from 'pos' in direction 'dir'? (Checks corners.)
+	bool CanStep(const Field& field, const grinliz::Vector2I& pos, const grinliz::Vector2I& dir) const;
+
+	WorldMap*	worldMap;
+	int			clock;
+	int			nComputed;
+	U32			sectorVersion[NUM_SECTORS_2];
+	grinliz::CDynArray<Field*>	fields;
+	grinliz::CDynArray<U32>		heap;	// (cost << 12) | tile
+	grinliz::CDynArray<grinliz::Vector2I> steps;
+};
+
+#endif // FLOW_FIELD_INCLUDED
@@ -15,9 +15,8 @@ static const int WATERFALL_HEIGHT = 1;
 static const int NDIR = 4;
 static const Vector2I DIR[NDIR] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
 
-U8 FluidSim::floodDepth[SECTOR_SIZE_2];
-grinliz::CArray<grinliz::Vector2I, SECTOR_SIZE_2> FluidSim::fillStack;
-grinliz::BitArray<SECTOR_SIZE, SECTOR_SIZE, 1> FluidSim::bitFlags;
+thread_local grinliz::CArray<grinliz::Vector2I, SECTOR_SIZE_2> FluidSim::fillStack;
+thread_local grinliz::BitArray<SECTOR_SIZE, SECTOR_SIZE, 1> FluidSim::bitFlags;
 
 
 FluidSim::FluidSim(WorldMap* wm, const Vector2I& s) : worldMap(wm), settled(false)
@@ -28,6 +27,8 @@ FluidSim::FluidSim(WorldMap* wm, const Vector2I& s) : worldMap(wm), settled(fals
 	innerBounds.Outset(-1);
 	fluidType = WorldGrid::FLUID_WATER;
 	nRocks = 0;
+	terrainDirty = true;
+	memset(floodDepth, 0, sizeof(floodDepth));
 }
 
 
@@ -45,11 +46,11 @@ void FluidSim::EmitWaterfalls(U32 delta, Engine* engine)
 
 	for (int i = 0; i<waterfalls.Size(); ++i) {
 		const Vector2I& wf = waterfalls[i];
-		const WorldGrid& wg = worldMap->grid[worldMap->INDEX(wf)];
+		const WorldGrid& wg = worldMap->grid.Get(worldMap->INDEX(wf));
 
 		for (int j = 0; j<NDIR; ++j) {
 			Vector2I v = wf + DIR[j];
-			const WorldGrid& altWG = worldMap->grid[worldMap->INDEX(v)];
+			const WorldGrid& altWG = worldMap->grid.Get(worldMap->INDEX(v));
 			int type = 0;
 			if (HasWaterfall(wg, altWG, &type)) {
 
@@ -110,18 +111,35 @@ int FluidSim::ContainsWaterfalls(const grinliz::Rectangle2I& bounds) const
 void FluidSim::Unsettle()
 {
 	settled = false;
+	terrainDirty = true;
+}
+
+
+void FluidSim::CommitChanges()
+{
+	for (int i = 0; i < changed.Size(); ++i) {
+		int index = changed[i];
+		worldMap->planes.Sync(index, worldMap->grid.Get(index));
+	}
+	changed.Clear();
 }
 
 
 bool FluidSim::DoStep()
 {
 	if (settled) return true;
+	settled = true;
+	if (!terrainDirty) {
+		// The pools are the same; just keep moving the fluid.
+		settled = MoveFluid();
+		return settled;
+	}
+	terrainDirty = false;
 
 	memset(floodDepth, 0, SECTOR_SIZE_2*sizeof(floodDepth[0]));
 
 	pools.Clear();
 	waterfalls.Clear();
-	settled = true;
 
 	for (int d = 1; d <= MAX_ROCK_HEIGHT; ++d) {
 		bitFlags.ClearAll();
@@ -130,7 +148,7 @@ bool FluidSim::DoStep()
 			Vector2I pos2i = it.Pos();
 			Vector2I loc2i = pos2i - outerBounds.min;
 
-			const WorldGrid& wg = worldMap->grid[worldMap->INDEX(pos2i)];
+			const WorldGrid& wg = worldMap->grid.Get(worldMap->INDEX(pos2i));
 
 			if (wg.IsWater() || wg.IsPort() || wg.IsGrid()) continue;
 			if (wg.RockHeight() >= d) continue;
@@ -169,7 +187,7 @@ bool FluidSim::FloodFill(const Vector2I& start, int d, grinliz::CDynArray<grinli
 	Vector2I locStart = start - outerBounds.min;
 	GLASSERT(locStart.x < SECTOR_SIZE && locStart.y < SECTOR_SIZE);
 
-	const WorldGrid& wg = worldMap->grid[worldMap->INDEX(start)];
+	const WorldGrid& wg = worldMap->grid.Get(worldMap->INDEX(start));
 
 	GLASSERT(wg.IsLand() && (!wg.IsPort()) && (!wg.IsGrid()));
 	GLASSERT(wg.RockHeight() < d);
@@ -189,7 +207,7 @@ bool FluidSim::FloodFill(const Vector2I& start, int d, grinliz::CDynArray<grinli
 		for (int i = 0; i < NDIR; ++i) {
 			Vector2I p1 = p0 + DIR[i];
 			Vector2I loc1 = p1 - outerBounds.min;
-			const WorldGrid& wg1 = worldMap->grid[worldMap->INDEX(p1)];
+			const WorldGrid& wg1 = worldMap->grid.Get(worldMap->INDEX(p1));
 			int index1 = loc1.y*SECTOR_SIZE + loc1.x;
 			bool onEdge = (outerBounds.min.x == p1.x) 
 				|| (outerBounds.max.x == p1.x) 
@@ -238,17 +256,20 @@ bool FluidSim::MoveFluid()
 		Vector2I loc2i = p - outerBounds.min;
 		GLASSERT(loc2i.x < SECTOR_SIZE && loc2i.y < SECTOR_SIZE);
 
-		WorldGrid* wg = &worldMap->grid[worldMap->INDEX(p)];
+		const int index = worldMap->INDEX(p);
+		WorldGrid* wg = &worldMap->grid[index];
 		int d = floodDepth[loc2i.y * SECTOR_SIZE + loc2i.x];
 
 		if (wg->fluidHeight < unsigned(d * FLUID_PER_ROCK)) {
 			wg->fluidHeight++;
 			wg->SetFluidType(fluidType);
+			changed.Push(index);
 			thisSettled = false;
 		}
 		else if (wg->fluidHeight > unsigned(d * FLUID_PER_ROCK)) {
 			wg->fluidHeight--;
 			wg->SetFluidType(fluidType);
+			changed.Push(index);
 			thisSettled = false;
 		}
 		if (wg->RockHeight()) {
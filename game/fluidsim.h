@@ -33,11 +33,17 @@ public:
 	~FluidSim();
 
 	// Call every 600ms (?)
+	// Sims of different sectors don't share any grid cells, and
+	// can step concurrently. The grid planes are shared, so the
+	// fluid changes are applied to them in CommitChanges(), which
+	// must be called from the main thread after DoStep().
 	bool DoStep();
+	void CommitChanges();
 	// Particle calls
 	void EmitWaterfalls(U32 delta, Engine* engine);
 
 	bool Settled() const { return settled; }
+	// The rock changed: the sim runs, and the pools are re-computed.
 	void Unsettle();
 
 	int NumWaterfalls() const { return waterfalls.Size(); }
@@ -66,14 +72,21 @@ private:
 	bool settled;
 	int fluidType;	// water or lava
 	int nRocks;
+	bool terrainDirty;	// floodDepth needs to be re-computed
 
 	grinliz::CDynArray<grinliz::Vector2I> waterfalls;
 	grinliz::CDynArray<grinliz::Vector2I> pools;
 
-	// can be shared - scratch memory.
-	static U8 floodDepth[SECTOR_SIZE_2];
-	static grinliz::CArray<grinliz::Vector2I, SECTOR_SIZE_2> fillStack;
-	static grinliz::BitArray<SECTOR_SIZE, SECTOR_SIZE, 1> bitFlags;
+	grinliz::CDynArray<int> changed;	// grid indices changed by MoveFluid()
+
+	// The flood depth only depends on the rock, so it is kept
+	// until the sector is Unsettle()d. MoveFluid() can take many
+	// steps to get to it.
+	U8 floodDepth[SECTOR_SIZE_2];
+
+	// Scratch memory, one per thread.
+	static thread_local grinliz::CArray<grinliz::Vector2I, SECTOR_SIZE_2> fillStack;
+	static thread_local grinliz::BitArray<SECTOR_SIZE, SECTOR_SIZE, 1> bitFlags;
 };
 
 #endif // WORLDMAP_FLUID_SIM_INCLUDED
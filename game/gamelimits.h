@@ -29,12 +29,19 @@ static const float ROTATION_SPEED		= 360.f;		// degrees/second
 static const int SECTOR_SIZE		= 64;
 static const int SECTOR_SIZE_2		= SECTOR_SIZE * SECTOR_SIZE;
 static const int INNER_SECTOR_SIZE	= (SECTOR_SIZE-2);
-static const int NUM_SECTORS		= MAX_MAP_SIZE / SECTOR_SIZE;
+static const int NUM_SECTORS		= MAX_MAP_SIZE / SECTOR_SIZE;		// per-sector tables; see NumSectors()
 static const int NUM_SECTORS_2		= NUM_SECTORS * NUM_SECTORS;
 
+// The size of the world being played: 512, 1024, or 2048.
+// Chosen when the world is generated, and read back from
+// the map file. Set by WorldMap::Init().
+int  MapSize();
+void SetMapSize(int size);
+// Sectors across the current map. The sector tables are
+// NUM_SECTORS across; only the first NumSectors() are used.
+inline int NumSectors() { return (MapSize() + SECTOR_SIZE - 1) / SECTOR_SIZE; }
+
 static const int START_SECTOR_CHOICES = 16;
-static const int MOTHER_CORE_SECTOR_X = NUM_SECTORS / 2;
-static const int MOTHER_CORE_SECTOR_Y = NUM_SECTORS / 2;
 
 static const float METERS_PER_GRID	= 2.0f;
 static const int MAX_ACTIVE_ITEMS	= 8;
@@ -68,23 +75,26 @@ static const int TEMPLES_REPELS_GREATER = 1;
 static const float TECH_ATTRACTS_GREATER = 2.5f;
 
 // General guidelines to the # of things in the world.
-static const int MAP_SCALE_FACTOR = (1024 * 1024) / (MAX_MAP_SIZE*MAX_MAP_SIZE);
+// The numbers are for a 1024 map; MapArea() is 1, 4, 16 for 512, 1024, 2048.
+inline int MapArea()			{ int a = MapSize() * MapSize() / (512 * 512); return a > 0 ? a : 1; }
 
-static const int TYPICAL_DOMAINS	= 120		/ MAP_SCALE_FACTOR;
-static const int TYPICAL_AI_DOMAINS = 40		/ MAP_SCALE_FACTOR;
-static const int TYPICAL_DENIZENS	= 800		/ MAP_SCALE_FACTOR;
-static const int TYPICAL_LESSER		= 1500		/ MAP_SCALE_FACTOR;
-static const int TYPICAL_GREATER	= 10		/ MAP_SCALE_FACTOR;		// These guys get overwhelming fast - they can clear a domain.
-static const int TYPICAL_PLANTS		= 50 * 1000 / MAP_SCALE_FACTOR;
+inline int TypicalDomains()		{ return 120		* MapArea() / 4; }
+inline int TypicalAIDomains()	{ return 40			* MapArea() / 4; }
+inline int TypicalDenizens()	{ return 800		* MapArea() / 4; }
+inline int TypicalLesser()		{ return 1500		* MapArea() / 4; }
+inline int TypicalGreater()		{ return 10			* MapArea() / 4; }		// These guys get overwhelming fast - they can clear a domain.
+inline int TypicalPlants()		{ return 50 * 1000	* MapArea() / 4; }
 
-static const int SPAWN_RATS			= TYPICAL_LESSER / 10;	// below this will aggressively spawn rats
+inline int SpawnRats()			{ return TypicalLesser() / 10; }	// below this will aggressively spawn rats
 
 static const int GOLD_PER_DENIZEN  = 100;
 static const int GOLD_PER_LESSER   =  10;
 static const int GOLD_PER_GREATER  = 100;
-static const int ALL_GOLD =	(TYPICAL_DENIZENS * GOLD_PER_DENIZEN
-							+ TYPICAL_LESSER * GOLD_PER_LESSER
-							+ TYPICAL_GREATER * GOLD_PER_GREATER) * 3 / 2;
+inline int AllGold() {
+	return (TypicalDenizens() * GOLD_PER_DENIZEN
+			+ TypicalLesser() * GOLD_PER_LESSER
+			+ TypicalGreater() * GOLD_PER_GREATER) * 3 / 2;
+}
 
 // Values to prevent huge accumulation in one very lucky MOB.
 static const int MAX_LESSER_GOLD	= 100;
@@ -92,10 +102,10 @@ static const int MAX_GREATER_GOLD	= 1000;
 static const int MAX_LESSER_MOB_CRYSTAL = 4;
 static const int MAX_GREATER_MOB_CRYSTAL = 12;
 
-static const int ALL_CRYSTAL_GREEN  = TYPICAL_DOMAINS * 15;		// was 10, seemed stressed.
-static const int ALL_CRYSTAL_RED    = TYPICAL_DOMAINS * 4;
-static const int ALL_CRYSTAL_BLUE   = TYPICAL_DOMAINS * 2;
-static const int ALL_CRYSTAL_VIOLET = TYPICAL_DOMAINS / 2;
+inline int AllCrystalGreen()		{ return TypicalDomains() * 15; }		// was 10, seemed stressed.
+inline int AllCrystalRed()		{ return TypicalDomains() * 4; }
+inline int AllCrystalBlue()		{ return TypicalDomains() * 2; }
+inline int AllCrystalViolet()	{ return TypicalDomains() / 2; }
 
 static const int DENIZEN_CLOCK = 5 * 1000;	// how often groups of 4 denizens spawn
 static const int DENIZEN_WEAPON_ODDS = 6;	// 3 in DENIZEN_WEAPON_ODDS is the chance of a weapon
@@ -0,0 +1,149 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LUMOS_GRID_PLANES_INCLUDED
+#define LUMOS_GRID_PLANES_INCLUDED
+
+#include "../grinliz/gltypes.h"
+#include "../grinliz/gldebug.h"
+#include "worldgrid.h"
+#include "gridstore.h"
+
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*	Bit planes that shadow the WorldGrid, one bit per grid cell,
+	indexed the same way as the grid. The full map scans only care
+	about a few flags, and testing them in the WorldGrid means
+	loading and decoding 8 bytes a cell. Here 64 cells are one word,
+	so a scan can skip a run of boring cells with a single test.
+
+	The WorldMap keeps the planes in sync: anything that writes to
+	the grid must call Sync() (or SyncAll() after a bulk change.)
+
+	On top of the planes is an 'active' summary, a bit per word
+	that has any effect cells in it. Effects are rare, so the scan
+	mostly tests the summary, 4096 cells at a time.
+*/
+class GridPlanes
+{
+public:
+	enum {
+		LAND,
+		PLANT,
+		FIRE,		// plant on fire
+		SHOCK,		// plant on shock
+		MAGMA,
+		LAVA,		// lava fluid over the cell
+		NUM_PLANES
+	};
+	enum {
+		WORD_SHIFT	= 6,
+		WORD_MASK	= 63,
+		NUM_WORDS	= MAX_MAP_SIZE_2 / 64,
+		NUM_ACTIVE	= NUM_WORDS / 64
+	};
+
+	GridPlanes()	{ Clear(); }
+
+	void Clear()	{ memset(planes, 0, sizeof(planes)); memset(active, 0, sizeof(active)); }
+
+	void Sync(int index, const WorldGrid& wg) {
+		const U64 bit = U64(1) << (index & WORD_MASK);
+		const int word = index >> WORD_SHIFT;
+		Set(LAND,  word, bit, wg.IsLand());
+		Set(PLANT, word, bit, wg.Plant() != 0);
+		Set(FIRE,  word, bit, wg.PlantOnFire());
+		Set(SHOCK, word, bit, wg.PlantOnShock());
+		Set(MAGMA, word, bit, wg.Magma());
+		Set(LAVA,  word, bit, wg.IsFluid() && wg.FluidType() == WorldGrid::FLUID_LAVA);
+
+		const U64 activeBit = U64(1) << (word & WORD_MASK);
+		if (EffectWord(word))
+			active[word >> WORD_SHIFT] |= activeBit;
+		else
+			active[word >> WORD_SHIFT] &= ~activeBit;
+	}
+
+	void SyncAll(const GridStore& grid) {
+		Clear();
+		for (int i = 0; i < MAX_MAP_SIZE_2; ++i) {
+			Sync(i, grid[i]);
+		}
+	}
+
+	bool Test(int plane, int index) const {
+		GLASSERT(plane >= 0 && plane < NUM_PLANES);
+		GLASSERT(index >= 0 && index < MAX_MAP_SIZE_2);
+		return (planes[plane][index >> WORD_SHIFT] & (U64(1) << (index & WORD_MASK))) != 0;
+	}
+	bool Test(int plane, int x, int y) const {
+		return Test(plane, (y << MAP_Y_SHIFT) | x);
+	}
+
+	// The cells that the effect scan needs to visit: land that is
+	// burning, shocked, magma, or under lava.
+	U64 EffectWord(int word) const {
+		return planes[LAND][word]
+			& (planes[FIRE][word] | planes[SHOCK][word] | planes[MAGMA][word] | planes[LAVA][word]);
+	}
+
+	// First word in [word, end) with effect cells, or 'end' if there are none.
+	int NextEffectWord(int word, int end) const {
+		while (word < end) {
+			U64 a = active[word >> WORD_SHIFT] >> (word & WORD_MASK);
+			if (a) {
+				word += LowestBit(a);
+				return word < end ? word : end;
+			}
+			word = (word | WORD_MASK) + 1;
+		}
+		return end;
+	}
+
+	bool AnyEffect() const {
+		for (int i = 0; i < NUM_ACTIVE; ++i) {
+			if (active[i]) return true;
+		}
+		return false;
+	}
+
+	// Index of the lowest set bit. 'w' must not be 0.
+	static int LowestBit(U64 w) {
+		GLASSERT(w);
+#ifdef _MSC_VER
+		unsigned long i = 0;
+		_BitScanForward64(&i, w);
+		return int(i);
+#else
+		return __builtin_ctzll(w);
+#endif
+	}
+
+private:
+	void Set(int plane, int word, U64 bit, bool on) {
+		if (on)
+			planes[plane][word] |= bit;
+		else
+			planes[plane][word] &= ~bit;
+	}
+
+	U64 planes[NUM_PLANES][NUM_WORDS];
+	U64 active[NUM_ACTIVE];		// bit per word: EffectWord() != 0
+};
+
+#endif // LUMOS_GRID_PLANES_INCLUDED
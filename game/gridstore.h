@@ -0,0 +1,179 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LUMOS_GRID_STORE_INCLUDED
+#define LUMOS_GRID_STORE_INCLUDED
+
+#include "../grinliz/gltypes.h"
+#include "../grinliz/gldebug.h"
+#include "worldgrid.h"
+
+#include <string.h>
+#include <atomic>
+
+/*	Storage for the WorldGrid. Indexed like a flat array,
+	(y << MAP_Y_SHIFT) | x, but the cells are kept in a chunk
+	per sector that is allocated the first time it is written.
+	A map smaller than MAX_MAP_SIZE, or mostly untouched, only
+	pays for the sectors it uses.
+
+	Reading a cell in a chunk that doesn't exist returns water,
+	the same as a cleared grid. Note that a non-const operator[]
+	is a write, and will allocate. Readers should use Get(), which
+	never allocates and so is safe on any thread. Threads can
+	allocate at the same time as long as they work on different
+	sectors.
+
+	Every write path marks its chunk dirty, so a save can copy
+	only the chunks that changed (CopyDirtyTo()).
+*/
+class GridStore
+{
+public:
+	enum {
+		CHUNK_SHIFT = 6,		// SECTOR_SIZE
+		CHUNK_SIZE  = 1 << CHUNK_SHIFT,
+		CHUNK_MASK  = CHUNK_SIZE - 1,
+		CHUNKS_PER_ROW = MAX_MAP_SIZE / CHUNK_SIZE,
+		NUM_CHUNKS = CHUNKS_PER_ROW * CHUNKS_PER_ROW
+	};
+
+	GridStore() : nChunks(0) {
+		GLASSERT(CHUNK_SIZE == SECTOR_SIZE);
+		memset(chunks, 0, sizeof(chunks));
+		memset(dirty, 1, sizeof(dirty));
+	}
+	~GridStore() { Clear(); }
+
+	// Free all the chunks; the whole grid reads as water.
+	void Clear() {
+		for (int i = 0; i < NUM_CHUNKS; ++i) {
+			delete[] chunks[i];
+			chunks[i] = 0;
+		}
+		nChunks = 0;
+		memset(dirty, 1, sizeof(dirty));
+	}
+
+	WorldGrid& operator[](int index) {
+		const int ci = Chunk(index);
+		WorldGrid*& c = chunks[ci];
+		dirty[ci] = 1;
+		if (!c) {
+			c = new WorldGrid[CHUNK_SIZE*CHUNK_SIZE];
+			memset(c, 0, sizeof(WorldGrid)*CHUNK_SIZE*CHUNK_SIZE);
+			++nChunks;
+		}
+		return c[Local(index)];
+	}
+
+	const WorldGrid& operator[](int index) const {
+		return Get(index);
+	}
+
+	// Read a cell. Never allocates: a chunk that doesn't
+	// exist reads as a shared water cell.
+	const WorldGrid& Get(int index) const {
+		const WorldGrid* c = chunks[Chunk(index)];
+		return c ? c[Local(index)] : water;
+	}
+
+	// The cell, if its chunk exists, else null. For the writes
+	// (debug flags) that don't need to touch water.
+	WorldGrid* Find(int index) {
+		const int ci = Chunk(index);
+		WorldGrid* c = chunks[ci];
+		if (!c) return 0;
+		dirty[ci] = 1;
+		return c + Local(index);
+	}
+
+	// A run of the cells in one chunk row: (x,y) to the end
+	// of the chunk. May be null if the chunk doesn't exist.
+	const WorldGrid* Run(int x, int y) const {
+		const WorldGrid* c = chunks[Chunk((y << MAP_Y_SHIFT) | x)];
+		return c ? c + Local((y << MAP_Y_SHIFT) | x) : 0;
+	}
+	WorldGrid* Run(int x, int y) {
+		return &(*this)[(y << MAP_Y_SHIFT) | x];
+	}
+
+	// Replace the contents of 'dst' with a copy of this.
+	void CopyTo(GridStore* dst) const {
+		dst->Clear();
+		for (int i = 0; i < NUM_CHUNKS; ++i) {
+			if (chunks[i]) {
+				dst->chunks[i] = new WorldGrid[CHUNK_SIZE*CHUNK_SIZE];
+				memcpy(dst->chunks[i], chunks[i], sizeof(WorldGrid)*CHUNK_SIZE*CHUNK_SIZE);
+				++dst->nChunks;
+			}
+		}
+	}
+
+	// Bring 'dst', a copy made by earlier calls, up to date by
+	// copying the chunks written since, and clear the dirty bits.
+	// The chunks copied are also set in 'changed' (NUM_CHUNKS.)
+	void CopyDirtyTo(GridStore* dst, U8* changed) {
+		for (int i = 0; i < NUM_CHUNKS; ++i) {
+			if (!dirty[i]) continue;
+			dirty[i] = 0;
+			changed[i] = 1;
+			if (chunks[i]) {
+				if (!dst->chunks[i]) {
+					dst->chunks[i] = new WorldGrid[CHUNK_SIZE*CHUNK_SIZE];
+					++dst->nChunks;
+				}
+				memcpy(dst->chunks[i], chunks[i], sizeof(WorldGrid)*CHUNK_SIZE*CHUNK_SIZE);
+			}
+			else if (dst->chunks[i]) {
+				delete[] dst->chunks[i];
+				dst->chunks[i] = 0;
+				--dst->nChunks;
+			}
+		}
+	}
+
+	// The chunk (0 to NUM_CHUNKS-1) that holds (x,y).
+	static int ChunkIndex(int x, int y)	{ return Chunk((y << MAP_Y_SHIFT) | x); }
+
+	// Chunks across a map 'size' cells wide.
+	static int MapChunks(int size)	{ return (size + CHUNK_MASK) >> CHUNK_SHIFT; }
+
+	int NumChunks() const		{ return nChunks.load(); }
+	size_t MemoryUsed() const	{ return size_t(nChunks.load()) * sizeof(WorldGrid) * CHUNK_SIZE * CHUNK_SIZE; }
+
+private:
+	GridStore(const GridStore&);		// not supported
+	void operator=(const GridStore&);	// not supported
+
+	static int Chunk(int index) {
+		GLASSERT(index >= 0 && index < MAX_MAP_SIZE_2);
+		int x = index & MAP_X_MASK;
+		int y = index >> MAP_Y_SHIFT;
+		return (y >> CHUNK_SHIFT) * CHUNKS_PER_ROW + (x >> CHUNK_SHIFT);
+	}
+	static int Local(int index) {
+		int x = index & CHUNK_MASK;
+		int y = (index >> MAP_Y_SHIFT) & CHUNK_MASK;
+		return (y << CHUNK_SHIFT) | x;
+	}
+
+	std::atomic<int> nChunks;
+	WorldGrid* chunks[NUM_CHUNKS];
+	U8 dirty[NUM_CHUNKS];		// written since the last CopyDirtyTo(); a byte each, so threads can mark different chunks at once
+	static const WorldGrid water;
+};
+
+#endif // LUMOS_GRID_STORE_INCLUDED
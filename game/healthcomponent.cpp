@@ -56,6 +56,11 @@ int HealthComponent::DoTick(U32 delta)
 	}
 	if (item) {
 		if (item->hp == 0) {
+			if (ChitBag::ParallelTicking()) {
+				// Creates the tombstone.
+				Context()->chitBag->DeferTick(this, delta);
+				return VERY_LONG_TICK;
+			}
 			// Audio.
 			if (XenoAudio::Instance()) {
 				MOBIshFilter mobIsh;
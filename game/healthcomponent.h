@@ -42,6 +42,8 @@ public:
 	virtual void DebugStr( grinliz::GLString* str )		{ str->AppendFormat( "[Health] " ); }
 	virtual void OnChitMsg( Chit* chit, const ChitMsg& msg );
 	virtual int DoTick( U32 delta );
+	// Only dying has to be serial.
+	virtual bool ParallelTickSafe() const { return true; }
 
 private:
 };
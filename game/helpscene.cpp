@@ -86,16 +86,18 @@ void HelpScene::Resize()
 	while( currentScreen >= nPages ) currentScreen -= nPages;
 
 	const gamedb::Item* pageItem = helpItem->Child( currentScreen );
-	const char* text = 0;
 
 	grinliz::GLString full = "text_";
 	full += PlatformName();
-
-	if ( pageItem->HasAttribute( full.c_str() ) ) {
-		text = (const char*)reader->AccessData( pageItem, full.c_str(), 0 );
-	}
-	else {
-		text = (const char*)reader->AccessData( pageItem, "text", 0 );
+	const char* attrib = pageItem->HasAttribute( full.c_str() ) ? full.c_str() : "text";
+
+	// Text stored uncompressed points in to the database file,
+	// and isn't null terminated: copy it out by size.
+	int size = 0;
+	const char* mem = (const char*)reader->AccessData( pageItem, attrib, &size );
+	grinliz::GLString text;
+	if ( mem && size ) {
+		text.append( mem, size );
 	}
 
 	float tw = port.UIWidth() - GAME_GUTTER*2.0f;
@@ -127,7 +129,7 @@ void HelpScene::Resize()
 
 	textBox.SetPos( GAME_GUTTER, GAME_GUTTER );
 	textBox.SetSize( port.UIWidth()-GAME_GUTTER*2.f, port.UIHeight()-GAME_GUTTER*2.f );
-	textBox.SetText( text ? text : "" );
+	textBox.SetText( text.c_str() );
 
 	buttons[PREV_BUTTON].SetEnabled( currentScreen > 0 );
 	buttons[NEXT_BUTTON].SetEnabled( currentScreen < nPages - 1 );
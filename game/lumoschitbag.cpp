@@ -543,7 +543,7 @@ Chit* LumosChitBag::NewVisitor( int visitorIndex, const Web& web)
 	const ChitContext* context = Context();
 	if (web.Empty()) return 0;
 
-	Vector2I startSector = { NUM_SECTORS / 2, NUM_SECTORS / 2 };
+	Vector2I startSector = { NumSectors() / 2, NumSectors() / 2 };
 	CoreScript* cs = CoreScript::GetCore(startSector);
 	if (!cs) return 0;	// cores get deleted, web is cached, etc.
 	Vector3F pos = cs->ParentChit()->Position();
@@ -1072,9 +1072,15 @@ void RelationshipFilter::CheckRelationship(int _team, ERelate _relationship)
 
 
 bool RelationshipFilter::Accept( Chit* chit )
+{
+	return AcceptTeam(chit->Team());
+}
+
+
+bool RelationshipFilter::AcceptTeam(int t) const
 {
 	if (team < 0) return true;	// not checking.
-	return Team::Instance()->GetRelationship(team, chit->Team()) == relationship;
+	return Team::Instance()->GetRelationship(team, t) == relationship;
 }
 
 
@@ -1259,7 +1265,7 @@ bool LumosChitBag::PopScene( int* id, SceneData** data )
 
 IString LumosChitBag::NameGen(const char* dataset, int seed)
 {
-	const gamedb::Reader* database = Context()->game->GetDatabase();
+	const gamedb::Reader* database = Context()->database;
 	const gamedb::Item* parent = database->Root()->Child("markovName");
 	GLASSERT(parent);
 	const gamedb::Item* item = parent->Child(dataset);
@@ -1346,6 +1352,7 @@ CoreScript* LumosChitBag::TakeOverCore(const Vector2I& sector, Chit* conquerer)
 		}
 		else if (buildingFilter.Accept(c) && mainItem->IName() != ISC::core) {
 			c->GetItem()->SetTeam(teamID);
+			UpdateSpatialFlags(c);
 		}
 	}
 	// Finally, give this new core a chance. 
@@ -1397,3 +1404,47 @@ void LumosChitBag::DoTick(U32 delta)
 	}
 	super::DoTick(delta);
 }
+
+
+U32 LumosChitBag::SpatialFlags(Chit* chit)
+{
+	U32 flags = super::SpatialFlags(chit);
+	const GameItem* item = chit->GetItem();
+	if (item && !item->keyValues.GetIString(ISC::mob).empty()) {
+		flags |= SPATIAL_MOB;
+	}
+	if (GET_SUB_COMPONENT(chit, SpatialComponent, MapSpatialComponent)) {
+		flags |= SPATIAL_BUILDING;
+	}
+	return flags;
+}
+
+
+int LumosChitBag::ChitLOD(Chit* chit)
+{
+	const Rectangle3F& aoi = AreaOfInterest();
+	const Vector3F& pos = chit->Position();
+	if (aoi.Contains(pos) || chit->PlayerControlled()) {
+		return LOD_FULL;
+	}
+	AIComponent* ai = chit->GetAIComponent();
+	if (ai && ai->AwareOfEnemy()) {
+		return LOD_FULL;
+	}
+	Vector2I sector = ToSector(pos);
+	if (sector == GetHomeSector()) {
+		return LOD_FULL;
+	}
+
+	// A sector's width past the area of interest.
+	static const float MARGIN = float(SECTOR_SIZE);
+	bool far =    pos.x < aoi.min.x - MARGIN || pos.x > aoi.max.x + MARGIN
+			   || pos.z < aoi.min.z - MARGIN || pos.z > aoi.max.z + MARGIN;
+	if (far && Team::Group(chit->Team()) < TEAM_HOUSE) {
+		CoreScript* cs = CoreScript::GetCore(sector);
+		if (!cs || !cs->InUse()) {
+			return LOD_STATISTICAL;
+		}
+	}
+	return LOD_COARSE;
+}
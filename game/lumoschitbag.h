@@ -36,6 +36,7 @@ class BuildingFilter : public IChitAccept
 {
 public:
 	virtual bool Accept( Chit* chit );
+	virtual U32 SpatialFlags() const { return SPATIAL_BUILDING; }
 };
 
 
@@ -43,12 +44,14 @@ class BuildingRepairFilter : public IChitAccept
 {
 public:
 	virtual bool Accept(Chit* chit);
+	virtual U32 SpatialFlags() const { return SPATIAL_BUILDING; }
 };
 
 class BuildingWithPorchFilter : public IChitAccept
 {
 public:
 	virtual bool Accept(Chit* chit);
+	virtual U32 SpatialFlags() const { return SPATIAL_BUILDING; }
 };
 
 // This one is abstract - has no Type()
@@ -58,6 +61,7 @@ public:
 	RelationshipFilter() : team(-1), relationship(ERelate::NEUTRAL) {}
 
 	virtual bool Accept( Chit* chit );
+	virtual bool AcceptTeam(int team) const;
 
 	void CheckRelationship(Chit* compareTo, ERelate status);
 	void CheckRelationship(int team, ERelate status);
@@ -72,6 +76,7 @@ class MOBKeyFilter : public RelationshipFilter
 {
 public:
 	virtual bool Accept( Chit* chit );
+	virtual U32 SpatialFlags() const { return SPATIAL_MOB; }
 		
 	grinliz::IString value;	// if null (the default) will accept any value for the "mob" key
 };
@@ -99,6 +104,7 @@ class RemovableFilter : public IChitAccept
 {
 public:
 	virtual bool Accept( Chit* chit );
+	virtual U32 SpatialFlags() const { return SPATIAL_BUILDING; }
 };
 
 
@@ -106,6 +112,7 @@ class ChitHasMapSpatial : public IChitAccept
 {
 public:
 	virtual bool Accept( Chit* chit );
+	virtual U32 SpatialFlags() const { return SPATIAL_BUILDING; }
 };
 
 class ItemNameFilter : public IChitAccept
@@ -115,6 +122,7 @@ public:
 	ItemNameFilter( const grinliz::IString* names, int n);
 
 	virtual bool Accept( Chit* chit );
+	virtual U32 SpatialFlags() const { return SPATIAL_ITEM; }
 
 protected:
 	ItemNameFilter();
@@ -128,6 +136,7 @@ public:
 	ItemFlagFilter( int _required, int _excluded ) : required(_required), excluded(_excluded) {}
 
 	virtual bool Accept( Chit* chit );
+	virtual U32 SpatialFlags() const { return SPATIAL_ITEM; }
 	
 private:
 	int required, excluded;
@@ -148,6 +157,7 @@ class LootFilter : public IChitAccept
 {
 public:
 	virtual bool Accept( Chit* chit );
+	virtual U32 SpatialFlags() const { return SPATIAL_ITEM; }
 };
 
 
@@ -165,6 +175,7 @@ class FruitElixirFilter : public IChitAccept
 {
 public:
 	virtual bool Accept(Chit* chit);
+	virtual U32 SpatialFlags() const { return SPATIAL_ITEM; }
 };
 
 
@@ -173,6 +184,7 @@ class WeaponFilter : public IChitAccept
 {
 public:
 	virtual bool Accept(Chit* chit);
+	virtual U32 SpatialFlags() const { return SPATIAL_ITEM; }
 };
 
 
@@ -181,6 +193,7 @@ class TeamFilter : public IChitAccept
 public:
 	TeamFilter(int _team) : team(_team) {}
 	virtual bool Accept(Chit* chit);
+	virtual bool AcceptTeam(int t) const { return t == team; }
 
 private:
 	int team;
@@ -202,6 +215,11 @@ public:
 	Sim* GetSim() const { return sim; }
 
 	virtual void DoTick( U32 delta );
+	// Full: in view, the avatar, the home domain, or fighting.
+	// Statistical: wildlife well out of view and outside any domain.
+	// Everything else is coarse.
+	virtual int ChitLOD( Chit* chit );
+	virtual U32 SpatialFlags( Chit* chit );
 
 	// Buildings can't move - no update.
 	void AddToBuildingHash( MapSpatialComponent* chit, int x, int y );
@@ -17,6 +17,7 @@
 #include "gamelimits.h"
 #include "worldinfo.h"
 #include "layout.h"
+#include "backgroundsave.h"
 #include "../markov/markov.h"
 
 #include "../scenes/titlescene.h"
@@ -49,6 +50,9 @@ LumosGame::LumosGame(  int width, int height, int rotation )
 {
 	InitButtonLooks();
 	CoreScript::Init();
+#ifdef DEBUG
+	BackgroundSave::Test();
+#endif
 
 	PushScene( SCENE_TITLE, 0 );
 	PushPopScene();
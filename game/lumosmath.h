@@ -67,8 +67,8 @@ inline grinliz::Vector2I AdjacentWorldGrid( const grinliz::Vector2F& pos2 ) {
 
 inline grinliz::Vector2I ToSector( const grinliz::Vector2I& pos2i ) {
 	grinliz::Vector2I v = { pos2i.x / SECTOR_SIZE, pos2i.y / SECTOR_SIZE };
-	GLASSERT( v.x >= 0 && v.x < NUM_SECTORS );
-	GLASSERT( v.y >= 0 && v.y < NUM_SECTORS );
+	GLASSERT( v.x >= 0 && v.x < NumSectors() );
+	GLASSERT( v.y >= 0 && v.y < NumSectors() );
 	return v;
 }
 
@@ -107,7 +107,7 @@ inline grinliz::Rectangle2I InnerSectorBounds( const grinliz::Vector2I& sector )
 }
 
 inline int SectorIndex( const grinliz::Vector2I& sector ) {
-	GLASSERT( sector.x >= 0 && sector.y >= 0 && sector.x < NUM_SECTORS && sector.y < NUM_SECTORS );
+	GLASSERT( sector.x >= 0 && sector.y >= 0 && sector.x < NumSectors() && sector.y < NumSectors() );
 	return sector.y * NUM_SECTORS + sector.x;
 }
 
@@ -197,17 +197,17 @@ inline grinliz::Vector2F RandomInRect(const grinliz::Rectangle2I& r, grinliz::Ra
 
 inline grinliz::Vector2I RandomInOutland(grinliz::Random* random) 
 {
-	static const int OUTLAND = NUM_SECTORS / 4 + 1;
+	const int OUTLAND = NumSectors() / 4 + 1;
 
 
 	grinliz::Vector2I v = { 0, 0 };
 	for (int i = 0; i < 2; ++i) {
 		if (random->Bit())
-			v.X(i) = NUM_SECTORS - OUTLAND + random->Rand(OUTLAND);
+			v.X(i) = NumSectors() - OUTLAND + random->Rand(OUTLAND);
 		else
 			v.X(i) = random->Rand(OUTLAND);
 
-		GLASSERT(v.X(i) >= 0 && v.X(i) < NUM_SECTORS);
+		GLASSERT(v.X(i) >= 0 && v.X(i) < NumSectors());
 	}
 	return v;
 }
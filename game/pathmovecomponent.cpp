@@ -19,6 +19,8 @@
 #include "gamelimits.h"
 #include "gridmovecomponent.h"
 #include "lumoschitbag.h"
+#include "pathqueue.h"
+#include "flowfield.h"
 
 #include "../xegame/spatialcomponent.h"
 #include "../xegame/rendercomponent.h"
@@ -78,10 +80,27 @@ void PathMoveComponent::OnAdd( Chit* chit, bool init )
 
 void PathMoveComponent::OnRemove()
 {
+	CancelPath();
 	super::OnRemove();
 }
 
 
+void PathMoveComponent::Stop()
+{
+	CancelPath();
+	SetNoPath();
+}
+
+
+void PathMoveComponent::CancelPath()
+{
+	if (pathTicket && parentChit) {
+		Context()->worldMap->GetPathQueue()->Cancel(pathTicket);
+	}
+	pathTicket = 0;
+}
+
+
 
 void PathMoveComponent::OnChitMsg( Chit* chit, const ChitMsg& msg )
 {
@@ -146,7 +165,7 @@ bool PathMoveComponent::NeedComputeDest()
 	// - If there is a path, and this doesn't change it, do nothing.
 	// - If there is a path, and this only changes the end rotation, just do that.
 	// But if the force count is high, don't optimize. We may be stuck.
-	if ( !path.Empty() && !ForceCountHigh() ) {
+	if ( (!path.Empty() || pathTicket) && !ForceCountHigh() ) {
 		static const float EPS = 0.1f;
 		if ( dest.pos.Equal( queued.pos, EPS ) ) {
 			dest.heading = queued.heading;
@@ -195,8 +214,44 @@ void PathMoveComponent::ComputeDest()
 #endif
 	}
 
+	CancelPath();
+	if ( !pathDebugging && dest.sectorPort.IsValid() ) {
+		// Heading for a port, probably with the rest of a herd or
+		// an army. They all share the port's flow field.
+		SectorPort local = context->worldMap->NearestPort( dest.pos, 0 );
+		if ( local.IsValid() ) {
+			Rectangle2I portLoc = context->worldMap->GetSectorData( local.sector ).GetPortLoc( local.port );
+			float cost = 0;
+			if ( context->worldMap->GetFlowFields()->CalcPath( posVec, dest.pos, portLoc, &path, &cost )) {
+				PathReady( true );
+				return;
+			}
+		}
+	}
+	if ( !pathDebugging ) {
+		pathTicket = context->worldMap->GetPathQueue()->Submit( posVec, dest.pos );
+		return;
+	}
+	// Debugging is synchronous, so that the WorldMap draws the path.
 	float cost=0;
 	bool okay = context->worldMap->CalcPath( posVec, dest.pos, &path, &cost, pathDebugging ); 
+	PathReady( okay );
+}
+
+
+void PathMoveComponent::PollPath()
+{
+	float cost = 0;
+	int result = Context()->worldMap->GetPathQueue()->Result( pathTicket, &path, &cost );
+	if ( result != PathQueue::PENDING ) {
+		pathTicket = 0;
+		PathReady( result == PathQueue::SOLVED );
+	}
+}
+
+
+void PathMoveComponent::PathReady( bool okay )
+{
 	if ( !okay ) {
 		SetNoPath();
 		parentChit->SendMessage( ChitMsg( ChitMsg::PATHMOVE_DESTINATION_BLOCKED ), this ); 
@@ -415,6 +470,10 @@ void PathMoveComponent::AvoidOthers(U32 delta, grinliz::Vector2F* pos2, grinliz:
 
 int PathMoveComponent::DoTick( U32 delta )
 {
+	if (ChitBag::ParallelTicking()) {
+		Context()->chitBag->DeferTick(this, delta);
+		return VERY_LONG_TICK;
+	}
 	PROFILE_FUNC();
 	const ChitContext* context = Context();
 
@@ -423,6 +482,9 @@ int PathMoveComponent::DoTick( U32 delta )
 		path.Clear();
 		ComputeDest();			// ComputeDest can fail, send message, then cause re-queue
 	}
+	if ( pathTicket ) {
+		PollPath();
+	}
 
 	blockForceApplied = false;
 	avoidForceApplied = false;
@@ -488,7 +550,13 @@ int PathMoveComponent::DoTick( U32 delta )
 		}
 	}
 
-	AvoidOthers( delta, &pos2, &heading );
+	// Only worth it where someone can see it.
+	if (parentChit->LOD() == LOD_FULL) {
+		AvoidOthers( delta, &pos2, &heading );
+	}
+	else {
+		avoidForceApplied = false;
+	}
 	ApplyBlocks( &pos2, &this->blockForceApplied );
 
 	if ( portJump.IsValid() ) {
@@ -514,6 +582,9 @@ int PathMoveComponent::DoTick( U32 delta )
 		time = 0;
 	}
 
+	if ( pathTicket ) {
+		time = 0;
+	}
 	SetPosRot( pos2, heading );
 	return time;
 }
@@ -25,7 +25,8 @@
 class WorldMap;
 
 /*	Move along a path.
-	Future note: Pathing should be async and done by message passing.
+	The path is requested from the WorldMap's PathQueue, and
+	picked up on a later tick.
 */
 class PathMoveComponent : public GameMoveComponent
 {
@@ -34,7 +35,7 @@ private:
 public:
 
 	PathMoveComponent()
-		: GameMoveComponent(), pathPos( 0 ), pathDebugging( false ), forceCount( 0 )
+		: GameMoveComponent(), pathPos( 0 ), pathTicket( 0 ), pathDebugging( false ), forceCount( 0 )
 	{ 
 		queued.Clear();
 		dest.Clear();
@@ -52,6 +53,8 @@ public:
 	virtual void OnAdd( Chit* chit, bool init );
 	virtual void OnRemove();
 	virtual int DoTick( U32 delta );
+	// Moving and pathing are serial: the whole tick is deferred.
+	virtual bool ParallelTickSafe() const { return true; }
 	virtual void OnChitMsg( Chit* chit, const ChitMsg& msg );
 	virtual bool ShouldAvoid() const			{ return true; }
 
@@ -68,9 +71,9 @@ public:
 	}
 	const grinliz::Vector2F& DestPos() const { return dest.pos; }
 
-	void Stop()				{ SetNoPath(); }
+	void Stop();
 	void Clear()			{ Stop(); queued.Clear(); }
-	bool Stopped() const	{ return path.Empty() && queued.pos.IsZero(); }
+	bool Stopped() const	{ return path.Empty() && queued.pos.IsZero() && !pathTicket; }
 
 	void SetPathDebugging( bool d )	{ pathDebugging = d; }
 
@@ -93,12 +96,17 @@ private:
 	// Commit the 'queued' to the 'dest', if possible. 
 	void ComputeDest();
 	bool NeedComputeDest();
+	// Check on the path request.
+	void PollPath();
+	void PathReady( bool okay );
+	void CancelPath();
 	
 	void GetPosRot( grinliz::Vector2F* pos,		  grinliz::Vector2F* heading );
 	void SetPosRot( const grinliz::Vector2F& pos, const grinliz::Vector2F& heading );
 
 	void SetNoPath() {
 		pathPos = forceCount = 0;
+		pathTicket = 0;
 		path.Clear();
 		dest.Clear();
 	}
@@ -112,6 +120,7 @@ private:
 	void AvoidOthers( U32 delta, grinliz::Vector2F* pos2, grinliz::Vector2F* heading );
 
 	int pathPos;				// index of where we are on path
+	int pathTicket;				// PathQueue request, if waiting on one
 
 	struct Dest {
 		void Clear() { pos.Zero(); heading.Zero(); sectorPort.Zero(); }
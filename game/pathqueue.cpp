@@ -0,0 +1,349 @@
+#include "pathqueue.h"
+#include "worldmap.h"
+#include "lumosmath.h"
+
+#include "../grinliz/gljobsystem.h"
+#include "../Shiny/include/Shiny.h"
+
+#include <chrono>
+
+using namespace grinliz;
+
+PathQueue::PathQueue(WorldMap* map) : worldMap(map)
+{
+	budget = 2000;
+	idPool = 0;
+	frame = 0;
+	nSearches = 0;
+	nCoalesced = 0;
+	zoneGeneration = 0;
+	queueHead = 0;
+	zoneGraph.worldMap = map;
+	for (int i = 0; i < NUM_SOLVERS; ++i) {
+		solvers[i] = new micropather::MicroPather(&zoneGraph, 1000, 7, false);
+	}
+}
+
+
+PathQueue::~PathQueue()
+{
+	for (int i = queueHead; i < queue.Size(); ++i) {
+		delete queue[i];
+	}
+	DeleteAll(&done);
+	DeleteAll(&batch);
+	while (!searchPool.Empty()) {
+		delete searchPool.Pop();
+	}
+	for (int i = 0; i < NUM_SOLVERS; ++i) {
+		delete solvers[i];
+	}
+}
+
+
+void PathQueue::DeleteAll(CDynArray<Request*>* arr)
+{
+	while (!arr->Empty()) {
+		delete arr->Pop();
+	}
+}
+
+
+void PathQueue::RemoveDone(Request* r)
+{
+	int i = r->doneIndex;
+	GLASSERT(i >= 0 && done[i] == r);
+	done.SwapRemove(i);
+	if (i < done.Size()) {
+		done[i]->doneIndex = i;
+	}
+	r->doneIndex = -1;
+}
+
+
+int PathQueue::Submit(const Vector2F& start, const Vector2F& end)
+{
+	++idPool;
+	if (idPool <= 0) idPool = 1;
+
+	Request* r = new Request();
+	r->ticket = idPool;
+	r->status = PENDING;
+	r->frame = 0;
+	r->cost = 0;
+	r->start = start;
+	r->end = end;
+	r->search = -1;
+	r->doneIndex = -1;
+	queue.Push(r);
+	tickets.Add(r->ticket, r);
+	return r->ticket;
+}
+
+
+int PathQueue::Result(int ticket, CDynArray<Vector2F>* path, float* cost)
+{
+	Request* r = 0;
+	if (!tickets.Query(ticket, &r)) {
+		// Expired or cancelled.
+		return NO_PATH;
+	}
+	if (r->doneIndex < 0) {
+		return PENDING;
+	}
+	int status = r->status;
+	path->Clear();
+	for (int k = 0; k < r->path.Size(); ++k) {
+		path->Push(r->path[k]);
+	}
+	*cost = r->cost;
+	tickets.Remove(ticket);
+	RemoveDone(r);
+	delete r;
+	return status;
+}
+
+
+void PathQueue::Cancel(int ticket)
+{
+	Request* r = 0;
+	if (!tickets.Query(ticket, &r)) {
+		return;
+	}
+	tickets.Remove(ticket);
+	if (r->doneIndex >= 0) {
+		RemoveDone(r);
+		delete r;
+	}
+	else {
+		// Leave the slot, so the order is kept; SolveBatch() skips it.
+		r->status = NO_PATH;
+		r->ticket = 0;
+	}
+}
+
+
+void PathQueue::DoTick()
+{
+	PROFILE_FUNC();
+	++frame;
+
+	for (int i = 0; i < done.Size(); ++i) {
+		Request* r = done[i];
+		if (r->frame + EXPIRE_FRAMES < frame) {
+			tickets.Remove(r->ticket);
+			RemoveDone(r);
+			delete r;
+			--i;
+		}
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (queueHead < queue.Size()) {
+		SolveBatch();
+		if (budget) {
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if (std::chrono::duration_cast<std::chrono::microseconds>(now - start).count() >= budget) {
+				break;
+			}
+		}
+	}
+	if (queueHead == queue.Size()) {
+		queue.Clear();
+		queueHead = 0;
+	}
+}
+
+
+bool PathQueue::Prepare(Request* r)
+{
+	Vector2I starti = ToWorld2I(r->start);
+	Vector2I endi = ToWorld2I(r->end);
+
+	worldMap->CalcZone(starti.x, starti.y);
+	worldMap->CalcZone(endi.x, endi.y);
+
+	r->status = NO_PATH;
+	if (!worldMap->IsPassable(starti.x, starti.y) || !worldMap->IsPassable(endi.x, endi.y)) {
+		return true;
+	}
+	// Same zone, or a straight line: same as WorldMap::CalcPath()
+	if (   worldMap->ZoneOrigin(starti.x, starti.y) == worldMap->ZoneOrigin(endi.x, endi.y)
+		|| worldMap->GridPath(r->start, r->end, false))
+	{
+		r->path.Push(r->start);
+		r->path.Push(r->end);
+		r->cost = (r->end - r->start).Length();
+		r->status = SOLVED;
+		return true;
+	}
+
+	void* startState = worldMap->ToState(starti.x, starti.y);
+	void* endState = worldMap->ToState(endi.x, endi.y);
+	StatePair key = { startState, endState };
+	if (searchIndex.Query(key, &r->search)) {
+		++nCoalesced;
+		return false;
+	}
+	Search* search = searchPool.Empty() ? new Search() : searchPool.Pop();
+	search->startState = startState;
+	search->endState = endState;
+	search->result = micropather::MicroPather::NO_SOLUTION;
+	search->cached = false;
+	search->cost = 0;
+	if (worldMap->FindRegionPath(startState, endState, &search->regions, &search->cost)) {
+		search->result = micropather::MicroPather::SOLVED;
+		search->cached = true;
+	}
+	r->search = searches.Size();
+	searchIndex.Add(key, r->search);
+	searches.Push(search);
+	return false;
+}
+
+
+void PathQueue::SearchJob(void* data, int start, int end)
+{
+	PathQueue* pq = (PathQueue*)data;
+	for (int s = start; s < end; ++s) {
+		micropather::MicroPather* pather = pq->solvers[s];
+		for (int i = s; i < pq->searches.Size(); i += NUM_SOLVERS) {
+			Search* search = pq->searches[i];
+			if (search->result != micropather::MicroPather::SOLVED) {
+				search->result = pather->Solve(search->startState, search->endState, &search->regions, &search->cost);
+			}
+		}
+	}
+}
+
+
+void PathQueue::SolveBatch()
+{
+	int n = Min(queue.Size() - queueHead, (int)BATCH_SIZE);
+	for (int i = 0; i < n; ++i) {
+		Request* r = queue[queueHead + i];
+		if (r->ticket == 0) {
+			delete r;	// cancelled
+		}
+		else {
+			batch.Push(r);
+		}
+	}
+	queueHead += n;
+
+	for (int i = 0; i < batch.Size(); ++i) {
+		Prepare(batch[i]);
+	}
+
+	if (!searches.Empty()) {
+		int nCached = 0;
+		for (int i = 0; i < searches.Size(); ++i) {
+			if (searches[i]->result == micropather::MicroPather::SOLVED)
+				++nCached;
+		}
+		if (nCached < searches.Size()) {
+			// The workers can't compute zones, so compute them now,
+			// but only around the searches. Only the blocks that
+			// changed cost anything.
+			zoneGraph.sectors.ClearAll();
+			for (int i = 0; i < searches.Size(); ++i) {
+				const Search* search = searches[i];
+				if (search->result == micropather::MicroPather::SOLVED)
+					continue;
+
+				Vector2I start, end;
+				worldMap->ToGrid(search->startState, &start);
+				worldMap->ToGrid(search->endState, &end);
+				Rectangle2I bounds;
+				bounds.FromPair(ToSector(start), ToSector(end));
+				bounds.Outset(1);
+				Rectangle2I map;
+				map.Set(0, 0, NumSectors() - 1, NumSectors() - 1);
+				bounds.DoIntersection(map);
+
+				for (int y = bounds.min.y; y <= bounds.max.y; ++y) {
+					for (int x = bounds.min.x; x <= bounds.max.x; ++x) {
+						if (!zoneGraph.sectors.IsSet(x, y)) {
+							zoneGraph.sectors.Set(x, y);
+							Vector2I sector = { x, y };
+							worldMap->CalcSectorZones(sector);
+						}
+					}
+				}
+			}
+			if (zoneGeneration != worldMap->zoneGeneration) {
+				zoneGeneration = worldMap->zoneGeneration;
+				for (int i = 0; i < NUM_SOLVERS; ++i) {
+					solvers[i]->Reset();
+				}
+			}
+			nSearches += searches.Size() - nCached;
+			JobSystem::Instance()->ParallelFor(Min(searches.Size(), (int)NUM_SOLVERS), 1, SearchJob, this);
+
+			// Only the new solves go back in the region cache.
+			for (int i = 0; i < searches.Size(); ++i) {
+				Search* search = searches[i];
+				if (!search->cached && search->result == micropather::MicroPather::SOLVED) {
+					worldMap->AddRegionPath(search->startState, search->endState, search->regions, search->cost);
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < batch.Size(); ++i) {
+		Request* r = batch[i];
+		if (r->search >= 0) {
+			const Search* search = searches[r->search];
+			if (   search->result == micropather::MicroPather::SOLVED
+				&& worldMap->RegionsToPath(search->regions, r->start, r->end, &r->path))
+			{
+				r->cost = search->cost;
+				r->status = SOLVED;
+			}
+			else {
+				r->path.Clear();
+				r->status = NO_PATH;
+			}
+		}
+		r->frame = frame;
+		r->doneIndex = done.Size();
+		done.Push(r);
+	}
+	batch.Clear();
+	searchIndex.Clear();
+	while (!searches.Empty()) {
+		searchPool.Push(searches.Pop());
+	}
+}
+
+
+float PathQueue::ZoneGraph::LeastCostEstimate(void* stateStart, void* stateEnd)
+{
+	return worldMap->ZoneDistance(stateStart, stateEnd);
+}
+
+
+void PathQueue::ZoneGraph::AdjacentCost(void* state, MP_VECTOR< micropather::StateCost > *adjacent)
+{
+	worldMap->AdjacentZones(state, adjacent);
+
+	// Zones outside the computed sectors may be stale.
+	unsigned n = 0;
+	for (unsigned i = 0; i < adjacent->size(); ++i) {
+		Vector2I v;
+		worldMap->ToGrid((*adjacent)[i].state, &v);
+		Vector2I sector = ToSector(v);
+		if (sectors.IsSet(sector.x, sector.y)) {
+			(*adjacent)[n++] = (*adjacent)[i];
+		}
+	}
+	adjacent->resize(n);
+}
+
+
+void PathQueue::ZoneGraph::PrintStateInfo(void* state)
+{
+	Vector2I vec;
+	worldMap->ToGrid(state, &vec);
+	GLOUTPUT(("(%d,%d) ", vec.x, vec.y));
+}
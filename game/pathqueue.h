@@ -0,0 +1,135 @@
+#ifndef PATH_QUEUE_INCLUDED
+#define PATH_QUEUE_INCLUDED
+
+#include "../grinliz/gldebug.h"
+#include "../grinliz/glvector.h"
+#include "../grinliz/glcontainer.h"
+#include "../grinliz/glbitarray.h"
+#include "../micropather/micropather.h"
+#include "gamelimits.h"
+
+class WorldMap;
+
+/*	Asynchronous WorldMap::CalcPath(). Submit() a start and end and get
+	a ticket back. The queue is solved in batches when the WorldMap ticks,
+	the region searches in parallel on the JobSystem, and the result is
+	picked up with Result() on a later tick.
+
+	Requests from the same zone to the same zone (a herd moving to one
+	place) share a single region search.
+
+	The workers don't change the map: before the search starts, the
+	zones are computed for the sectors around each search's start and
+	end (the box between them, and one sector more), and each worker
+	has its own MicroPather over a read only view of the zone graph,
+	limited to those sectors. A path that has to leave them isn't
+	found by the queue.
+*/
+class PathQueue
+{
+public:
+	PathQueue(WorldMap* worldMap);
+	~PathQueue();
+
+	enum {
+		PENDING,
+		SOLVED,
+		NO_PATH,
+	};
+
+	// Returns the ticket, never 0.
+	int Submit(const grinliz::Vector2F& start, const grinliz::Vector2F& end);
+	// PENDING, or the result. Once the result is returned,
+	// the ticket is no longer valid.
+	int Result(int ticket, grinliz::CDynArray<grinliz::Vector2F>* path, float* cost);
+	void Cancel(int ticket);
+
+	// Solves requests until the queue is empty or the time
+	// budget (in microseconds) runs out. 0 is no limit.
+	void DoTick();
+	void SetBudget(int usec)	{ budget = usec; }
+
+	int NumQueued() const		{ return queue.Size() - queueHead; }
+	int NumSearches() const		{ return nSearches; }
+	int NumCoalesced() const	{ return nCoalesced; }
+
+private:
+	enum {
+		NUM_SOLVERS = 8,		// fixed, so the results don't depend on the thread count
+		BATCH_SIZE = 64,
+		EXPIRE_FRAMES = 60		// unclaimed results are thrown away
+	};
+
+	struct Request {
+		int ticket;
+		int status;
+		int frame;				// frame solved
+		float cost;
+		grinliz::Vector2F start;
+		grinliz::Vector2F end;
+		int search;				// index into 'searches', or -1
+		int doneIndex;			// index into 'done', or -1 if not solved yet
+		grinliz::CDynArray<grinliz::Vector2F> path;
+	};
+
+	struct Search {
+		void* startState;
+		void* endState;
+		int result;
+		bool cached;			// came from the WorldMap region cache
+		float cost;
+		MP_VECTOR<void*> regions;
+	};
+
+	// Key for coalescing the searches in a batch.
+	struct StatePair {
+		void* start;
+		void* end;
+	};
+	class CompStatePair {
+	public:
+		static U32 Hash(const StatePair& p)	{ return U32(intptr_t(p.start)) * 37 + U32(intptr_t(p.end)); }
+		static bool Equal(const StatePair& a, const StatePair& b) { return a.start == b.start && a.end == b.end; }
+	};
+
+	// The micropather::Graph over the zones, without
+	// the side effects of WorldMap's own.
+	class ZoneGraph : public micropather::Graph {
+	public:
+		const WorldMap* worldMap;
+		// The sectors with current zones, that the searches can use.
+		grinliz::BitArray< NUM_SECTORS, NUM_SECTORS, 1 > sectors;
+		virtual float LeastCostEstimate(void* stateStart, void* stateEnd);
+		virtual void  AdjacentCost(void* state, MP_VECTOR< micropather::StateCost > *adjacent);
+		virtual void  PrintStateInfo(void* state);
+	};
+
+	void SolveBatch();
+	// Everything that doesn't need a search. Returns true if done.
+	bool Prepare(Request* r);
+	void DeleteAll(grinliz::CDynArray<Request*>* arr);
+	void RemoveDone(Request* r);
+	static void SearchJob(void* data, int start, int end);
+
+	WorldMap* worldMap;
+	int budget;
+	int idPool;
+	int frame;
+	int nSearches;
+	int nCoalesced;
+	U32 zoneGeneration;
+
+	ZoneGraph zoneGraph;
+	micropather::MicroPather* solvers[NUM_SOLVERS];
+
+	int queueHead;
+	grinliz::CDynArray<Request*> queue;
+	grinliz::CDynArray<Request*> batch;
+	grinliz::CDynArray<Request*> done;
+	grinliz::CDynArray<Search*>  searches;		// in use this batch
+	grinliz::HashTable<int, Request*> tickets;	// every live request, queued or done
+	grinliz::HashTable<StatePair, int, CompStatePair> searchIndex;	// (start, end) -> 'searches'
+	grinliz::CDynArray<Search*>  searchPool;
+};
+
+#endif // PATH_QUEUE_INCLUDED
@@ -5,7 +5,10 @@
 #include "fluidsim.h"
 #include "lumosmath.h"
 #include "worldgrid.h"
+#include "worldmap.h"
 #include "../xarchive/glstreamer.h"
+#include "../grinliz/gljobsystem.h"
+#include "../version.h"
 
 using namespace grinliz;
 
@@ -14,6 +17,7 @@ PhysicsSims::PhysicsSims(const ChitContext* _context) : context(_context)
 	for (int i = 0; i < NUM_SECTORS*NUM_SECTORS; ++i) {
 		circuitSim[i] = 0;
 		fluidSim[i] = 0;
+		pagedCircuit[i] = 0;
 	}
 	GLASSERT(context->worldMap);
 	{
@@ -24,12 +28,12 @@ PhysicsSims::PhysicsSims(const ChitContext* _context) : context(_context)
 	}
 
 	Rectangle2I outer;
-	outer.Set(0, 0, NUM_SECTORS - 1, NUM_SECTORS - 1);
+	outer.Set(0, 0, NumSectors() - 1, NumSectors() - 1);
 	Rectangle2I inner = outer;
 	inner.Outset(-2);
 
-	for (int j = 1; j < NUM_SECTORS - 1; ++j) {
-		for (int i = 1; i < NUM_SECTORS - 1; ++i) {
+	for (int j = 1; j < NumSectors() - 1; ++j) {
+		for (int i = 1; i < NumSectors() - 1; ++i) {
 			Vector2I sector = { i, j };
 			circuitSim[j*NUM_SECTORS + i] = new CircuitSim(context, sector);
 			fluidSim[j*NUM_SECTORS + i] = new FluidSim(context->worldMap, sector);
@@ -45,10 +49,11 @@ PhysicsSims::PhysicsSims(const ChitContext* _context) : context(_context)
 
 PhysicsSims::~PhysicsSims()
 {
-	for (int j = 0; j < NUM_SECTORS; ++j) {
-		for (int i = 0; i < NUM_SECTORS; ++i) {
+	for (int j = 0; j < NumSectors(); ++j) {
+		for (int i = 0; i < NumSectors(); ++i) {
 			delete circuitSim[j*NUM_SECTORS + i];
 			delete fluidSim[j*NUM_SECTORS + i];
+			delete pagedCircuit[j*NUM_SECTORS + i];
 		}
 	}
 }
@@ -57,13 +62,16 @@ PhysicsSims::~PhysicsSims()
 void PhysicsSims::Serialize(XStream* xs)
 {
 	XarcOpen(xs, "PhysicsSim");
-	for (int j = 0; j < NUM_SECTORS; ++j) {
-		for (int i = 0; i < NUM_SECTORS; ++i) {
+	for (int j = 0; j < NumSectors(); ++j) {
+		for (int i = 0; i < NumSectors(); ++i) {
 			XarcOpen(xs, "Sector");
 			XARC_SER_KEY(xs, "x", i);
 			XARC_SER_KEY(xs, "y", j);
-			if (circuitSim[j*NUM_SECTORS + i]) {
-				circuitSim[j*NUM_SECTORS + i]->Serialize(xs);
+			// Paged sims are brought back in; the sector pager
+			// will page them out again if they stay dormant.
+			CircuitSim* cs = CircuitSimAt(j*NUM_SECTORS + i);
+			if (cs) {
+				cs->Serialize(xs);
 			}
 			if (fluidSim[j*NUM_SECTORS + i]) {
 				fluidSim[j*NUM_SECTORS + i]->Unsettle();		// doesn't have to keep state around.
@@ -74,20 +82,74 @@ void PhysicsSims::Serialize(XStream* xs)
 	XarcClose(xs);
 }
 
+bool PhysicsSims::PageOut(const Vector2I& sector)
+{
+	int i = sector.y*NUM_SECTORS + sector.x;
+	if (!circuitSim[i] || !circuitSim[i]->Idle()) {
+		return false;
+	}
+	StreamWriter writer(0, CURRENT_FILE_VERSION);
+	circuitSim[i]->Serialize(&writer);
+
+	pagedCircuit[i] = new CDynArray<U8>();
+	U8* p = pagedCircuit[i]->PushArr(writer.Data().Size());
+	memcpy(p, writer.Data().Mem(), writer.Data().Size());
+
+	delete circuitSim[i];
+	circuitSim[i] = 0;
+	return true;
+}
+
+
+void PhysicsSims::PageIn(int i)
+{
+	GLASSERT(pagedCircuit[i] && !circuitSim[i]);
+	Vector2I sector = { i % NUM_SECTORS, i / NUM_SECTORS };
+	circuitSim[i] = new CircuitSim(context, sector);
+
+	StreamReader reader(pagedCircuit[i]->Mem(), pagedCircuit[i]->Size());
+	circuitSim[i]->Serialize(&reader);
+
+	delete pagedCircuit[i];
+	pagedCircuit[i] = 0;
+}
+
+
+void PhysicsSims::FluidStepJob(void* data, int start, int end)
+{
+	FluidSim** sims = (FluidSim**)data;
+	for (int i = start; i < end; ++i) {
+		sims[i]->DoStep();
+	}
+}
+
+
 void PhysicsSims::DoTick(int delta)
 {
 	{
 		PROFILE_BLOCK(FluidSim);
-		int n = fluidTicker.Delta(delta);
+		// A test map can be smaller than a sector. Sectors that
+		// aren't fully on the map are skipped, so they don't
+		// touch (and allocate) grid that isn't there.
+		const int nx = context->worldMap->Width() / SECTOR_SIZE;
+		const int ny = context->worldMap->Height() / SECTOR_SIZE;
+		int n = Min(fluidTicker.Delta(delta), Square(NUM_SECTORS));
+		stepping.Clear();
 		while (n--) {
-			if (fluidSim[fluidSector]) {
-				fluidSim[fluidSector]->DoStep();
+			FluidSim* sim = fluidSim[fluidSector];
+			if (sim && !sim->Settled() && (fluidSector % NUM_SECTORS) < nx && (fluidSector / NUM_SECTORS) < ny) {
+				stepping.Push(sim);
 			}
 			fluidSector++;
 			if (fluidSector >= Square(NUM_SECTORS)) {
 				fluidSector = 0;
 			}
 		}
+		// The sectors are disjoint, so the sims step in parallel.
+		JobSystem::Instance()->ParallelFor(stepping.Size(), 1, FluidStepJob, stepping.Mem());
+		for (int i = 0; i < stepping.Size(); ++i) {
+			stepping[i]->CommitChanges();
+		}
 	}
 
 	for (int i = 0; i < NUM_SECTORS*NUM_SECTORS; ++i) {
@@ -4,6 +4,7 @@
 #include "../grinliz/gldebug.h"
 #include "../grinliz/glvector.h"
 #include "../xegame/cticker.h"
+#include "../grinliz/glcontainer.h"
 #include "gamelimits.h"
 
 class ChitContext;
@@ -21,22 +22,42 @@ public:
 	void Serialize( XStream* xs );
 
 	FluidSim* GetFluidSim(const grinliz::Vector2I& sector) const {
-		GLASSERT(sector.x >= 0 && sector.x < NUM_SECTORS);
-		GLASSERT(sector.y >= 0 && sector.y < NUM_SECTORS);
+		GLASSERT(sector.x >= 0 && sector.x < NumSectors());
+		GLASSERT(sector.y >= 0 && sector.y < NumSectors());
 		return fluidSim[sector.y*NUM_SECTORS + sector.x];
 	}
 
-	CircuitSim* GetCircuitSim(const grinliz::Vector2I& sector) const {
-		GLASSERT(sector.x >= 0 && sector.x < NUM_SECTORS);
-		GLASSERT(sector.y >= 0 && sector.y < NUM_SECTORS);
-		return circuitSim[sector.y*NUM_SECTORS + sector.x];
+	// Pages the sim back in if it was paged out.
+	CircuitSim* GetCircuitSim(const grinliz::Vector2I& sector) {
+		GLASSERT(sector.x >= 0 && sector.x < NumSectors());
+		GLASSERT(sector.y >= 0 && sector.y < NumSectors());
+		return CircuitSimAt(sector.y*NUM_SECTORS + sector.x);
 	}
+
+	// Sector paging: an idle CircuitSim is serialized to a blob
+	// and deleted. Returns false if it isn't idle.
+	bool PageOut(const grinliz::Vector2I& sector);
+	bool PagedOut(const grinliz::Vector2I& sector) const {
+		return pagedCircuit[sector.y*NUM_SECTORS + sector.x] != 0;
+	}
+
 private:
+	CircuitSim* CircuitSimAt(int i) {
+		if (pagedCircuit[i]) PageIn(i);
+		return circuitSim[i];
+	}
+	void PageIn(int i);
+
+	// JobSystem entry: steps sims[start, end)
+	static void FluidStepJob(void* data, int start, int end);
+
 	const ChitContext* context;
 	CTicker		fluidTicker;
 	int			fluidSector;
 	CircuitSim*	circuitSim[NUM_SECTORS*NUM_SECTORS];
 	FluidSim*	fluidSim[NUM_SECTORS*NUM_SECTORS];
+	grinliz::CDynArray<U8>* pagedCircuit[NUM_SECTORS*NUM_SECTORS];
+	grinliz::CDynArray<FluidSim*> stepping;		// the unsettled sims this tick
 };
 
 
@@ -40,14 +40,19 @@ ReserveBank::ReserveBank()
 		crystalValue[i] = 0;
 	}
 	wallet.SetCanBeUnderwater(true);
+	Fill();
+}
+
 
+void ReserveBank::Fill()
+{
 	// All the gold in the world.
-	const int gold = ALL_GOLD;
+	const int gold = AllGold();
 	const int crystal[NUM_CRYSTAL_TYPES] = {
-		ALL_CRYSTAL_GREEN,
-		ALL_CRYSTAL_RED,
-		ALL_CRYSTAL_BLUE,
-		ALL_CRYSTAL_VIOLET
+		AllCrystalGreen(),
+		AllCrystalRed(),
+		AllCrystalBlue(),
+		AllCrystalViolet()
 	};
 	wallet.Set(gold, crystal);
 }
@@ -122,9 +127,9 @@ const int* ReserveBank::CrystalValue()
 		crystalValue[0] = int(item->GetValue() + 1.0f);
 		delete item; item = 0;
 
-		crystalValue[CRYSTAL_RED] = crystalValue[0] * ALL_CRYSTAL_GREEN / ALL_CRYSTAL_RED;
-		crystalValue[CRYSTAL_BLUE] = crystalValue[0] * ALL_CRYSTAL_GREEN / ALL_CRYSTAL_BLUE;
-		crystalValue[CRYSTAL_VIOLET] = crystalValue[0] * ALL_CRYSTAL_GREEN / ALL_CRYSTAL_VIOLET;
+		crystalValue[CRYSTAL_RED] = crystalValue[0] * AllCrystalGreen() / AllCrystalRed();
+		crystalValue[CRYSTAL_BLUE] = crystalValue[0] * AllCrystalGreen() / AllCrystalBlue();
+		crystalValue[CRYSTAL_VIOLET] = crystalValue[0] * AllCrystalGreen() / AllCrystalViolet();
 	}
 	return crystalValue;
 }
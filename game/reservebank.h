@@ -33,6 +33,9 @@ public:
 	Wallet wallet;
 
 	void Serialize( XStream* xs );
+	// Puts all the gold and crystal for the current MapSize()
+	// in the bank. Called for a new world.
+	void Fill();
 
 	void WithdrawDenizen(Wallet* dst);
 	void WithdrawMonster(Wallet* dst, bool greater);
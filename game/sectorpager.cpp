@@ -0,0 +1,401 @@
+#include "sectorpager.h"
+
+#include "../version.h"
+#include "../xarchive/glstreamer.h"
+
+#include "../xegame/chit.h"
+#include "../xegame/chitcontext.h"
+#include "../xegame/itemcomponent.h"
+#include "../xegame/spatialcomponent.h"
+#include "../xegame/istringconst.h"
+
+#include "../engine/engine.h"
+
+#include "../script/corescript.h"
+#include "../script/countdownscript.h"
+#include "../ai/director.h"
+
+#include "lumoschitbag.h"
+#include "worldmap.h"
+#include "physicssims.h"
+#include "aicomponent.h"
+#include "gameitem.h"
+#include "lumosmath.h"
+#include "team.h"
+
+using namespace grinliz;
+
+SectorPager::SectorPager(const ChitContext* c) : context(c), enabled(false), nPaged(0), nPagedChits(0), scanSector(0), nFocus(0)
+{
+	for (int i = 0; i < NUM_SECTORS_2; ++i) {
+		pages[i] = 0;
+		quiet[i] = 0;
+	}
+	scanTicker.SetPeriod(Max(1, int(SCAN_TIME) / NUM_SECTORS_2));
+}
+
+
+SectorPager::~SectorPager()
+{
+	// The chit bag may already be gone; don't touch the census.
+	for (int i = 0; i < NUM_SECTORS_2; ++i) {
+		delete pages[i];
+	}
+}
+
+
+void SectorPager::SetEnabled(bool enable)
+{
+	enabled = enable;
+	if (!enabled) {
+		PageInAll();
+	}
+}
+
+
+void SectorPager::Clear()
+{
+	for (int i = 0; i < NUM_SECTORS_2; ++i) {
+		if (pages[i]) {
+			InformCensus(*pages[i], false);
+			delete pages[i];
+			pages[i] = 0;
+		}
+		quiet[i] = 0;
+	}
+	nPaged = 0;
+	nPagedChits = 0;
+}
+
+
+void SectorPager::InformCensus(const Page& page, bool add)
+{
+	Census& census = context->chitBag->census;
+	for (int i = 0; i < page.mobs.Size(); ++i) {
+		if (add)
+			census.AddMOB(page.mobs[i]);
+		else
+			census.RemoveMOB(page.mobs[i]);
+	}
+	census.wildFruit += add ? page.wildFruit : -page.wildFruit;
+	GLASSERT(census.wildFruit >= 0);
+}
+
+
+bool SectorPager::Active(const Vector2I& sector)
+{
+	for (int i = 0; i < nFocus; ++i) {
+		if (abs(sector.x - focus[i].x) <= ACTIVE_RADIUS && abs(sector.y - focus[i].y) <= ACTIVE_RADIUS) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+bool SectorPager::Pageable(Chit* chit)
+{
+	GameItem* item = chit->GetItem();
+	if (!item || item->hp <= 0) return false;
+	// Buildings block the map, and are tracked by the building hash.
+	if (chit->GetSpatialComponent() && chit->GetSpatialComponent()->ToMapSpatialComponent()) return false;
+	if (chit->PlayerControlled()) return false;
+	// Only the wild things: denizens, visitors, and deities have
+	// homes, squads, and plans that reference them.
+	if (Team::Group(chit->Team()) >= TEAM_HOUSE) return false;
+	if (context->chitBag->IsQueuedForDelete(chit)) return false;
+	// Travelling between sectors.
+	if (chit->GetComponent("GridMoveComponent")) return false;
+
+	AIComponent* ai = chit->GetAIComponent();
+	if (ai && ai->AwareOfEnemy()) return false;
+
+	Chit* directorChit = context->chitBag->GetNamedChit(ISC::Director);
+	if (directorChit) {
+		Director* director = (Director*)directorChit->GetComponent("Director");
+		if (director && director->ChitInPlay(chit)) return false;
+	}
+	return true;
+}
+
+
+bool SectorPager::Dormant(const Vector2I& sector, CDynArray<Chit*>* chits)
+{
+	chits->Clear();
+	if (Active(sector)) return false;
+
+	CoreScript* cs = CoreScript::GetCore(sector);
+	if (cs && cs->InUse()) return false;
+
+	Chit* directorChit = context->chitBag->GetNamedChit(ISC::Director);
+	if (directorChit) {
+		Director* director = (Director*)directorChit->GetComponent("Director");
+		if (director && director->SectorInPlay(sector)) return false;
+	}
+
+	context->chitBag->QuerySpatialHash(&queryArr, SectorBounds(sector), 0, 0);
+	for (int i = 0; i < queryArr.Size(); ++i) {
+		Chit* chit = queryArr[i];
+		if (Pageable(chit)) {
+			chits->Push(chit);
+		}
+		else if (chit->GetMoveComponent()) {
+			// Something that can't be paged is moving around.
+			chits->Clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+
+bool SectorPager::Intruder(const Vector2I& sector)
+{
+	// Only the buildings stay behind in a paged sector. 
+	// Anything that moves walked in.
+	context->chitBag->QuerySpatialHash(&queryArr, SectorBounds(sector), 0, 0);
+	for (int i = 0; i < queryArr.Size(); ++i) {
+		if (queryArr[i]->GetMoveComponent()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void SectorPager::DoTick(U32 delta)
+{
+	if (!enabled) return;
+
+	LumosChitBag* chitBag = context->chitBag;
+	nFocus = 0;
+	Vector3F at = V3F_ZERO;
+	context->engine->CameraLookingAt(&at);
+	focus[nFocus++] = ToSector(at);
+	Chit* avatar = chitBag->GetAvatar();
+	if (avatar) {
+		focus[nFocus++] = ToSector(avatar->Position());
+	}
+	Vector2I home = chitBag->GetHomeSector();
+	if (!home.IsZero()) {
+		focus[nFocus++] = home;
+	}
+
+	// Coming into view is checked every tick; it's just the sectors
+	// around the focus points.
+	for (int k = 0; k < nFocus; ++k) {
+		for (int j = focus[k].y - ACTIVE_RADIUS; j <= focus[k].y + ACTIVE_RADIUS; ++j) {
+			for (int i = focus[k].x - ACTIVE_RADIUS; i <= focus[k].x + ACTIVE_RADIUS; ++i) {
+				if (i >= 0 && i < NumSectors() && j >= 0 && j < NumSectors()) {
+					Vector2I sector = { i, j };
+					PageIn(sector);
+				}
+			}
+		}
+	}
+
+	// Everything else is scanned round robin, a few sectors a tick.
+	const int nx = context->worldMap->Width() / SECTOR_SIZE;
+	const int ny = context->worldMap->Height() / SECTOR_SIZE;
+	int n = Min(scanTicker.Delta(delta), NUM_SECTORS_2);
+	while (n--) {
+		int index = scanSector;
+		scanSector = (scanSector + 1) % NUM_SECTORS_2;
+
+		Vector2I sector = { index % NUM_SECTORS, index / NUM_SECTORS };
+		if (sector.x >= nx || sector.y >= ny) continue;
+
+		if (pages[index]) {
+			if (Intruder(sector)) {
+				PageIn(sector);
+			}
+			else {
+				// A path through the sector may have re-created it.
+				context->worldMap->ReleasePather(sector);
+			}
+		}
+		else if (Dormant(sector, &pageArr)) {
+			if (++quiet[index] >= QUIET_VISITS) {
+				PageOut(sector, pageArr);
+			}
+		}
+		else {
+			quiet[index] = 0;
+		}
+	}
+}
+
+
+void SectorPager::PageOut(const Vector2I& sector, const CDynArray<Chit*>& chits)
+{
+	int index = sector.y * NUM_SECTORS + sector.x;
+	GLASSERT(!pages[index]);
+	LumosChitBag* chitBag = context->chitBag;
+
+	Page* page = new Page();
+	page->time = chitBag->AbsTime();
+	page->nChits = chits.Size();
+	page->wildFruit = 0;
+
+	if (chits.Size()) {
+		StreamWriter writer(0, CURRENT_FILE_VERSION);
+		XarcOpen(&writer, "Sector");
+		for (int i = 0; i < chits.Size(); ++i) {
+			Chit* chit = chits[i];
+			XarcOpen(&writer, "id");
+			writer.Set("id", chit->ID());
+			XarcClose(&writer);
+			chit->Serialize(&writer);
+
+			// Same rules as ItemComponent::InformCensus()
+			const GameItem* item = chit->GetItem();
+			if (item->IName() == ISC::fruit && item->IProperName() == ISC::wildFruit) {
+				page->wildFruit += 1;
+			}
+			else if (!item->keyValues.GetIString(ISC::mob).empty()) {
+				page->mobs.Push(item->IName());
+			}
+		}
+		XarcClose(&writer);
+
+		U8* p = page->data.PushArr(writer.Data().Size());
+		memcpy(p, writer.Data().Mem(), writer.Data().Size());
+
+		// The wallets aren't lost: they are in the page.
+		GameItem::trackWallet = false;
+		for (int i = 0; i < chits.Size(); ++i) {
+			chitBag->DeleteChit(chits[i]);
+		}
+		GameItem::trackWallet = true;
+		InformCensus(*page, true);
+	}
+
+	context->worldMap->ReleasePather(sector);
+	context->physicsSims->PageOut(sector);
+
+	pages[index] = page;
+	quiet[index] = 0;
+	nPaged++;
+	nPagedChits += page->nChits;
+}
+
+
+void SectorPager::PageIn(const Vector2I& sector)
+{
+	int index = sector.y * NUM_SECTORS + sector.x;
+	Page* page = pages[index];
+	if (!page) return;
+
+	pages[index] = 0;
+	nPaged--;
+	nPagedChits -= page->nChits;
+
+	// Loading the chits adds them back.
+	InformCensus(*page, false);
+
+	if (page->data.Size()) {
+		LumosChitBag* chitBag = context->chitBag;
+		U32 elapsed = chitBag->AbsTime() - page->time;
+
+		StreamReader reader(page->data.Mem(), page->data.Size());
+		XarcOpen(&reader, "Sector");
+		while (reader.HasChild()) {
+			int id = 0;
+			XarcOpen(&reader, "id");
+			XARC_SER_KEY(&reader, "id", id);
+			XarcClose(&reader);
+
+			Chit* chit = chitBag->NewChit(id);
+			chit->Serialize(&reader);
+			CatchUp(chit, elapsed);
+		}
+		XarcClose(&reader);
+	}
+	delete page;
+}
+
+
+void SectorPager::PageInAll()
+{
+	for (int j = 0; j < NumSectors(); ++j) {
+		for (int i = 0; i < NumSectors(); ++i) {
+			Vector2I sector = { i, j };
+			PageIn(sector);
+		}
+	}
+	GLASSERT(nPaged == 0 && nPagedChits == 0);
+}
+
+
+void SectorPager::CatchUp(Chit* chit, U32 elapsed)
+{
+	// The coarse version of what the ticks would have done.
+	GameItem* item = chit->GetItem();
+	if (item && item->hp > 0) {
+		item->fireTime = 0;
+		item->shockTime = 0;
+		item->hp = Clamp(item->hp + double(Travel(item->hpRegen, elapsed)), 0.0, double(item->TotalHP()));
+	}
+	CountDownScript* countDown = GET_GENERAL_COMPONENT(chit, CountDownScript);
+	if (countDown) {
+		countDown->DoTick(elapsed);
+	}
+	chit->SetTickNeeded();
+}
+
+
+void SectorPager::Serialize(XStream* xs)
+{
+	XarcOpen(xs, "SectorPager");
+	XARC_SER(xs, enabled);
+
+	if (xs->Saving()) {
+		for (int index = 0; index < NUM_SECTORS_2; ++index) {
+			Page* page = pages[index];
+			if (!page) continue;
+
+			XarcOpen(xs, "Page");
+			Vector2I sector = { index % NUM_SECTORS, index / NUM_SECTORS };
+			XARC_SER(xs, sector);
+			XARC_SER_KEY(xs, "time", page->time);
+			XARC_SER_KEY(xs, "nChits", page->nChits);
+			XARC_SER_KEY(xs, "wildFruit", page->wildFruit);
+			CDynArray<IString>& mobs = page->mobs;
+			XARC_SER_VAL_CARRAY(xs, mobs);
+			XarcSet(xs, "data.size", page->data.Size());
+			XarcSetBulk(xs, "data", page->data.Mem(), page->data.Size());
+			XarcClose(xs);
+		}
+	}
+	else {
+		Clear();
+		while (xs->Loading()->HasChild()) {
+			Page* page = new Page();
+			Vector2I sector = { 0, 0 };
+			int size = 0;
+
+			XarcOpen(xs, "Page");
+			XARC_SER(xs, sector);
+			XARC_SER_KEY(xs, "time", page->time);
+			XARC_SER_KEY(xs, "nChits", page->nChits);
+			XARC_SER_KEY(xs, "wildFruit", page->wildFruit);
+			CDynArray<IString>& mobs = page->mobs;
+			XARC_SER_VAL_CARRAY(xs, mobs);
+			XarcGet(xs, "data.size", size);
+			if (size) {
+				XarcGetBulk(xs, "data", page->data.PushArr(size), size);
+			}
+			XarcClose(xs);
+
+			int index = sector.y * NUM_SECTORS + sector.x;
+			GLASSERT(!pages[index]);
+			delete pages[index];
+			pages[index] = page;
+			nPaged++;
+			nPagedChits += page->nChits;
+			// The paged chits still count.
+			InformCensus(*page, true);
+		}
+	}
+	XarcClose(xs);
+}
@@ -0,0 +1,110 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LUMOS_SECTOR_PAGER_INCLUDED
+#define LUMOS_SECTOR_PAGER_INCLUDED
+
+#include "../grinliz/gltypes.h"
+#include "../grinliz/gldebug.h"
+#include "../grinliz/glcontainer.h"
+#include "../grinliz/glstringutil.h"
+#include "../grinliz/glvector.h"
+#include "../xegame/cticker.h"
+#include "gamelimits.h"
+
+class ChitContext;
+class Chit;
+class XStream;
+
+/*	Pages out the sectors where nothing is happening: no avatar or
+	camera nearby, no domain, no plot, and nothing fighting. The
+	wildlife and loose items in a dormant sector are serialized to
+	a blob and deleted, and the sector's pather and (idle) CircuitSim
+	are freed, so the tick and memory cost follow the active part of
+	the world rather than its size.
+
+	Buildings stay: they block the map and are in the building hash.
+	The census keeps counting the paged MOBs, so the spawners don't
+	refill a dormant sector.
+
+	A paged sector doesn't tick. When it comes back (the camera or
+	avatar gets close, or a moving chit walks in) the time it was
+	out is applied coarsely: hp regenerates, fire and shock burn out,
+	and the self-destruct timers run down.
+*/
+class SectorPager
+{
+public:
+	SectorPager(const ChitContext* context);
+	~SectorPager();
+
+	// Off by default. Turning it off pages everything back in.
+	void SetEnabled(bool enable);
+	bool Enabled() const	{ return enabled; }
+
+	void DoTick(U32 delta);
+	void Serialize(XStream* xs);
+	// Drops the paged sectors (and their chits); for Sim::Load().
+	void Clear();
+
+	bool PagedOut(const grinliz::Vector2I& sector) const {
+		GLASSERT(sector.x >= 0 && sector.x < NumSectors() && sector.y >= 0 && sector.y < NumSectors());
+		return pages[sector.y*NUM_SECTORS + sector.x] != 0;
+	}
+	void PageIn(const grinliz::Vector2I& sector);
+	void PageInAll();
+
+	int NumPagedSectors() const	{ return nPaged; }
+	int NumPagedChits() const	{ return nPagedChits; }
+
+private:
+	struct Page {
+		U32 time;			// bag time when paged out
+		int nChits;
+		int wildFruit;
+		grinliz::CDynArray<grinliz::IString> mobs;	// for the census
+		grinliz::CDynArray<U8> data;					// the chits, as a memory stream
+	};
+
+	// The sectors near the camera, avatar, and home core stay in.
+	bool Active(const grinliz::Vector2I& sector);
+	bool Pageable(Chit* chit);
+	// Returns true (and fills 'chits') if the sector can be paged out.
+	bool Dormant(const grinliz::Vector2I& sector, grinliz::CDynArray<Chit*>* chits);
+	bool Intruder(const grinliz::Vector2I& sector);
+	void PageOut(const grinliz::Vector2I& sector, const grinliz::CDynArray<Chit*>& chits);
+	void CatchUp(Chit* chit, U32 elapsed);
+	void InformCensus(const Page& page, bool add);
+
+	enum {
+		QUIET_VISITS = 2,		// dormant on this many scans in a row before paging out
+		SCAN_TIME = 4000,		// msec to visit every sector
+		ACTIVE_RADIUS = 1		// in sectors, around the camera / avatar / home
+	};
+
+	const ChitContext* context;
+	bool enabled;
+	int nPaged;
+	int nPagedChits;
+	int scanSector;
+	CTicker scanTicker;
+	Page* pages[NUM_SECTORS_2];
+	U8 quiet[NUM_SECTORS_2];
+	grinliz::Vector2I focus[3];
+	int nFocus;
+	grinliz::CDynArray<Chit*> queryArr, pageArr;
+};
+
+#endif // LUMOS_SECTOR_PAGER_INCLUDED
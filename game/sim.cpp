@@ -46,12 +46,16 @@
 #include "gridmovecomponent.h"
 #include "physicssims.h"
 #include "fluidsim.h"
+#include "backgroundsave.h"
+#include "sectorpager.h"
 
 #include "../xarchive/glstreamer.h"
 
 #include "../grinliz/glperformance.h"
 #include "../grinliz/glarrayutil.h"
 
+#include <chrono>
+
 using namespace grinliz;
 using namespace tinyxml2;
 
@@ -74,18 +78,23 @@ static const float SPAWN_PERCENT[NSPAWNS] = {
 };
 
 
-Sim::Sim(LumosGame* g) : minuteClock(60 * 1000), secondClock(1000), volcTimer(10 * 1000), denizenClock(DENIZEN_CLOCK), visitorClock(4*1000)
+Sim::Sim(LumosGame* g) : Sim(g->GetDatabase(), g->GetScreenportMutable())
 {
 	context.game = g;
+}
+
+
+Sim::Sim(const gamedb::Reader* database, Screenport* port) : minuteClock(60 * 1000), secondClock(1000), volcTimer(10 * 1000), denizenClock(DENIZEN_CLOCK), visitorClock(4*1000)
+{
+	context.database = database;
 	spawnEnabled = 0xff;
-	Screenport* port = context.game->GetScreenportMutable();
-	const gamedb::Reader* database = context.game->GetDatabase();
 	cachedWebAge = VERY_LONG_TICK;
+	ClearTickProfile();
 
 	itemDB				= new ItemDB();
-	context.worldMap	= new WorldMap( MAX_MAP_SIZE, MAX_MAP_SIZE );
+	context.worldMap	= new WorldMap( MapSize(), MapSize() );
 	context.engine		= new Engine( port, database, context.worldMap );
-	weather				= new Weather( MAX_MAP_SIZE, MAX_MAP_SIZE );
+	weather				= new Weather();
 	reserveBank			= new ReserveBank();
 	teamInfo			= new Team(database);
 	visitors			= new Visitors();
@@ -101,18 +110,22 @@ Sim::Sim(LumosGame* g) : minuteClock(60 * 1000), secondClock(1000), volcTimer(10
 
 	context.physicsSims = new PhysicsSims(&context);
 	context.worldMap->AttatchPhysics(context.physicsSims);
+	sectorPager = new SectorPager(&context);
 
 	random.SetSeedFromTime();
 	plantScript = new PlantScript(context.chitBag->Context());
+	backgroundSave = new BackgroundSave();
 }
 
 
 Sim::~Sim()
 {
+	delete backgroundSave;	// waits for a save in progress
 	context.worldMap->AttatchPhysics(0);
 	context.worldMap->AttachEngine( 0, 0 );
 	context.worldMap->AttachHistory(0);
 	context.chitBag->RemoveListener(this);
+	delete sectorPager;
 	delete context.physicsSims;
 	context.physicsSims= 0;
 	delete plantScript;
@@ -136,11 +149,20 @@ float  Sim::AgeF() const { return float(AgeD()); }
 
 void Sim::Load(const char* mapDAT, const char* gameDAT)
 {
+	sectorPager->Clear();
 	context.chitBag->DeleteAll();
 	context.worldMap->Load(mapDAT);
 
+	// The map file sets MapSize(); the per-sector sims
+	// are sized from it.
+	context.worldMap->AttatchPhysics(0);
+	delete context.physicsSims;
+	context.physicsSims = new PhysicsSims(&context);
+	context.worldMap->AttatchPhysics(context.physicsSims);
+
 	if (!gameDAT) {
 		// Fresh start
+		reserveBank->Fill();
 		CreateRockInOutland();
 		CreateCores();
 
@@ -159,8 +181,15 @@ void Sim::Load(const char* mapDAT, const char* gameDAT)
 		FILE* fp = fopen(path.c_str(), "rb");
 		GLASSERT(fp);
 		if (fp) {
-			StreamReader reader(fp);
-			XarcOpen(&reader, "Sim");
+			StreamReader base(fp);
+			XarcOpen(&base, "Sim");
+
+			// With a delta save, everything but the unchanged
+			// chits comes from the delta.
+			DeltaReader delta;
+			StreamReader* deltaReader = delta.Open(path.c_str(), &base, "Sim");
+			StreamReader& reader = deltaReader ? *deltaReader : base;
+			context.chitBag->SetLoadBase(deltaReader ? &base : 0);
 
 			XARC_SER(&reader, avatarTimer);
 			XARC_SER(&reader, GameItem::idPool);
@@ -177,6 +206,10 @@ void Sim::Load(const char* mapDAT, const char* gameDAT)
 			context.physicsSims->Serialize(&reader);
 			context.engine->camera.Serialize(&reader);
 			context.chitBag->Serialize(&reader);
+			context.chitBag->SetLoadBase(0);
+			if (reader.HasChild() && StrEqual(reader.PeekElement(), "SectorPager")) {
+				sectorPager->Serialize(&reader);
+			}
 
 			XarcClose(&reader);
 
@@ -185,44 +218,78 @@ void Sim::Load(const char* mapDAT, const char* gameDAT)
 	}
 	// Set the spawn limits, try to limit population blowouts.
 	for (int i = 0; i < NSPAWNS; ++i) {
-		context.chitBag->census.SetTypical(StringPool::Intern(SPAWN_NAME[i]), int(SPAWN_PERCENT[i] * float(TYPICAL_LESSER)));
+		context.chitBag->census.SetTypical(StringPool::Intern(SPAWN_NAME[i]), int(SPAWN_PERCENT[i] * float(TypicalLesser())));
 	}
 }
 
 
 void Sim::Save(const char* mapDAT, const char* gameDAT)
 {
-	context.worldMap->Save(mapDAT);
+	// A background save could finish after this one, and overwrite it.
+	backgroundSave->Wait();
+	// Same save (possibly a delta), but wait for it.
+	SaveInBackground(mapDAT, gameDAT);
+	backgroundSave->Wait();
+}
 
-	{
-		QuickProfile qp("Sim::SaveXarc");
 
-		GLString path;
-		GetSystemPath(GAME_SAVE_DIR, gameDAT, &path);
-		FILE* fp = fopen(path.c_str(), "wb");
-		if (fp) {
-			StreamWriter writer(fp, CURRENT_FILE_VERSION);
-			XarcOpen(&writer, "Sim");
-			XARC_SER(&writer, avatarTimer);
-			XARC_SER(&writer, GameItem::idPool);
-
-			minuteClock.Serialize(&writer, "minuteClock");
-			secondClock.Serialize(&writer, "secondClock");
-			volcTimer.Serialize(&writer, "volcTimer");
-			denizenClock.Serialize(&writer, "denizenClock");
-			visitorClock.Serialize(&writer, "visitorClock");
-			itemDB->Serialize(&writer);
-			reserveBank->Serialize(&writer);
-			teamInfo->Serialize(&writer);
-			visitors->Serialize(&writer);
-			context.physicsSims->Serialize(&writer);
-			context.engine->camera.Serialize(&writer);
-			context.chitBag->Serialize(&writer);
-
-			XarcClose(&writer);
-			fclose(fp);
-		}
+bool Sim::SaveInBackground(const char* mapDAT, const char* gameDAT)
+{
+	GLString mapPath, gamePath;
+	GetSystemPath(GAME_SAVE_DIR, mapDAT, &mapPath);
+	GetSystemPath(GAME_SAVE_DIR, gameDAT, &gamePath);
+
+	SimSnapshot* snapshot = backgroundSave->GetSnapshot(mapPath.c_str(), gamePath.c_str());
+	if (!snapshot) {
+		return false;
 	}
+	Snapshot(snapshot);
+	backgroundSave->Start();
+	return true;
+}
+
+
+bool Sim::SaveInProgress() const
+{
+	return backgroundSave->Busy();
+}
+
+
+void Sim::Snapshot(SimSnapshot* snapshot)
+{
+	U32 baseID = snapshot->baseID;
+	bool delta = snapshot->delta;
+	context.worldMap->Snapshot(&snapshot->map, baseID, delta, backgroundSave->ChangedChunks());
+
+	QuickProfile qp("Sim::SaveXarc");
+	StreamWriter writer(0, CURRENT_FILE_VERSION);
+	XarcOpen(&writer, "Sim");
+	XARC_SER(&writer, baseID);
+	XARC_SER(&writer, delta);
+	XARC_SER(&writer, avatarTimer);
+	XARC_SER(&writer, GameItem::idPool);
+
+	minuteClock.Serialize(&writer, "minuteClock");
+	secondClock.Serialize(&writer, "secondClock");
+	volcTimer.Serialize(&writer, "volcTimer");
+	denizenClock.Serialize(&writer, "denizenClock");
+	visitorClock.Serialize(&writer, "visitorClock");
+	itemDB->Serialize(&writer);
+	reserveBank->Serialize(&writer);
+	teamInfo->Serialize(&writer);
+	visitors->Serialize(&writer);
+	context.physicsSims->Serialize(&writer);
+	context.engine->camera.Serialize(&writer);
+	context.chitBag->SetSaveDelta(delta ? backgroundSave->BaseChits() : 0, backgroundSave->LastChits(), &snapshot->chits);
+	context.chitBag->Serialize(&writer);
+	context.chitBag->SetSaveDelta(0, 0, 0);
+	sectorPager->Serialize(&writer);
+
+	XarcClose(&writer);
+
+	snapshot->game.Clear();
+	U8* p = snapshot->game.PushArr(writer.Data().Size());
+	memcpy(p, writer.Data().Mem(), writer.Data().Size());
 }
 
 
@@ -230,17 +297,17 @@ void Sim::CreateCores()
 {
 	int ncores = 0;
 
-	for (int j = 0; j < NUM_SECTORS; ++j) {
-		for (int i = 0; i < NUM_SECTORS; ++i) {
+	for (int j = 0; j < NumSectors(); ++j) {
+		for (int i = 0; i < NumSectors(); ++i) {
 			Vector2I sector = { i, j };
 
 			int team = TEAM_NEUTRAL;
-			if (i == MOTHER_CORE_SECTOR_X && j == MOTHER_CORE_SECTOR_Y) {
+			if (i == NumSectors() / 2 && j == NumSectors() / 2) {
 				// Mother Core. Always at the center: spawn point of the Visitors.
 				team = DEITY_MOTHER_CORE;
 			}
 			CoreScript* cs = CoreScript::CreateCore(sector, team, &context);
-			if (i == NUM_SECTORS / 2 && j == NUM_SECTORS / 2) {
+			if (i == NumSectors() / 2 && j == NumSectors() / 2) {
 				cs->ParentChit()->GetItem()->flags |= GameItem::INDESTRUCTABLE;
 				HealthComponent* hc = cs->ParentChit()->GetHealthComponent();
 				if (hc) {
@@ -288,9 +355,9 @@ void Sim::AssignDefaultSpawns()
 	}
 	
 	list.Reverse();
-	for (int i = 0; i < NUM_SECTORS / 2; ++i) {
+	for (int i = 0; i < NumSectors() / 2; ++i) {
 		Rectangle2I rect;
-		rect.Set(NUM_SECTORS / 2 - i - 1, NUM_SECTORS / 2 - i - 1, NUM_SECTORS / 2 + i, NUM_SECTORS / 2 + i);
+		rect.Set(NumSectors() / 2 - i - 1, NumSectors() / 2 - i - 1, NumSectors() / 2 + i, NumSectors() / 2 + i);
 		for (Rectangle2IEdgeIterator it(rect); !it.Done(); it.Next()) {
 			CoreScript* cs = CoreScript::GetCore(it.Pos());
 			if (cs) {
@@ -320,11 +387,11 @@ void Sim::SpawnDenizens()
 	int greater = 0, lesser = 0, denizen = 0;
 	context.chitBag->census.NumByType(&lesser, &greater, &denizen);
 
-	if (denizen < TYPICAL_DENIZENS) {
+	if (denizen < TypicalDenizens()) {
 		SectorPort sp;
 		for (int i = 0; i < 4; ++i) {
 			sp.Zero();
-			Vector2I sector = { int(random.Rand(NUM_SECTORS)), int(random.Rand(NUM_SECTORS)) };
+			Vector2I sector = { int(random.Rand(NumSectors())), int(random.Rand(NumSectors())) };
 			CoreScript* cs = CoreScript::GetCore(sector);
 			if (cs && !cs->InUse()) {
 				const SectorData& sd = context.worldMap->GetSectorData(sector);
@@ -411,7 +478,7 @@ void Sim::SpawnGreater()
 
 	int lesser = 0, greater = 0, denizen = 0;
 	context.chitBag->census.NumByType(&lesser, &greater, &denizen);
-	if (greater < TYPICAL_GREATER) {
+	if (greater < TypicalGreater()) {
 		SectorPort sp;
 		for (int i = 0; i < 4; ++i) {
 			sp.Zero();
@@ -455,7 +522,7 @@ void Sim::CreateTruulgaCore()
 			continue;
 
 		// Need a new core for Truulga.
-		Vector2I newSector = { random.Rand(NUM_SECTORS), random.Rand(NUM_SECTORS) };
+		Vector2I newSector = { random.Rand(NumSectors()), random.Rand(NumSectors()) };
 		CoreScript* cs = CoreScript::GetCore(newSector);
 		if (cs && cs->ParentChit()->Team() == 0) {
 			CoreScript* deity = CoreScript::CreateCore(newSector, deityGroup, &context);
@@ -516,14 +583,48 @@ Texture* Sim::GetMiniMapTexture()
 }
 
 
+const char* Sim::TickProfileName(int i)
+{
+	static const char* NAME[NUM_TICK_PROFILE] = {
+		"WorldMap", "Plants", "Physics", "Team", "ChitBag", "Paging", "Spawn", "Weather"
+	};
+	GLASSERT(i >= 0 && i < NUM_TICK_PROFILE);
+	return NAME[i];
+}
+
+
+// Accumulates the time between construction and Mark() into
+// a tick profile slot, then restarts for the next slot.
+class TickProfileTimer
+{
+public:
+	TickProfileTimer(double* p) : profile(p), start(std::chrono::steady_clock::now()) {}
+
+	void Mark(int i) {
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		profile[i] += std::chrono::duration<double, std::micro>(now - start).count();
+		start = now;
+	}
+
+private:
+	double* profile;
+	std::chrono::steady_clock::time_point start;
+};
+
+
 void Sim::DoTick( U32 delta, bool useAreaOfInterest )
 {
 	cachedWebAge += delta;
+	TickProfileTimer timer(tickProfile);
 
 	context.worldMap->DoTick( delta, context.chitBag );
+	timer.Mark(TICK_WORLDMAP);
 	plantScript->DoTick(delta);
+	timer.Mark(TICK_PLANTS);
 	context.physicsSims->DoTick(delta);
+	timer.Mark(TICK_PHYSICS);
 	Team::Instance()->DoTick(delta);
+	timer.Mark(TICK_TEAM);
 
 	if (useAreaOfInterest) {
 		Vector3F center = V3F_ZERO;
@@ -539,6 +640,9 @@ void Sim::DoTick( U32 delta, bool useAreaOfInterest )
 	}
 
 	context.chitBag->DoTick( delta );
+	timer.Mark(TICK_CHITBAG);
+	sectorPager->DoTick(delta);
+	timer.Mark(TICK_PAGING);
 
 	CreateTruulgaCore();
 
@@ -557,7 +661,7 @@ void Sim::DoTick( U32 delta, bool useAreaOfInterest )
 	// Age of Fire. Needs lots of volcanoes to seed the world.
 	static const int VOLC_RAD = 6;
 	static const int VOLC_DIAM = VOLC_RAD*2+1;
-	static const int NUM_VOLC = MAX_MAP_SIZE*MAX_MAP_SIZE / (VOLC_DIAM*VOLC_DIAM);
+	const int NUM_VOLC = MapSize()*MapSize() / (VOLC_DIAM*VOLC_DIAM);
 	int MSEC_TO_VOLC = AGE_IN_MSEC / NUM_VOLC;
 
 	int age = AgeI();
@@ -565,8 +669,8 @@ void Sim::DoTick( U32 delta, bool useAreaOfInterest )
 
 	if (volcano) {
 		int rock = 0, nSectors = 0;
-		for (int y = 0; y < NUM_SECTORS; ++y) {
-			for (int x = 0; x < NUM_SECTORS; ++x) {
+		for (int y = 0; y < NumSectors(); ++y) {
+			for (int x = 0; x < NumSectors(); ++x) {
 				Vector2I sector = { x, y };
 				FluidSim* fluidSim = context.physicsSims->GetFluidSim(sector);
 				if (CoreScript::GetCore(sector) && fluidSim && fluidSim->Settled()) {
@@ -576,7 +680,7 @@ void Sim::DoTick( U32 delta, bool useAreaOfInterest )
 			}
 		}
 		const static float ROCK_COVERAGE = 0.35f;
-		if (nSectors > NUM_SECTORS) {
+		if (nSectors > NumSectors()) {
 			float ratio = float(rock) / float(nSectors * SECTOR_SIZE_2);
 			if (ratio > ROCK_COVERAGE) {
 				volcano = 0;
@@ -627,16 +731,18 @@ void Sim::DoTick( U32 delta, bool useAreaOfInterest )
 
 	// Cheat! Seed early on, so there is good plant variety.
 	int plantCount = context.worldMap->CountPlants();
-	if (context.worldMap->CountPlants() < TYPICAL_PLANTS / 2) {
+	if (context.worldMap->CountPlants() < TypicalPlants() / 2) {
 		// And seed lots of plants in the beginning, with extra variation in the early world.
 		for (int i = 0; i < 5; ++i) {
 			int x = random.Rand(context.worldMap->Width());
 			int y = random.Rand(context.worldMap->Height());
-			int type = plantCount < TYPICAL_PLANTS / 4 ? random.Rand(NUM_BASE_PLANT_TYPES) : -1;
+			int type = plantCount < TypicalPlants() / 4 ? random.Rand(NUM_BASE_PLANT_TYPES) : -1;
 			CreatePlant(x, y, type);
 		}
 	}
+	timer.Mark(TICK_SPAWN);
 	DoWeatherEffects( delta );
+	timer.Mark(TICK_WEATHER);
 
 	// Special rule for player controlled chit: give money to the core.
 	CoreScript* cs = context.chitBag->GetHomeCore();
@@ -646,7 +752,7 @@ void Sim::DoTick( U32 delta, bool useAreaOfInterest )
 		// Don't clear the avatar's wallet if a scene is pushed - the avatar
 		// may be about to use the wallet!
 		if ( item && !item->wallet.IsEmpty() ) {
-			if ( !context.game->IsScenePushed() && !context.chitBag->IsScenePushed() ) {
+			if ( !(context.game && context.game->IsScenePushed()) && !context.chitBag->IsScenePushed() ) {
 				cs->ParentChit()->GetWallet()->Deposit(&item->wallet, item->wallet);
 			}
 		}
@@ -766,8 +872,8 @@ void Sim::Draw3D( U32 deltaTime )
 
 void Sim::CreateRockInOutland()
 {
-	for (int sj = 0; sj < NUM_SECTORS; ++sj) {
-		for (int si = 0; si < NUM_SECTORS; ++si) {
+	for (int sj = 0; sj < NumSectors(); ++sj) {
+		for (int si = 0; si < NumSectors(); ++si) {
 			Vector2I sector = { si, sj };
 			const SectorData& sd = context.worldMap->GetSectorData(sector);
 			if (!sd.HasCore()) {
@@ -837,7 +943,7 @@ void Sim::SeedPlants()
 	Rectangle2I bounds = context.worldMap->Bounds();
 	bounds.Outset(-SECTOR_SIZE);
 
-	for (int i = 0; i < TYPICAL_PLANTS; ++i) {
+	for (int i = 0; i < TypicalPlants(); ++i) {
 		int x = bounds.min.x + random.Rand(bounds.Width());
 		int y = bounds.min.y + random.Rand(bounds.Height());
 
@@ -1001,7 +1107,7 @@ void Sim::CalcStrategicRelationships(const grinliz::Vector2I& sector, int rad, g
 	stateArr->Clear();
 
 	Rectangle2I mapBounds, bounds;
-	mapBounds.Set(1, 1, NUM_SECTORS - 2, NUM_SECTORS - 2);
+	mapBounds.Set(1, 1, NumSectors() - 2, NumSectors() - 2);
 	bounds.min = bounds.max = sector;
 	bounds.Outset(rad);
 	bounds.DoIntersection(mapBounds);
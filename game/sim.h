@@ -48,11 +48,18 @@ class ItemDB;
 class CoreScript;
 class PlantScript;
 class Team;
+class Screenport;
+class BackgroundSave;
+class SectorPager;
+struct SimSnapshot;
+namespace gamedb { class Reader; }
 
 class Sim : public IChitListener, public IUITracker
 {
 public:
 	Sim( LumosGame* game );
+	// Headless: no LumosGame, and no GL context behind the Engine.
+	Sim( const gamedb::Reader* database, Screenport* port );
 	virtual ~Sim();
 
 	void DoTick( U32 deltaTime, bool useAreaOfInterest=true );
@@ -61,6 +68,11 @@ public:
 
 	void Load( const char* mapDAT, const char* gameDAT );
 	void Save( const char* mapDAT, const char* gameDAT );
+	// Save() without the hitch: the sim is copied now, and the
+	// compression and file writes happen on a thread. Returns
+	// false (and doesn't save) if the last save isn't done.
+	bool SaveInBackground( const char* mapDAT, const char* gameDAT );
+	bool SaveInProgress() const;
 
 	Texture*		GetMiniMapTexture();
 
@@ -69,6 +81,7 @@ public:
 	Engine*			GetEngine()		{ return context.engine; }
 	LumosChitBag*	GetChitBag()	{ return context.chitBag; }
 	WorldMap*		GetWorldMap()	{ return context.worldMap; }
+	SectorPager*	GetSectorPager()	{ return sectorPager; }
 
 	int    AgeI() const;
 	double AgeD() const;
@@ -104,11 +117,29 @@ public:
 
 	void CalcStrategicRelationships(const grinliz::Vector2I& sector, int radius, grinliz::CArray<CoreScript*, 32> *stateArr);
 
+	// Time spent in each part of DoTick(), accumulated
+	// until ClearTickProfile(). In microseconds.
+	enum {
+		TICK_WORLDMAP,
+		TICK_PLANTS,
+		TICK_PHYSICS,
+		TICK_TEAM,
+		TICK_CHITBAG,
+		TICK_PAGING,
+		TICK_SPAWN,
+		TICK_WEATHER,
+		NUM_TICK_PROFILE
+	};
+	static const char* TickProfileName(int i);
+	double TickProfile(int i) const	{ GLASSERT(i >= 0 && i < NUM_TICK_PROFILE); return tickProfile[i]; }
+	void ClearTickProfile()			{ for (int i = 0; i < NUM_TICK_PROFILE; ++i) tickProfile[i] = 0; }
+
 private:
 	void CreateCores();
 	void CreateRockInOutland();
 	void DoWeatherEffects( U32 delta );
 	void AssignDefaultSpawns();
+	void Snapshot( SimSnapshot* snapshot );
 
 	void SpawnGreater();
 	void SpawnDenizens();
@@ -121,6 +152,8 @@ private:
 	Visitors*		visitors;
 	ItemDB*			itemDB;
 	PlantScript*	plantScript;
+	BackgroundSave*	backgroundSave;
+	SectorPager*	sectorPager;
 
 	grinliz::Random	random;
 	int avatarTimer;
@@ -137,6 +170,7 @@ private:
 
 	grinliz::CDynArray< Chit* >	queryArr;					// local; cached at object.
 	grinliz::CDynArray< int > uiChits;						// chits that have displayed UI elements
+	double tickProfile[NUM_TICK_PROFILE];
 };
 
 
@@ -430,9 +430,9 @@ int Team::CalcAttitude(CoreScript* center, CoreScript* eval, const Web* web)
 	// Too much of one group.
 	const Census& census = center->ParentChit()->Context()->chitBag->census;	// FIXME clearly a path out of scope
 	int numCores = census.NumCoresOfTeam(Team::Group(evalTeam));
-	if (numCores >= TYPICAL_AI_DOMAINS / 2)
+	if (numCores >= TypicalAIDomains() / 2)
 		d--;
-	if (numCores >= TYPICAL_AI_DOMAINS * 3 / 4)
+	if (numCores >= TypicalAIDomains() * 3 / 4)
 		d--;
 
 	// Control!
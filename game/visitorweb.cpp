@@ -109,7 +109,7 @@ const MinSpanTree::Node* Web::FindNode(const grinliz::Vector2I& v) const
 
 void Web::Calc(const Vector2I* exclude)
 {
-	static Vector2I origin = { NUM_SECTORS / 2, NUM_SECTORS / 2 };
+	const Vector2I origin = { NumSectors() / 2, NumSectors() / 2 };
 	CArray<Vector2I, NUM_SECTORS * NUM_SECTORS> cores;
 	cores.Push(origin);
 
@@ -21,10 +21,12 @@
 #include "../grinliz/glutil.h"
 #include "../grinliz/glrandom.h"
 
+#include "gamelimits.h"
+
 class Weather
 {
 public:
-	Weather(int p_width, int p_height) : width((float)p_width), height((float)p_height) { GLASSERT(instance == 0); instance = this; }
+	Weather() { GLASSERT(instance == 0); instance = this; }
 	~Weather() { GLASSERT(instance == this); instance = 0; }
 	static Weather* Instance() { return instance; }
 
@@ -40,7 +42,7 @@ public:
 
 		// More rain in the West.
 		// Prevailing wind from West to East.
-		float r = grinliz::Lerp( MAX_RAIN, MIN_RAIN, x / width );
+		float r = grinliz::Lerp( MAX_RAIN, MIN_RAIN, x / float(MapSize()) );
 		static const float delta[8] = { -1.0f, -0.75f, -0.50f, -0.25f, 0.25f, 0.50f, 0.75f, 1.0f };
 		
 		int xi = (int)x;
@@ -63,13 +65,11 @@ public:
 	}
 
 	float Temperature( float, float y ) {
-		return grinliz::Lerp( 0.0f, 1.0f, y/height );
+		return grinliz::Lerp( 0.0f, 1.0f, y/float(MapSize()) );
 	}
 
 private:
 	static Weather* instance;
-	float width;
-	float height;
 };
 
 #endif // LUMOS_WEATHER_INCLUDED
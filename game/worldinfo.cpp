@@ -1,12 +1,13 @@
 #include "worldinfo.h"
 #include "worldgrid.h"
+#include "gridstore.h"
 
 #include "../grinliz/glrandom.h"
 
 using namespace tinyxml2;
 using namespace grinliz;
 
-WorldInfo::WorldInfo( const WorldGrid* grid, int mw, int mh )
+WorldInfo::WorldInfo( const GridStore* grid, int mw, int mh )
 {
 	pather = new micropather::MicroPather( this, NUM_SECTORS*NUM_SECTORS, 4, true );
 	worldGrid = grid;
@@ -25,8 +26,8 @@ int WorldInfo::Solve( GridBlock start, GridBlock end, grinliz::CDynArray<GridBlo
 {
 	GLASSERT(!start.IsZero());
 	GLASSERT(!end.IsZero());
-	GLASSERT(worldGrid[INDEX(start)].IsGrid());
-	GLASSERT(worldGrid[INDEX(end)].IsGrid());
+	GLASSERT((*worldGrid)[INDEX(start)].IsGrid());
+	GLASSERT((*worldGrid)[INDEX(end)].IsGrid());
 
 	path->Clear();
 	float cost = 0;
@@ -42,8 +43,12 @@ void WorldInfo::Serialize( XStream* xs )
 {
 	XarcOpen( xs, "WorldInfo" );
 
-	for( int i=0; i<NUM_SECTORS*NUM_SECTORS; ++i ) {
-		sectorData[i].Serialize( xs );
+	// Only the sectors on the map are written, so the file
+	// doesn't depend on the size of the sector table.
+	for( int j=0; j<mapHeight/SECTOR_SIZE; ++j ) {
+		for( int i=0; i<mapWidth/SECTOR_SIZE; ++i ) {
+			sectorData[j*NUM_SECTORS+i].Serialize( xs );
+		}
 	}
 
 	XarcClose( xs );
@@ -52,7 +57,7 @@ void WorldInfo::Serialize( XStream* xs )
 
 GridBlock WorldInfo::GetGridBlock( const grinliz::Vector2I& sector, int port ) const
 {
-	GLASSERT( sector.x >= 0 && sector.x < NUM_SECTORS && sector.y >= 0 && sector.y < NUM_SECTORS );
+	GLASSERT( sector.x >= 0 && sector.x < NumSectors() && sector.y >= 0 && sector.y < NumSectors() );
 	const SectorData& sd = sectorData[sector.y*NUM_SECTORS+sector.x];
 	GridBlock g = { 0, 0 };
 	static const int HALF_SIZE = SECTOR_SIZE / 2;
@@ -86,8 +91,8 @@ float WorldInfo::LeastCostEstimate( void* stateStart, void* stateEnd )
 	GridBlock start = FromState( stateStart );	
 	GridBlock end   = FromState( stateEnd );
 
-	GLASSERT(worldGrid[INDEX(start)].IsGrid());
-	GLASSERT(worldGrid[INDEX(end)].IsGrid());
+	GLASSERT((*worldGrid)[INDEX(start)].IsGrid());
+	GLASSERT((*worldGrid)[INDEX(end)].IsGrid());
 
 	int len = abs( start.x - end.x ) + abs( start.y - end.y );
 	return (float)len;
@@ -98,7 +103,7 @@ void  WorldInfo::AdjacentCost( void* state, MP_VECTOR< micropather::StateCost >
 {
 	adjacent->clear();
 	const GridBlock g = FromState( state );
-	GLASSERT(worldGrid[INDEX(g)].IsGrid());
+	GLASSERT((*worldGrid)[INDEX(g)].IsGrid());
 
 	// If we are not at a Port or Corner, then the next step is
 	// to the 2 near Ports/Corners. That's a one way move.
@@ -137,7 +142,7 @@ void  WorldInfo::AdjacentCost( void* state, MP_VECTOR< micropather::StateCost >
 	for (int i = 0; i < adj.Size(); ++i) {
 		Vector2I v = { adj[i].x, adj[i].y };
 		GridBlock vgb = { S16(adj[i].x), S16(adj[i].y) };
-		if (bounds.Contains(v) && worldGrid[INDEX(vgb)].IsGrid()) {
+		if (bounds.Contains(v) && (*worldGrid)[INDEX(vgb)].IsGrid()) {
 			micropather::StateCost sc = { ToState(vgb), HALF };
 			adjacent->push_back(sc);
 		}
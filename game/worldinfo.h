@@ -27,6 +27,7 @@
 #include "../grinliz/glrectangle.h"
 
 struct WorldGrid;
+class GridStore;
 namespace micropather {
 	class MicroPather;
 }
@@ -89,7 +90,7 @@ inline GridBlock MapToGridBlock(float x, float y)
 class WorldInfo : public micropather::Graph
 {
 public:
-	WorldInfo( const WorldGrid* worldGrid, int mapWidth, int mapHeight );
+	WorldInfo( const GridStore* worldGrid, int mapWidth, int mapHeight );
 	~WorldInfo();
 	
 	void Serialize( XStream* );
@@ -104,12 +105,12 @@ public:
 
 	// Get the current sector from the grid coordinates.
 	const SectorData& GetSectorData( const grinliz::Vector2I& sector ) const {
-		GLASSERT( sector.x >= 0 && sector.y >= 0 && sector.x < NUM_SECTORS && sector.y < NUM_SECTORS );
+		GLASSERT( sector.x >= 0 && sector.y >= 0 && sector.x < NumSectors() && sector.y < NumSectors() );
 		return sectorData[NUM_SECTORS*sector.y+sector.x];
 	}
 
 	SectorData* GetSectorDataMutable(const grinliz::Vector2I& sector) {
-		GLASSERT( sector.x >= 0 && sector.y >= 0 && sector.x < NUM_SECTORS && sector.y < NUM_SECTORS );
+		GLASSERT( sector.x >= 0 && sector.y >= 0 && sector.x < NumSectors() && sector.y < NumSectors() );
 		return &sectorData[NUM_SECTORS*sector.y+sector.x];
 	}
 
@@ -139,7 +140,7 @@ private:
 
 	int mapWidth;
 	int mapHeight;
-	const WorldGrid* worldGrid;
+	const GridStore* worldGrid;
 
 	SectorData sectorData[NUM_SECTORS*NUM_SECTORS];
 };
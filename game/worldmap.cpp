@@ -31,7 +31,7 @@
 
 #include "../xarchive/glstreamer.h"
 #include "../shared/lodepng.h"
-#include "../xarchive/squisher.h"
+#include "../xarchive/blockcodec.h"
 
 #include "../engine/engine.h"
 #include "../engine/texture.h"
@@ -47,6 +47,9 @@
 #include "fluidsim.h"
 #include "circuitsim.h"
 #include "physicssims.h"
+#include "pathqueue.h"
+#include "flowfield.h"
+#include "backgroundsave.h"
 
 #include "../script/worldgen.h"
 #include "../script/procedural.h"
@@ -107,11 +110,27 @@ static const float INV_LEN_F8[8] = {
 	1, INV_SQRT2, 1, INV_SQRT2, 1, INV_SQRT2, 1, INV_SQRT2
 };
 
+const WorldGrid GridStore::water = WorldGrid();
+
+static int mapSize = DEFAULT_MAP_SIZE;
+
+int MapSize()
+{
+	return mapSize;
+}
+
+void SetMapSize(int size)
+{
+	GLASSERT(size > 0 && size <= MAX_MAP_SIZE);
+	mapSize = size;
+}
+
 
 WorldMap::WorldMap(int width, int height) : Map(width, height)
 {
 	GLASSERT( width % ZONE_SIZE == 0 );
 	GLASSERT( height % ZONE_SIZE == 0 );
+	GLASSERT( width <= MAX_MAP_SIZE && height <= MAX_MAP_SIZE );
 	ShaderManager::Instance()->AddDeviceLossHandler( this );
 
 	engine = 0;
@@ -133,8 +152,13 @@ WorldMap::WorldMap(int width, int height) : Map(width, height)
 	magmaGrids.Reserve(1000);
 	treePool.Reserve(1000);
 
-	memset(grid, 0, sizeof(WorldGrid)*MAX_MAP_SIZE*MAX_MAP_SIZE);
 	memset(pathers, 0, sizeof(pathers[0]) * NUM_SECTORS_2);
+	memset(patherDirty, 0, sizeof(patherDirty[0]) * NUM_SECTORS_2);
+	memset(zoneVersion, 0, sizeof(zoneVersion[0]) * NUM_ZONES * NUM_ZONES);
+	regionPathHit = regionPathMiss = 0;
+	zoneGeneration = 0;
+	pathQueue = new PathQueue(this);
+	flowFields = new FlowFields(this);
 
 	for (int i = 0; i < NUM_EXTENDED_PLANT_TYPES; ++i) {
 		for (int j = 0; j < MAX_PLANT_STAGES; ++j) {
@@ -153,6 +177,8 @@ WorldMap::~WorldMap()
 	ShaderManager::Instance()->RemoveDeviceLossHandler( this );
 
 	DeleteAllRegions();
+	delete pathQueue;
+	delete flowFields;
 	delete worldInfo;
 
 	delete voxelVertexVBO;
@@ -199,7 +225,7 @@ void WorldMap::AttachEngine( Engine* e, IMapGridBlocked* imap )
 	if ( !e ) {
 		for( int j=0; j<height; ++j ) {
 			for( int i=0; i<width; ++i ) {
-				if ( grid[INDEX(i,j)].IsLand() ) {
+				if ( grid.Get(INDEX(i,j)).IsLand() ) {
 					SetRock( i, j, 0, false, 0 );
 				}
 			}
@@ -233,13 +259,13 @@ void WorldMap::VoxelHit( const Vector3I& v, const DamageDesc& dd )
 {
 	//Vector2I v2 = { v.x, v.z };
 	int index = INDEX(v.x, v.z);
-	const WorldGrid wasWG = grid[index];
+	const WorldGrid wasWG = grid.Get(index);
 	
-	if (grid[index].RockHeight() || grid[index].Plant()) {
+	if (grid.Get(index).RockHeight() || grid.Get(index).Plant()) {
 		// fluids don't take damage; rocks and plants do.
 		grid[index].DeltaHP((int)(-dd.damage));
 	}
-	if ( grid[index].HP() == 0 ) {
+	if ( grid.Get(index).HP() == 0 ) {
 		if (wasWG.HP()) {
 			Vector3F pos = { (float)v.x + 0.5f, (float)v.y + 0.5f, (float)v.z + 0.5f };
 			engine->particleSystem->EmitPD(ISC::derez, pos, V3F_UP, 0);
@@ -247,8 +273,8 @@ void WorldMap::VoxelHit( const Vector3I& v, const DamageDesc& dd )
 			SetPlant(v.x, v.z, 0, 0);
 		}
 	}
-	else if (grid[index].Plant()) {
-		const GameItem* plant = PlantScript::PlantDef( grid[index].Plant() - 1);
+	else if (grid.Get(index).Plant()) {
+		const GameItem* plant = PlantScript::PlantDef( grid.Get(index).Plant() - 1);
 
 		// catch fire/shock?
 		float chanceFire = 0;
@@ -273,6 +299,7 @@ void WorldMap::VoxelHit( const Vector3I& v, const DamageDesc& dd )
 		bool shock = random.Uniform() < chanceShock;
 		if (fire || shock) {
 			grid[index].SetOn(fire, shock);
+			planes.Sync(index, grid.Get(index));
 		}
 	}
 }
@@ -284,7 +311,7 @@ void WorldMap::SavePNG( const char* filename )
 
 	for (int j = 0; j < height; ++j) {
 		for (int i = 0; i < width; ++i) {
-			pixels[j*width+i] = grid[INDEX(i,j)].ToColor();
+			pixels[j*width+i] = grid.Get(INDEX(i,j)).ToColor();
 		}
 	}
 	GLString path;
@@ -297,34 +324,100 @@ void WorldMap::SavePNG( const char* filename )
 
 void WorldMap::Save( const char* filename )
 {
-	// Debug or laptap, about 4.5MClock
-	// smaller window size: 3.8MClock
-	// btype == 0 about the same.
-	// None of this matters; may need to add an ultra-simple fast encoder.
+	MapSnapshot snapshot;
+	Snapshot( &snapshot, BackgroundSave::NewBaseID(), false );
+
 	GLString path;
 	GetSystemPath(GAME_SAVE_DIR, filename, &path);
-	FILE* fp = fopen( path.c_str(), "wb" );
-	GLASSERT( fp );
-	if ( fp ) {
+	SaveFile file( path.c_str() );
+	if ( file.FP() ) {
+		WriteSnapshot( snapshot, file.FP() );
+		if ( file.Commit() ) {
+			// A new base; any delta is for the old one.
+			GLString deltaPath;
+			BackgroundSave::DeltaPath( path.c_str(), &deltaPath );
+			remove( deltaPath.c_str() );
+		}
+	}
+}
+
 
-		StreamWriter writer(fp, CURRENT_FILE_VERSION);
+void WorldMap::Snapshot( MapSnapshot* snapshot, U32 baseID, bool delta, U8* changed )
+{
+	StreamWriter writer(0, CURRENT_FILE_VERSION);
+	int gridCodec = BlockCodec::FASTLZ;
 
-		XarcOpen( &writer, "Map" );
-		XARC_SER( &writer, width );
-		XARC_SER( &writer, height );
+	XarcOpen( &writer, "Map" );
+	XARC_SER( &writer, width );
+	XARC_SER( &writer, height );
+	XARC_SER( &writer, gridCodec );
+	XARC_SER( &writer, baseID );
+	XARC_SER( &writer, delta );
 		
-		worldInfo->Serialize( &writer );
-		XarcClose( &writer );
+	worldInfo->Serialize( &writer );
+	XarcClose( &writer );
+
+	snapshot->header.Clear();
+	U8* p = snapshot->header.PushArr( writer.Data().Size() );
+	memcpy( p, writer.Data().Mem(), writer.Data().Size() );
+
+	snapshot->width = width;
+	snapshot->height = height;
+	if ( changed ) {
+		// Only the chunks written since the last snapshot.
+		grid.CopyDirtyTo( &snapshot->grid, changed );
+	}
+	else {
+		grid.CopyTo( &snapshot->grid );
+	}
+}
 
-		// Tack on the grid so that the dat file can still be inspected.
-		//fwrite( grid, sizeof(WorldGrid), width*height, fp );
 
-		// This works very well; about 3:1 compression.
-		Squisher squisher;
-		squisher.StreamEncode( grid, sizeof(WorldGrid)*MAX_MAP_SIZE*MAX_MAP_SIZE, fp );
-		squisher.StreamEncode( 0, 0, fp );
+void WorldMap::WriteSnapshot( const MapSnapshot& snapshot, FILE* fp, const U8* changed )
+{
+	fwrite( snapshot.header.Mem(), snapshot.header.Size(), 1, fp );
 
-		fclose( fp );
+	// The grid is written a chunk at a time, filtered and then
+	// compressed with the 'gridCodec' from the header. Chunks that
+	// were never allocated are empty blocks. (The Squisher got about
+	// 3:1, but at ~4.5MClock a save; FastLZ on the filtered chunks
+	// is close in size and many times faster both ways.)
+	//
+	// A delta is a list of (chunk index, block) for the chunks
+	// 'changed' since the base, ending with an index of -1. Only
+	// the chunks on the map are written, in rows of the map's width,
+	// so the file doesn't depend on MAX_MAP_SIZE.
+	static const int CHUNK_CELLS = GridStore::CHUNK_SIZE * GridStore::CHUNK_SIZE;
+	static const int CHUNK_BYTES = CHUNK_CELLS * sizeof(WorldGrid);
+
+	FastLZCodec codec;
+	GridFilter filter( sizeof(WorldGrid), GridStore::CHUNK_SIZE );
+	CDynArray<U8> filtered;
+	filtered.PushArr( CHUNK_BYTES );
+
+	const int chunksPerRow = GridStore::MapChunks( snapshot.width );
+	for (int j = 0; j < snapshot.height; j += GridStore::CHUNK_SIZE) {
+		for (int i = 0; i < snapshot.width; i += GridStore::CHUNK_SIZE) {
+			S32 index = (j / GridStore::CHUNK_SIZE) * chunksPerRow + (i / GridStore::CHUNK_SIZE);
+			if (changed) {
+				if (!changed[GridStore::ChunkIndex(i, j)]) continue;
+				fwrite( &index, sizeof(index), 1, fp );
+			}
+
+			// The run at the chunk origin is the whole chunk.
+			const WorldGrid* chunk = snapshot.grid.Run(i, j);
+			if (chunk) {
+				filter.Encode( chunk, CHUNK_CELLS, filtered.Mem() );
+				codec.WriteBlock( filtered.Mem(), CHUNK_BYTES, fp );
+			}
+			else {
+				codec.WriteBlock( 0, 0, fp );
+			}
+		}
+	}
+	if (changed) {
+		S32 end = -1;
+		fwrite( &end, sizeof(end), 1, fp );
 	}
 }
 
@@ -340,15 +433,54 @@ void WorldMap::Load( const char* filename )
 		
 		XarcOpen( &reader, "Map" );
 
+		int gridCodec = 0;
 		XARC_SER(&reader, width);
 		XARC_SER( &reader, height );
+		XARC_SER( &reader, gridCodec );
 		Init( width, height );
 
-		worldInfo->Serialize( &reader );
+		// If there is a delta save, it has the current WorldInfo.
+		DeltaReader delta;
+		StreamReader* deltaReader = delta.Open( path.c_str(), &reader, "Map" );
+		if ( deltaReader ) {
+			while ( reader.HasChild() ) {
+				reader.SkipElement();
+			}
+		}
+		else {
+			worldInfo->Serialize( &reader );
+		}
 		XarcClose( &reader );
 
-		Squisher squisher;
-		squisher.StreamDecode( grid, sizeof(WorldGrid)*MAX_MAP_SIZE*MAX_MAP_SIZE, fp );
+		static const int CHUNK_CELLS = GridStore::CHUNK_SIZE * GridStore::CHUNK_SIZE;
+		static const int CHUNK_BYTES = CHUNK_CELLS * sizeof(WorldGrid);
+
+		// Every save of this version has a 'gridCodec'.
+		BlockCodec* codec = BlockCodec::Create( gridCodec );
+		GLASSERT( codec );
+		GridFilter filter( sizeof(WorldGrid), GridStore::CHUNK_SIZE );
+		CDynArray<U8> filtered;
+		filtered.PushArr( CHUNK_BYTES );
+
+		for (int j = 0; codec && j < height; j += GridStore::CHUNK_SIZE) {
+			for (int i = 0; i < width; i += GridStore::CHUNK_SIZE) {
+				int n = codec->ReadBlock( filtered.Mem(), CHUNK_BYTES, fp );
+				GLASSERT( n >= 0 );
+				if (n > 0) {
+					filter.Decode( filtered.Mem(), CHUNK_CELLS, grid.Run(i, j) );
+				}
+			}
+		}
+		delete codec;
+
+		if ( deltaReader ) {
+			int deltaCodec = 0;
+			XarcGet( deltaReader, "gridCodec", deltaCodec );
+			worldInfo->Serialize( deltaReader );
+			XarcClose( deltaReader );
+			LoadDelta( delta.FP(), deltaCodec );
+		}
+		planes.SyncAll(grid);
 
 		fclose( fp );
 		
@@ -357,9 +489,12 @@ void WorldMap::Load( const char* filename )
 		for( int j=0; j<height; ++j ) {
 			for( int i=0; i<width; ++i ) {
 				int index = INDEX( i, j );
-				grid[index].extBlock = 0;	// clear out the block. will be set by callback later.
-				const WorldGrid& wg = grid[index];
-				SetRock( i, j, -2, grid[index].Magma(), grid[index].RockType() );
+				// A chunk that wasn't loaded is water: nothing to set up.
+				WorldGrid* cell = grid.Find( index );
+				if ( !cell ) continue;
+				cell->extBlock = 0;	// clear out the block. will be set by callback later.
+				const WorldGrid& wg = grid.Get( index );
+				SetRock( i, j, -2, wg.Magma(), wg.RockType() );
 
 				if (wg.Plant()) {
 					plantCount[wg.Plant() - 1][wg.PlantStage()] += 1;
@@ -370,6 +505,43 @@ void WorldMap::Load( const char* filename )
 }
 
 
+void WorldMap::LoadDelta( FILE* fp, int gridCodec )
+{
+	static const int CHUNK_CELLS = GridStore::CHUNK_SIZE * GridStore::CHUNK_SIZE;
+	static const int CHUNK_BYTES = CHUNK_CELLS * sizeof(WorldGrid);
+
+	BlockCodec* codec = BlockCodec::Create( gridCodec );
+	GLASSERT( codec );
+	if ( !codec ) return;
+
+	GridFilter filter( sizeof(WorldGrid), GridStore::CHUNK_SIZE );
+	CDynArray<U8> filtered;
+	filtered.PushArr( CHUNK_BYTES );
+
+	const int chunksPerRow = GridStore::MapChunks( width );
+	const int nChunks = chunksPerRow * GridStore::MapChunks( height );
+
+	while ( true ) {
+		S32 index = -1;
+		if ( fread( &index, sizeof(index), 1, fp ) != 1 || index < 0 || index >= nChunks ) {
+			GLASSERT( index == -1 );
+			break;
+		}
+		int x = (index % chunksPerRow) * GridStore::CHUNK_SIZE;
+		int y = (index / chunksPerRow) * GridStore::CHUNK_SIZE;
+
+		int n = codec->ReadBlock( filtered.Mem(), CHUNK_BYTES, fp );
+		GLASSERT( n >= 0 );
+		// Chunks are never freed, so an empty block is one
+		// that was never allocated in the base either.
+		if ( n > 0 ) {
+			filter.Decode( filtered.Mem(), CHUNK_CELLS, grid.Run(x, y) );
+		}
+	}
+	delete codec;
+}
+
+
 void WorldMap::PatherCacheHitMiss( const grinliz::Vector2I& sector, micropather::CacheData* data )
 {
 	MicroPather* pather = GetPather(sector, false);
@@ -382,14 +554,12 @@ void WorldMap::PatherCacheHitMiss( const grinliz::Vector2I& sector, micropather:
 int WorldMap::CalcNumRegions()
 {
 	int count = 0;
-	if ( grid ) {
-		// Delete all the regions. Be careful to only
-		// delete from the origin location.
-		for( int j=0; j<height; ++j ) {	
-			for( int i=0; i<width; ++i ) {
-				if ( IsZoneOrigin( i, j )) {
-					++count;
-				}
+	// Delete all the regions. Be careful to only
+	// delete from the origin location.
+	for( int j=0; j<height; ++j ) {	
+		for( int i=0; i<width; ++i ) {
+			if ( IsZoneOrigin( i, j )) {
+				++count;
 			}
 		}
 	}
@@ -399,15 +569,13 @@ int WorldMap::CalcNumRegions()
 
 void WorldMap::DumpRegions()
 {
-	if ( grid ) {
-		for( int j=0; j<height; ++j ) {	
-			for( int i=0; i<width; ++i ) {
-				if ( IsPassable(i,j) && IsZoneOrigin(i, j)) {
-					const WorldGrid& gs = grid[INDEX(i,j)];
-					GLOUTPUT(( "Region %d,%d size=%d", i, j, gs.ZoneSize() ));
-					GLOUTPUT(( "\n" ));
-					(void)gs;
-				}
+	for( int j=0; j<height; ++j ) {	
+		for( int i=0; i<width; ++i ) {
+			if ( IsPassable(i,j) && IsZoneOrigin(i, j)) {
+				const WorldGrid& gs = grid.Get(INDEX(i,j));
+				GLOUTPUT(( "Region %d,%d size=%d", i, j, gs.ZoneSize() ));
+				GLOUTPUT(( "\n" ));
+				(void)gs;
 			}
 		}
 	}
@@ -417,6 +585,12 @@ void WorldMap::DumpRegions()
 void WorldMap::DeleteAllRegions()
 {
 	zoneInit.ClearAll();
+	ClearRegionPaths();
+	++zoneGeneration;
+	for (int i = 0; i < NUM_SECTORS_2; ++i) {
+		patherDirty[i] = true;
+	}
+	flowFields->InvalidateAll();
 }
 
 
@@ -433,16 +607,19 @@ void WorldMap::Init( int w, int h )
 	DeleteAllRegions();
 	this->width = w;
 	this->height = h;
-	memset( grid, 0, MAX_MAP_SIZE*MAX_MAP_SIZE*sizeof(WorldGrid) );
+	SetMapSize( Max( w, h ));
+	grid.Clear();
+	planes.Clear();
 	
 	delete worldInfo;
-	worldInfo = new WorldInfo( grid, width, height );
+	worldInfo = new WorldInfo( &grid, width, height );
 }
 
 
 void WorldMap::InitCircle()
 {
-	memset( grid, 0, MAX_MAP_SIZE*MAX_MAP_SIZE*sizeof(WorldGrid) );
+	grid.Clear();
+	planes.Clear();
 
 	const int R = Min( width, height )/2-1;
 	const int R2 = R * R;
@@ -458,6 +635,7 @@ void WorldMap::InitCircle()
 			}
 		}
 	}
+	planes.SyncAll(grid);
 	//Tessellate();
 }
 
@@ -516,6 +694,7 @@ bool WorldMap::InitPNG( const char* filename,
 			}
 		}
 		free( pixels );
+		planes.SyncAll(grid);
 	}
 	//Tessellate();
 	return error == 0;
@@ -524,26 +703,35 @@ bool WorldMap::InitPNG( const char* filename,
 
 void WorldMap::MapInit( const U8* land, const U16* path )
 {
-	GLASSERT( grid );
-	for( int i=0; i<width*height; ++i ) {
-		int h = *(land + i);
-		if ( h >= WorldGen::WATER && h <= WorldGen::LAND3 ) {
-			grid[i].SetLandAndRock( h );
-		}
-		else if ( h == WorldGen::GRID ) {
-			grid[i].SetLand(WorldGrid::GRID);
-		}
-		else if ( h == WorldGen::PORT ) {
-			grid[i].SetLand(WorldGrid::PORT);
-		}
-		else if ( h == WorldGen::CORE ) {
-			grid[i].SetLandAndRock(1);
-		}
-		else {
-			GLASSERT( 0 );
+	// WorldGen rows are 'width' long; the grid rows are MAX_MAP_SIZE.
+	for( int j=0; j<height; ++j ) {
+		for( int k=0; k<width; ++k ) {
+			const int src = j*width + k;
+			const int i = INDEX( k, j );
+			int h = land[src];
+			// A missing chunk already reads as water; don't allocate it.
+			if ( h == WorldGen::WATER && !path[src] && !grid.Find( i )) {
+				continue;
+			}
+			if ( h >= WorldGen::WATER && h <= WorldGen::LAND3 ) {
+				grid[i].SetLandAndRock( h );
+			}
+			else if ( h == WorldGen::GRID ) {
+				grid[i].SetLand(WorldGrid::GRID);
+			}
+			else if ( h == WorldGen::PORT ) {
+				grid[i].SetLand(WorldGrid::PORT);
+			}
+			else if ( h == WorldGen::CORE ) {
+				grid[i].SetLandAndRock(1);
+			}
+			else {
+				GLASSERT( 0 );
+			}
+			grid[i].SetPath( path[src] );
 		}
-		grid[i].SetPath( path[i] );
 	}
+	planes.SyncAll(grid);
 }
 
 
@@ -573,59 +761,105 @@ void WorldMap::PushQuad( int layer, int x, int y, int w, int h, CDynArray<PTVert
 	pv[3].tex.Set( (float)w, (float)h );
 }
 
-#if defined(WORLDMAP_THREADS)
-int WorldMap::ScanEffects(void* p1, void*, void*, void*)
+void WorldMap::ScanEffectsJob(void* p, int start, int end)
 {
-	ScanEffectsData* data = (ScanEffectsData*)p1;
-#else
+	ScanEffectsData* data = (ScanEffectsData*)p;
+	for (int i = start; i < end; ++i) {
+		ScanEffects(&data[i]);
+	}
+}
+
+
 int WorldMap::ScanEffects(ScanEffectsData* data)
 {
-#endif
 	static const int MAP2 = MAX_MAP_SIZE*MAX_MAP_SIZE;
 	Rectangle2I b = data->worldMap->Bounds();
 	b.Outset(-1);
+	GridPlanes* planes = &data->worldMap->planes;
 
-	for (int i = 0; i < data->n; ++i) {
-		const int index = (data->start + i) & (MAP2 - 1);
-		WorldGrid* wg = &data->worldMap->grid[index];
-		if (!wg->IsLand()) continue;
-
-		const int y = (index >> MAP_Y_SHIFT);
-		const int x = (index & MAP_X_MASK);
-		const Vector2I pos2i = { x, y };
+	// Only the active cells are visited, in index order, so the
+	// cadence and the random numbers are the same as a full sweep.
+	// The range can wrap around the end of the map.
+	const int start = data->start & (MAP2 - 1);
+	const int end = start + data->n;
+	ScanEffectRange(data, planes, start, Min(end, MAP2), b);
+	if (end > MAP2) {
+		ScanEffectRange(data, planes, 0, end - MAP2, b);
+	}
+	return data->n;
+}
 
-		if (!b.Contains(pos2i)) continue;
 
-		// flammability is reflected in the chance
-		// of it catching fire; once on fire, everything
-		// has the same chance of the fire going out.
+void WorldMap::ScanEffectRange(ScanEffectsData* data, GridPlanes* planes, int first, int last, const Rectangle2I& b)
+{
+	// Each thread's range stays inside its own quarter of the map
+	// (ProcessEffect clamps it to the SLICE), and the quarters start
+	// on summary word boundaries (4096 cells). So the threads never
+	// write to the same word of the planes, even though the ranges
+	// themselves are not aligned.
+	const int endWord = (last + GridPlanes::WORD_MASK) >> GridPlanes::WORD_SHIFT;
+	int word = first >> GridPlanes::WORD_SHIFT;
 
-		if (wg->PlantOnFire()) {
-			bool underWater = wg->FluidHeight() && (wg->FluidType() == WorldGrid::FLUID_WATER);
-			if (underWater || (data->random.Uniform() < CHANCE_FIRE_OUT)) {
-				wg->SetPlantOnFire(false);
-			}
+	while ((word = planes->NextEffectWord(word, endWord)) < endWord) {
+		const int base = word << GridPlanes::WORD_SHIFT;
+		U64 bits = planes->EffectWord(word);
+		if (base < first) {
+			bits &= ~U64(0) << (first - base);
 		}
-		if (wg->PlantOnShock() && data->random.Uniform() < CHANCE_FIRE_OUT) {
-			wg->SetPlantOnShock(false);
+		if (base + 64 > last) {
+			bits &= ~U64(0) >> (base + 64 - last);
 		}
-
-		int effect = 0;
-		if (wg->Plant()) {
-			if (wg->PlantOnFire())  effect |= GameItem::EFFECT_FIRE;
-			if (wg->PlantOnShock()) effect |= GameItem::EFFECT_SHOCK;
+		while (bits) {
+			const int index = base + GridPlanes::LowestBit(bits);
+			bits &= bits - 1;
+			ScanEffect(data, planes, index, b);
 		}
+		++word;
+	}
+}
 
-		if (wg->Magma() || (wg->IsFluid() && wg->FluidType() == WorldGrid::FLUID_LAVA)) {
-			effect |= GameItem::EFFECT_FIRE;
-		}
 
-		if (effect) {
-			EffectRecord r = { pos2i, effect };
-			data->effects->Push(r);
+void WorldMap::ScanEffect(ScanEffectsData* data, GridPlanes* planes, int index, const Rectangle2I& b)
+{
+	WorldGrid* wg = &data->worldMap->grid[index];
+	GLASSERT(wg->IsLand());
+
+	const int y = (index >> MAP_Y_SHIFT);
+	const int x = (index & MAP_X_MASK);
+	const Vector2I pos2i = { x, y };
+
+	if (!b.Contains(pos2i)) return;
+
+	// flammability is reflected in the chance
+	// of it catching fire; once on fire, everything
+	// has the same chance of the fire going out.
+
+	if (wg->PlantOnFire()) {
+		bool underWater = wg->FluidHeight() && (wg->FluidType() == WorldGrid::FLUID_WATER);
+		if (underWater || (data->random.Uniform() < CHANCE_FIRE_OUT)) {
+			wg->SetPlantOnFire(false);
+			planes->Sync(index, *wg);
 		}
 	}
-	return data->n;
+	if (wg->PlantOnShock() && data->random.Uniform() < CHANCE_FIRE_OUT) {
+		wg->SetPlantOnShock(false);
+		planes->Sync(index, *wg);
+	}
+
+	int effect = 0;
+	if (wg->Plant()) {
+		if (wg->PlantOnFire())  effect |= GameItem::EFFECT_FIRE;
+		if (wg->PlantOnShock()) effect |= GameItem::EFFECT_SHOCK;
+	}
+
+	if (wg->Magma() || (wg->IsFluid() && wg->FluidType() == WorldGrid::FLUID_LAVA)) {
+		effect |= GameItem::EFFECT_FIRE;
+	}
+
+	if (effect) {
+		EffectRecord r = { pos2i, effect };
+		data->effects->Push(r);
+	}
 }
 
 /*
@@ -654,44 +888,40 @@ void WorldMap::ProcessEffect(ChitBag* chitBag, int delta)
 	int nGrid = N_PER_MSEC * delta;
 	effectCache.Clear();
 
-	// Threaded: 27ms
+	// Threaded: 27ms (4 threads)
 	// Single:   50ms
 #if defined(WORLDMAP_THREADS)
 	{
-		// Carefully spread out the threads to be as far apart
+		// Carefully spread out the slices to be as far apart
 		// in memory as possible. Try to give the processor
 		// cache some room.
-		const static int QUARTER = MAP2 / ThreadPool::NTHREAD;
-		int n = nGrid / ThreadPool::NTHREAD;
-		GLASSERT(processIndex < QUARTER);
-		n = Min(n, QUARTER - processIndex);
+		const static int SLICE = MAP2 / NUM_EFFECT_SLICES;
+		int n = nGrid / NUM_EFFECT_SLICES;
+		GLASSERT(processIndex < SLICE);
+		n = Min(n, SLICE - processIndex);
 
-		ScanEffectsData data[ThreadPool::NTHREAD];
+		ScanEffectsData data[NUM_EFFECT_SLICES];
 
-		for (int i = 0; i < ThreadPool::NTHREAD; ++i) {
+		for (int i = 0; i < NUM_EFFECT_SLICES; ++i) {
 			subEffectCache[i].Clear();
 			data[i].random.SetSeed(random.Rand() + i*1000);
 			data[i].effects = &subEffectCache[i];
-			data[i].start = processIndex + i*QUARTER;
+			data[i].start = processIndex + i*SLICE;
 			data[i].n = n;
 			data[i].worldMap = this;
-
-			// Fire off 3 threads, use the main thread for the
-			// end. There are only 4 threads on my system anyway,
-			// no point having the main thread wait.
-			if (i != ThreadPool::NTHREAD - 1)
-				threadPool.Add(WorldMap::ScanEffects, (void*)&data[i]);
-			else
-				ScanEffects((void*)&data[i], nullptr, nullptr, nullptr);
 		}
-		threadPool.Wait(0);
-		for (int i = 0; i < ThreadPool::NTHREAD; ++i) {
+		// Nothing burning? Don't wake the workers.
+		if (planes.AnyEffect()) {
+			JobSystem::Instance()->ParallelFor(NUM_EFFECT_SLICES, 1, WorldMap::ScanEffectsJob, data);
+		}
+
+		for (int i = 0; i < NUM_EFFECT_SLICES; ++i) {
 			for (int k = 0; k < subEffectCache[i].Size(); ++k) {
 				effectCache.Push(subEffectCache[i][k]);
 			}
 		}
 		processIndex += n;
-		if (processIndex >= QUARTER) processIndex = 0;
+		if (processIndex >= SLICE) processIndex = 0;
 	}
 #else
 	ScanEffectsData data;
@@ -724,7 +954,7 @@ void WorldMap::ProcessEffect(ChitBag* chitBag, int delta)
 			Vector2I v2 = pos2i + delta[j];
 			Vector3I v3 = { v2.x, 0, v2.y };
 			int ia = INDEX(v2);
-			if (grid[ia].Plant()) {
+			if (grid.Get(ia).Plant()) {
 				if (random.Uniform() < CHANCE_FIRE_SPREAD) {
 					DamageDesc dd(0, effect);
 					this->VoxelHit(v3, dd);
@@ -744,8 +974,8 @@ void WorldMap::FluidStats(PhysicsSims* context, int* pools, int* waterfalls)
 {
 	*pools = 0;
 	*waterfalls = 0;
-	for (int j = 0; j < NUM_SECTORS; ++j) {
-		for (int i = 0; i < NUM_SECTORS; ++i) {
+	for (int j = 0; j < NumSectors(); ++j) {
+		for (int i = 0; i < NumSectors(); ++i) {
 			Vector2I sector = { i, j };
 			FluidSim* fluidSim = context->GetFluidSim(sector);
 			if (fluidSim) {
@@ -760,6 +990,7 @@ void WorldMap::FluidStats(PhysicsSims* context, int* pools, int* waterfalls)
 void WorldMap::DoTick(U32 delta, ChitBag* chitBag)
 {
 	ProcessEffect(chitBag, delta);
+	pathQueue->DoTick();
 
 	slowTick -= (int)(delta);
 
@@ -786,12 +1017,12 @@ void WorldMap::DoTick(U32 delta, ChitBag* chitBag)
 		r.max.x += 1.0f; r.max.z += 1.0f;
 
 		int index = INDEX(magmaGrids[i]);
-		if (grid[index].IsWater() || grid[index].IsFluid()) {
-			r.min.y = r.max.y = grid[index].FluidHeight();
+		if (grid.Get(index).IsWater() || grid.Get(index).IsFluid()) {
+			r.min.y = r.max.y = grid.Get(index).FluidHeight();
 			engine->particleSystem->EmitPD(pdSmoke, r, V3F_UP, delta);
 		}
 		else {
-			r.min.y = r.max.y = (float)grid[index].RockHeight();
+			r.min.y = r.max.y = (float)grid.Get(index).RockHeight();
 			engine->particleSystem->EmitPD(pdSmoke, r, V3F_UP, delta);
 		}
 	}
@@ -814,10 +1045,10 @@ void WorldMap::DoTick(U32 delta, ChitBag* chitBag)
 void WorldMap::SetPlant(int x, int y, int typeBase1, int stage)
 {
 	int index = INDEX(x, y);
-	const WorldGrid was = grid[index];
+	const WorldGrid was = grid.Get(index);
 	GLASSERT(typeBase1 == 0 || was.IsLand());
 
-	WorldGrid wg = grid[index];
+	WorldGrid wg = grid.Get(index);
 	wg.SetPlant(typeBase1, stage);
 	wg.DeltaHP(wg.TotalHP());
 
@@ -825,6 +1056,7 @@ void WorldMap::SetPlant(int x, int y, int typeBase1, int stage)
 		ResetPather(x, y);
 	}
 	grid[index] = wg;
+	planes.Sync(index, wg);
 
 	if (was.Plant()) {
 		plantCount[was.Plant() - 1][was.PlantStage()] -= 1;
@@ -839,7 +1071,7 @@ void WorldMap::SetRock( int x, int y, int h, bool magma, int rockType )
 {
 	Vector2I vec	= { x, y };
 	int index		= INDEX(x,y);
-	const WorldGrid was = grid[index];
+	const WorldGrid was = grid.Get(index);
 
 	if ( !was.IsLand() ) {
 		return;
@@ -850,7 +1082,7 @@ void WorldMap::SetRock( int x, int y, int h, bool magma, int rockType )
 		if (    ( iMapGridUse && !iMapGridUse->MapGridBlocked( x, y ))
 			 || ( !iMapGridUse ) )
 		{
-			h = grid[index].NominalRockHeight();
+			h = grid.Get(index).NominalRockHeight();
 		}
 		else {
 			h = was.RockHeight();
@@ -862,7 +1094,7 @@ void WorldMap::SetRock( int x, int y, int h, bool magma, int rockType )
 			GLASSERT(magmaGrids.Find(vec) < 0);
 			magmaGrids.Push(vec);
 		}
-		h     = grid[index].RockHeight();
+		h     = grid.Get(index).RockHeight();
 		if ( iMapGridUse ) {
 			GLASSERT( iMapGridUse->MapGridBlocked( x, y ) == 0 );
 		}
@@ -880,6 +1112,7 @@ void WorldMap::SetRock( int x, int y, int h, bool magma, int rockType )
 
 	if (!was.VoxelEqual(wg)) {
 		grid[INDEX(x, y)] = wg;
+		planes.Sync(index, wg);
 
 		if (physics) {
 			Vector2I sector = ToSector(x, y);
@@ -949,7 +1182,7 @@ void WorldMap::GetWorldGrid(const grinliz::Vector2I&p, WorldGrid* arr, int count
 
 	// Zero entry:
 	if (count & 1) {
-		arr[n] = grid[INDEX(p)];
+		arr[n] = grid.Get(INDEX(p));
 		if (dirArr)
 			dirArr[n].Zero();
 		n++;
@@ -961,7 +1194,7 @@ void WorldMap::GetWorldGrid(const grinliz::Vector2I&p, WorldGrid* arr, int count
 	for (int i = 0; i < 8; i += step) {
 		const Vector2I v = p + DIR_I8[i];
 		if (bounds.Contains(v)) {
-			arr[n] = grid[INDEX(v)];
+			arr[n] = grid.Get(INDEX(v));
 		}
 		else {
 			// return water if out of bounds. much
@@ -977,18 +1210,90 @@ void WorldMap::GetWorldGrid(const grinliz::Vector2I&p, WorldGrid* arr, int count
 
 void WorldMap::ResetPather( int x, int y )
 {
-	Vector2I sector = ToSector(x, y);
-	micropather::MicroPather* pather = GetPather(sector, false);
-	if (pather)
-		pather->Reset();
-	zoneInit.Clear( x>>ZONE_SHIFT, y>>ZONE_SHIFT);
+	int zx = x >> ZONE_SHIFT;
+	int zy = y >> ZONE_SHIFT;
+	// The zones of this block are re-computed when next used.
+	zoneInit.Clear(zx, zy);
+	++zoneGeneration;
+	flowFields->Invalidate(ToSector(x, y));
+
+	// Region paths through the neighbors can go stale too, since
+	// AdjacentCost() checks corners across zone boundaries. The
+	// region path cache is versioned per block, but MicroPather
+	// can only Reset() as a whole: every sector that can see the
+	// block loses its entire node cache (lazily, before its next
+	// solve), not just the states in the changed zones.
+	for (int j = Max(zy - 1, 0); j <= Min(zy + 1, NUM_ZONES - 1); ++j) {
+		for (int i = Max(zx - 1, 0); i <= Min(zx + 1, NUM_ZONES - 1); ++i) {
+			zoneVersion[j*NUM_ZONES + i]++;
+			Vector2I sector = ToSector(i << ZONE_SHIFT, j << ZONE_SHIFT);
+			patherDirty[sector.y * NUM_SECTORS + sector.x] = true;
+		}
+	}
+}
+
+
+bool WorldMap::FindRegionPath(void* start, void* end, MP_VECTOR<void*>* path, float* cost)
+{
+	U64 key = U64(intptr_t(start)) | (U64(intptr_t(end)) << 32);
+	int index = -1;
+	if (regionPathTable.Query(key, &index)) {
+		const RegionPath& rp = regionPaths[index];
+		const RegionPathState* states = regionPathStates.Mem() + rp.offset;
+		bool valid = true;
+		for (int i = 0; i < rp.count; ++i) {
+			if (ZoneVersion(states[i].state) != states[i].version) {
+				valid = false;
+				break;
+			}
+		}
+		if (valid) {
+			path->clear();
+			for (int i = 0; i < rp.count; ++i) {
+				path->push_back(states[i].state);
+			}
+			*cost = rp.cost;
+			++regionPathHit;
+			return true;
+		}
+		regionPathTable.Remove(key);
+	}
+	++regionPathMiss;
+	return false;
+}
+
+
+void WorldMap::AddRegionPath(void* start, void* end, const MP_VECTOR<void*>& path, float cost)
+{
+	if (   regionPaths.Size() >= MAX_REGION_PATHS
+		|| regionPathStates.Size() + int(path.size()) > MAX_REGION_PATH_STATES)
+	{
+		// Stale entries are only reclaimed here.
+		ClearRegionPaths();
+	}
+	U64 key = U64(intptr_t(start)) | (U64(intptr_t(end)) << 32);
+	RegionPath rp = { cost, regionPathStates.Size(), int(path.size()) };
+	for (unsigned i = 0; i < path.size(); ++i) {
+		RegionPathState rps = { path[i], ZoneVersion(path[i]) };
+		regionPathStates.Push(rps);
+	}
+	regionPathTable.Add(key, regionPaths.Size());
+	regionPaths.Push(rp);
+}
+
+
+void WorldMap::ClearRegionPaths()
+{
+	regionPathTable.Clear();
+	regionPaths.Clear();
+	regionPathStates.Clear();
 }
 
 
 bool WorldMap::IsPassable( int x, int y, bool ignoreBuildings ) const
 {
 	int index = INDEX(x,y);
-	const WorldGrid& wg = grid[index];
+	const WorldGrid& wg = grid.Get(index);
 	return ignoreBuildings ? wg.IsInternalPassable() : wg.IsPassable();
 }
 
@@ -1049,7 +1354,7 @@ WorldMap::BlockResult WorldMap::CalcBlockEffect(	const grinliz::Vector2F& pos,
 		bool blocked = !bounds.Contains(block);
 		if (!blocked) {
 			if (type == BT_PASSABLE)   blocked = !IsPassable(block.x, block.y);
-			else if (type == BT_FLUID) blocked = !grid[INDEX(block)].IsFluid() && !IsPassable(block.x, block.y);
+			else if (type == BT_FLUID) blocked = !grid.Get(INDEX(block)).IsFluid() && !IsPassable(block.x, block.y);
 		}
 		if (!blocked) continue;
 
@@ -1083,7 +1388,7 @@ WorldMap::BlockResult WorldMap::ApplyBlockEffect(	const Vector2F inPos,
 
 	// If blocked on input, no fixing that:
 	Vector2I pos2i = ToWorld2I(inPos);
-	if (grid[INDEX(pos2i)].IsBlocked()) {
+	if (grid.Get(INDEX(pos2i)).IsBlocked()) {
 		*outPos = ToWorld2F(FindPassable(pos2i.x, pos2i.y));
 		return FORCE_APPLIED;
 	}
@@ -1099,7 +1404,7 @@ WorldMap::BlockResult WorldMap::ApplyBlockEffect(	const Vector2F inPos,
 	//}
 
 	pos2i = ToWorld2I(*outPos);
-	if (grid[INDEX(pos2i)].IsBlocked()) {
+	if (grid.Get(INDEX(pos2i)).IsBlocked()) {
 		GLASSERT(false);	// shouldn't happen - we weren't blocked at start of function.
 		*outPos = ToWorld2F(FindPassable(pos2i.x, pos2i.y));
 	}
@@ -1131,6 +1436,12 @@ void WorldMap::CalcZone( int mapX, int mapY )
 		//GLOUTPUT(( "CalcZone (%d,%d) %d\n", zx, zy, ZDEX(zx,zy) ));
 		zoneInit.Set( zx>>ZONE_SHIFT, zy>>ZONE_SHIFT);
 
+		// A chunk that doesn't exist is water, and already
+		// reads as zone size 0. Don't allocate it.
+		if ( !grid.Find( INDEX( zx, zy ))) {
+			return;
+		}
+
 		// Build up a bit pattern to analyze.
 		for( int y=0; y<ZONE_SIZE; ++y ) {
 			for( int x=0; x<ZONE_SIZE; ++x ) {
@@ -1185,6 +1496,12 @@ void WorldMap::CalcZone( int mapX, int mapY )
 
 // micropather
 float WorldMap::LeastCostEstimate( void* stateStart, void* stateEnd )
+{
+	return ZoneDistance(stateStart, stateEnd);
+}
+
+
+float WorldMap::ZoneDistance( void* stateStart, void* stateEnd ) const
 {
 	Vector2I startI, endI;
 	ToGrid( stateStart, &startI );
@@ -1198,6 +1515,29 @@ float WorldMap::LeastCostEstimate( void* stateStart, void* stateEnd )
 
 // micropather
 void WorldMap::AdjacentCost( void* state, MP_VECTOR< micropather::StateCost > *adjacent )
+{
+	Vector2I start;
+	const WorldGrid* startGrid = ToGrid( state, &start );
+	int size = startGrid->ZoneSize();
+	GLASSERT( size > 0 );
+
+	// A zone never crosses a ZONE_SIZE block, so the ring
+	// around it can touch at most 3x3 blocks. Flush those.
+	Rectangle2I mapBounds = this->Bounds();
+	const int xs[3] = { start.x - 1, start.x, start.x + size };
+	const int ys[3] = { start.y - 1, start.y, start.y + size };
+	for (int j = 0; j < 3; ++j) {
+		for (int i = 0; i < 3; ++i) {
+			if (mapBounds.Contains(xs[i], ys[j])) {
+				CalcZone(xs[i], ys[j]);
+			}
+		}
+	}
+	AdjacentZones( state, adjacent );
+}
+
+
+void WorldMap::AdjacentZones( void* state, MP_VECTOR< micropather::StateCost > *adjacent ) const
 {
 	Vector2I start;
 	const WorldGrid* startGrid = ToGrid( state, &start );
@@ -1224,9 +1564,6 @@ void WorldMap::AdjacentCost( void* state, MP_VECTOR< micropather::StateCost > *a
 		if ( !mapBounds.Contains( v )) {
 			continue;
 		}
-		// Move this down? But be careful to flush
-		// everything.
-		CalcZone( v.x, v.y );
 		Vector2I origin = ZoneOrigin( v.x, v.y );
 		if ( origin == currentOrigin ) {
 			// just looked at this.
@@ -1240,7 +1577,7 @@ void WorldMap::AdjacentCost( void* state, MP_VECTOR< micropather::StateCost > *a
 
 	for( int i=0; i<adj.Size(); ++i ) {
 		Vector2I origin = adj[i];	
-		const WorldGrid* wg = ZoneOriginG( origin.x, origin.y );
+		const WorldGrid* wg = &grid.Get(INDEX( origin ));
 
 		if ( wg->ZoneSize() && IsPassable( origin.x, origin.y )) {
 			// We can path to it - unless it's a corner. In
@@ -1285,7 +1622,7 @@ void WorldMap::AdjacentCost( void* state, MP_VECTOR< micropather::StateCost > *a
 void WorldMap::PrintStateInfo( void* state )
 {
 	Vector2I vec;
-	WorldGrid* g = ToGrid( state, &vec );
+	const WorldGrid* g = static_cast<const WorldMap*>(this)->ToGrid( state, &vec );
 	int size = g->ZoneSize();
 	GLOUTPUT(( "(%d,%d)s=%d ", vec.x, vec.y, size ));
 	(void)size;
@@ -1298,7 +1635,7 @@ int WorldMap::IntersectPlantAtVoxel(const grinliz::Vector3I& voxel,
 									grinliz::Vector3F* at)
 {
 	int index = INDEX(voxel.x, voxel.z);
-	const WorldGrid& wg = grid[index];
+	const WorldGrid& wg = grid.Get(index);
 	if (!wg.Plant()) {
 		return REJECT;
 	}
@@ -1430,7 +1767,7 @@ Vector3I WorldMap::IntersectVoxel(	const Vector3F& origin,
 // Specifically this link: http://playtechs.blogspot.com/2007/03/raytracing-on-grid.html
 // Returns true if there is a straight line path between the start and end.
 // The line-walk can/should get moved to the utility package. (and the grid lookup replaced with visit() )
-bool WorldMap::GridPath( const grinliz::Vector2F& p0, const grinliz::Vector2F& p1, bool ignoreBuildings )
+bool WorldMap::GridPath( const grinliz::Vector2F& p0, const grinliz::Vector2F& p1, bool ignoreBuildings ) const
 {
 	if (ToWorld2I(p0) == ToWorld2I(p1))
 		return true;	// start-end same
@@ -1468,8 +1805,6 @@ bool WorldMap::GridPath( const grinliz::Vector2F& p0, const grinliz::Vector2F& p
     }
 
     for (; n > 0; --n) {
-		CalcZone( x,y );
-
         if ( !IsPassable(x, y, ignoreBuildings) )
 			return false;
 
@@ -1492,7 +1827,7 @@ SectorPort WorldMap::RandomPort( grinliz::Random* random )
 
 	SectorPort sp;
 	while ( true ) {
-		Vector2I sector = { int(random->Rand( NUM_SECTORS )), int(random->Rand( NUM_SECTORS )) };
+		Vector2I sector = { int(random->Rand( NumSectors() )), int(random->Rand( NumSectors() )) };
 		const SectorData& sd = GetSectorData( sector );
 		if ( sd.HasCore() ) {
 			GLASSERT( sd.ports );
@@ -1623,18 +1958,34 @@ bool WorldMap::HasStraightPathBeside(const Vector2F& start, const Rectangle2I& r
 
 micropather::MicroPather* WorldMap::GetPather(const grinliz::Vector2I& sector, bool createIfNeeded)
 {
-	GLASSERT( sector.x >= 0 && sector.x < NUM_SECTORS );
-	GLASSERT( sector.y >= 0 && sector.y < NUM_SECTORS );
+	GLASSERT( sector.x >= 0 && sector.x < NumSectors() );
+	GLASSERT( sector.y >= 0 && sector.y < NumSectors() );
 	int index = sector.y * NUM_SECTORS + sector.x;
 
 	if (!pathers[index] && createIfNeeded) {
 		const SectorData& sd = this->GetSectorData(sector);
 		pathers[index] = new micropather::MicroPather( this, sd.area ? sd.area : 1000, 7, true );
+		patherDirty[index] = false;
+	}
+	if (pathers[index] && patherDirty[index]) {
+		pathers[index]->Reset();
+		patherDirty[index] = false;
 	}
 	return pathers[index];
 }
 
 
+void WorldMap::ReleasePather(const grinliz::Vector2I& sector)
+{
+	GLASSERT( sector.x >= 0 && sector.x < NumSectors() );
+	GLASSERT( sector.y >= 0 && sector.y < NumSectors() );
+	int index = sector.y * NUM_SECTORS + sector.x;
+	delete pathers[index];
+	pathers[index] = 0;
+	patherDirty[index] = false;
+}
+
+
 bool WorldMap::CalcWorkPath(const grinliz::Vector2F& start,
 							const grinliz::Rectangle2I& end,
 							grinliz::Vector2F* bestEnd,
@@ -1722,8 +2073,8 @@ bool WorldMap::CalcPath(const grinliz::Vector2F& start,
 	CalcZone(starti.x, starti.y);
 	CalcZone(endi.x, endi.y);
 
-	WorldGrid* wgStart = grid + INDEX(starti.x, starti.y);
-	WorldGrid* wgEnd = grid + INDEX(endi.x, endi.y);
+	const WorldGrid* wgStart = &grid.Get(INDEX(starti.x, starti.y));
+	const WorldGrid* wgEnd = &grid.Get(INDEX(endi.x, endi.y));
 
 	if (!IsPassable(starti.x, starti.y) || !IsPassable(endi.x, endi.y)) {
 		return false;
@@ -1749,55 +2100,22 @@ bool WorldMap::CalcPath(const grinliz::Vector2F& start,
 		}
 	}
 
-	// Use the region solver.
+	// Use the region solver, or the region paths it found before.
 	if (!okay) {
-		micropather::MicroPather* pather = GetPather(sector);
-
-		int result = pather->Solve(ToState(starti.x, starti.y), ToState(endi.x, endi.y),
-								   &pathRegions, totalCost);
+		void* startState = ToState(starti.x, starti.y);
+		void* endState = ToState(endi.x, endi.y);
+		int result = micropather::MicroPather::SOLVED;
+
+		if (!FindRegionPath(startState, endState, &pathRegions, totalCost)) {
+			micropather::MicroPather* pather = GetPather(sector);
+			result = pather->Solve(startState, endState, &pathRegions, totalCost);
+			if (result == micropather::MicroPather::SOLVED) {
+				AddRegionPath(startState, endState, pathRegions, *totalCost);
+			}
+		}
 		if (result == micropather::MicroPather::SOLVED) {
 			//GLOUTPUT(( "Region succeeded len=%d.\n", pathRegions.size() ));
-			Vector2F from = start;
-			path->Push(start);
-			okay = true;
-
-			// Walk each of the regions, and connect them with vectors.
-			for (unsigned i = 0; i < pathRegions.size() - 1; ++i) {
-				Vector2I originA, originB;
-				ToGrid(pathRegions[i], &originA);
-				ToGrid(pathRegions[i + 1], &originB);
-
-				Rectangle2F bA = ZoneBounds(originA.x, originA.y);
-				Rectangle2F bB = ZoneBounds(originB.x, originB.y);
-				bA.DoIntersection(bB);
-
-				// Every point on a path needs to be obtainable,
-				// else the chit will get stuck. There inset
-				// away from the walls so we don't put points
-				// too close to walls to get to.
-				static const float INSET = MAX_BASE_RADIUS;
-				if (bA.min.x + INSET*2.0f < bA.max.x) {
-					bA.min.x += INSET;
-					bA.max.x -= INSET;
-				}
-				if (bA.min.y + INSET*2.0f < bA.max.y) {
-					bA.min.y += INSET;
-					bA.max.y -= INSET;
-				}
-
-				Vector2F v = bA.min;
-				if (bA.min != bA.max) {
-					int result = ClosestPointOnLine(bA.min, bA.max, from, &v, true);
-					GLASSERT(result == INTERSECT);
-					if (result == REJECT) {
-						okay = false;
-						break;
-					}
-				}
-				path->Push(v);
-				from = v;
-			}
-			path->Push(end);
+			okay = RegionsToPath(pathRegions, start, end, path);
 		}
 	}
 
@@ -1814,12 +2132,77 @@ bool WorldMap::CalcPath(const grinliz::Vector2F& start,
 }
 
 
+bool WorldMap::RegionsToPath(const MP_VECTOR<void*>& regions,
+							 const grinliz::Vector2F& start,
+							 const grinliz::Vector2F& end,
+							 CDynArray<grinliz::Vector2F>* path) const
+{
+	Vector2F from = start;
+	path->Push(start);
+
+	// Walk each of the regions, and connect them with vectors.
+	for (unsigned i = 0; i < regions.size() - 1; ++i) {
+		Vector2I originA, originB;
+		ToGrid(regions[i], &originA);
+		ToGrid(regions[i + 1], &originB);
+
+		Rectangle2F bA = ZoneBounds(originA.x, originA.y);
+		Rectangle2F bB = ZoneBounds(originB.x, originB.y);
+		bA.DoIntersection(bB);
+
+		// Every point on a path needs to be obtainable,
+		// else the chit will get stuck. There inset
+		// away from the walls so we don't put points
+		// too close to walls to get to.
+		static const float INSET = MAX_BASE_RADIUS;
+		if (bA.min.x + INSET*2.0f < bA.max.x) {
+			bA.min.x += INSET;
+			bA.max.x -= INSET;
+		}
+		if (bA.min.y + INSET*2.0f < bA.max.y) {
+			bA.min.y += INSET;
+			bA.max.y -= INSET;
+		}
+
+		Vector2F v = bA.min;
+		if (bA.min != bA.max) {
+			int result = ClosestPointOnLine(bA.min, bA.max, from, &v, true);
+			GLASSERT(result == INTERSECT);
+			if (result == REJECT) {
+				return false;
+			}
+		}
+		path->Push(v);
+		from = v;
+	}
+	path->Push(end);
+	return true;
+}
+
+
+void WorldMap::CalcSectorZones(const grinliz::Vector2I& sector)
+{
+	int x0 = sector.x * SECTOR_SIZE;
+	int y0 = sector.y * SECTOR_SIZE;
+	for (int j = y0; j < y0 + SECTOR_SIZE; j += ZONE_SIZE) {
+		for (int i = x0; i < x0 + SECTOR_SIZE; i += ZONE_SIZE) {
+			CalcZone(i, j);
+		}
+	}
+}
+
+
 void WorldMap::ClearDebugDrawing()
 {
-	for( int i=0; i<width*height; ++i ) {
-		grid[i].SetDebugAdjacent( false );
-		grid[i].SetDebugOrigin( false );
-		grid[i].SetDebugPath( false );
+	for( int j=0; j<height; ++j ) {
+		for( int i=0; i<width; ++i ) {
+			WorldGrid* wg = grid.Find( INDEX( i, j ));
+			if ( wg ) {
+				wg->SetDebugAdjacent( false );
+				wg->SetDebugOrigin( false );
+				wg->SetDebugPath( false );
+			}
+		}
 	}
 	debugPathVector.Clear();
 }
@@ -1841,7 +2224,7 @@ void WorldMap::ShowRegionPath( float x0, float y0, float x1, float y1 )
 		if ( result == micropather::MicroPather::SOLVED ) {
 			for( unsigned i=0; i<pathRegions.size(); ++i ) {
 				WorldGrid* vp = ToGrid( pathRegions[i], 0 );
-				vp->SetDebugPath( true );
+				if ( vp ) vp->SetDebugPath( true );
 			}
 		}
 	}
@@ -1856,14 +2239,16 @@ void WorldMap::ShowAdjacentRegions( float fx, float fy )
 
 	if ( IsPassable( x, y ) ) {
 		WorldGrid* r = ZoneOriginG( x, y );
-		r->SetDebugOrigin( true );
+		if ( r ) r->SetDebugOrigin( true );
 
 		MP_VECTOR< micropather::StateCost > adj;
 		AdjacentCost( ToState( x, y ), &adj );
 		for( unsigned i=0; i<adj.size(); ++i ) {
 			WorldGrid* n = ToGrid( adj[i].state, 0 );
-			GLASSERT( n->DebugAdjacent() == false );
-			n->SetDebugAdjacent( true );
+			if ( n ) {
+				GLASSERT( n->DebugAdjacent() == false );
+				n->SetDebugAdjacent( true );
+			}
 		}
 	}
 }
@@ -1908,7 +2293,7 @@ void WorldMap::DrawZones()
 			if ( IsZoneOrigin( i, j ) ) {
 				if ( IsPassable( i, j ) ) {
 
-					const WorldGrid& gs = grid[INDEX(i,j)];
+					const WorldGrid& gs = grid.Get(INDEX(i,j));
 					Vector3F p0 = { (float)i+offset, 0.01f, (float)j+offset };
 					Vector3F p1 = { (float)(i+gs.ZoneSize())-offset, 0.01f, (float)(j+gs.ZoneSize())-offset };
 
@@ -1956,7 +2341,7 @@ void WorldMap::CreateTexture( Texture* t )
 
 		for( int y=0; y<t->Height(); ++y ) {
 			for( int x=0; x<t->Width(); ++x ) {
-				const WorldGrid& wg = grid[INDEX(x*dx,y*dy)];
+				const WorldGrid& wg = grid.Get(INDEX(x*dx,y*dy));
 				int index = y * t->Width() + x;
 				GLASSERT(index < size);
 				if (index < size) {
@@ -2080,7 +2465,7 @@ void WorldMap::PrepGrid( const SpaceTree* spaceTree )
 					break;
 				}
 
-				const WorldGrid& wg = grid[INDEX(x,y)];
+				const WorldGrid& wg = grid.Get(INDEX(x,y));
 				int rotation = 0;
 
 				if ( wg.Height() == 0 ) {
@@ -2227,7 +2612,7 @@ void WorldMap::PrepVoxels(const SpaceTree* spaceTree, grinliz::CDynArray<Model*>
 				float wall[4] = { -1, -1, -1, -1 };
 				float h = 0;
 				int id = ROCK;
-				const WorldGrid& wg = grid[INDEX(x,y)];
+				const WorldGrid& wg = grid.Get(INDEX(x,y));
 
 				if (wg.Plant()) {
 					Rectangle3F aabb;
@@ -2291,7 +2676,7 @@ void WorldMap::PrepVoxels(const SpaceTree* spaceTree, grinliz::CDynArray<Model*>
 					// duplicated in PushVoxel
 					static const Vector2I delta[4] = { {1,0}, {0,1}, {-1,0}, {0,-1} };
 					for( int k=0; k<4; ++k ) {
-						const WorldGrid& next = grid[INDEX(x+delta[k].x, y+delta[k].y)];
+						const WorldGrid& next = grid.Get(INDEX(x+delta[k].x, y+delta[k].y));
 						if (!next.IsFluid() && !next.Magma()) {
 							// draw wall or nothing.
 							if ( next.RockHeight() < wg.RockHeight() ) {
@@ -18,6 +18,8 @@
 
 #include "gamelimits.h"
 #include "worldgrid.h"
+#include "gridstore.h"
+#include "gridplanes.h"
 #include "sectorport.h"
 
 #include "../xegame/cticker.h"
@@ -33,7 +35,7 @@
 #include "../grinliz/glcontainer.h"
 #include "../grinliz/glmemorypool.h"
 #include "../grinliz/glbitarray.h"
-#include "../grinliz/glthreadpool.h"
+#include "../grinliz/gljobsystem.h"
 
 #include "../tinyxml2/tinyxml2.h"
 
@@ -49,9 +51,21 @@ class GameItem;
 class ChitContext;
 class PhysicsSims;
 class Chit;
+class PathQueue;
+class FlowFields;
 
 #define WORLDMAP_THREADS
 
+// A copy of the map, taken quickly, that can be compressed
+// and written out on another thread. See WorldMap::Snapshot().
+struct MapSnapshot {
+	MapSnapshot() : width(0), height(0) {}
+
+	int						width, height;
+	grinliz::CDynArray<U8>	header;		// size and WorldInfo stream
+	GridStore				grid;
+};
+
 /*
 	Remembering Y is up and we are in the xz plane:
 
@@ -83,6 +97,8 @@ class WorldMap : public Map,
 {
 	friend class FluidSim;
 	friend class CircuitSim;
+	friend class PathQueue;
+	friend class FlowFields;
 
 public:
 	WorldMap( int width, int height );
@@ -107,6 +123,15 @@ public:
 	void SavePNG( const char* path );
 	void Save( const char* filename );
 	void Load( const char* filename );
+	// Save() in two parts: the copy, and the (thread safe) write.
+	// 'baseID' identifies the full save a delta save goes with.
+	// With 'changed', the snapshot is kept from save to save: only
+	// the chunks written since are copied, and marked in 'changed'.
+	void Snapshot( MapSnapshot* snapshot, U32 baseID, bool delta, U8* changed=0 );
+	// Writes the map. If 'changed' (the chunks changed since the
+	// full save) is set, it's a delta save, and only those chunks
+	// are written.
+	static void WriteSnapshot( const MapSnapshot& snapshot, FILE* fp, const U8* changed=0 );
 
 	// Set the rock to h.
 	//		h= 1 to 3 rock
@@ -116,13 +141,13 @@ public:
 	void SetRock( int x, int y, int h, bool magma, int rockType );
 	void SetMagma( int x, int y, bool magma ) {
 		int index = INDEX( x, y );
-		WorldGrid wg = grid[index];
+		WorldGrid wg = grid.Get(index);
 		SetRock( x, y, wg.RockHeight(), magma, wg.RockType() );
 	}
 
 	void SetPave( int x, int y, int pave ) {
 		int index = INDEX(x,y);
-		const WorldGrid& wg = grid[index];
+		const WorldGrid& wg = grid.Get(index);
 		if ( wg.Land() == WorldGrid::LAND && wg.RockHeight() == 0 ) {
 			grid[index].SetPave(pave);
 		}
@@ -136,8 +161,11 @@ public:
 		grid[INDEX(x, y)].SetHP(hp);
 	}
 
-	const WorldGrid& GetWorldGrid(int x, int y) { return grid[INDEX(x, y)]; }
-	const WorldGrid& GetWorldGrid(const grinliz::Vector2I& p) { return grid[INDEX(p.x, p.y)]; }
+	// Reads never allocate a chunk, so these are safe on the parallel tick.
+	const WorldGrid& GetWorldGrid(int x, int y) const { return grid.Get(INDEX(x, y)); }
+	// Bit plane shadow of the grid, for fast scans.
+	const GridPlanes& Planes() const { return planes; }
+	const WorldGrid& GetWorldGrid(const grinliz::Vector2I& p) const { return grid.Get(INDEX(p.x, p.y)); }
 	// count: +x, +y, -x, -y
 	//	4 get neighbors
 	//	5 center & neighbors, center is at index 0
@@ -147,6 +175,9 @@ public:
 	void GetWorldGrid(const grinliz::Vector2I&p, WorldGrid* arr, int count, grinliz::Vector2I* dir );
 
 	void ResetPather( int x, int y );
+	// Frees a sector's pather and its cache. It is re-created
+	// when it is needed again.
+	void ReleasePather( const grinliz::Vector2I& sector );
 	// Updates the pathing for GRID_BLOCKED - external chits (MapSpatialComponents) that impact
 	// the pather. Works by doing a spatial query. Will automatically reset the pather if needed.
 	void UpdateBlock( int x, int y );
@@ -154,9 +185,9 @@ public:
 
 	bool IsPassable(int x, int y, bool ignoreBuildings = false) const;
 	
-	bool IsLand( int x, int y )		{ 
+	bool IsLand( int x, int y ) const	{ 
 		int i = INDEX(x,y);
-		return grid[i].IsLand(); 
+		return grid.Get(i).IsLand(); 
 	}
 	
 	// Call the pather; return true if successful.
@@ -172,6 +203,11 @@ public:
 						grinliz::Vector2F* bestEnd,
 						float* totalCost );
 
+	// Asynchronous version of CalcPath(), for the PathMoveComponents.
+	PathQueue* GetPathQueue() { return pathQueue; }
+	// Shared fields for many chits moving to the same place.
+	FlowFields* GetFlowFields() { return flowFields; }
+
 	// Uses the very fast straight line pather.
 	bool HasStraightPath( const grinliz::Vector2F& start, 
 						  const grinliz::Vector2F& end,
@@ -260,6 +296,9 @@ public:
 	bool IsShowingRegionOverlay() const							{ return debugRegionOverlay.Area() > 1; }
 	void ShowRegionOverlay( const grinliz::Rectangle2I& over )	{ debugRegionOverlay = over; }
 	void PatherCacheHitMiss( const grinliz::Vector2I& sector, micropather::CacheData* data );
+	void RegionPathCacheHitMiss(int* size, int* hit, int* miss) const {
+		*size = regionPaths.Size(); *hit = regionPathHit; *miss = regionPathMiss;
+	}
 	int CalcNumRegions();
 
 	// --- MetaData --- //
@@ -269,8 +308,8 @@ public:
 	const SectorData& GetSectorData( const grinliz::Vector2I& sector ) const;
 
 	// Find random land on the largest continent
-	grinliz::Color4U8 Pixel( int x, int y )	{ 
-		return grid[y*width+x].ToColor();
+	grinliz::Color4U8 Pixel( int x, int y ) const	{ 
+		return grid.Get(INDEX(x, y)).ToColor();
 	}
 
 	/* A 16x16 zone, needs 3 bits to describe the depth. From the depth
@@ -320,6 +359,8 @@ private:
 	} 
 
 	void Init( int w, int h );
+	// Reads the chunks of a delta save over the grid.
+	void LoadDelta( FILE* fp, int gridCodec );
 	void FreeVBOs();
 
 	void CalcZone( int x, int y );
@@ -344,17 +385,18 @@ private:
 	//	Grid path:		intermediate; a path checked by a step walk between points on the grid
 	//  State path:		the micropather computed region
 
-	bool GridPath(const grinliz::Vector2F& start, const grinliz::Vector2F& end, bool ignoreBuildings);
+	bool GridPath(const grinliz::Vector2F& start, const grinliz::Vector2F& end, bool ignoreBuildings) const;
 
 	grinliz::Vector2I ZoneOrigin( int x, int y ) const {
-		const WorldGrid& g = grid[INDEX(x,y)];
+		const WorldGrid& g = grid.Get(INDEX(x,y));
 		grinliz::Vector2I origin = g.ZoneOrigin( x, y );
 		return origin;
 	}
 
+	// Null if the zone origin's chunk doesn't exist.
 	WorldGrid* ZoneOriginG( int x, int y ) {
 		grinliz::Vector2I v = ZoneOrigin( x, y );
-		return &grid[INDEX(v)];
+		return grid.Find(INDEX(v));
 	}
 
 	bool IsZoneOrigin( int x, int y ) const {
@@ -364,7 +406,7 @@ private:
 
 	grinliz::Rectangle2F ZoneBounds( int x, int y ) const {
 		grinliz::Vector2I v = ZoneOrigin( x, y );
-		const WorldGrid& g = grid[INDEX(x,y)];
+		const WorldGrid& g = grid.Get(INDEX(x,y));
 		grinliz::Rectangle2F b;
 		b.min.Set( (float)v.x, (float)v.y );
 		int size = g.ZoneSize();
@@ -377,12 +419,19 @@ private:
 		return r.Center();
 	}
 
-	void* ToState( int x, int y ) {
+	void* ToState( int x, int y ) const {
 		grinliz::Vector2I v = ZoneOrigin( x, y );
 		return (void*)INDEX(v);
 	}
 
+	// Null if the state's chunk doesn't exist.
 	WorldGrid* ToGrid( void* state, grinliz::Vector2I* vec ) {
+		int v = (int)(intptr_t(state));
+		static_cast<const WorldMap*>(this)->ToGrid(state, vec);
+		return grid.Find(v);
+	}
+
+	const WorldGrid* ToGrid( void* state, grinliz::Vector2I* vec ) const {
 		int v = (int)(intptr_t(state));
 		int x = v & MAP_X_MASK;
 		int y = v >> MAP_Y_SHIFT;
@@ -392,9 +441,21 @@ private:
 		if ( vec ) {
 			vec->Set( x, y );
 		}
-		return &grid[INDEX(x, y)];
+		return &grid.Get(INDEX(x, y));
 	}
 
+	// The const parts of the micropather::Graph. The zones
+	// around the states must already be computed.
+	float ZoneDistance( void* stateStart, void* stateEnd ) const;
+	void AdjacentZones( void* state, MP_VECTOR< micropather::StateCost > *adjacent ) const;
+	// Computes the zones of a sector that aren't current.
+	void CalcSectorZones( const grinliz::Vector2I& sector );
+	// Connect the region path with vectors.
+	bool RegionsToPath( const MP_VECTOR< void* >& regions,
+						const grinliz::Vector2F& start,
+						const grinliz::Vector2F& end,
+						grinliz::CDynArray<grinliz::Vector2F>* path ) const;
+
 	void PushQuad( int layer, int x, int y, int w, int h, grinliz::CDynArray<PTVertex>* vertex, grinliz::CDynArray<U16>* index );
 	void PushVoxel( int id, float x, float y, float h, const float* walls );
 	Vertex* PushVoxelQuad( int id, const grinliz::Vector3F& normal );
@@ -417,11 +478,11 @@ private:
 		int n;
 		WorldMap* worldMap;
 	};
-#if defined(WORLDMAP_THREADS)
-	static int ScanEffects(void*, void*, void*, void*);
-#else
 	static int ScanEffects(ScanEffectsData* data);
-#endif
+	static void ScanEffectRange(ScanEffectsData* data, GridPlanes* planes, int first, int last, const grinliz::Rectangle2I& bounds);
+	static void ScanEffect(ScanEffectsData* data, GridPlanes* planes, int index, const grinliz::Rectangle2I& bounds);
+	// JobSystem entry: scans data[start, end)
+	static void ScanEffectsJob(void* data, int start, int end);
 	Engine*						engine;
 	IMapGridBlocked*			iMapGridUse;
 	PhysicsSims*				physics;
@@ -434,6 +495,37 @@ private:
 
 	micropather::MicroPather* GetPather(const grinliz::Vector2I& sector, bool createIfNeeded = true);
 
+	// Region path cache: the zone path between two zones, in front of
+	// the pathers. Each entry records the version of the zone blocks it
+	// passes through. ResetPather() only bumps the versions around the
+	// change, so only the paths through the changed zones get re-solved.
+	struct RegionPath {
+		float cost;
+		int offset;		// into regionPathStates
+		int count;
+	};
+	struct RegionPathState {
+		void* state;
+		U32 version;
+	};
+	class CompRegionPath {
+	public:
+		static U32 Hash(U64 v)						{ return U32(v) ^ (U32(v >> 32) * 2654435761U); }
+		static bool Equal(U64 v0, U64 v1)			{ return v0 == v1; }
+	};
+	enum {
+		MAX_REGION_PATHS = 4096,
+		MAX_REGION_PATH_STATES = 64*1024
+	};
+	U32& ZoneVersion(void* state) {
+		grinliz::Vector2I v;
+		ToGrid(state, &v);
+		return zoneVersion[ZDEX(v.x, v.y)];
+	}
+	bool FindRegionPath(void* start, void* end, MP_VECTOR<void*>* path, float* cost);
+	void AddRegionPath(void* start, void* end, const MP_VECTOR<void*>& path, float cost);
+	void ClearRegionPaths();
+
 	MP_VECTOR< void* >						pathRegions;
 	grinliz::CDynArray< grinliz::Vector2F >	debugPathVector;
 	grinliz::CDynArray< grinliz::Vector2F >	pathCache;
@@ -457,8 +549,10 @@ private:
 	grinliz::CDynArray< grinliz::Vector2I > magmaGrids;
 	grinliz::CDynArray< EffectRecord > effectCache;
 #ifdef WORLDMAP_THREADS
-	grinliz::CDynArray< EffectRecord > subEffectCache[grinliz::ThreadPool::NTHREAD];
-	grinliz::ThreadPool	threadPool;
+	// The map is scanned in a fixed number of slices, independent
+	// of the number of threads, so results are deterministic.
+	enum { NUM_EFFECT_SLICES = 16 };
+	grinliz::CDynArray< EffectRecord > subEffectCache[NUM_EFFECT_SLICES];
 #endif
 
 	// Memory pool of models to use for tree rendering.
@@ -466,9 +560,21 @@ private:
 	grinliz::BitArray< NUM_ZONES, NUM_ZONES, 1 > zoneInit;		// pather
 
 	micropather::MicroPather*	pathers[NUM_SECTORS_2];
-
-	// Big memory: the actual map.
-	WorldGrid grid[MAX_MAP_SIZE*MAX_MAP_SIZE];
+	PathQueue*					pathQueue;
+	FlowFields*					flowFields;
+	U32							zoneGeneration;				// bumped whenever any zone changes
+	bool						patherDirty[NUM_SECTORS_2];	// Reset() before the next solve
+
+	grinliz::HashTable< U64, int, CompRegionPath >	regionPathTable;
+	grinliz::CDynArray< RegionPath >				regionPaths;
+	grinliz::CDynArray< RegionPathState >			regionPathStates;
+	int												regionPathHit;
+	int												regionPathMiss;
+	U32												zoneVersion[NUM_ZONES*NUM_ZONES];
+
+	// Big memory: the actual map, allocated by sector.
+	GridStore grid;
+	GridPlanes planes;
 
 	// Temporary - big one - last in class
 	grinliz::CArray< Vertex, MAX_VOXEL_QUADS*4 > voxelBuffer;
@@ -0,0 +1,266 @@
+#include "gljobsystem.h"
+#include "glutil.h"
+
+using namespace grinliz;
+
+JobSystem* JobSystem::instance = 0;
+thread_local int JobSystem::workerIndex = -1;
+
+JobSystem::JobSystem(int nThreads) : nQueued(0), nextQueue(0), stop(false)
+{
+	if (nThreads <= 0) {
+		nThreads = (int)std::thread::hardware_concurrency();
+		if (nThreads <= 0) nThreads = 4;	// unknown; guess.
+	}
+	// The thread calling Wait() is also a worker.
+	nWorkers = Clamp(nThreads - 1, 1, (int)MAX_WORKERS);
+
+	for (int i = 0; i < nWorkers; ++i) {
+		threads[i] = std::thread([this, i] { this->WorkerMain(i); });
+	}
+}
+
+
+JobSystem::~JobSystem()
+{
+	{
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		stop = true;
+	}
+	sleepCondition.notify_all();
+	for (int i = 0; i < nWorkers; ++i) {
+		threads[i].join();
+	}
+	GLASSERT(nQueued == 0);
+	if (instance == this) instance = 0;
+}
+
+
+void JobSystem::Add(JobGroup* group, JOB_FUNC func, void* data, int start, int end, JobGroup* dependsOn)
+{
+	GLASSERT(group);
+	GLASSERT(group != dependsOn);
+	group->pending++;
+
+	Job job = { func, data, start, end, group };
+	if (dependsOn) {
+		std::unique_lock<std::mutex> lock(dependsOn->continuationMutex);
+		if (dependsOn->pending > 0) {
+			dependsOn->continuations.Push(job);
+			return;
+		}
+	}
+	Push(job);
+}
+
+
+void JobSystem::Push(const Job& job)
+{
+	// Workers push to their own queue, which keeps related
+	// work on the same thread. Everyone else spreads out.
+	int q = workerIndex;
+	if (q < 0) {
+		q = nWorkers;
+	}
+	{
+		std::unique_lock<std::mutex> lock(queues[q].mutex);
+		queues[q].jobs.Push(job);
+	}
+	nQueued++;
+	{
+		// Sync with the sleepers' predicate check, or the wakeup can be lost.
+		std::unique_lock<std::mutex> lock(sleepMutex);
+	}
+	sleepCondition.notify_one();
+}
+
+
+bool JobSystem::Pop(Job* job)
+{
+	int q = workerIndex >= 0 ? workerIndex : nWorkers;
+	Queue& queue = queues[q];
+	std::unique_lock<std::mutex> lock(queue.mutex);
+	if (queue.jobs.Size() > queue.head) {
+		// LIFO from our own queue: it is the warmest in cache.
+		*job = queue.jobs.Pop();
+		if (queue.jobs.Size() == queue.head) {
+			queue.jobs.Clear();
+			queue.head = 0;
+		}
+		nQueued--;
+		return true;
+	}
+	return false;
+}
+
+
+bool JobSystem::Steal(int thief, Job* job)
+{
+	// Start at a different queue each time so
+	// that thieves don't all line up on one victim.
+	int n = nWorkers + 1;
+	int start = int(nextQueue++ % U32(n));
+	for (int i = 0; i < n; ++i) {
+		int q = (start + i) % n;
+		if (q == thief) continue;
+
+		Queue& queue = queues[q];
+		std::unique_lock<std::mutex> lock(queue.mutex);
+		if (queue.jobs.Size() > queue.head) {
+			// FIFO when stealing: the oldest jobs are usually the biggest.
+			*job = queue.jobs[queue.head++];
+			if (queue.jobs.Size() == queue.head) {
+				queue.jobs.Clear();
+				queue.head = 0;
+			}
+			nQueued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void JobSystem::Run(const Job& job)
+{
+	job.func(job.data, job.start, job.end);
+
+	JobGroup* group = job.group;
+	CDynArray<Job> released;
+	bool finished = false;
+	{
+		// Hold the lock while decrementing so that Add() can't
+		// queue a continuation after the group finishes. Once
+		// the lock is released, the group may be gone.
+		std::unique_lock<std::mutex> lock(group->continuationMutex);
+		if (--group->pending == 0) {
+			finished = true;
+			for (int i = 0; i < group->continuations.Size(); ++i) {
+				released.Push(group->continuations[i]);
+			}
+			group->continuations.Clear();
+		}
+	}
+	for (int i = 0; i < released.Size(); ++i) {
+		Push(released[i]);
+	}
+	if (finished) {
+		// Someone may be sleeping in Wait() on this group.
+		{
+			std::unique_lock<std::mutex> lock(sleepMutex);
+		}
+		sleepCondition.notify_all();
+	}
+}
+
+
+void JobSystem::WorkerMain(int index)
+{
+	workerIndex = index;
+	for (;;) {
+		Job job;
+		if (Pop(&job) || Steal(index, &job)) {
+			Run(job);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepCondition.wait(lock, [this] {
+			return this->stop || this->nQueued > 0;
+		});
+		if (stop && nQueued == 0)
+			return;
+	}
+}
+
+
+void JobSystem::Wait(JobGroup* group)
+{
+	int self = workerIndex >= 0 ? workerIndex : nWorkers;
+	while (!group->Done()) {
+		Job job;
+		if (Pop(&job) || Steal(self, &job)) {
+			Run(job);
+			continue;
+		}
+		// Nothing to run: the group's last jobs are running elsewhere,
+		// or waiting on a dependency that is.
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepCondition.wait(lock, [this, group] {
+			return group->Done() || this->nQueued > 0;
+		});
+	}
+}
+
+
+void JobSystem::ParallelFor(int count, int grain, JOB_FUNC func, void* data)
+{
+	if (count <= 0) return;
+	if (grain <= 0) {
+		grain = Max(1, count / (NumThreads() * 4));
+	}
+	JobGroup group;
+	for (int start = 0; start < count; start += grain) {
+		Add(&group, func, data, start, Min(start + grain, count));
+	}
+	Wait(&group);
+}
+
+
+static void TestSum(void* data, int start, int end)
+{
+	std::atomic<int>* sum = (std::atomic<int>*)data;
+	for (int i = start; i < end; ++i) {
+		*sum += i;
+	}
+}
+
+
+static void TestOrder(void* data, int start, int)
+{
+	// Records the order the jobs ran in.
+	std::atomic<int>* slots = (std::atomic<int>*)data;
+	int order = slots[0]++;
+	slots[1 + start] = order;
+}
+
+
+void JobSystem::Test()
+{
+	{
+		// Empty:
+		JobSystem js;
+		JobGroup group;
+		js.Wait(&group);
+		js.ParallelFor(0, 0, TestSum, 0);
+	}
+	{
+		JobSystem js;
+		std::atomic<int> sum(0);
+		js.ParallelFor(1000, 0, TestSum, &sum);
+		GLASSERT(sum == 1000 * 999 / 2);
+		sum = 0;
+		js.ParallelFor(1000, 7, TestSum, &sum);
+		GLASSERT(sum == 1000 * 999 / 2);
+	}
+	{
+		// Dependencies: the 'b' jobs can't start until all the 'a' jobs are done.
+		JobSystem js(8);
+		static const int N = 16;
+		std::atomic<int> slots[1 + N * 2];
+		for (int i = 0; i < 1 + N * 2; ++i) slots[i] = 0;
+
+		JobGroup a, b;
+		for (int i = 0; i < N; ++i) {
+			js.Add(&a, TestOrder, slots, i);
+		}
+		for (int i = 0; i < N; ++i) {
+			js.Add(&b, TestOrder, slots, N + i, 0, &a);
+		}
+		js.Wait(&b);
+		GLASSERT(a.Done());
+		for (int i = 0; i < N; ++i) {
+			GLASSERT(slots[1 + N + i] >= N);
+		}
+	}
+	GLOUTPUT(("JobSystem::Test pass.\n"));
+}
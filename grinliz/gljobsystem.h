@@ -0,0 +1,117 @@
+#ifndef GRINLIZ_JOBSYSTEM
+#define GRINLIZ_JOBSYSTEM
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "glcontainer.h"
+
+namespace grinliz {
+
+class JobSystem;
+
+/*	A JobGroup counts the jobs that are still outstanding. Wait() on
+	a group to block until all of its jobs are done, or pass the group
+	as a dependency so that later jobs don't start until it completes.
+	A group can be re-used once it is idle.
+*/
+class JobGroup
+{
+	friend class JobSystem;
+public:
+	JobGroup() : pending(0) {}
+	~JobGroup() {
+		GLASSERT(pending == 0);
+		// The last job may still be releasing the lock.
+		std::unique_lock<std::mutex> lock(continuationMutex);
+	}
+
+	bool Done() const { return pending.load() == 0; }
+
+private:
+	JobGroup(const JobGroup&);		// not supported
+	void operator=(const JobGroup&);	// not supported
+
+	struct Job {
+		void(*func)(void*, int, int);
+		void* data;
+		int start;
+		int end;
+		JobGroup* group;
+	};
+
+	std::atomic<int> pending;
+	std::mutex continuationMutex;
+	CDynArray<Job> continuations;	// jobs waiting on this group
+};
+
+
+/*	Work stealing job system. There is a worker per hardware thread
+	(less the calling thread, which works while it waits.) Each worker
+	has its own queue; idle workers steal from the front of the other
+	queues. The job function is called with a [start, end) range so
+	that ParallelFor() doesn't need a job per item.
+
+	Jobs must not block on other jobs except through Wait(), which
+	runs jobs itself rather than sleeping.
+*/
+class JobSystem
+{
+public:
+	typedef void(*JOB_FUNC)(void* data, int start, int end);
+
+	// nThreads == 0 uses std::thread::hardware_concurrency()
+	JobSystem(int nThreads = 0);
+	~JobSystem();
+
+	static JobSystem* Instance() { if (!instance) instance = new JobSystem(); return instance; }
+
+	// Number of threads that do work, including the caller of Wait().
+	int NumThreads() const { return nWorkers + 1; }
+
+	// Queue a job. If 'dependsOn' is not null, the job will not
+	// start until every job in 'dependsOn' is done.
+	void Add(JobGroup* group, JOB_FUNC func, void* data, int start = 0, int end = 0, JobGroup* dependsOn = 0);
+
+	// Run jobs until the group is done.
+	void Wait(JobGroup* group);
+
+	// Call func(data, start, end) over [0, count) in chunks of at most
+	// 'grain' items, and wait for all of them. grain == 0 picks a chunk
+	// size that gives each thread a few chunks.
+	void ParallelFor(int count, int grain, JOB_FUNC func, void* data);
+
+	static void Test();
+
+private:
+	typedef JobGroup::Job Job;
+	enum { MAX_WORKERS = 64 };
+
+	struct Queue {
+		std::mutex mutex;
+		CDynArray<Job> jobs;
+		int head = 0;		// front of the queue; stolen from
+	};
+
+	void Push(const Job& job);
+	bool Pop(Job* job);
+	bool Steal(int thief, Job* job);
+	void Run(const Job& job);
+	void WorkerMain(int index);
+
+	static JobSystem* instance;
+	static thread_local int workerIndex;	// -1 if not a worker thread
+
+	int nWorkers;
+	std::thread threads[MAX_WORKERS];
+	Queue queues[MAX_WORKERS + 1];		// the last queue is for non-worker threads
+	std::atomic<int> nQueued;
+	std::atomic<U32> nextQueue;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+	bool stop;
+};
+
+};
+#endif // GRINLIZ_JOBSYSTEM
@@ -86,6 +86,23 @@ public:
 		return hits;
 	}
 
+	// Query() without the metrics: doesn't write to the
+	// hash, so it is safe to call from several threads.
+	int Find(const Vector2I& pos, CDynArray<V>* arr) const {
+		if (!buckets) return 0;
+		int hits = 0;
+		U32 h = Hash(pos) & (nBuckets - 1);
+		while (buckets[h].state != UNUSED) {
+			if (buckets[h].state == IN_USE && buckets[h].pos == pos) {
+				arr->Push(buckets[h].value);
+				++hits;
+			}
+			++h;
+			if (h == nBuckets) h = 0;
+		}
+		return hits;
+	}
+
 	bool Empty() const { return nItems == 0; }
 	int NumAllocated() const { return nBuckets; }
 	int NumItems() const { return nItems; }
@@ -100,7 +117,7 @@ public:
 
 private:
 
-	U32 Hash(const Vector2I& v) {
+	U32 Hash(const Vector2I& v) const {
 #if 0
 		// Base
 		GLASSERT(v.x >= 0 && v.y < 65536);		// will still work, but less efficient.
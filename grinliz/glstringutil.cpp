@@ -92,9 +92,9 @@ void GLString::append( const char* str )
 
 void GLString::append( const char* str, int n )
 {
-	int strSize = strlen( str );
-	if ( strSize > n )
-		strSize = n;
+	// Doesn't read past n: 'str' needn't be null terminated.
+	const char* end = (const char*) memchr( str, 0, n );
+	int strSize = end ? int( end - str ) : n;
 
 	ensureSize( strSize + size() );
 	if ( strSize )
@@ -433,6 +433,7 @@ IString StringPool::Get( const char* str, bool strIsStaticMem )
 	GLASSERT( strlen( str ) < BLOCK_SIZE-1 );
 
 	U32 hash = Random::Hash( str, U32(-1) ); 
+	std::lock_guard<std::mutex> lock( mutex );
 	
 	Node searchNode = { hash, 0 };
 	int search = nodes.BSearch(searchNode);
@@ -486,6 +487,7 @@ const char* StringPool::Add( const char* str )
 
 void StringPool::GetAllStrings( grinliz::CDynArray< const char* >* arr )
 {
+	std::lock_guard<std::mutex> lock( mutex );
 	arr->Clear();
 	arr->EnsureCap( nodes.Size() );
 	for( int i=0; i<nodes.Size(); ++i ) {
@@ -497,6 +499,7 @@ void StringPool::GetAllStrings( grinliz::CDynArray< const char* >* arr )
 
 void StringPool::GetAllStrings( grinliz::CDynArray< IString >* arr )
 {
+	std::lock_guard<std::mutex> lock( mutex );
 	arr->Clear();
 	arr->EnsureCap( nodes.Size() );
 	for( int i=0; i<nodes.Size(); ++i ) {
@@ -35,6 +35,7 @@ distribution.
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <mutex>
 
 #include "gldebug.h"
 #include "gltypes.h"
@@ -377,6 +378,7 @@ private:
 	*/
 	SortedDynArray<Node, ValueSem, CompValueNode> nodes;
 	Block* root;
+	std::mutex mutex;	// Get() can be called from the loader and sim threads
 
 	int nBlocks;
 };
@@ -2,6 +2,7 @@ sources :=  glcontainer.cpp \
 			gldebug.cpp \
 			glfixed.cpp \
 			glgeometry.cpp \
+			gljobsystem.cpp \
 			glmatrix.cpp \
 			glmemorypool.cpp \
 			glperformance.cpp \
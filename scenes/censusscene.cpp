@@ -55,8 +55,8 @@ CensusScene::CensusScene( LumosGame* game, CensusSceneData* d ) : Scene( game ),
 	simStr.AppendFormat("\n\nDomains\n\n");
 
 	CDynArray<Census::MOBItem> domains;
-	for (int j = 0; j < NUM_SECTORS; j++) {
-		for (int i = 0; i < NUM_SECTORS; i++) {
+	for (int j = 0; j < NumSectors(); j++) {
+		for (int i = 0; i < NumSectors(); i++) {
 			Vector2I sector = { i, j };
 			CoreScript* cs = CoreScript::GetCore(sector);
 			if (cs && cs->ParentChit()->Team()) {
@@ -93,8 +93,8 @@ CensusScene::CensusScene( LumosGame* game, CensusSceneData* d ) : Scene( game ),
 	GLString domainStr;
 	CDynArray<int> subTeamArr;
 
-	for (int j = 0; j < NUM_SECTORS; ++j) {
-		for (int i = 0; i < NUM_SECTORS; ++i) {
+	for (int j = 0; j < NumSectors(); ++j) {
+		for (int i = 0; i < NumSectors(); ++i) {
 			Vector2I sector = { i, j };
 			CoreScript* cs = CoreScript::GetCore(sector);
 			if (cs && cs->InUse()) {
@@ -326,7 +326,7 @@ void CensusScene::DoLayout(bool first)
 	if (first) {
 		GLString debug;
 
-		debug.AppendFormat("Allocated:\tAu=%d Green=%d Red=%d Blue=%d Violet=%d\n", ALL_GOLD, ALL_CRYSTAL_GREEN, ALL_CRYSTAL_RED, ALL_CRYSTAL_BLUE, ALL_CRYSTAL_VIOLET);
+		debug.AppendFormat("Allocated:\tAu=%d Green=%d Red=%d Blue=%d Violet=%d\n", AllGold(), AllCrystalGreen(), AllCrystalRed(), AllCrystalBlue(), AllCrystalViolet());
 		debug.AppendFormat("InPlay:\tAu=%d Green=%d Red=%d Blue=%d Violet=%d\n", allWallet.Gold(), allWallet.Crystal(0), allWallet.Crystal(1), allWallet.Crystal(2), allWallet.Crystal(3));
 		debug.AppendFormat("InReserve:\tAu=%d Green=%d Red=%d Blue=%d Violet=%d\n", reserveWallet.Gold(), reserveWallet.Crystal(1), reserveWallet.Crystal(1), reserveWallet.Crystal(2), reserveWallet.Crystal(3));
 		debug.AppendFormat("Total:\tAu=%d Green=%d Red=%d Blue=%d Violet=%d\n",
@@ -69,6 +69,8 @@ GameScene::GameScene( LumosGame* game ) : Scene( game )
 	domainWarningTimer = 0;
 	poolView = 0;
 	paused = false;
+	autoSaveTicker.SetPeriod(5 * 60 * 1000);
+	autoSaveTicker.Reset();
 	attached.Zero();
 	voxelInfoID.Zero();
 	mapDragStart.Zero();
@@ -1557,7 +1559,7 @@ void GameScene::TeleportAllEnemies(const grinliz::Vector2I& sector, int team)
 	Rectangle2F bounds = ToWorld2F(InnerSectorBounds(sector));
 	sim->GetChitBag()->QuerySpatialHash(&arr, bounds, 0, &filter);
 
-	static const Vector2I MC_SECTOR = { MOTHER_CORE_SECTOR_X, MOTHER_CORE_SECTOR_Y };
+	const Vector2I MC_SECTOR = { NumSectors() / 2, NumSectors() / 2 };
 
 	for (int i = 0; i<arr.Size(); ++i) {
 		IString mob = arr[i]->GetItem()->keyValues.GetIString(ISC::mob);
@@ -1574,6 +1576,10 @@ void GameScene::DoTick(U32 delta)
 
 	if (!paused) {
 		sim->DoTick(delta);
+		if (autoSaveTicker.Delta(delta)) {
+			// Skipped (and retried next period) if the previous save is still writing.
+			sim->SaveInBackground(game->GamePath("map", 0, "dat"), game->GamePath("game", 0, "dat"));
+		}
 	}
 	menu->DoTick(GetHomeCore(), buildingCounts, BuildScript::NUM_PLAYER_OPTIONS);
 
@@ -1906,7 +1912,7 @@ void GameScene::CheckGameStage(U32 delta)
 		random.SetSeedFromTime();
 
 		b.min.y = b.min.x = 0;
-		b.max.y = b.max.x = NUM_SECTORS - 1;
+		b.max.y = b.max.x = NumSectors() - 1;
 
 		CArray<SectorInfo, NUM_SECTORS_2> arr;
 
@@ -2075,6 +2081,11 @@ void GameScene::DrawDebugText()
 				  cacheData.hitFraction);
 	y += 16;
 
+	int nRegionPaths = 0, regionHit = 0, regionMiss = 0;
+	sim->GetWorldMap()->RegionPathCacheHitMiss(&nRegionPaths, &regionHit, &regionMiss);
+	ufoText->Draw(x, y, "Region paths n=%d h:m=%d:%d", nRegionPaths, regionHit, regionMiss);
+	y += 16;
+
 	Chit* info = sim->GetChitBag()->GetChit(infoID);
 	if (info) {
 		GLString str;
@@ -19,6 +19,7 @@
 #include "../xegame/scene.h"
 #include "../xegame/chitevent.h"
 #include "../xegame/chit.h"
+#include "../xegame/cticker.h"
 
 #include "../game/newsconsole.h"
 #include "../game/workqueue.h"
@@ -170,6 +171,7 @@ private:
 	Sim*				sim;
 	int					endTimer;
 	bool				paused;
+	CTicker				autoSaveTicker;	// autosave runs on a background thread; see Sim::SaveInBackground
 	grinliz::Vector2I	attached;
 	int					targetChit;
 	int					possibleChit;
@@ -93,7 +93,7 @@ MapScene::MapScene( LumosGame* game, MapSceneData* data ) : Scene( game ), lumos
 		unitMarker[i].Init(&gamui2D, unitAtom, true);
 	}
 
-	for (int i = 1; i < NUM_SECTORS; ++i) {
+	for (int i = 1; i < NumSectors(); ++i) {
 		numbers[i].Init(&gamui2D);
 		letters[i].Init(&gamui2D);
 		CStr<16> str;
@@ -173,23 +173,23 @@ void MapScene::Resize()
 			squadMark[i][k].SetSize(SQUAD_MARK_SIZE, SQUAD_MARK_SIZE);
 		}
 	}
-//	travelMark.SetSize(dx / float(NUM_SECTORS), dy / float(NUM_SECTORS));
-	homeMark[0].SetSize(dx / float(NUM_SECTORS), dy / float(NUM_SECTORS));
+//	travelMark.SetSize(dx / float(NumSectors()), dy / float(NumSectors()));
+	homeMark[0].SetSize(dx / float(NumSectors()), dy / float(NumSectors()));
 	homeMark[1].SetSize(dx / float(MAP2_SIZE), dy / float(MAP2_SIZE));
-	selectionMark.SetSize(float(MAP2_SIZE) * dx / float(NUM_SECTORS), float(MAP2_SIZE) *dx / float(NUM_SECTORS));
+	selectionMark.SetSize(float(MAP2_SIZE) * dx / float(NumSectors()), float(MAP2_SIZE) *dx / float(NumSectors()));
 
 	webCanvas.SetPos(mapImage.X(), mapImage.Y());
 
-	for (int i = 0; i < NUM_SECTORS; ++i) {
+	for (int i = 0; i < NumSectors(); ++i) {
 		float dx = gamui2D.TextHeightVirtual() * 0.5f;
 		float dy = gamui2D.TextHeightVirtual() * 0.5f;
 
-		float x = dx + mapImage.X() + mapImage.Width() * i / NUM_SECTORS;
+		float x = dx + mapImage.X() + mapImage.Width() * i / NumSectors();
 		float y = dy + mapImage.Y();
 		letters[i].SetPos(x, y);
 
 		x = dx + mapImage.X();
-		y = dy + mapImage.Y() + mapImage.Height() * i / NUM_SECTORS;
+		y = dy + mapImage.Y() + mapImage.Height() * i / NumSectors();
 		numbers[i].SetPos(x, y);
 	}
 
@@ -205,13 +205,13 @@ Rectangle2I MapScene::MapBounds2()
 		subOrigin = lumosChitBag->GetHomeSector();
 	}
 	if (subOrigin.IsZero()) {
-		subOrigin.Set(NUM_SECTORS / 2, NUM_SECTORS / 2);
+		subOrigin.Set(NumSectors() / 2, NumSectors() / 2);
 	}
 
 	if ( subOrigin.x < MAP2_RAD )					subOrigin.x = MAP2_RAD;
 	if ( subOrigin.y < MAP2_RAD )					subOrigin.y = MAP2_RAD;
-	if ( subOrigin.x >= NUM_SECTORS - MAP2_RAD )	subOrigin.x = NUM_SECTORS - MAP2_RAD - 1;
-	if ( subOrigin.y >= NUM_SECTORS - MAP2_RAD )	subOrigin.y = NUM_SECTORS - MAP2_RAD - 1;
+	if ( subOrigin.x >= NumSectors() - MAP2_RAD )	subOrigin.x = NumSectors() - MAP2_RAD - 1;
+	if ( subOrigin.y >= NumSectors() - MAP2_RAD )	subOrigin.y = NumSectors() - MAP2_RAD - 1;
 	Rectangle2I subBounds;
 	subBounds.min = subBounds.max = subOrigin;
 	subBounds.Outset(MAP2_RAD);
@@ -258,13 +258,13 @@ void MapScene::DrawMap()
 	const Web& web = lumosChitBag->GetSim()->CalcWeb();
 
 	Rectangle2I subBounds = MapBounds2();
-	float map2X = float(subBounds.min.x) / float(NUM_SECTORS);
-	float map2Y = float(subBounds.min.y) / float(NUM_SECTORS);
+	float map2X = float(subBounds.min.x) / float(NumSectors());
+	float map2Y = float(subBounds.min.y) / float(NumSectors());
 	RenderAtom subAtom = mapImage.GetRenderAtom();
 	subAtom.tx0 = map2X;
 	subAtom.ty1 = map2Y;
-	subAtom.tx1 = map2X + float(MAP2_SIZE) / float(NUM_SECTORS);
-	subAtom.ty0 = map2Y + float(MAP2_SIZE) / float(NUM_SECTORS);
+	subAtom.tx1 = map2X + float(MAP2_SIZE) / float(NumSectors());
+	subAtom.ty0 = map2Y + float(MAP2_SIZE) / float(NumSectors());
 	mapImage2.SetAtom(subAtom);
 
 	for (Rectangle2IIterator it(subBounds); !it.Done(); it.Next()) {
@@ -317,10 +317,10 @@ void MapScene::DrawMap()
 		playerPos = ToWorld2F(player->Position());
 	}
 
-	const float dx = mapImage.Width() / float(NUM_SECTORS);
-	const float dy = mapImage.Height() / float(NUM_SECTORS);
-	for (int j = 0; j < NUM_SECTORS; ++j) {
-		for (int i = 0; i < NUM_SECTORS; ++i) {
+	const float dx = mapImage.Width() / float(NumSectors());
+	const float dy = mapImage.Height() / float(NumSectors());
+	for (int j = 0; j < NumSectors(); ++j) {
+		for (int i = 0; i < NumSectors(); ++i) {
 			diplomacy[j*NUM_SECTORS + i].SetSize(dx, dy);
 			diplomacy[j*NUM_SECTORS + i].SetPos(mapImage.X() + dx * float(i), mapImage.Y() + dy * float(j));
 		}
@@ -359,7 +359,7 @@ void MapScene::DrawMap()
 		selectionMark.SetPos(pos.x, pos.y);
 	}
 
-	float scale = float(mapImage.Width()) / float(NUM_SECTORS);
+	float scale = float(mapImage.Width()) / float(NumSectors());
 	{
 		webCanvas.Clear();
 
@@ -391,8 +391,8 @@ void MapScene::DrawMap()
 		}
 	}
 
-	for (int j = 0; j < NUM_SECTORS; ++j) {
-		for (int i = 0; i < NUM_SECTORS; ++i) {
+	for (int j = 0; j < NumSectors(); ++j) {
+		for (int i = 0; i < NumSectors(); ++i) {
 			diplomacy[i].SetAtom(RenderAtom());
 
 			Vector2I sector = { i, j };
@@ -441,8 +441,8 @@ void MapScene::ItemTapped(const gamui::UIItem* item)
 	else if (item == &mapImage) {
 		float x = 0, y = 0;
 		gamui2D.GetRelativeTap(&x, &y);
-		sector.x = int(x * float(NUM_SECTORS));
-		sector.y = int(y * float(NUM_SECTORS));
+		sector.x = int(x * float(NumSectors()));
+		sector.y = int(y * float(NumSectors()));
 		data->destSector = sector;
 		DrawMap();
 		EnableButtons();
@@ -17,6 +17,7 @@
 
 #include "../game/lumosgame.h"
 #include "../game/worldmap.h"
+#include "../game/pathqueue.h"
 #include "../game/mapspatialcomponent.h"
 #include "../game/gamelimits.h"
 #include "../game/pathmovecomponent.h"
@@ -249,6 +250,7 @@ void NavTest2Scene::ItemTapped( const gamui::UIItem* item )
 
 void NavTest2Scene::DoTick( U32 deltaTime )
 {
+	context.worldMap->GetPathQueue()->DoTick();
 	context.chitBag->DoTick( deltaTime );
 	++creationTick;
 	DoCheck();
@@ -28,6 +28,7 @@
 
 #include "../game/lumosgame.h"
 #include "../game/worldmap.h"
+#include "../game/pathqueue.h"
 #include "../game/pathmovecomponent.h"
 #include "../game/debugpathcomponent.h"
 #include "../game/lumoschitbag.h"
@@ -249,6 +250,7 @@ void NavTestScene::ItemTapped( const gamui::UIItem* item )
 
 void NavTestScene::DoTick( U32 deltaTime )
 {
+	context.worldMap->GetPathQueue()->DoTick();
 	context.chitBag->DoTick( deltaTime );
 }
 
@@ -27,16 +27,19 @@ WorldGenScene::WorldGenScene(LumosGame* game) : Scene(game)
 	InitStd(&gamui2D, &okay, &cancel);
 	sim = 0;
 
-	worldMap = new WorldMap(MAX_MAP_SIZE, MAX_MAP_SIZE);
+	// The size is picked here, and then carried by the map file.
+	mapSize = SettingsManager::Instance()->MapSize();
+	SetMapSize(mapSize);
+	worldMap = new WorldMap(mapSize, mapSize);
 	pix16 = 0;
 
 	TextureManager* texman = TextureManager::Instance();
-	texman->CreateTexture("worldGenPreview", MAX_MAP_SIZE, MAX_MAP_SIZE, TEX_RGB16, Texture::PARAM_NONE, this);
+	texman->CreateTexture("worldGenPreview", mapSize, mapSize, TEX_RGB16, Texture::PARAM_NONE, this);
 
-	worldGen = new WorldGen();
+	worldGen = new WorldGen(mapSize);
 	worldGen->LoadFeatures("./res/features.png");
 
-	rockGen = new RockGen(MAX_MAP_SIZE);
+	rockGen = new RockGen(mapSize);
 
 	RenderAtom atom((const void*)UIRenderer::RENDERSTATE_UI_NORMAL_OPAQUE, texman->GetTexture("worldGenPreview"),
 					0, 1, 1, 0);	// y-flip: image to texture coordinate conversion
@@ -101,10 +104,10 @@ void WorldGenScene::Resize()
 
 	debugFPS = SettingsManager::Instance()->DebugFPS();
 
-	for (int j = 0; j < NUM_SECTORS; ++j) {
-		for (int i = 0; i < NUM_SECTORS; ++i) {
-			const float dx = worldImage.Width() / float(NUM_SECTORS);
-			const float dy = worldImage.Height() / float(NUM_SECTORS);
+	for (int j = 0; j < NumSectors(); ++j) {
+		for (int i = 0; i < NumSectors(); ++i) {
+			const float dx = worldImage.Width() / float(NumSectors());
+			const float dy = worldImage.Height() / float(NumSectors());
 			gridWidget[j*NUM_SECTORS + i].SetSize(dx, dy);
 			gridWidget[j*NUM_SECTORS + i].SetPos(worldImage.X() + dx * float(i), worldImage.Y() + dy * float(j));
 		}
@@ -148,18 +151,18 @@ void WorldGenScene::CreateTexture(Texture* t)
 	if (StrEqual(t->Name(), "worldGenPreview")) {
 
 		if (!pix16) {
-			pix16 = new U16[MAX_MAP_SIZE_2];
+			pix16 = new U16[mapSize*mapSize];
 		}
 		// Must also set SectorData, which is done elsewhere.
 		worldMap->MapInit(worldGen->Land(), worldGen->Path());
 
 		int i = 0;
-		for (int y = 0; y < MAX_MAP_SIZE; ++y) {
-			for (int x = 0; x < MAX_MAP_SIZE; ++x) {
+		for (int y = 0; y < mapSize; ++y) {
+			for (int x = 0; x < mapSize; ++x) {
 				pix16[i++] = Surface::CalcRGB16(worldMap->Pixel(x, y));
 			}
 		}
-		t->Upload(pix16, MAX_MAP_SIZE_2*sizeof(U16));
+		t->Upload(pix16, mapSize*mapSize*sizeof(U16));
 	}
 	else {
 		GLASSERT(0);
@@ -169,9 +172,9 @@ void WorldGenScene::CreateTexture(Texture* t)
 
 void WorldGenScene::BlendLine(int y)
 {
-	for (int x = 0; x < MAX_MAP_SIZE; ++x) {
-		int h = *(worldGen->Land() + y*MAX_MAP_SIZE + x);
-		int r = *(rockGen->Height() + y*MAX_MAP_SIZE + x);
+	for (int x = 0; x < mapSize; ++x) {
+		int h = *(worldGen->Land() + y*mapSize + x);
+		int r = *(rockGen->Height() + y*mapSize + x);
 
 		if (h >= WorldGen::LAND0 && h <= WorldGen::LAND3) {
 			if (r) {
@@ -249,18 +252,18 @@ void WorldGenScene::DoTick(U32 delta)
 
 			clock_t start = clock();
 			if (clock() - start < CLOCK_MSEC(30)) {
-				while (genState.y < MAX_MAP_SIZE) {
+				while (genState.y < mapSize) {
 					for (int i = 0; i < 16; ++i) {
 						worldGen->DoLandAndWater(genState.y++);
 					}
 				}
 			}
 			CStr<32> str;
-			str.Format("Stage 1/3 Land: %d%%", (int)(100.0f*(float)genState.y / (float)MAX_MAP_SIZE));
+			str.Format("Stage 1/3 Land: %d%%", (int)(100.0f*(float)genState.y / (float)mapSize));
 			footerText.SetText(str.c_str());
 			GLString name;
 
-			if (genState.y == MAX_MAP_SIZE) {
+			if (genState.y == mapSize) {
 				SetMapBright(true);
 				bool okay = worldGen->EndLandAndWater(0.4f);
 				if (okay) {
@@ -276,8 +279,8 @@ void WorldGenScene::DoTick(U32 delta)
 					GLString postfix;
 
 //					const gamedb::Reader* database = game->GetDatabase();
-					for (int j = 0; j < NUM_SECTORS; ++j) {
-						for (int i = 0; i < NUM_SECTORS; ++i) {
+					for (int j = 0; j < NumSectors(); ++j) {
+						for (int i = 0; i < NumSectors(); ++i) {
 							name = "sector";
 							// Keep the names a little short, so that they don't overflow UI.
 							/*
@@ -319,24 +322,24 @@ void WorldGenScene::DoTick(U32 delta)
 		case GenState::ROCKGEN:
 		{
 			clock_t start = clock();
-			while ((genState.y < MAX_MAP_SIZE) && (clock() - start < CLOCK_MSEC(30))) {
+			while ((genState.y < mapSize) && (clock() - start < CLOCK_MSEC(30))) {
 				for (int i = 0; i < 16; ++i) {
 					rockGen->DoCalc(genState.y);
 					genState.y++;
 				}
 			}
 			CStr<32> str;
-			str.Format("Stage 2/3 Rock: %d%%", (int)(100.0f*(float)genState.y / (float)MAX_MAP_SIZE));
+			str.Format("Stage 2/3 Rock: %d%%", (int)(100.0f*(float)genState.y / (float)mapSize));
 			footerText.SetText(str.c_str());
 
-			if (genState.y == MAX_MAP_SIZE) {
+			if (genState.y == mapSize) {
 				rockGen->EndCalc();
 
 				Random random;
 				random.SetSeedFromTime();
 
 				rockGen->DoThreshold(random.Rand(), 0.35f, RockGen::NOISE_HEIGHT);
-				for (int y = 0; y < MAX_MAP_SIZE; ++y) {
+				for (int y = 0; y < mapSize; ++y) {
 					BlendLine(y);
 				}
 				sendTexture = true;
@@ -445,8 +448,8 @@ void WorldGenScene::DoTick(U32 delta)
 			str.Format("Stage 3/3 Simulation: %1.f%%", 100.0f * age);
 			footerText.SetText(str.c_str());
 
-			for (int j = 0; j < NUM_SECTORS; ++j) {
-				for (int i = 0; i < NUM_SECTORS; ++i) {
+			for (int j = 0; j < NumSectors(); ++j) {
+				for (int i = 0; i < NumSectors(); ++i) {
 					Vector2I sector = { i, j };
 					CoreScript* cs = CoreScript::GetCore(sector);
 					// FIXME: don't need the sim->GetWeb() call. Here to force
@@ -60,6 +60,7 @@ private:
 	RockGen*	rockGen;
 	WorldMap*	worldMap;
 	U16*		pix16;
+	int			mapSize;
 	bool		plantsSeeded = false;
 
 	struct GenState {
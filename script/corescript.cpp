@@ -198,6 +198,7 @@ void CoreScript::OnChitMsg(Chit* chit, const ChitMsg& msg)
 			if (citizen && citizen->GetItem()) {
 				// Set to rogue team.
 				citizen->GetItem()->SetRogue();
+				Context()->chitBag->UpdateSpatialFlags(citizen);
 			}
 		}
 
@@ -411,6 +412,7 @@ void CoreScript::AddCitizen( Chit* chit )
 	GLASSERT(Team::IsRogue(chit->Team()) || (chit->Team() == ParentChit()->Team()));
 
 	chit->GetItem()->SetTeam(ParentChit()->Team());
+	Context()->chitBag->UpdateSpatialFlags(chit);
 	citizens.Push( chit->ID() );
 	AssignToSquads();
 }
@@ -766,7 +768,7 @@ void CoreScript::DoTickNeutral( int delta, int nSpawnTicks )
 	int typical = 0;
 	int numOf = census.NumOf(defaultSpawn, &typical);
 
-	bool lesserPossible = (lesser < TYPICAL_LESSER) && (!typical || numOf < typical * 2);
+	bool lesserPossible = (lesser < TypicalLesser()) && (!typical || numOf < typical * 2);
 
 	Vector2I pos2i = ToWorld2I(parentChit->Position());
 	Vector2I sector = ToSector(pos2i);
@@ -1021,6 +1023,7 @@ CoreScript* CoreScript::CreateCore( const Vector2I& sector, int team, const Chit
 				Chit* c = buildings[i];
 				if (c->GetItem() && c->GetItem()->IName() != ISC::core) {
 					c->GetItem()->SetTeam(team);
+					context->chitBag->UpdateSpatialFlags(c);
 				}
 			}
 		}
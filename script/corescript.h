@@ -133,8 +133,8 @@ public:
 	bool HasTask(const grinliz::Vector2I& pos2i);
 
 	static CoreScript* GetCore(const grinliz::Vector2I& sector) { 
-		GLASSERT(sector.x >= 0 && sector.x < NUM_SECTORS);
-		GLASSERT(sector.y >= 0 && sector.y < NUM_SECTORS);
+		GLASSERT(sector.x >= 0 && sector.x < NumSectors());
+		GLASSERT(sector.y >= 0 && sector.y < NumSectors());
 		return coreArr[sector.y*NUM_SECTORS + sector.x]; 
 	}
 
@@ -28,6 +28,7 @@ public:
 
 	virtual void Serialize( XStream* xs );
 	virtual int DoTick( U32 delta );
+	virtual bool ParallelTickSafe() const { return true; }	// DeRez() only touches this chit
 	virtual const char* Name() const { return "CountDownScript"; }
 
 private:
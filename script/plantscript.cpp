@@ -99,8 +99,11 @@ void PlantScript::DoTick(U32 delta)
 		int x = IndexToMapX(index);
 		int y = IndexToMapY(index);
 
+		// Most of the map is bare; check the plant plane
+		// before pulling the WorldGrid into cache.
+		if (!worldMap->Planes().Test(GridPlanes::PLANT, x, y)) continue;
 		const WorldGrid& wg = worldMap->GetWorldGrid(x, y);
-		if (!wg.Plant()) continue;
+		GLASSERT(wg.Plant());
 
 		Vector2I pos2i = { x, y };
 		Vector2F pos2f = ToWorld2F(pos2i);
@@ -41,13 +41,14 @@ void SectorData::Serialize(XStream* xs)
 }
 
 
-WorldGen::WorldGen()
+WorldGen::WorldGen( int _size ) : size(_size), nSectors(_size / SECTOR_SIZE)
 {
-	land = new U8[MAX_MAP_SIZE_2];
-	memset(land, 0, MAX_MAP_SIZE_2*sizeof(*land));
-	color = new U16[MAX_MAP_SIZE_2];
-	path = new U16[MAX_MAP_SIZE_2];
-	memset(path, 0, sizeof(*path)*MAX_MAP_SIZE_2);
+	GLASSERT(size > 0 && size <= MAX_MAP_SIZE);
+	land = new U8[size*size];
+	memset(land, 0, size*size*sizeof(*land));
+	color = new U16[size*size];
+	path = new U16[size*size];
+	memset(path, 0, sizeof(*path)*size*size);
 	flixels = 0;
 	noise0 = 0;
 	noise1 = 0;
@@ -74,7 +75,7 @@ void WorldGen::LoadFeatures( const char* path )
 
 void WorldGen::StartLandAndWater( U32 seed0, U32 seed1 )
 {
-	flixels = new float[MAX_MAP_SIZE*MAX_MAP_SIZE];
+	flixels = new float[size*size];
 
 	noise0 = new PerlinNoise( seed0 );
 	noise1 = new PerlinNoise( seed1 );
@@ -83,10 +84,10 @@ void WorldGen::StartLandAndWater( U32 seed0, U32 seed1 )
 
 void WorldGen::DoLandAndWater(int j)
 {
-	GLASSERT(j >= 0 && j < MAX_MAP_SIZE);
-	for (int i = 0; i < MAX_MAP_SIZE; ++i) {
-		float nx = (float)i / (float)MAX_MAP_SIZE;
-		float ny = (float)j / (float)MAX_MAP_SIZE;
+	GLASSERT(j >= 0 && j < size);
+	for (int i = 0; i < size; ++i) {
+		float nx = (float)i / (float)size;
+		float ny = (float)j / (float)size;
 
 		// Noise layer.
 		float n0 = noise0->Noise2(BASE0*nx, BASE0*ny);
@@ -101,7 +102,7 @@ void WorldGen::DoLandAndWater(int j)
 		dEdge = Min(ny, 1.0f - ny);
 		if (dEdge < EDGE)		n = Lerp(0.f, n, dEdge / EDGE);
 
-		flixels[j*MAX_MAP_SIZE + i] = n;
+		flixels[j*size + i] = n;
 	}
 }
 
@@ -109,11 +110,11 @@ void WorldGen::DoLandAndWater(int j)
 bool WorldGen::EndLandAndWater( float fractionLand )
 {
 	float cutoff = fractionLand;
-	int target = (int)((float)(MAX_MAP_SIZE*MAX_MAP_SIZE)*fractionLand);
+	int target = (int)((float)(size*size)*fractionLand);
 	float high = 1.0f;
 	int highCount = 0;
 	float low = 0.0f;
-	int lowCount = MAX_MAP_SIZE*MAX_MAP_SIZE;
+	int lowCount = size*size;
 	int iteration=0;
 	static const int MAX_ITERATION = 10;
 	float maxh = 1.0f;
@@ -136,17 +137,17 @@ bool WorldGen::EndLandAndWater( float fractionLand )
 		++iteration;
 	}
 
-	for( int j=0; j<MAX_MAP_SIZE; ++j ) {
-		for( int i=0; i<MAX_MAP_SIZE; ++i ) {
-			if ( flixels[j*MAX_MAP_SIZE+i] > cutoff ) {
-				float flix = (flixels[j*MAX_MAP_SIZE+i] - cutoff) / (maxh-cutoff);
+	for( int j=0; j<size; ++j ) {
+		for( int i=0; i<size; ++i ) {
+			if ( flixels[j*size+i] > cutoff ) {
+				float flix = (flixels[j*size+i] - cutoff) / (maxh-cutoff);
 				GLASSERT( flix >= 0 && flix <= 1 );
 				int h = LAND0 + (int)(flix*3.5f);
 				GLASSERT( h > 0 && h <= 4 );
-				land[j*MAX_MAP_SIZE+i] = h;
+				land[j*size+i] = h;
 			}
 			else {
-				land[j*MAX_MAP_SIZE+i] = 0;
+				land[j*size+i] = 0;
 			}
 		}
 	}
@@ -164,10 +165,10 @@ void WorldGen::WriteMarker()
 	for ( int y=0; y<S; ++y ) {
 		for( int x=0; x<S; ++x ) {
 			if ( y==0 || y==(S-1) || x==0 || x==(S-1) ) {
-				land[y*MAX_MAP_SIZE+x] = 0;
+				land[y*size+x] = 0;
 			}
 			else {
-				land[y*MAX_MAP_SIZE+x] = 1;
+				land[y*size+x] = 1;
 			}
 		}
 	}
@@ -178,9 +179,9 @@ int WorldGen::CountFlixelsAboveCutoff( const float* flixels, float cutoff, float
 {
 	int count = 0;
 	*maxh = 0.0f;
-	for( int j=0; j<MAX_MAP_SIZE; ++j ) {
-		for( int i=0; i<MAX_MAP_SIZE; ++i ) {
-			float f = flixels[j*MAX_MAP_SIZE+i];
+	for( int j=0; j<size; ++j ) {
+		for( int i=0; i<size; ++i ) {
+			float f = flixels[j*size+i];
 			if ( f > cutoff ) {
 				++count;
 				if ( f > *maxh ) *maxh = f;
@@ -217,7 +218,7 @@ int WorldGen::Color( const Rectangle2I& bounds, const Vector2I& origin )
 	int c = 1;
 	CDynArray<Vector2I> stack;
 
-	GLASSERT( land[origin.y*MAX_MAP_SIZE+origin.x] );
+	GLASSERT( land[origin.y*size+origin.x] );
 
 	stack.Push( origin );
 	color[INDEX(origin.x, origin.y)] = 1;
@@ -265,8 +266,8 @@ void WorldGen::RemoveUncoloredLand( SectorData* s )
 
 	for( int y=bounds.min.y; y<=bounds.max.y; ++y ) {
 		for( int x=bounds.min.x; x<=bounds.max.x; ++x ) {
-			if ( color[y*MAX_MAP_SIZE+x] == 0 ) {
-				land[y*MAX_MAP_SIZE+x] = 0;
+			if ( color[y*size+x] == 0 ) {
+				land[y*size+x] = 0;
 			}
 		}
 	}
@@ -281,11 +282,11 @@ void WorldGen::DepositLand( SectorData* s, U32 seed, int n )
 	// Inset one more, so that checks can be in all directions.
 	for( int y=bounds.min.y+1; y<=bounds.max.y-1; ++y ) {
 		for( int x=bounds.min.x+1; x<=bounds.max.x-1; ++x ) {
-			if (    land[y*MAX_MAP_SIZE+x]		// is land
-			     && (    land[y*MAX_MAP_SIZE+x+1] == 0
-					  || land[y*MAX_MAP_SIZE+x-1] == 0
-					  || land[(y+1)*MAX_MAP_SIZE+x] == 0
-					  || land[(y-1)*MAX_MAP_SIZE+x] == 0 ))
+			if (    land[y*size+x]		// is land
+			     && (    land[y*size+x+1] == 0
+					  || land[y*size+x-1] == 0
+					  || land[(y+1)*size+x] == 0
+					  || land[(y-1)*size+x] == 0 ))
 			{
 				Vector2I v = { x, y };
 				stack.Push( v );
@@ -304,13 +305,13 @@ void WorldGen::DepositLand( SectorData* s, U32 seed, int n )
 		int d = Min( 4, stack.Size()-1 );
 		int index = d > 1 ? (stack.Size()-1-random.Rand(d)) : (stack.Size()-1);
 		Vector2I origin = stack[index];
-		GLASSERT( land[origin.y*MAX_MAP_SIZE+origin.x] );
+		GLASSERT( land[origin.y*size+origin.x] );
 
 		bool deposit = false;
 		for( int i=0; i<4; ++i ) {
 			Vector2I c = origin + dir[i];
-			if ( bounds.Contains(c) && land[c.y*MAX_MAP_SIZE+c.x] == 0 ) {
-				land[c.y*MAX_MAP_SIZE+c.x] = LAND0;
+			if ( bounds.Contains(c) && land[c.y*size+c.x] == 0 ) {
+				land[c.y*size+c.x] = LAND0;
 				deposit = true;
 				stack.Push( c );
 				--n;
@@ -327,11 +328,11 @@ void WorldGen::DepositLand( SectorData* s, U32 seed, int n )
 
 void WorldGen::Draw( const Rectangle2I& r, int isLand )
 {
-	GLASSERT( r.min.x >= 0 && r.max.x < MAX_MAP_SIZE );
-	GLASSERT( r.min.y >= 0 && r.max.y < MAX_MAP_SIZE );
+	GLASSERT( r.min.x >= 0 && r.max.x < size );
+	GLASSERT( r.min.y >= 0 && r.max.y < size );
 	for( int y=r.min.y; y<=r.max.y; ++y ) {
 		for( int x=r.min.x; x<=r.max.x; ++x ) {
-			land[y*MAX_MAP_SIZE+x] = isLand;
+			land[y*size+x] = isLand;
 		}
 	}
 }
@@ -347,10 +348,10 @@ void WorldGen::CutRoads( U32 seed, SectorData* sectorData )
 	
 	//First pass: split up the world.
 	for( int pass=0; pass<2; ++pass ) {
-		for( int j=0; j<NUM_SECTORS-1; ++j ) {
+		for( int j=0; j<nSectors-1; ++j ) {
 			Rectangle2I r;
 			r.Set( 0,	   (j+1)*SECTOR_SIZE-1, 
-				   MAX_MAP_SIZE-1, (j+1)*SECTOR_SIZE );
+				   size-1, (j+1)*SECTOR_SIZE );
 			if ( pass == 1 ) {
 				Swap( &r.min.x, &r.min.y );
 				Swap( &r.max.x, &r.max.y );
@@ -364,27 +365,27 @@ void WorldGen::CutRoads( U32 seed, SectorData* sectorData )
 	// everything which can be a road is a road.
 	BitArray< NUM_SECTORS, NUM_SECTORS, 1 > sectors;
 	Random random( seed );
-	Vector2I center = { NUM_SECTORS/2, NUM_SECTORS/2 };
-	int rad = NUM_SECTORS/2;
+	Vector2I center = { nSectors/2, nSectors/2 };
+	int rad = nSectors/2;
 
 	// Set the basic:
 	Rectangle2I r;
-	r.Set(1, 1, NUM_SECTORS - 2, NUM_SECTORS - 2);
+	r.Set(1, 1, nSectors - 2, nSectors - 2);
 	sectors.SetRect(r);
 
 	// Clear corners:
 	sectors.Clear(1, 1);
-	sectors.Clear(1, NUM_SECTORS - 2);
-	sectors.Clear(NUM_SECTORS - 2, 1);
-	sectors.Clear(NUM_SECTORS - 2, NUM_SECTORS - 2);
-	int nCores = (NUM_SECTORS - 2) * (NUM_SECTORS - 2) - 4;
+	sectors.Clear(1, nSectors - 2);
+	sectors.Clear(nSectors - 2, 1);
+	sectors.Clear(nSectors - 2, nSectors - 2);
+	int nCores = (nSectors - 2) * (nSectors - 2) - 4;
 
 	// 16x16 -> 120 domains
 	// 8x8 -> 30 domains
-	static const int NUM_CORES = 120 * NUM_SECTORS_2 / (16 * 16);
+	const int NUM_CORES = 120 * nSectors * nSectors / (16 * 16);
 
 	while (nCores > NUM_CORES) {
-		int y = random.Rand(NUM_SECTORS);
+		int y = random.Rand(nSectors);
 		if (random.Bit()) {
 			for (int x = 0; x < center.x - 2; ++x) {
 				if (sectors.IsSet(x, y)) {
@@ -395,7 +396,7 @@ void WorldGen::CutRoads( U32 seed, SectorData* sectorData )
 			}
 		}
 		else {
-			for (int x = NUM_SECTORS-1; x > center.x + 1; --x) {
+			for (int x = nSectors-1; x > center.x + 1; --x) {
 				if (sectors.IsSet(x, y)) {
 					sectors.Clear(x, y);
 					nCores--;
@@ -406,8 +407,8 @@ void WorldGen::CutRoads( U32 seed, SectorData* sectorData )
 	}
 
 	// Now fill in roads.
-	for( int j=1; j<NUM_SECTORS-1; ++j ) {
-		for( int i=1; i<NUM_SECTORS-1; ++i ) {
+	for( int j=1; j<nSectors-1; ++j ) {
+		for( int i=1; i<nSectors-1; ++i ) {
 			if ( sectors.IsSet( i, j )) {
 				Rectangle2I r;
 
@@ -480,7 +481,7 @@ int WorldGen::CalcSectorArea( int sx, int sy )
 			 i < (sx+1)*SECTOR_SIZE-1;
 			 ++i )
 		{
-			if ( land[j*MAX_MAP_SIZE+i] ) {
+			if ( land[j*size+i] ) {
 				++area;
 			}
 		}
@@ -610,8 +611,8 @@ void WorldGen::ProcessSectors( U32 seed, SectorData* sectorData )
 	// change with caution.
 	CDynArray<SectorData*> sectors;
 
-	for( int j=0; j<NUM_SECTORS; ++j ) {
-		for( int i=0; i<NUM_SECTORS; ++i ) {
+	for( int j=0; j<nSectors; ++j ) {
+		for( int i=0; i<nSectors; ++i ) {
 			SectorData* s = &sectorData[j*NUM_SECTORS+i];
 			s->sector.Set(i, j);
 			if ( s->ports ) {
@@ -634,13 +635,13 @@ void WorldGen::Filter( const Rectangle2I& bounds )
 {
 	for( int y=bounds.min.y; y<=bounds.max.y; ++y ) {
 		for( int x=bounds.min.x; x<=bounds.max.x; ++x ) {
-			if (    land[y*MAX_MAP_SIZE+x] == WATER 
-				 && land[(y-1)*MAX_MAP_SIZE+x] != WATER
-				 && land[(y+1)*MAX_MAP_SIZE+x] != WATER
-				 && land[y*MAX_MAP_SIZE+(x+1)] != WATER
-				 && land[y*MAX_MAP_SIZE+(x-1)] != WATER )
+			if (    land[y*size+x] == WATER 
+				 && land[(y-1)*size+x] != WATER
+				 && land[(y+1)*size+x] != WATER
+				 && land[y*size+(x+1)] != WATER
+				 && land[y*size+(x-1)] != WATER )
 			{
-				land[y*MAX_MAP_SIZE+x] = LAND0;
+				land[y*size+x] = LAND0;
 			}
 		}
 	}
@@ -668,7 +669,7 @@ void WorldGen::GenerateTerrain( U32 seed, SectorData* s )
 	r.Outset( 2 );
 	Draw( r, LAND0 );
 
-	land[c.y*MAX_MAP_SIZE+c.x]	= CORE;
+	land[c.y*size+c.x]	= CORE;
 	int  a				= Color( s->InnerBounds(), s->core );
 	int portsColored	= PortsColored( s );
 	int	featurePlaced	= random.Rand( 2 );
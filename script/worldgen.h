@@ -37,7 +37,9 @@ class PerlinNoise;
 class WorldGen
 {
 public:
-	WorldGen();
+	// 'size' is the edge of the (square) map being generated; it
+	// can be smaller than MAX_MAP_SIZE.
+	WorldGen( int size = MAX_MAP_SIZE );
 	~WorldGen();
 
 	void LoadFeatures( const char* path );
@@ -65,8 +67,8 @@ public:
 	};
 
 	void SetHeight( int x, int y, int h ) {
-		int index = y*MAX_MAP_SIZE+x;
-		GLASSERT( x >= 0 && x < MAX_MAP_SIZE && y >= 0 && y < MAX_MAP_SIZE );
+		int index = y*size+x;
+		GLASSERT( x >= 0 && x < size && y >= 0 && y < size );
 		GLASSERT( h >= WATER && h < NUM_TYPES );
 		land[index] = h;
 	}
@@ -91,20 +93,20 @@ public:
 
 	grinliz::Vector2I FromState( void* s ) {
 		int i = int(intptr_t(s));
-		int y = i / MAX_MAP_SIZE;
-		int x = i - y*MAX_MAP_SIZE;
+		int y = i / size;
+		int x = i - y*size;
 		grinliz::Vector2I v = { x, y };
 		return v;
 	}
 
 	void* ToState( const grinliz::Vector2I& v ) {
-		int i = v.y*MAX_MAP_SIZE + v.x;
+		int i = v.y*size + v.x;
 		return (void*)i;
 	}
 
 private:
-	int INDEX( int x, int y ) const					{ return y*MAX_MAP_SIZE + x; }
-	int INDEX( const grinliz::Vector2I& v ) const	{ return v.y*MAX_MAP_SIZE + v.x; }
+	int INDEX( int x, int y ) const					{ return y*size + x; }
+	int INDEX( const grinliz::Vector2I& v ) const	{ return v.y*size + v.x; }
 
 	int  CountFlixelsAboveCutoff( const float* flixels, float cutoff, float* maxh );
 	void Draw( const grinliz::Rectangle2I& r, int land );
@@ -121,6 +123,9 @@ private:
 	void RemoveUncoloredLand( SectorData* s );
 	void CalcPath( const SectorData* s );
 
+	int size;		// map edge, in grid units
+	int nSectors;	// sectors along an edge
+
 	float* flixels;
 	grinliz::PerlinNoise* noise0;
 	grinliz::PerlinNoise* noise1;
@@ -28,6 +28,17 @@
 #include "../grinliz/glstringutil.h"	// FIXME: only used for child index snprintf. Can and should be removed.
 #include "../FastLZ/fastlz.h"
 
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
 #ifdef _MSC_VER
 #pragma warning ( disable : 4996 )
 #endif
@@ -98,12 +109,16 @@ public:
 
 
 /* static */ Reader* Reader::readerRoot = 0;
+/* static */ std::mutex Reader::rootMutex;
+/* static */ thread_local const Reader* Reader::pinReader = 0;
+/* static */ thread_local Reader::CacheEntry* Reader::pinEntry = 0;
 
 /* static */ const Reader* Reader::GetContext( const Item* item )
 {
 	GLASSERT( item );
 	const void* m = item;
 
+	std::lock_guard<std::mutex> lock( rootMutex );
 	for( Reader* r=readerRoot; r; r=r->next ) {
 		if ( m >= r->mem && m < r->endMem ) {
 			return r;
@@ -116,74 +131,167 @@ public:
 Reader::Reader()
 {
 	mem = 0;
+	endMem = 0;
 	memSize = 0;
-	fp = 0;
+	offset = 0;
+	file = 0;
+	fileSize = 0;
+	mapped = false;
+	root = 0;
 
 	// Add to linked list.
-	next = readerRoot;
-	readerRoot = this;
-	buffer = 0;
-	bufferSize = 0;
-	access = 0;
-	accessSize = 0;
+	{
+		std::lock_guard<std::mutex> lock( rootMutex );
+		next = readerRoot;
+		readerRoot = this;
+	}
+
+	lru.prev = lru.next = &lru;
+	cacheSize = 0;
+	cacheBudget = 16 * 1024 * 1024;
 }
 
 
 Reader::~Reader()
 {
-	// unlink from the global list.
-	Reader* r = readerRoot;
-	Reader* prev = 0;
-	while( r && r != this ) {
-		prev = r;
-		r = r->next;
+	// unlink from the global list. Once it is out, no other
+	// thread can find it to release a pin.
+	{
+		std::lock_guard<std::mutex> lock( rootMutex );
+		Reader* r = readerRoot;
+		Reader* prev = 0;
+		while( r && r != this ) {
+			prev = r;
+			r = r->next;
+		}
+		GLASSERT( r );
+
+		if ( prev ) {
+			prev->next = r->next;
+		}
+		else {
+			readerRoot = r->next;
+		}
 	}
-	GLASSERT( r );
 
-	if ( prev ) {
-		prev->next = r->next;
+	if ( pinReader == this ) {
+		pinReader = 0;
+		pinEntry = 0;
 	}
-	else {
-		readerRoot = r->next;
+	for( CacheEntry* e = lru.next; e != &lru; ) {
+		CacheEntry* n = e->next;
+		Free( e );
+		e = n;
 	}
+	UnmapFile();
+}
+
 
-	if ( mem )
-		Free( mem );
-	if ( buffer )
-		Free( buffer );
-	if ( access )
-		Free( access );
-	if ( fp ) {
-		fclose( fp );
+bool Reader::MapFile( const char* filename )
+{
+	if ( !filename ) return false;
+
+#ifdef _WIN32
+	HANDLE f = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+	if ( f != INVALID_HANDLE_VALUE ) {
+		LARGE_INTEGER size;
+		HANDLE m = 0;
+		if ( GetFileSizeEx( f, &size ) && size.QuadPart > 0 ) {
+			m = CreateFileMappingA( f, 0, PAGE_READONLY, 0, 0, 0 );
+		}
+		CloseHandle( f );	// the mapping holds the file open
+		if ( m ) {
+			const void* view = MapViewOfFile( m, FILE_MAP_READ, 0, 0, 0 );
+			CloseHandle( m );	// and the view holds the mapping
+			if ( view ) {
+				file = (const U8*)view;
+				fileSize = size_t( size.QuadPart );
+				mapped = true;
+				return true;
+			}
+		}
 	}
+#else
+	int fd = open( filename, O_RDONLY );
+	if ( fd >= 0 ) {
+		struct stat st;
+		void* view = MAP_FAILED;
+		if ( fstat( fd, &st ) == 0 && st.st_size > 0 ) {
+			view = mmap( 0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+		}
+		close( fd );	// the mapping holds the file open
+		if ( view != MAP_FAILED ) {
+			file = (const U8*)view;
+			fileSize = size_t( st.st_size );
+			mapped = true;
+			return true;
+		}
+	}
+#endif
+
+	// Can't map it (packaged assets, odd file systems); read it all instead.
+	FILE* fp = fopen( filename, "rb" );
+	if ( !fp ) return false;
+	fseek( fp, 0, SEEK_END );
+	long size = ftell( fp );
+	fseek( fp, 0, SEEK_SET );
+	bool okay = false;
+	if ( size > 0 ) {
+		void* m = Malloc( size );
+		okay = fread( m, size, 1, fp ) == 1;
+		if ( okay ) {
+			file = (const U8*)m;
+			fileSize = size_t( size );
+			mapped = false;
+		}
+		else {
+			Free( m );
+		}
+	}
+	fclose( fp );
+	return okay;
+}
+
+
+void Reader::UnmapFile()
+{
+	if ( !file ) return;
+	if ( mapped ) {
+#ifdef _WIN32
+		UnmapViewOfFile( file );
+#else
+		munmap( (void*)file, fileSize );
+#endif
+	}
+	else {
+		Free( (void*)file );
+	}
+	file = 0;
+	fileSize = 0;
+	mem = endMem = 0;
 }
 
 
 bool Reader::Init( int id, const char* filename, int _offset )
 {
 	databaseID = id;
-	fp = fopen( filename, "rb" );
-	if ( !fp ) {
+	if ( !MapFile( filename )) {
 		GLOUTPUT_REL(("Reader::Init failed on '%s'\n", filename ? filename : ""));
 		GLASSERT( 0 );
 		return false;
 	}
 
 	offset = _offset;	
-	fseek( fp, 0, SEEK_END );
-	int dbSize = (int)ftell( fp ) - (int)offset;
-	fseek( fp, offset, SEEK_SET );
+	int dbSize = (int)fileSize - (int)offset;
 
-	// Read in the data structers. Leave the "data" compressed and in the file.
-	HeaderStruct header;
-	int size = fread( &header, sizeof(header), 1, fp );
-	if ( size != 1 ) {
+	// The data structures are used in place, and the "data" stays
+	// compressed in the mapping until it is asked for.
+	if ( offset < 0 || dbSize < (int)sizeof(HeaderStruct) ) {
 		GLOUTPUT(( "CORRUPT DATABASE\n" ));
-		fclose( fp );
+		UnmapFile();
 		return false;
 	}
-
-	fseek( fp, offset, SEEK_SET );
+	const HeaderStruct& header = *(const HeaderStruct*)(file + offset);
 	memSize = header.offsetToData;
 
 	// FIXME: Should add a checksum...
@@ -192,19 +300,16 @@ bool Reader::Init( int id, const char* filename, int _offset )
 		 || memSize > dbSize ) 
 	{
 		GLOUTPUT(( "CORRUPT DATABASE\n" ));
-		fclose( fp );
+		UnmapFile();
 		return false;
 	}
 
-	mem = Malloc( memSize );
+	mem = file + offset;
 	endMem = (const char*)mem + memSize;
 
-	GLOUTPUT(( "Reading '%s' from offset=%d\n", filename, offset ));
-	size_t  didRead = fread( mem, memSize, 1, fp );
-	GLASSERT(didRead == 1);
-	(void)didRead;
+	GLOUTPUT(( "Mapped '%s' from offset=%d\n", filename, offset ));
 
-	root = (const Item*)( (U8*)mem + header.offsetToItems );
+	root = (const Item*)( (const U8*)mem + header.offsetToItems );
 
 #if 0		// Dump string pool
 
@@ -344,7 +449,7 @@ int Reader::GetDataSize( int dataID ) const
 }
 
 
-void Reader::GetData( int dataID, void* target, int memSize ) const
+const DataDescStruct& Reader::DataDesc( int dataID ) const
 {
 	const HeaderStruct* header = (const HeaderStruct*)mem;
 	GLASSERT( header->offsetToDataDesc % 4 == 0 );
@@ -352,37 +457,42 @@ void Reader::GetData( int dataID, void* target, int memSize ) const
 	const DataDescStruct* dataDescPtr = (const DataDescStruct*)((const U8*)mem + header->offsetToDataDesc);
 	GLASSERT( dataID >= 0 && dataID < (int)header->nData );
 	const DataDescStruct& dataDesc = dataDescPtr[dataID];
-	
-	fseek( fp, offset+dataDesc.offset, SEEK_SET );
+	GLASSERT( size_t(offset) + dataDesc.offset + dataDesc.compressedSize <= fileSize );
+	return dataDesc;
+}
 
+
+void Reader::Decompress( const DataDescStruct& dataDesc, void* target ) const
+{
+	const U8* src = (const U8*)mem + dataDesc.offset;
 	if ( dataDesc.compressedSize == dataDesc.size ) {
-		// no compression.
-		GLASSERT( dataDesc.size == (U32)memSize );
-		size_t didRead = fread( target, memSize, 1, fp );
-		GLASSERT(didRead == 1);
-		(void)didRead;
+		memcpy( target, src, dataDesc.size );
 	}
 	else {
-		if ( bufferSize < (int)dataDesc.compressedSize ) {
-			bufferSize = (int)dataDesc.compressedSize*5/4;
-			if ( bufferSize < 1000 )
-				bufferSize = 1000;
-			if ( buffer )
-				buffer = Realloc( buffer, bufferSize );
-			else 
-				buffer = Malloc( bufferSize );
+		int resultSize = fastlz_decompress(src, dataDesc.compressedSize, target, dataDesc.size);
+
+		if (resultSize != int(dataDesc.size)) {
+			GLOUTPUT_REL(("Reader::Decompress uncompress returned size %d. size=%d compressedSize=%d\n", resultSize, dataDesc.size, dataDesc.compressedSize));
 		}
-		size_t didRead = fread( buffer, dataDesc.compressedSize, 1, fp );
-		GLASSERT(didRead == 1);
-		(void)didRead;
+	}
+}
 
-		int resultSize = fastlz_decompress(buffer, dataDesc.compressedSize, target, dataDesc.size);
 
-		if (resultSize != int(dataDesc.size)) {
-			GLOUTPUT_REL(("Reader::GetData uncompress returned size %d. dataID=%d size=%d compressedSize=%d memSize=%d\n", resultSize, dataID, dataDesc.size, dataDesc.compressedSize, memSize));
+void Reader::GetData( int dataID, void* target, int memSize ) const
+{
+	const DataDescStruct& dataDesc = DataDesc( dataID );
+	GLASSERT( dataDesc.size == (U32)memSize );
+
+	if ( dataDesc.compressedSize != dataDesc.size ) {
+		// A copy from the cache beats decompressing again.
+		std::lock_guard<std::mutex> lock( cacheMutex );
+		CacheEntry* e = 0;
+		if ( cacheMap.Query( dataID, &e )) {
+			memcpy( target, e->Data(), memSize );
+			return;
 		}
-		GLASSERT( dataDesc.size == (U32)memSize );
 	}
+	Decompress( dataDesc, target );
 }
 
 
@@ -390,28 +500,120 @@ const void* Reader::AccessData( const Item* item, const char* name, int* p_size
 {
 	GLASSERT( ItemInReader( item ));
 
-	int size = 0;
 	if ( p_size ) *p_size = 0;
 
-	int type = item->AttributeType( name ); 
-	if ( !IsDataType( type ) ) {
+	int i = item->AttributeIndex( name );
+	if ( i < 0 || !IsDataType( item->AttributeType( i ) )) {
 		return 0;
 	}
-	size = item->GetDataSize( name );
-	// Make sure we have enough space, including appended null terminator.
-	if ( (size+1) > accessSize ) {
-		accessSize = (size+1);
-		if ( access )
-			access = Realloc( access, accessSize );
-		else
-			access = Malloc( accessSize );
+	int dataID = item->GetDataID( i );
+	const DataDescStruct& dataDesc = DataDesc( dataID );
+	if ( p_size )
+		*p_size = dataDesc.size;
+
+	if ( dataDesc.compressedSize == dataDesc.size ) {
+		// Zero copy: straight from the mapping.
+		return (const U8*)mem + dataDesc.offset;
 	}
-	item->GetData( name, access, size );
-	*((char*)access + size) = 0;	// null terminate for text assets.
 
-	if ( p_size )
-		*p_size = size;
-	return access;
+	// Pin the new entry before letting go of the last one, in case
+	// they are the same.
+	CacheEntry* entry = Acquire( dataID );
+	if ( pinEntry ) {
+		// The Reader that owns the pin may have been deleted (on another thread).
+		std::lock_guard<std::mutex> lock( rootMutex );
+		for( const Reader* r = readerRoot; r; r = r->next ) {
+			if ( r == pinReader ) {
+				r->Release( pinEntry );
+				break;
+			}
+		}
+	}
+	pinReader = this;
+	pinEntry = entry;
+	return entry->Data();
+}
+
+
+Reader::CacheEntry* Reader::Acquire( int dataID ) const
+{
+	CacheEntry* e = 0;
+	{
+		std::lock_guard<std::mutex> lock( cacheMutex );
+		if ( cacheMap.Query( dataID, &e )) {
+			++e->refs;
+			Unlink( e );
+			LinkFront( e );
+			return e;
+		}
+	}
+
+	// Decompress without the lock. If two threads race to the
+	// same data, the second copy is thrown away.
+	const DataDescStruct& dataDesc = DataDesc( dataID );
+	CacheEntry* fresh = (CacheEntry*) Malloc( sizeof(CacheEntry) + dataDesc.size + 1 );
+	fresh->dataID = dataID;
+	fresh->size = dataDesc.size;
+	fresh->refs = 1;
+	Decompress( dataDesc, fresh->Data() );
+	fresh->Data()[dataDesc.size] = 0;	// null terminate for text assets.
+
+	std::lock_guard<std::mutex> lock( cacheMutex );
+	if ( cacheMap.Query( dataID, &e )) {
+		Free( fresh );
+		++e->refs;
+		Unlink( e );
+		LinkFront( e );
+		return e;
+	}
+	cacheMap.Add( dataID, fresh );
+	LinkFront( fresh );
+	cacheSize += fresh->size;
+	Trim();
+	return fresh;
+}
+
+
+void Reader::Release( CacheEntry* e ) const
+{
+	std::lock_guard<std::mutex> lock( cacheMutex );
+	GLASSERT( e->refs > 0 );
+	--e->refs;
+	Trim();
+}
+
+
+void Reader::Trim() const
+{
+	// Walk from the least recently used end; pinned entries stay.
+	CacheEntry* e = lru.prev;
+	while ( cacheSize > cacheBudget && e != &lru ) {
+		CacheEntry* prev = e->prev;
+		if ( e->refs == 0 ) {
+			Unlink( e );
+			cacheMap.Remove( e->dataID );
+			cacheSize -= e->size;
+			Free( e );
+		}
+		e = prev;
+	}
+}
+
+
+void Reader::Unlink( CacheEntry* e )
+{
+	e->prev->next = e->next;
+	e->next->prev = e->prev;
+	e->prev = e->next = 0;
+}
+
+
+void Reader::LinkFront( CacheEntry* e ) const
+{
+	e->prev = &lru;
+	e->next = lru.next;
+	lru.next->prev = e;
+	lru.next = e;
 }
 
 
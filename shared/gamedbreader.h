@@ -25,11 +25,13 @@
 #define GRINLIZ_GAME_DB_READER_INCLUDED
 
 #include <stdio.h>
+#include <stddef.h>
+#include <mutex>
 #include "../grinliz/gltypes.h"
 #include "../grinliz/gldebug.h"
 #include "gamedb.h"
 
-// only used for Manifest()
+// Manifest() and the data cache
 #include "../grinliz/glcontainer.h"
 #include "../grinliz/glstringutil.h"
 
@@ -153,8 +155,12 @@ private:
 	# Navigate and query Items
 	# At the end of program execution, or when all resources are loaded, delete Reader
 
-	Threading note: currently all Readers should be on the same thread. That could
-	be fixed by adding a semaphore to GetContext()
+	The database file is memory mapped. Items, attributes, and uncompressed data are
+	read in place; compressed data is decompressed in to an LRU cache keyed by the
+	data ID.
+
+	Threading note: Readers should be created and deleted on the same thread, but
+	once Init() returns, any thread can query Items and call GetData() / AccessData().
 */
 class Reader
 {
@@ -163,7 +169,7 @@ public:
 	Reader();
 	~Reader();
 
-	/** Initialize the object. This will hold a read-binary FILE* for the lifetime of Reader.
+	/** Initialize the object. This maps the file for the lifetime of Reader.
 		@return true if filename could be opened and read.
 				false if error.
 	*/
@@ -180,14 +186,18 @@ public:
 
 	/** Utility function to access binary data without having to do memory management in the
 		host program. Given an item, and binary attribute, returns a pointer to the uncompressed
-		data. The data length is returned, if requested. The data is null terminated so can
-		always safely be treated as a string.
+		data. The data length is returned, if requested. Data that was stored uncompressed is
+		a pointer in to the file mapping, and is NOT null terminated. Data that was compressed
+		comes from the cache, and is null terminated.
 
-		WARNING: Any call to access ATTRIBUTE_DATA anywhere in the tree will invalidate the cache.
+		WARNING: The next call to AccessData on the same thread may invalidate the pointer.
 		AccessData should be called, and the data consumed or copied. It is very transient.
 	*/
 	const void* AccessData( const Item* item, const char* name, int* size=0 ) const;
 
+	/// Memory the cache of decompressed data may use, not counting data in use. Default 16MB.
+	void SetCacheBudget( int bytes )			{ cacheBudget = bytes; }
+
 	const void* BaseMem() const					{ return mem; }
 	int OffsetFromStart() const					{ return offset; }	///< Offset from the start of the file (passed in)
 
@@ -204,21 +214,54 @@ private:
 	bool IsDataType( int i ) const { return i == ATTRIBUTE_DATA || i == ATTRIBUTE_INT_ARRAY || i == ATTRIBUTE_FLOAT_ARRAY; }
 	void ManifestRec(const gamedb::Item* item, int depth, int maxDepth, grinliz::CDynArray<ManifestItem>* arr) const;
 
+	// A block of decompressed data; the data follows the struct.
+	struct CacheEntry
+	{
+		int dataID;
+		int size;
+		int refs;			// AccessData() pins, from any thread
+		CacheEntry* prev;	// LRU list; most recent after the sentinel
+		CacheEntry* next;
+
+		U8* Data() { return (U8*)(this + 1); }
+	};
+
+	bool MapFile( const char* filename );
+	void UnmapFile();
+
+	const DataDescStruct& DataDesc( int dataID ) const;
+	void Decompress( const DataDescStruct& dataDesc, void* target ) const;
+
+	CacheEntry* Acquire( int dataID ) const;
+	void Release( CacheEntry* entry ) const;
+	void Trim() const;		// cacheMutex must be held
+	static void Unlink( CacheEntry* e );
+	void LinkFront( CacheEntry* e ) const;
+
 	static Reader* readerRoot;
+	static std::mutex rootMutex;	// guards readerRoot and the list
 	Reader* next;
 
-	FILE* fp;
 	int databaseID;
 
-	void* mem;
+	const U8* file;		// the whole file, mapped (or read, if mapping fails)
+	size_t fileSize;
+	bool mapped;
+
+	const void* mem;	// file + offset
 	const void* endMem;
 	int memSize;
 	int offset;	// offset to read from file start
 
-	mutable void* buffer;
-	mutable int bufferSize;
-	mutable void* access;
-	mutable int accessSize;
+	mutable std::mutex cacheMutex;
+	mutable grinliz::HashTable< int, CacheEntry* > cacheMap;
+	mutable CacheEntry lru;		// sentinel of the circular LRU list
+	mutable int cacheSize;
+	int cacheBudget;
+
+	// The entry returned by the last AccessData() on this thread.
+	static thread_local const Reader* pinReader;
+	static thread_local CacheEntry* pinEntry;
 
 	const Item* root;
 };
@@ -2,7 +2,7 @@
 #include "../grinliz/glmatrix.h"
 #include "../grinliz/glgeometry.h"
 #include "../grinliz/glspatialhash.h"
-#include "../grinliz/glthreadpool.h"
+#include "../grinliz/gljobsystem.h"
 
 #include "../game/news.h"
 
@@ -11,32 +11,38 @@
 
 using namespace grinliz;
 
-int TFunc(void* v, void*, void*, void*) {
+void TFunc(void* v, int start, int end) {
 
-	int i = reinterpret_cast<int>(v);
-	std::chrono::milliseconds ms(i%10 + 1);
-	std::this_thread::sleep_for(ms);
-	//printf("ThreadFunc %d run.\n", i);
-	return i;
+	int* result = (int*)v;
+	for (int i = start; i < end; ++i) {
+		std::chrono::milliseconds ms(i%10 + 1);
+		std::this_thread::sleep_for(ms);
+		//printf("ThreadFunc %d run.\n", i);
+		result[i] = i;
+	}
 }
 
-void TestThreadPool()
+void TestJobSystem()
 {
-	CDynArray<int> result;
+	JobSystem::Test();
+
+	int result[100];
 	{
 		// Empty:
-		ThreadPool pool;
-		pool.Wait(0);
-		printf("Empty pool pass.\n");
+		JobSystem js;
+		JobGroup group;
+		js.Wait(&group);
+		printf("Empty job system pass.\n");
 	}
 	{
 		int N = 8;
-		ThreadPool pool;
+		JobSystem js;
+		JobGroup group;
 		for (int i = 0; i < N; ++i) {
-			pool.Add(TFunc, (void*)i);
+			result[i] = -1;
+			js.Add(&group, TFunc, result, i, i + 1);
 		}
-		pool.Wait(&result);
-		result.Sort();
+		js.Wait(&group);
 		for (int i = 0; i < N; ++i) {
 			GLASSERT(result[i] == i);
 		}
@@ -45,12 +51,9 @@ void TestThreadPool()
 	{
 		for (int pass = 0; pass < 2; ++pass) {
 			int N = 100;
-			ThreadPool pool;
-			for (int i = 0; i < N; ++i) {
-				pool.Add(TFunc, (void*)i);
-			}
-			pool.Wait(&result);
-			result.Sort();
+			JobSystem js;
+			for (int i = 0; i < N; ++i) result[i] = -1;
+			js.ParallelFor(N, pass ? 1 : 0, TFunc, result);
 			for (int i = 0; i < N; ++i) {
 				GLASSERT(result[i] == i);
 			}
@@ -58,22 +61,25 @@ void TestThreadPool()
 		}
 	}
 	{
-		static const int P = 2;
-		ThreadPool pool[P];
+		// A chain: each group depends on the one before.
+		static const int P = 4;
+		JobSystem js;
+		JobGroup group[P];
 		int N = 100;
-		for (int i = 0; i < N; ++i) {
-			for (int pass = 0; pass < P; ++pass) {
-				pool[pass].Add(TFunc, (void*)i);
+		for (int i = 0; i < N; ++i) result[i] = -1;
+		for (int pass = 0; pass < P; ++pass) {
+			for (int i = pass; i < N; i += P) {
+				js.Add(&group[pass], TFunc, result, i, i + 1, pass ? &group[pass - 1] : 0);
 			}
 		}
+		js.Wait(&group[P - 1]);
 		for (int pass = 0; pass < P; ++pass) {
-			pool[pass].Wait(&result);
-			result.Sort();
-			for (int i = 0; i < N; ++i) {
-				GLASSERT(result[i] == i);
-			}
+			GLASSERT(group[pass].Done());
+		}
+		for (int i = 0; i < N; ++i) {
+			GLASSERT(result[i] == i);
 		}
-		printf("Parallel stress pass.\n");
+		printf("Dependency stress pass.\n");
 	}
 }
 
@@ -155,6 +161,6 @@ int main(int argc, const char* argv[])
 	Quaternion::Test();
 	TestSpatialHash();
 	TestConditions();
-	TestThreadPool();
+	TestJobSystem();
 	return 0;
 }
\ No newline at end of file
@@ -10,4 +10,5 @@
 //static const int CURRENT_FILE_VERSION = 13;		// Beta5a
 //static const int CURRENT_FILE_VERSION = 14;		// Beta6
 //static const int CURRENT_FILE_VERSION = 15;			// Beta7
-static const int CURRENT_FILE_VERSION = 16;			// Beta7b
+//static const int CURRENT_FILE_VERSION = 16;			// Beta7b
+static const int CURRENT_FILE_VERSION = 17;			// Beta7b, stream string tables, element lengths & bulk POD data
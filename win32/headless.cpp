@@ -0,0 +1,266 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+	Headless simulation runner. Loads a map (and optionally a game)
+	and runs the Sim as fast as the CPU allows, with a fixed time step.
+	There is no window and no GL context: the engine is constructed,
+	but GPU resources are never created and nothing is drawn.
+
+	-prep N runs the scene preparation of N frames (culling and render
+	queue fill, no GL) at the saved camera instead, serial and then
+	parallel, and reports the time per frame.
+
+	-particles N runs N frames of the particle system (emit, integrate,
+	cull, and write the vertex stream) with a waterfall in front of the
+	camera, serial and then parallel.
+
+	lumos_headless [-m minutes] [-s stepMSec] [-aoi] [-par] [-page] [-prep frames] [-particles frames] [--profile-startup] [map.dat [game.dat]]
+*/
+
+#include "../grinliz/gldebug.h"
+#include "../grinliz/gltypes.h"
+#include "../grinliz/glstringutil.h"
+#include "../grinliz/gljobsystem.h"
+
+#include "../xegame/cgame.h"
+#include "../xegame/platformpath.h"
+#include "../xegame/istringconst.h"
+
+#include "../engine/gpustatemanager.h"
+#include "../engine/shadermanager.h"
+#include "../engine/texture.h"
+#include "../engine/surface.h"
+#include "../engine/model.h"
+#include "../engine/animation.h"
+#include "../engine/screenport.h"
+#include "../engine/assetloader.h"
+#include "../engine/engine.h"
+#include "../engine/particle.h"
+
+#include "../shared/gamedbreader.h"
+#include "../script/itemscript.h"
+#include "../script/corescript.h"
+
+#include "../game/sim.h"
+#include "../game/lumoschitbag.h"
+#include "../game/worldmap.h"
+#include "../game/sectorpager.h"
+
+#include "../version.h"
+
+#include <chrono>
+
+using namespace grinliz;
+
+static const U32 TIME_BETWEEN_FRAMES = 1000 / 33;
+
+static void PrepBenchmark(Engine* engine, int frames)
+{
+	for (int pass = 0; pass < 2; ++pass) {
+		bool parallel = pass == 1;
+		engine->SetParallelPrep(parallel);
+		engine->PrepFrame();	// warm up the caches and queues
+
+		int items = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < frames; ++i) {
+			items = engine->PrepFrame();
+		}
+		double msec = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		printf("prep %-8s frames=%d items=%d total=%.1fms per frame=%.3fms\n",
+			   parallel ? "parallel" : "serial", frames, items, msec, msec / double(frames));
+	}
+}
+
+
+static void ParticleBenchmark(Engine* engine, int frames)
+{
+	ParticleSystem* system = engine->particleSystem;
+	ParticleDef def = system->GetPD(ISC::fallingWater);
+	// Continuous emitter, in particles per second: enough to run the
+	// system up against its cap in a couple of seconds.
+	def.count = 4000;
+	static const Vector3F DOWN = { 0, -1, 0 };
+
+	const Vector3F* eyeDir = engine->camera.EyeDir3();
+	const Vector3F center = engine->camera.PosWC() + eyeDir[0] * 10.0f;
+	static const Vector3F HALF = { 4.0f, 1.0f, 4.0f };
+	Rectangle3F rect;
+	rect.min = center - HALF;
+	rect.max = center + HALF;
+
+	for (int pass = 0; pass < 2; ++pass) {
+		bool parallel = pass == 1;
+		system->SetParallel(parallel);
+		system->Clear();
+
+		int updated = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < frames; ++i) {
+			system->EmitPD(def, rect, DOWN, TIME_BETWEEN_FRAMES);
+			system->Update(TIME_BETWEEN_FRAMES, &engine->camera);
+			updated += system->NumParticles();
+		}
+		double msec = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		printf("particles %-8s frames=%d live=%d per frame=%.3fms particles/ms=%.0f\n",
+			   parallel ? "parallel" : "serial", frames, system->NumParticles(), msec / double(frames), double(updated) / msec);
+	}
+	system->Clear();
+}
+
+
+static void RunSim(Sim* sim, int minutes, U32 step, bool useAOI)
+{
+	const U32 total = U32(minutes) * 60 * 1000;
+	U32 simTime = 0;
+	int ticks = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	while (simTime < total) {
+		sim->DoTick(step, useAOI);
+		simTime += step;
+		++ticks;
+
+		if ((simTime / 60000) != ((simTime - step) / 60000)) {
+			double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			ChitBag* cb = sim->GetChitBag();
+			printf("minute %d: chits=%d lod=%d/%d/%d paged sectors=%d chits=%d ticks/sec=%.1f\n", simTime / 60000, cb->NumChits(),
+				   cb->NumLOD(LOD_FULL), cb->NumLOD(LOD_COARSE), cb->NumLOD(LOD_STATISTICAL),
+				   sim->GetSectorPager()->NumPagedSectors(), sim->GetSectorPager()->NumPagedChits(), double(ticks) / sec);
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("Simulated %d minutes in %.2f seconds. ticks=%d ticks/sec=%.1f speedup=%.1fx\n",
+		   minutes, seconds, ticks, double(ticks) / seconds, double(total) / (seconds * 1000.0));
+	for (int i = 0; i < Sim::NUM_TICK_PROFILE; ++i) {
+		double msec = sim->TickProfile(i) / 1000.0;
+		printf("  %-10s total=%10.1fms per tick=%.3fms\n", Sim::TickProfileName(i), msec, msec / double(ticks));
+	}
+}
+
+
+int main(int argc, char **argv)
+{
+	int minutes = 10;
+	U32 step = TIME_BETWEEN_FRAMES;
+	bool useAOI = false;
+	bool parallel = false;
+	bool paging = false;
+	int prepFrames = 0;
+	int particleFrames = 0;
+	const char* mapDAT = "map.dat";
+	const char* gameDAT = 0;
+
+	int nFile = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (StrEqual(argv[i], "-m") && i + 1 < argc) {
+			minutes = atoi(argv[++i]);
+		}
+		else if (StrEqual(argv[i], "-s") && i + 1 < argc) {
+			step = (U32)atoi(argv[++i]);
+		}
+		else if (StrEqual(argv[i], "-aoi")) {
+			useAOI = true;
+		}
+		else if (StrEqual(argv[i], "-par")) {
+			parallel = true;
+		}
+		else if (StrEqual(argv[i], "-page")) {
+			paging = true;
+		}
+		else if (StrEqual(argv[i], "-prep") && i + 1 < argc) {
+			prepFrames = atoi(argv[++i]);
+		}
+		else if (StrEqual(argv[i], "-particles") && i + 1 < argc) {
+			particleFrames = atoi(argv[++i]);
+		}
+		else if (StrEqual(argv[i], "--profile-startup")) {
+			AssetLoader::SetProfileStartup(true);
+		}
+		else if (nFile == 0) {
+			mapDAT = argv[i];
+			++nFile;
+		}
+		else {
+			gameDAT = argv[i];
+			++nFile;
+		}
+	}
+	if (minutes <= 0 || step == 0) {
+		printf("Usage: lumos_headless [-m minutes] [-s stepMSec] [-aoi] [-par] [-page] [-prep frames] [-particles frames] [--profile-startup] [map.dat [game.dat]]\n");
+		return 1;
+	}
+	printf("Altera headless. version='%s' map='%s' game='%s' minutes=%d step=%d\n",
+		   VERSION, mapDAT, gameDAT ? gameDAT : "(new)", minutes, step);
+
+	GPUDevice::SetHeadless(true);
+	IStringConst::Init();
+
+	char buffer[260];
+	int offset = 0;
+	int length = 0;
+	PathToDatabase(buffer, 260, &offset, &length);
+	gamedb::Reader* database = new gamedb::Reader();
+	database->Init(0, buffer, offset);
+
+	TextureManager::Create(database);
+	ImageManager::Create(database);
+	ModelResourceManager::Create();
+	AnimationResourceManager::Create();
+	{
+		// No GL: models and animations only.
+		AssetLoader loader(database);
+		loader.Load();
+		if (AssetLoader::ProfileStartup()) {
+			loader.Report();
+		}
+	}
+
+	ItemDefDB* itemDefDB = new ItemDefDB();
+	itemDefDB->Load("./res/itemdef.xml");
+	CoreScript::Init();
+
+	Screenport screenport(800, 600);
+	Sim* sim = new Sim(database, &screenport);
+	sim->Load(mapDAT, gameDAT);
+	sim->GetChitBag()->SetParallelTick(parallel);
+	sim->GetSectorPager()->SetEnabled(paging);
+
+	if (prepFrames > 0) {
+		PrepBenchmark(sim->GetEngine(), prepFrames);
+	}
+	else if (particleFrames > 0) {
+		ParticleBenchmark(sim->GetEngine(), particleFrames);
+	}
+	else {
+		RunSim(sim, minutes, step, useAOI);
+	}
+
+	delete sim;
+	CoreScript::Free();
+	delete itemDefDB;
+	AnimationResourceManager::Destroy();
+	ModelResourceManager::Destroy();
+	ImageManager::Destroy();
+	TextureManager::Destroy();
+	delete ShaderManager::Instance();
+	delete GPUDevice::Instance();
+	delete JobSystem::Instance();
+	delete database;
+	delete StringPool::Instance();
+	return 0;
+}
@@ -31,6 +31,7 @@
 #include "../xegame/cgame.h"
 #include "../xegame/platformpath.h"
 #include "../engine/platformgl.h"
+#include "../engine/assetloader.h"
 
 #include "../shared/lodepng.h"
 
@@ -158,9 +159,20 @@ int main(int argc, char **argv)
 	int screenWidth = displayMode.w * 3 / 4;
 	int screenHeight = displayMode.h * 3 / 4;
 
-	if (argc == 3) {
-		screenWidth = atoi(argv[1]);
-		screenHeight = atoi(argv[2]);
+	// altera [--profile-startup] [width height]
+	const char* size[2] = { 0, 0 };
+	int nSize = 0;
+	for (int i = 1; i < argc; ++i) {
+		if (grinliz::StrEqual(argv[i], "--profile-startup")) {
+			AssetLoader::SetProfileStartup(true);
+		}
+		else if (nSize < 2) {
+			size[nSize++] = argv[i];
+		}
+	}
+	if (nSize == 2) {
+		screenWidth = atoi(size[0]);
+		screenHeight = atoi(size[1]);
 		if (screenWidth <= 0) screenWidth = SCREEN_WIDTH;
 		if (screenHeight <= 0) screenHeight = SCREEN_HEIGHT;
 	}
@@ -20,8 +20,8 @@ using namespace grinliz;
 
 static const int COUNT = 5;
 static const float FRACTION_LAND = 0.3f;
-static const int WIDTH  = MAX_MAP_SIZE;
-static const int HEIGHT = MAX_MAP_SIZE;
+static const int WIDTH  = DEFAULT_MAP_SIZE;
+static const int HEIGHT = DEFAULT_MAP_SIZE;
 
 
 int main(int argc, const char* argv[])
@@ -43,7 +43,7 @@ int main(int argc, const char* argv[])
 	clock_t startTime = clock();
 	clock_t loopTime = startTime;
 
-	WorldGen worldGen;
+	WorldGen worldGen( WIDTH );
 	worldGen.LoadFeatures( "../res/features.png" );
 
 	for( int i=0; i<count; ++i ) {
@@ -83,7 +83,7 @@ int main(int argc, const char* argv[])
 		printf( "Writing %s\n", fname.c_str() );
 		fnameP.Format( "worldgen-path%02d.png", i );
 		
-		static const int SIZE2 = MAX_MAP_SIZE*MAX_MAP_SIZE;
+		static const int SIZE2 = WIDTH*HEIGHT;
 		Color4U8* pixels = new Color4U8[SIZE2];
 
 		for( int i=0; i<SIZE2; ++i ) {
@@ -111,7 +111,7 @@ int main(int argc, const char* argv[])
 			}
 			pixels[i] = grid.ToColor();
 		}
-		lodepng_encode32_file( fname.c_str(), (const unsigned char*)pixels, MAX_MAP_SIZE, MAX_MAP_SIZE );
+		lodepng_encode32_file( fname.c_str(), (const unsigned char*)pixels, WIDTH, HEIGHT );
 
 		for( int i=0; i<SIZE2; ++i ) {
 			int path = *(worldGen.Path() + i);
@@ -129,7 +129,7 @@ int main(int argc, const char* argv[])
 				pixels[i].Set( 0, 0, 0, 255 );
 			}
 		}
-		lodepng_encode32_file( fnameP.c_str(), (const unsigned char*)pixels, MAX_MAP_SIZE, MAX_MAP_SIZE );
+		lodepng_encode32_file( fnameP.c_str(), (const unsigned char*)pixels, WIDTH, HEIGHT );
 
 		delete [] pixels;
 		delete [] sectorData;
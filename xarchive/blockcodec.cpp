@@ -0,0 +1,126 @@
+#include "blockcodec.h"
+#include "../FastLZ/fastlz.h"
+#include <string.h>
+
+using namespace grinliz;
+
+BlockCodec* BlockCodec::Create(int id)
+{
+	switch (id) {
+		case FASTLZ:	return new FastLZCodec();
+		default:		break;
+	}
+	return 0;
+}
+
+
+void BlockCodec::WriteBlock(const void* in, int nIn, FILE* fp)
+{
+	U32 size = 0;
+	if (!in || !nIn) {
+		fwrite(&size, sizeof(size), 1, fp);
+		return;
+	}
+
+	buffer.Clear();
+	int nOut = Compress(in, nIn, &buffer);
+	if (nOut > 0 && nOut < nIn) {
+		size = U32(nOut);
+		fwrite(&size, sizeof(size), 1, fp);
+		fwrite(buffer.Mem(), nOut, 1, fp);
+	}
+	else {
+		size = U32(nIn) | STORED;
+		fwrite(&size, sizeof(size), 1, fp);
+		fwrite(in, nIn, 1, fp);
+	}
+}
+
+
+int BlockCodec::ReadBlock(void* out, int nOut, FILE* fp)
+{
+	U32 size = 0;
+	if (fread(&size, sizeof(size), 1, fp) != 1) {
+		return -1;
+	}
+	if (size == 0) {
+		return 0;
+	}
+	if (size & STORED) {
+		if (int(size & ~STORED) != nOut || fread(out, nOut, 1, fp) != 1) {
+			return -1;
+		}
+		return nOut;
+	}
+	// Can't be bigger than the stored block would have been.
+	if (int(size) >= nOut) {
+		return -1;
+	}
+	buffer.Clear();
+	U8* p = buffer.PushArr(int(size));
+	if (fread(p, size, 1, fp) != 1) {
+		return -1;
+	}
+	return Decompress(p, int(size), out, nOut) ? nOut : -1;
+}
+
+
+int FastLZCodec::Compress(const void* in, int nIn, CDynArray<U8>* out)
+{
+	int start = out->Size();
+	out->PushArr(fastlz_compress_buffer_size(nIn));
+	int n = fastlz_compress(in, nIn, out->Mem() + start);
+	// Trim the worst case space back to what was used.
+	while (out->Size() > start + n) {
+		out->Pop();
+	}
+	return n;
+}
+
+
+bool FastLZCodec::Decompress(const void* in, int nIn, void* out, int nOut)
+{
+	int n = fastlz_decompress(in, nIn, out, nOut);
+	return n == nOut;
+}
+
+
+void GridFilter::Encode(const void* in, int nRecords, U8* out) const
+{
+	const U8* src = (const U8*)in;
+	const int stride = recordSize;
+	const int rowBytes = recordsPerRow * recordSize;
+
+	for (int b = 0; b < recordSize; ++b) {
+		U8* plane = out + b * nRecords;
+		const U8* s = src + b;
+		int r = 0;
+		// The first row has nothing above it.
+		for (; r < recordsPerRow && r < nRecords; ++r, s += stride) {
+			plane[r] = *s;
+		}
+		for (; r < nRecords; ++r, s += stride) {
+			plane[r] = *s ^ *(s - rowBytes);
+		}
+	}
+}
+
+
+void GridFilter::Decode(const U8* in, int nRecords, void* out) const
+{
+	U8* dst = (U8*)out;
+	const int stride = recordSize;
+	const int rowBytes = recordsPerRow * recordSize;
+
+	for (int b = 0; b < recordSize; ++b) {
+		const U8* plane = in + b * nRecords;
+		U8* d = dst + b;
+		int r = 0;
+		for (; r < recordsPerRow && r < nRecords; ++r, d += stride) {
+			*d = plane[r];
+		}
+		for (; r < nRecords; ++r, d += stride) {
+			*d = plane[r] ^ *(d - rowBytes);
+		}
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef BLOCK_CODEC_INCLUDED
+#define BLOCK_CODEC_INCLUDED
+
+#include "../grinliz/gltypes.h"
+#include "../grinliz/gldebug.h"
+#include "../grinliz/glcontainer.h"
+
+#include <stdio.h>
+
+/*	Compresses a buffer at a time, rather than the bit at a time
+	of the Squisher. The ID is written to files so that the reader
+	can find the matching codec; ids are never reused.
+*/
+class BlockCodec
+{
+public:
+	enum {
+		FASTLZ = 1		// 0 was the Squisher stream
+	};
+
+	virtual ~BlockCodec() {}
+	virtual int ID() const = 0;
+
+	// Appends the compressed data to 'out' and returns its size.
+	virtual int Compress(const void* in, int nIn, grinliz::CDynArray<U8>* out) = 0;
+	// Returns false if 'in' doesn't decompress to exactly nOut bytes.
+	virtual bool Decompress(const void* in, int nIn, void* out, int nOut) = 0;
+
+	// Writes a block as a U32 size followed by the data. Data the
+	// codec can't shrink is stored. A null 'in' writes an empty block.
+	void WriteBlock(const void* in, int nIn, FILE* fp);
+	// Returns nOut, 0 for an empty block, or -1 on error.
+	int ReadBlock(void* out, int nOut, FILE* fp);
+
+	// Null if the id isn't a block codec.
+	static BlockCodec* Create(int id);
+
+private:
+	enum {
+		STORED = 0x80000000		// high bit of the block size
+	};
+	grinliz::CDynArray<U8> buffer;
+};
+
+
+class FastLZCodec : public BlockCodec
+{
+public:
+	virtual int ID() const { return FASTLZ; }
+	virtual int Compress(const void* in, int nIn, grinliz::CDynArray<U8>* out);
+	virtual bool Decompress(const void* in, int nIn, void* out, int nOut);
+};
+
+
+/*	Pre-filter for arrays of fixed size records laid out in rows,
+	like a chunk of the WorldGrid. The records are split in to byte
+	planes (byte 0 of every record, then byte 1...) so that fields
+	that seldom change become runs, and each row is XORed with the
+	row before it so that terrain that carries on down the map
+	becomes zeros. Both give an LZ coder longer matches.
+*/
+class GridFilter
+{
+public:
+	GridFilter(int _recordSize, int _recordsPerRow) : recordSize(_recordSize), recordsPerRow(_recordsPerRow) {}
+
+	// 'in' and 'out' are nRecords*recordSize bytes, and can't overlap.
+	void Encode(const void* in, int nRecords, U8* out) const;
+	void Decode(const U8* in, int nRecords, void* out) const;
+
+private:
+	int recordSize;
+	int recordsPerRow;
+};
+
+#endif // BLOCK_CODEC_INCLUDED
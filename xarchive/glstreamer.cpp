@@ -27,14 +27,22 @@ XStream::~XStream()
 StreamWriter::StreamWriter( FILE* p_fp, int version ) 
 	:	XStream(), 
 		file( p_fp ), 
+		fileStart( 0 ),
+		flushed( 0 ),
 		depth( 0 ),
+		checksumming( false ),
+		checksum( 0 ),
 		nCompInt( 0 ),
 		nInt( 0 ),
 		nStr( 0 ),
 		nNumber( 0 )
 {
 	// Write the header:
+	if ( file ) {
+		fileStart = ftell( file );
+	}
 	idPool = 0;
+	strHash.Push( 0 );	// the empty string
 	WriteInt( version );
 	Flush();
 }
@@ -52,6 +60,8 @@ StreamWriter::~StreamWriter()
 
 void StreamWriter::WriteInt( int value )
 {
+	int start = buffer.Size();
+
 	// Very simple compression. Lead 4 bits
 	// saves the sign & #bytes needed.
 	//
@@ -81,44 +91,107 @@ void StreamWriter::WriteInt( int value )
 
 	nCompInt += nBytes + 1;
 	nInt += 4;
+
+	if ( checksumming ) {
+		Checksum( start );
+	}
+}
+
+
+int StreamReader::ReadFileInt()
+{
+	int value = 0;
+	int lead = FileByte();
+	int sign = (lead & (1<<7)) ? 1 : -1;
+	int nBytes = (lead & 0x70)>>4;
+
+	value = lead & 0xf;
+	for( int i=0; i<nBytes; ++i ) {
+		value |= (FileByte() << (4+i*8));
+	}
+	return value * sign;
+}
+
+
+int StreamReader::FileByte()
+{
+	if ( fileMem ) {
+		return filePos < fileSize ? fileMem[filePos++] : EOF;
+	}
+	return getc( fp );
+}
+
+
+void StreamReader::FileRead( void* mem, int n )
+{
+	if ( fileMem ) {
+		GLASSERT( filePos + n <= fileSize );
+		memcpy( mem, fileMem + filePos, n );
+		filePos += n;
+		return;
+	}
+	size_t didRead = fread( mem, n, 1, fp );
+	GLASSERT( didRead == 1 );
+	(void)didRead;
+}
+
+
+void StreamReader::FileSkip( int n )
+{
+	if ( fileMem ) {
+		GLASSERT( filePos + n <= fileSize );
+		filePos += n;
+		return;
+	}
+	fseek( fp, n, SEEK_CUR );
 }
 
 
 int StreamReader::ReadInt()
 {
 	int value = 0;
-	int lead = getc( fp );
+	int lead = ReadByte();
 	int sign = (lead & (1<<7)) ? 1 : -1;
 	int nBytes = (lead & 0x70)>>4;
 
 	value = lead & 0xf;
 	for( int i=0; i<nBytes; ++i ) {
-		value |= (getc(fp) << (4+i*8));
+		value |= (ReadByte() << (4+i*8));
 	}
 	return value * sign;
 }
 
 
+void StreamReader::ReadBytes( void* mem, int n )
+{
+	GLASSERT( pos + n <= data.Size() );
+	memcpy( mem, data.Mem() + pos, n );
+	pos += n;
+}
+
+
 int StreamReader::PeekByte()
 {
+	if ( pos >= data.Size() ) {
+		return READER_EOF;
+	}
 	int value = 0;
-	int lead = getc( fp );
+	int lead = data[pos];
 	int sign = (lead & (1<<7)) ? 1 : -1;
 	int nBytes = (lead & 0x70)>>4;
 	GLASSERT( nBytes == 0 );
 	(void)nBytes;
 
 	value = lead & 0xf;
-	ungetc( lead, fp );
 	return value * sign;
 }
 
 
 void StreamWriter::WriteString( const char* str )
 {
-	// Write the name.
-	// Has it been written before? Re-use, positive index.
-	// Else, negative index, then add string.
+	// Write the id of the string. New strings get the
+	// next id, and go in the string table written after
+	// the top level element.
 
 	// Special case empty string.
 	if ( str == 0 || *str == 0 ) {
@@ -127,53 +200,89 @@ void StreamWriter::WriteString( const char* str )
 	}
 
 	int index=0;
-	if ( strToIndex.Query( str, &index )) {
-		WriteInt( index );
+	if ( !strToIndex.Query( str, &index )) {
+		index = ++idPool;
+		IString istr = StringPool::Intern( str );
+		strToIndex.Add( istr.c_str(), index );
+		newStrings.Push( istr.c_str() );
+		strHash.Push( CompCharPtr::Hash( str ));
 	}
-	else {
-		idPool++;
-		WriteInt( -idPool );
-		int len = strlen( str );
-		WriteInt( len );
-		//fwrite( str, len, 1, fp );
-		WriteBuffer(str, len);
 
-		nStr += len + 1;
+	// The id depends on the order strings were first written;
+	// the checksum uses the string itself.
+	U32 c = checksum;
+	WriteInt( index );
+	checksum = (c ^ strHash[index]) * 16777619;
+}
 
-		IString istr = StringPool::Intern( str );
-		indexToStr.Add( idPool, istr.c_str() );
-		strToIndex.Add( istr.c_str(), idPool );
+
+void StreamWriter::BeginChecksum()
+{
+	GLASSERT( !checksumming );
+	checksumming = true;
+	checksum = 2166136261UL;
+}
+
+
+U32 StreamWriter::EndChecksum()
+{
+	GLASSERT( checksumming );
+	checksumming = false;
+	return checksum;
+}
+
+
+void StreamWriter::Truncate( int position )
+{
+	GLASSERT( depth > 0 );
+	GLASSERT( position >= flushed && position <= Position() );
+	GLASSERT( lengthStack.Empty() || lengthStack[lengthStack.Size()-1] < position );
+	// Strings first used after 'position' stay in the table. They
+	// aren't referenced, but cost nothing else.
+	while ( Position() > position ) {
+		buffer.Pop();
 	}
 }
 
 
+void StreamWriter::WriteStringTable()
+{
+	// Written after every top level element, even if empty,
+	// so the reader always knows what follows.
+	GLASSERT( depth == 0 );
+	WriteInt( STRING_TABLE );
+	WriteInt( newStrings.Size() );
+	for( int i=0; i<newStrings.Size(); ++i ) {
+		int len = strlen( newStrings[i] );
+		WriteInt( len );
+		WriteBuffer( newStrings[i], len );
+		nStr += len + 1;
+	}
+	newStrings.Clear();
+}
+
+
 const char* StreamReader::ReadString()
 {
 	int id = ReadInt();
+	GLASSERT( id >= 0 && id < strTable.Size() );
+	return strTable[id];
+}
 
-	if ( id == 0 ) {
-		return "";
-	}
-
-	const char* r = 0;
 
-	if ( id < 0 ) {
-		int len = ReadInt();
+void StreamReader::ReadStringTable()
+{
+	int n = ReadFileInt();
+	for( int i=0; i<n; ++i ) {
+		int len = ReadFileInt();
 		strBuf.Clear();
 		char* p = strBuf.PushArr( len );
-		size_t didRead = fread( p, len, 1, fp );
-		GLASSERT(didRead == 1);
-		(void)didRead;
+		FileRead( p, len );
 		strBuf.Push(0);
 
 		IString istr = StringPool::Intern( strBuf.Mem() );
-		indexToStr.Add( -id, istr.c_str() );
-		r = istr.c_str();
-	}
-	else {
-		r = indexToStr.Get( id );
+		strTable.Push( istr.c_str() );
 	}
-	return r;
 }
 
 
@@ -185,13 +294,13 @@ void StreamWriter::WriteReal(double value, bool isDouble)
 	if (value == 0) {
 		nNumber += 1;
 		//fputc(ENC_0, fp);
-		buffer.Push(ENC_0);
+		WriteByte(ENC_0);
 		return;
 	}
 	if (value == 1) {
 		nNumber += 1;
 		//fputc(ENC_1, fp);
-		buffer.Push(ENC_1);
+		WriteByte(ENC_1);
 		return;
 	}
 
@@ -202,7 +311,7 @@ void StreamWriter::WriteReal(double value, bool isDouble)
 		if (nBytes < realBytes) {
 			nNumber += 1;
 			//fputc(ENC_INT, fp);
-			buffer.Push(ENC_INT);
+			WriteByte(ENC_INT);
 			WriteInt(int(value));
 			return;
 		}
@@ -214,14 +323,14 @@ void StreamWriter::WriteReal(double value, bool isDouble)
 		if (nBytes < realBytes) {
 			nNumber += 1;
 			//fputc(ENC_INT2, fp);
-			buffer.Push(ENC_INT2);
+			WriteByte(ENC_INT2);
 			WriteInt(int(value * 2));
 			return;
 		}
 	}
 	if ( realBytes == 4 ) {
 		//fputc(ENC_FLOAT, fp);
-		buffer.Push(ENC_FLOAT);
+		WriteByte(ENC_FLOAT);
 		nNumber += 1 + sizeof(float);
 		float f = float(value);
 		//fwrite(&f, sizeof(float), 1, fp);
@@ -230,7 +339,7 @@ void StreamWriter::WriteReal(double value, bool isDouble)
 	}
 
 	//fputc(ENC_DOUBLE, fp);
-	buffer.Push(ENC_DOUBLE);
+	WriteByte(ENC_DOUBLE);
 	nNumber += 1 + sizeof(double);
 	//fwrite(&value, sizeof(double), 1, fp);
 	WriteBuffer(&value, sizeof(double));
@@ -249,7 +358,7 @@ void StreamWriter::WriteFloat( float value )
 
 double StreamReader::ReadReal()
 {
-	int enc = fgetc(fp);
+	int enc = ReadByte();
 	if (enc == ENC_0) {
 		return 0;
 	}
@@ -266,16 +375,12 @@ double StreamReader::ReadReal()
 	}
 	else if (enc == ENC_FLOAT) {
 		float v = 0;
-		size_t didRead = fread(&v, sizeof(v), 1, fp);
-		GLASSERT(didRead == 1);
-		(void)didRead;
+		ReadBytes(&v, sizeof(v));
 		return v;
 	}
 	// ENC_DOUBLE
 	double v = 0;
-	size_t didRead = fread(&v, sizeof(v), 1, fp);
-	GLASSERT(didRead == 1);
-	(void)didRead;
+	ReadBytes(&v, sizeof(v));
 	return v;
 }
 
@@ -286,7 +391,7 @@ float StreamReader::ReadFloat()
 	return (float)ReadReal();
 #else
 	float v = 0;
-	fread( &v, sizeof(v), 1, fp );
+	ReadBytes( &v, sizeof(v) );
 	return v;
 #endif
 }
@@ -309,7 +414,7 @@ double StreamReader::ReadDouble()
 	return ReadReal();
 #else
 	double v=0;
-	fread( &v, sizeof(v), 1, fp );
+	ReadBytes( &v, sizeof(v) );
 	return v;
 #endif
 }
@@ -317,8 +422,9 @@ double StreamReader::ReadDouble()
 
 void StreamWriter::Flush()
 {
-	if (buffer.Size()) {
+	if (file && buffer.Size()) {
 		fwrite(buffer.Mem(), buffer.Size(), 1, file);
+		flushed += buffer.Size();
 		buffer.Clear();
 	}
 }
@@ -329,6 +435,11 @@ void StreamWriter::OpenElement( const char* str )
 	++depth;
 	WriteInt( BEGIN_ELEMENT );
 	WriteString( str );
+
+	// Length is patched in CloseElement()
+	lengthStack.Push( Position() );
+	U32 length = 0;
+	WriteBuffer( &length, sizeof(length) );
 }
 
 
@@ -338,7 +449,23 @@ void StreamWriter::CloseElement()
 	--depth;
 	WriteInt( END_ELEMENT );
 
-	if (depth == 0 || buffer.Size() > 32*1000) {
+	int position = lengthStack.Pop();
+	U32 length = U32( Position() - position - sizeof(length) );
+	if ( position >= flushed ) {
+		memcpy( buffer.Mem() + position - flushed, &length, sizeof(length) );
+	}
+	else {
+		// The start of the element has been flushed.
+		fseek( file, fileStart + position, SEEK_SET );
+		fwrite( &length, sizeof(length), 1, file );
+		fseek( file, fileStart + flushed, SEEK_SET );
+	}
+
+	if (depth == 0) {
+		WriteStringTable();
+		Flush();
+	}
+	else if (file && !checksumming && buffer.Size() > FLUSH_SIZE) {
 		Flush();
 	}
 }
@@ -463,36 +590,133 @@ void StreamWriter::SetArr( const char* key, const double* value, int n )
 	}
 }
 
-StreamReader::StreamReader(FILE* p_fp) : XStream(), fp(p_fp), depth(0), version(0), peekElementName(0)
+void StreamWriter::SetBulk( const char* key, const void* mem, int nBytes )
+{
+	WriteInt( ATTRIB_BULK );
+	WriteString( key );
+
+	bool zero = IsZeroArray( (const U8*)mem, nBytes );
+
+	if ( zero ) {
+		WriteInt( -nBytes );
+	}
+	else {
+		WriteInt( nBytes );
+		WriteBuffer( mem, nBytes );
+		nNumber += nBytes;
+	}
+}
+
+
+StreamReader::StreamReader(FILE* p_fp) : XStream(), fp(p_fp), fileMem(0), fileSize(0), filePos(0), pos(0), depth(0), version(0), elementLength(0), peekElementName(0)
+{
+	version = ReadFileInt();
+	strTable.Push( "" );	// id 0 is the empty string
+}
+
+
+StreamReader::StreamReader(const U8* mem, int size) : XStream(), fp(0), fileMem(mem), fileSize(size), filePos(0), pos(0), depth(0), version(0), elementLength(0), peekElementName(0)
 {
-	version = ReadInt();
+	version = ReadFileInt();
+	strTable.Push( "" );
 }
 
+
+const char* StreamReader::ReadElementHeader( bool skip )
+{
+	const char* elementName = 0;
+	U32 length = 0;
+
+	if ( depth == 0 ) {
+		int node = ReadFileInt();
+		GLASSERT( node == BEGIN_ELEMENT );
+		int id = ReadFileInt();
+		FileRead( &length, sizeof(length) );
+
+		// The whole element is read at once, and then
+		// the table of the strings it introduced.
+		data.Clear();
+		pos = 0;
+		if ( skip ) {
+			FileSkip( length );
+		}
+		else if ( length ) {
+			FileRead( data.PushArr( length ), length );
+		}
+		node = ReadFileInt();
+		GLASSERT( node == STRING_TABLE );
+		ReadStringTable();
+
+		GLASSERT( id >= 0 && id < strTable.Size() );
+		elementName = strTable[id];
+	}
+	else {
+		int node = ReadInt();
+		GLASSERT( node == BEGIN_ELEMENT );
+		(void)node;
+		elementName = ReadString();
+		ReadBytes( &length, sizeof(length) );
+	}
+	elementLength = int(length);
+	return elementName;
+}
+
+
 const char* StreamReader::PeekElement()
 {
-	GLASSERT(peekElementName == 0);
-	peekElementName = OpenElement();
+	if (!peekElementName) {
+		peekElementName = ReadElementHeader();
+	}
 	return peekElementName;
 }
 
 
-const char* StreamReader::OpenElement()
+void StreamReader::SkipElement()
 {
-	if (peekElementName) {
-		const char* r = peekElementName;
+	if ( peekElementName ) {
 		peekElementName = 0;
-		return r;
 	}
+	else {
+		ReadElementHeader( true );
+	}
+	if ( depth == 0 ) {
+		// Already read (or skipped) with the header.
+		data.Clear();
+		pos = 0;
+	}
+	else {
+		GLASSERT( pos + elementLength <= data.Size() );
+		pos += elementLength;
+	}
+}
 
-	int node = ReadInt();
-	GLASSERT( node == BEGIN_ELEMENT );
-	(void)node;
-	const char* elementName = ReadString();
+
+bool StreamReader::SkipTo( const char* name )
+{
+	while ( HasChild() ) {
+		if ( StrEqual( PeekElement(), name )) {
+			return true;
+		}
+		SkipElement();
+	}
+	return false;
+}
+
+
+const char* StreamReader::OpenElement()
+{
+	const char* elementName = peekElementName;
+	peekElementName = 0;
+	if ( !elementName ) {
+		elementName = ReadElementHeader();
+	}
+	++depth;
 
 	attributes.Clear();
 	intData.Clear();
 	floatData.Clear();
 	doubleData.Clear();
+	stringData.Clear();
 
 	// Attributes:
 	while ( true ) {
@@ -537,6 +761,15 @@ const char* StreamReader::OpenElement()
 					stringData.Push( zero ? "" : ReadString() );
 				}
 				break;
+
+			case ATTRIB_BULK:
+				// Points into 'data'; not copied.
+				a.offset = zero ? -1 : pos;
+				if ( !zero ) {
+					GLASSERT( pos + a.n <= data.Size() );
+					pos += a.n;
+				}
+				break;
 		
 			default:
 				GLASSERT( 0 );
@@ -555,6 +788,9 @@ const char* StreamReader::OpenElement()
 
 bool StreamReader::HasChild()
 {
+	if ( peekElementName ) {
+		return true;
+	}
 	int c = PeekByte();
 	return c == BEGIN_ELEMENT;
 }
@@ -562,9 +798,12 @@ bool StreamReader::HasChild()
 
 void StreamReader::CloseElement()
 {
+	GLASSERT( depth > 0 );
 	int node = ReadInt();
 	GLASSERT( node == END_ELEMENT );
 	(void)node;
+	--depth;
+	GLASSERT( depth > 0 || pos == data.Size() );
 }
 
 
@@ -626,6 +865,19 @@ void StreamReader::Value( const Attribute* a, IString* value, int size, int offs
 	}
 }
 
+void StreamReader::Bulk( const Attribute* a, void* mem, int nBytes ) const
+{
+	GLASSERT( a->type == ATTRIB_BULK );
+	GLASSERT( nBytes <= a->n );
+	if ( a->offset < 0 ) {
+		memset( mem, 0, nBytes );
+	}
+	else {
+		memcpy( mem, data.Mem() + a->offset, nBytes );
+	}
+}
+
+
 const char* StreamReader::Value( const Attribute* a, int index ) const
 {
 	GLASSERT( a->type == ATTRIB_STRING );
@@ -688,6 +940,10 @@ void DumpStream( StreamReader* reader, int depth )
 			printf( ") " );
 			break;
 
+		case XStream::ATTRIB_BULK:
+			printf( "%s=(b:%d bytes) ", attr->key, attr->n );
+			break;
+
 		default:
 			GLASSERT( 0 );
 		}
@@ -745,3 +1001,187 @@ void XarcSet( XStream* xs, const char* key, const grinliz::Matrix4& v )
 		XarcSetArr( xs, key, v.Mem(), 16 );
 	}
 }
+
+
+// Big enough to flush a file stream several times, in the
+// middle of both the top level element and its children.
+static const int TEST_GROUPS = 4;
+static const int TEST_CHILDREN = 500;
+
+static void WriteTestStream( StreamWriter* writer )
+{
+	writer->OpenElement( "Root" );
+	writer->Set( "version", 3 );
+	writer->Set( "name", "root" );
+
+	for( int g=0; g<TEST_GROUPS; ++g ) {
+		writer->OpenElement( "Group" );
+		if ( g == 0 ) {
+			// Written and then taken back out.
+			int position = writer->Position();
+			writer->BeginChecksum();
+			writer->OpenElement( "Dropped" );
+			writer->Set( "dropped", 1 );
+			writer->CloseElement();
+			writer->EndChecksum();
+			writer->Truncate( position );
+		}
+		for( int c=0; c<TEST_CHILDREN; ++c ) {
+			int i = g*TEST_CHILDREN + c;
+			CStr<16> key;
+			key.Format( "k%d", i );
+
+			U8 bytes[64];
+			for( int k=0; k<64; ++k ) {
+				bytes[k] = U8( i + k );
+			}
+			static const U8 zero[16] = { 0 };
+
+			writer->OpenElement( "Child" );
+			writer->Set( "i", i );
+			writer->Set( key.c_str(), float(i)*0.25f );
+			writer->SetBulk( "bulk", bytes, 64 );
+			writer->SetBulk( "zero", zero, 16 );
+			if ( i % 100 == 0 ) {
+				writer->OpenElement( "Nested" );
+				writer->Set( "s", key.c_str() );
+				writer->CloseElement();
+			}
+			writer->CloseElement();
+		}
+		writer->CloseElement();
+	}
+	writer->CloseElement();
+
+	writer->OpenElement( "Second" );
+	writer->Set( "name", "k1999" );	// from the table of the first element
+	writer->Set( "d", 1.5 );
+	writer->CloseElement();
+}
+
+
+static void ReadTestSecond( StreamReader* reader )
+{
+	const char* name = reader->OpenElement();
+	GLTEST( StrEqual( name, "Second" ));
+	IString str;
+	double d = 0;
+	XarcGet( reader, "name", str );
+	XarcGet( reader, "d", d );
+	GLTEST( str == "k1999" );
+	GLTEST( d == 1.5 );
+	GLTEST( !reader->HasChild() );
+	reader->CloseElement();
+}
+
+
+static void ReadTestStream( StreamReader* reader )
+{
+	GLTEST( reader->Version() == 1 );
+	const char* name = reader->OpenElement();
+	GLTEST( StrEqual( name, "Root" ));
+	int version = 0;
+	IString str;
+	XarcGet( reader, "version", version );
+	XarcGet( reader, "name", str );
+	GLTEST( version == 3 );
+	GLTEST( str == "root" );
+
+	for( int g=0; g<TEST_GROUPS; ++g ) {
+		name = reader->OpenElement();
+		GLTEST( StrEqual( name, "Group" ));
+		for( int c=0; c<TEST_CHILDREN; ++c ) {
+			int i = g*TEST_CHILDREN + c;
+			CStr<16> key;
+			key.Format( "k%d", i );
+
+			name = reader->OpenElement();
+			GLTEST( StrEqual( name, "Child" ));
+
+			int v = -1;
+			float f = 0;
+			U8 bytes[64], zero[16];
+			memset( zero, 0xff, 16 );
+			XarcGet( reader, "i", v );
+			XarcGet( reader, key.c_str(), f );
+			XarcGetBulk( reader, "bulk", bytes, 64 );
+			XarcGetBulk( reader, "zero", zero, 16 );
+			GLTEST( v == i );
+			GLTEST( f == float(i)*0.25f );
+			for( int k=0; k<64; ++k ) {
+				GLTEST( bytes[k] == U8( i + k ));
+			}
+			for( int k=0; k<16; ++k ) {
+				GLTEST( zero[k] == 0 );
+			}
+
+			GLTEST( reader->HasChild() == (i % 100 == 0) );
+			if ( i % 100 == 0 ) {
+				name = reader->OpenElement();
+				GLTEST( StrEqual( name, "Nested" ));
+				XarcGet( reader, "s", str );
+				GLTEST( str == key.c_str() );
+				reader->CloseElement();
+			}
+			reader->CloseElement();
+		}
+		GLTEST( !reader->HasChild() );
+		reader->CloseElement();
+	}
+	GLTEST( !reader->HasChild() );
+	reader->CloseElement();
+
+	ReadTestSecond( reader );
+}
+
+
+void XStream::Test()
+{
+	StreamWriter memWriter( 0, 1 );
+	WriteTestStream( &memWriter );
+	const CDynArray<U8>& mem = memWriter.Data();
+
+	{
+		StreamReader reader( mem.Mem(), mem.Size() );
+		ReadTestStream( &reader );
+	}
+	{
+		StreamReader reader( mem.Mem(), mem.Size() );
+		GLTEST( StrEqual( reader.PeekElement(), "Root" ));
+		reader.SkipElement();
+		ReadTestSecond( &reader );
+	}
+
+	// A file stream is flushed as it goes, and has to come
+	// out the same as the memory stream.
+	FILE* fp = tmpfile();
+	GLASSERT( fp );
+	if ( !fp ) {
+		return;
+	}
+	{
+		StreamWriter fileWriter( fp, 1 );
+		WriteTestStream( &fileWriter );
+	}
+	long size = ftell( fp );
+	GLTEST( size == mem.Size() );
+
+	CDynArray<U8> file;
+	fseek( fp, 0, SEEK_SET );
+	size_t didRead = fread( file.PushArr( int(size) ), size, 1, fp );
+	GLTEST( didRead == 1 );
+	GLTEST( memcmp( file.Mem(), mem.Mem(), mem.Size() ) == 0 );
+
+	{
+		fseek( fp, 0, SEEK_SET );
+		StreamReader reader( fp );
+		ReadTestStream( &reader );
+	}
+	{
+		fseek( fp, 0, SEEK_SET );
+		StreamReader reader( fp );
+		reader.SkipElement();
+		ReadTestSecond( &reader );
+	}
+	fclose( fp );
+}
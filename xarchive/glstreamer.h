@@ -35,30 +35,43 @@ public:
 	//			EndNode
 	//		EndNode
 	//	EndNode
+	//	StringTable
+	//
+	// Every top level element is followed by a StringTable of the
+	// strings (keys, names, values) it uses for the first time. In
+	// the body, a string is just its id in the table. Each element
+	// stores its length, so a reader can load a top level element
+	// with one read (and then its table), or skip an element without
+	// parsing it. Since the table comes last, a writer can flush
+	// in the middle of an element.
 
 	// chunks
 	enum {
 		READER_EOF = 0,
-		BEGIN_ELEMENT,		// name:String,
+		BEGIN_ELEMENT,		// name:String, length:U32 (bytes that follow, through END_ELEMENT)
 		END_ELEMENT,
+		STRING_TABLE,		// count:int, count * (length:int, chars)
 		ATTRIB_INT,
 		ATTRIB_FLOAT,
 		ATTRIB_DOUBLE,
 		ATTRIB_STRING,
+		ATTRIB_BULK,		// raw bytes of POD data
 
 		ATTRIB_START = ATTRIB_INT,
-		ATTRIB_END = ATTRIB_STRING+1
+		ATTRIB_END = ATTRIB_BULK+1
 	};
 
 
 	// Attrib:
 	//		type: int
 	//		name: string
-	//		count: int
+	//		count: int (bytes, for ATTRIB_BULK)
 	//		values[count] of type
 	virtual StreamWriter* Saving() { return 0; }
 	virtual StreamReader* Loading() { return 0; }
 
+	static void Test();
+
 protected:
 	enum {
 		ENC_0 = ATTRIB_END+1,
@@ -69,7 +82,6 @@ protected:
 		ENC_DOUBLE,
 	};
 
-	grinliz::HashTable< int, const char* >							indexToStr;
 	// The string is not interned on lookup. Need the CompCharPtr
 	grinliz::HashTable< const char*, int, grinliz::CompCharPtr >	strToIndex;
 };
@@ -77,11 +89,15 @@ protected:
 
 class StreamWriter : public XStream {
 public:
+	// If p_fp is null, the stream is kept in memory; see Data().
 	StreamWriter( FILE* p_fp, int version );
 	~StreamWriter();
 
 	virtual StreamWriter* Saving() { return this; }
 
+	// The memory stream. (Empty if writing to a file.)
+	const grinliz::CDynArray<U8>& Data() const { return buffer; }
+
 	void OpenElement( const char* name );
 	void CloseElement();
 
@@ -97,6 +113,24 @@ public:
 	void SetArr( const char* key, const char* value[], int n );
 	void SetArr( const char* key, const grinliz::IString* value, int n );
 
+	// Raw memory; only for POD data. Much faster to write and
+	// read than the encoded arrays, but not compressed.
+	void SetBulk( const char* key, const void* mem, int nBytes );
+
+	// A checksum of everything written between the calls, where
+	// strings count by value rather than id. Used to tell if an
+	// object has changed since it was last written.
+	void BeginChecksum();
+	U32 EndChecksum();
+
+	// Position() and Truncate() remove what was written after
+	// the position. Only in an element, and any elements opened
+	// after the position must be closed. A file stream doesn't
+	// flush while checksumming, so a checksummed object can always
+	// be truncated.
+	int Position() const				{ return flushed + buffer.Size(); }
+	void Truncate( int position );
+
 private:
 	int  NumBytesFollow(int value) {
 		int nBits = grinliz::LogBase2(value) + 1;
@@ -109,16 +143,39 @@ private:
 	void WriteDouble( double value );
 	void WriteReal(double value, bool isDouble);
 
+	void WriteByte(U8 b) {
+		buffer.Push(b);
+		if (checksumming) Checksum(buffer.Size() - 1);
+	}
 	void WriteBuffer(const void* data, int size) {
 		U8* p = buffer.PushArr(size);
 		memcpy(p, data, size);
+		if (checksumming) Checksum(buffer.Size() - size);
+	}
+	void Checksum(int start) {
+		for (int i = start; i < buffer.Size(); ++i) {
+			checksum = (checksum ^ buffer[i]) * 16777619;
+		}
 	}
+	void WriteStringTable();
 	void Flush();
+
+	// A file stream is written out when a top level element
+	// closes, or when a child closes and this much is buffered.
+	enum { FLUSH_SIZE = 32*1000 };
+
 	grinliz::CDynArray<U8> buffer;
+	grinliz::CDynArray<int> lengthStack;			// position of the length of each open element
+	grinliz::CDynArray<const char*> newStrings;	// first used in the current top level element
+	grinliz::CDynArray<U32> strHash;				// hash of each string, by id
 
 	FILE* file;
+	long fileStart;
+	int flushed;		// bytes written to the file
 	int idPool;
 	int depth;
+	bool checksumming;
+	U32 checksum;
 
 	// Integers include integer values, markers in the stream, and string IDs
 	int nCompInt;	
@@ -133,6 +190,8 @@ private:
 class StreamReader : public XStream {
 public:
 	StreamReader( FILE* fp );
+	// Reads a memory stream, as written by a StreamWriter with no file.
+	StreamReader( const U8* mem, int size );
 	~StreamReader()	{}
 
 	int Version() const { return version; }
@@ -155,11 +214,19 @@ public:
 	void Value( const Attribute* a, grinliz::IString* value, int size, int offset=0 ) const;
 
 	const char* Value( const Attribute* a, int index ) const;
+	// Read an ATTRIB_BULK; nBytes must be <= a->n
+	void Bulk( const Attribute* a, void* mem, int nBytes ) const;
 
 	// returns the name of the element; next call must be OpenElement()
+	// or SkipElement().
 	// Allows for name = PeekElement(); switch(name)... OpenElement()
 	const char*			PeekElement();		
 	const char*			OpenElement();
+	// Skips the next element, and all its children, without parsing it.
+	void				SkipElement();
+	// Skips child elements up to the one called 'name', which is
+	// then next to open. Returns false if there isn't one.
+	bool				SkipTo( const char* name );
 
 	const Attribute*	Attributes() const			{ return attributes.Mem(); }
 	int					NumAttributes() const		{ return attributes.Size(); }
@@ -169,6 +236,19 @@ public:
 	const Attribute*	Get( const char* key );
 
 private:
+	// The version, string tables, and the header of a top level
+	// element come from the file. Everything else is read from
+	// 'data', which holds the current top level element.
+	int ReadFileInt();
+	int FileByte();
+	void FileRead( void* mem, int n );
+	void FileSkip( int n );
+	void ReadStringTable();
+	// At the top level, also reads (or skips) the element and its string table.
+	const char* ReadElementHeader( bool skip=false );
+
+	int ReadByte()	{ GLASSERT( pos < data.Size() ); return data[pos++]; }
+	void ReadBytes( void* mem, int n );
 	int ReadInt();
 	float ReadFloat();
 	double ReadDouble();
@@ -176,6 +256,8 @@ private:
 	int PeekByte();
 	double ReadReal();
 
+	grinliz::CDynArray< U8 > data;
+	grinliz::CDynArray< const char* > strTable;	// indexed by string id; interned
 	grinliz::CDynArray< char > strBuf;
 	grinliz::CDynArray< int > intData;
 	grinliz::CDynArray< float > floatData;
@@ -184,8 +266,13 @@ private:
 	grinliz::CDynArray< Attribute > attributes;
 
 	FILE* fp;
+	const U8* fileMem;		// in place of 'fp' for a memory stream
+	int fileSize;
+	int filePos;
+	int pos;
 	int depth;
 	int version;
+	int elementLength;
 	const char* peekElementName;
 };
 
@@ -244,6 +331,18 @@ inline bool XarcGetArr( XStream* stream, const char* key, grinliz::Vector2<T>* v
 }
 
 
+template< class T >
+inline bool XarcGetBulk( XStream* stream, const char* key, T* value, int n ) {
+	GLASSERT( stream->Loading() );
+	const StreamReader::Attribute* attr = stream->Loading()->Get( key );
+	if ( attr ) {
+		stream->Loading()->Bulk( attr, value, n * sizeof(T) );
+		return true;
+	}
+	return false;
+}
+
+
 template< class T >
 void XarcSet( XStream* stream, const char* key, const T& value ) {
 	GLASSERT( stream->Saving() );
@@ -262,6 +361,12 @@ inline void XarcSetArr( XStream* stream, const char* key, const grinliz::IString
 	stream->Saving()->SetArr( key, value, n );
 }
 
+template< class T >
+void XarcSetBulk( XStream* stream, const char* key, const T* value, int n ) {
+	GLASSERT( stream->Saving() );
+	stream->Saving()->SetBulk( key, value, n * sizeof(T) );
+}
+
 template< class T >
 inline void XarcSetArr( XStream* stream, const char* key, const grinliz::Vector2<T>* value, int n ) {
 	GLASSERT( stream->Saving() );
@@ -380,6 +485,15 @@ void XarcSet(XStream* xs, const char* key, const grinliz::Matrix4& v);
 		XarcGetArr( stream, #name, name, n );		\
 }
 
+// Serialize an array of POD structures (or primitives)
+// as raw memory.
+#define XARC_SER_BULK( stream, name, n ) {			\
+	if ( (stream)->Saving() )						\
+		XarcSetBulk( stream, #name, name, n );		\
+	else											\
+		XarcGetBulk( stream, #name, name, n );		\
+}
+
 // Serialize a CArray or CDynArray with structures 
 // with Serialize methods.
 #define XARC_SER_CARRAY( stream, arr ) {					\
@@ -399,6 +513,22 @@ void XarcSet(XStream* xs, const char* key, const grinliz::Matrix4& v);
 	XarcClose(xs);											\
 }
 
+// Serialize a CArray or CDynArray of POD structures
+// as raw memory.
+#define XARC_SER_POD_CARRAY( stream, arr ) {				\
+	if ( (stream)->Saving() ) {								\
+		(stream)->Saving()->Set( #arr ".size", arr.Size()); \
+		XarcSetBulk(stream, #arr, arr.Mem(), arr.Size());	\
+	}														\
+	else {													\
+		int _size = 0;										\
+		XarcGet( stream, #arr ".size", _size );				\
+		arr.Clear();										\
+		arr.PushArr( _size );								\
+		XarcGetBulk(stream, #arr, arr.Mem(), arr.Size());	\
+	}														\
+}
+
 // Serialize a CArray or CDynArray of primitives.
 #define XARC_SER_VAL_CARRAY( stream, arr ) {				\
 	if ( (stream)->Saving() ) {								\
@@ -34,6 +34,13 @@ Chit::Chit( int _id, ChitBag* bag ) :
 	next( 0 ), 
 	timeToTick( 0 ), 
 	timeSince( 0 ),
+	lod( LOD_FULL ),
+	lastTick( 0 ),
+	dueTime( 0 ),
+	wheelSlot( -1 ),
+	wheelNext( 0 ),
+	wheelPrev( 0 ),
+	saveDirty( true ),
 	chitBag( bag ), 
 	id( _id ), 
 	playerControlled( false )
@@ -57,6 +64,10 @@ void Chit::Init( int _id, ChitBag* _chitBag )
 	random.SetSeed( _id );
 	timeToTick = 0;
 	timeSince = 0;
+	lod = LOD_FULL;
+	lastTick = dueTime = 0;
+	GLASSERT(wheelSlot < 0);
+	MarkChanged();
 	playerControlled = false;
 
 	position.Zero();
@@ -94,7 +105,19 @@ void Chit::Serialize(XStream* xs)
 {
 	XarcOpen( xs, "Chit" );
 	XARC_SER( xs, id );
-	XARC_SER( xs, timeSince );
+	// The bag time of the last tick, rather than the time since,
+	// so a chit that hasn't ticked saves the same every time.
+	// Older saves have 'timeSince'.
+	if (xs->Saving()) {
+		XARC_SER( xs, lastTick );
+	}
+	else if (!XarcGet( xs, "lastTick", lastTick )) {
+		timeSince = 0;
+		XarcGet( xs, "timeSince", timeSince );
+		if (chitBag) {
+			lastTick = chitBag->AbsTime() - U32(timeSince);
+		}
+	}
 	XARC_SER_DEF( xs, playerControlled, false );
 	XARC_SER(xs, position);
 	XARC_SER(xs, rotation);
@@ -139,6 +162,7 @@ bool Chit::StackedMoveComponent() const
 void Chit::Add( Component* c, bool loading )
 {
 	if (!c) return;
+	MarkChanged();
 
 	if ( c->ToSpatialComponent()) {
 		GLASSERT( spatialComponent == 0 );
@@ -207,7 +231,8 @@ void Chit::Add( Component* c, bool loading )
 		GLASSERT(i < NUM_GENERAL);
 	}
 	c->OnAdd( this, !loading );
-	timeToTick = 0;
+	SetTickNeeded();
+	if (chitBag) chitBag->UpdateSpatialFlags(this);
 
 	GLASSERT(!spatialComponent || spatialComponent->ToSpatialComponent());
 	GLASSERT(!moveComponent || moveComponent->ToMoveComponent());
@@ -220,7 +245,7 @@ void Chit::Add( Component* c, bool loading )
 
 Component* Chit::Remove( Component* c )
 {
-	timeToTick = 0;
+	SetTickNeeded();
 	for( int i=0; i<NUM_SLOTS; ++i ) {
 		if ( slot[i] == c ) {
 			c->OnRemove();
@@ -242,6 +267,7 @@ Component* Chit::Remove( Component* c )
 			GLASSERT(!aiComponent || aiComponent->ToAIComponent());
 			GLASSERT(!healthComponent || healthComponent->ToHealthComponent());
 			GLASSERT(!renderComponent || renderComponent->ToRenderComponent());
+			if (chitBag) chitBag->UpdateSpatialFlags(this);
 			return c;
 		}
 	}
@@ -252,6 +278,7 @@ Component* Chit::Remove( Component* c )
 
 Component* Chit::GetComponent(const char* name)
 {
+	MarkChanged();
 	for( int i=0; i<NUM_SLOTS; ++i ) {
 		if ( slot[i] && StrEqual( name, slot[i]->Name())) {
 			return slot[i];
@@ -263,6 +290,7 @@ Component* Chit::GetComponent(const char* name)
 
 Component* Chit::GetComponent( int id )
 {
+	MarkChanged();
 	for( int i=0; i<NUM_SLOTS; ++i ) {
 		if ( slot[i] && slot[i]->ID() == id ) {
 			return slot[i];
@@ -272,10 +300,21 @@ Component* Chit::GetComponent( int id )
 }
 
 
+void Chit::SetTickNeeded()
+{
+	MarkChanged();
+	if (chitBag)
+		chitBag->WakeChit(this);
+	else
+		timeToTick = 0;
+}
+
+
 void Chit::DoTick()
 {
 	timeToTick = MAX_FRAME_TIME;	// fixes "long frame time" bugs that plague the components, for very little (any?) perf impact.
 	GLASSERT(timeSince >= 0);
+	MarkChanged();
 	bool hasMove = moveComponent != 0;
 
 	for (int i = 0; i < NUM_SLOTS; ++i) {
@@ -294,8 +333,20 @@ void Chit::DoTick()
 }
 
 
+bool Chit::ParallelTickSafe() const
+{
+	for (int i = 0; i < NUM_SLOTS; ++i) {
+		if (slot[i] && !slot[i]->ParallelTickSafe()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
 void Chit::OnChitEvent( const ChitEvent& event )
 {
+	MarkChanged();
 	for( int i=0; i<NUM_SLOTS; ++i ) {
 		if ( slot[i] ) {
 			slot[i]->OnChitEvent( event );
@@ -307,6 +358,7 @@ void Chit::OnChitEvent( const ChitEvent& event )
 void Chit::SendMessage( const ChitMsg& msg, Component* exclude )
 {
 	GLASSERT(chitBag);
+	MarkChanged();
 	switch (msg.ID()) {
 		case ChitMsg::CHIT_DESTROYED:
 		case ChitMsg::CHIT_DAMAGE:
@@ -338,9 +390,19 @@ GameItem* Chit::GetItem()
 }
 
 
+const GameItem* Chit::GetItem() const
+{
+	const ItemComponent* pIC = itemComponent;
+	if ( pIC ) {
+		return pIC->GetItem();
+	}
+	return 0;
+}
+
+
 int Chit::GetItemID()
 {
-	const GameItem* gi = GetItem();
+	const GameItem* gi = static_cast<const Chit*>(this)->GetItem();
 	if (gi) return gi->ID();
 	return 0;
 }
@@ -406,22 +468,21 @@ void Chit::DebugStr( GLString* str )
 
 void Chit::SetPosition(const grinliz::Vector3F& newPosition)
 {
-	static Chit* checkRecursion = nullptr;
+	static thread_local Chit* checkRecursion = nullptr;
 	Chit* oldRecurse = checkRecursion;
 	GLASSERT(checkRecursion != this);		// don't call setPosition in setPosition!
 	checkRecursion = this;
 
-	Vector2I oldWorld = ToWorld2I(position);
-	Vector2I newWorld = ToWorld2I(newPosition);
+	if (position != newPosition) {
+		Vector2I oldWorld = ToWorld2I(position);
+		Vector2I newWorld = ToWorld2I(newPosition);
+		position = newPosition;
 
-	if (oldWorld != newWorld) {
-		// update an existing hash.
+		// update an existing hash. The spatial grid keeps the
+		// position, so this is needed even within a cell.
 		GLASSERT(chitBag);
 		chitBag->UpdateSpatialHash(this, oldWorld.x, oldWorld.y, newWorld.x, newWorld.y);
-	}
 
-	if (position != newPosition) {
-		position = newPosition;
 		SendMessage(ChitMsg(ChitMsg::CHIT_POS_CHANGE));
 		SetTickNeeded();
 	}
@@ -27,6 +27,8 @@
 
 #include "../tinyxml2/tinyxml2.h"
 
+#include <atomic>
+
 class Component;
 class SpatialComponent;
 class RenderComponent;
@@ -119,6 +121,17 @@ private:
 #define GET_GENERAL_COMPONENT( chit, name ) static_cast<name*>( chit->GetComponent( #name ) )
 #define GET_SUB_COMPONENT( chit, top, sub ) ( chit->Get##top() ? chit->Get##top()->To##sub() : 0 )
 
+/*	Simulation level of detail. The ChitBag sets it from the
+	distance to the camera, the player's domain, and fighting.
+	Components check it to skip the expensive parts.
+*/
+enum {
+	LOD_FULL,			// everything, as often as the components ask
+	LOD_COARSE,			// no line of sight or avoidance; ticks less often
+	LOD_STATISTICAL,	// no searching for enemies or needs; ticks rarely
+	NUM_LOD
+};
+
 /*	General purpose GameObject.
 	A class to hold Components.
 	Actually a POD. Do not subclass.
@@ -141,19 +154,25 @@ public:
 	void Add( Component*, bool loading=false );
 	Component* Remove( Component* );
 
-	void SetTickNeeded()		{ timeToTick = 0; }
+	// Ticks next frame. Moves the chit up in the ChitBag's tick wheel.
+	void SetTickNeeded();
 	void DoTick();
+	int LOD() const				{ return lod; }
+	// True if every component can tick in parallel.
+	bool ParallelTickSafe() const;
 
 	void OnChitEvent( const ChitEvent& event );
 
 	SpatialComponent*	GetSpatialComponent()			{ return spatialComponent; }
 	const SpatialComponent*	GetSpatialComponent() const	{ return spatialComponent; }
 
-	MoveComponent*		GetMoveComponent()		{ return moveComponent; }
-	ItemComponent*		GetItemComponent()		{ return itemComponent; }
-	AIComponent*		GetAIComponent()		{ return aiComponent; }
-	HealthComponent*	GetHealthComponent()	{ return healthComponent; }
-	RenderComponent*	GetRenderComponent()	{ return renderComponent; }
+	// The non-const accessors can be used to change the chit,
+	// so they mark it for the next save. (See MarkChanged().)
+	MoveComponent*		GetMoveComponent()		{ MarkChanged(); return moveComponent; }
+	ItemComponent*		GetItemComponent()		{ MarkChanged(); return itemComponent; }
+	AIComponent*		GetAIComponent()		{ MarkChanged(); return aiComponent; }
+	HealthComponent*	GetHealthComponent()	{ MarkChanged(); return healthComponent; }
+	RenderComponent*	GetRenderComponent()	{ MarkChanged(); return renderComponent; }
 
 	Component* GetComponent( int id );
 	Component* GetComponent( const char* name );
@@ -167,7 +186,7 @@ public:
 	// Returns the item if this has the ItemComponent.
 	GameItem* GetItem();
 	int GetItemID();
-	const GameItem* GetItem() const	{ return const_cast<const GameItem*>(const_cast<Chit*>(this)->GetItem()); }
+	const GameItem* GetItem() const;
 	Wallet* GetWallet();
 	bool PlayerControlled() const;	// more correctly: IsAvatar()
 
@@ -190,7 +209,24 @@ public:
 	// for components, so there is one random # generator per chit (not per component)
 	grinliz::Random random;
 	int timeToTick;		// time until next tick needed: set by DoTick() call
-	int timeSince;		// time since the last tick
+	int timeSince;		// time since the last tick: set by the ChitBag before DoTick()
+	int lod;			// LOD_FULL, etc. Set by the ChitBag when the chit is due.
+
+	// used by the ChitBag's TickWheel:
+	U32 lastTick;		// bag time of the last tick
+	U32 dueTime;
+	int wheelSlot;		// -1 if not scheduled
+	Chit* wheelNext;
+	Chit* wheelPrev;
+
+	// Called by anything that may change the chit: a tick, a message,
+	// moving, or a non-const accessor. Cleared when a save writes it;
+	// a chit that isn't marked is skipped by a delta save. Marking is
+	// conservative: a false mark costs a serialize, a missed one would
+	// lose state. Atomic, since other chits can mark it from the
+	// parallel tick.
+	void MarkChanged()		{ saveDirty.store(true, std::memory_order_relaxed); }
+	std::atomic<bool> saveDirty;
 
 	const grinliz::Vector3F& Position() const			{ return position; }
 
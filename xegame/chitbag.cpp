@@ -24,6 +24,7 @@
 
 #include "../engine/model.h"
 #include "../engine/engine.h"
+#include "../grinliz/gljobsystem.h"
 #include "../Shiny/include/Shiny.h"
 #include "../tinyxml2/tinyxml2.h"
 #include "../xarchive/glstreamer.h"
@@ -31,15 +32,24 @@
 using namespace grinliz;
 using namespace tinyxml2;
 
+thread_local ChitBag::TickCommands* ChitBag::tickCommands = 0;
+const int ChitBag::LOD_INTERVAL[NUM_LOD] = { 0, 250, 2000 };
+
 ChitBag::ChitBag(const ChitContext& c) : chitContext(c)
 {
 	idPool = 0;
 	frame = 0;
+	for (int i = 0; i < NUM_LOD; ++i) {
+		lodCount[i] = 0;
+		lodBudget[i] = 0;
+	}
 	bagTime = 0;
-#ifdef USE_SPACIAL_HASH
-#else
-	memset( spatialHash, 0, sizeof(*spatialHash)*SIZE2 );
-#endif
+	saveBase = 0;
+	saveLast = 0;
+	saveChecksums = 0;
+	loadBase = 0;
+	parallelTick = false;
+	tickBuckets = 0;
 	memRoot = 0;
 	newsHistory = new NewsHistory(this);
 	areaOfInterest.Set(0, 0, 0, 0, 0, 0);
@@ -52,6 +62,7 @@ ChitBag::~ChitBag()
 	newsHistory = 0;
 
 	DeleteAll();
+	delete[] tickBuckets;
 	RenderComponent::textLabelPool.FreePool();
 	RenderComponent::imagePool.FreePool();
 	RenderComponent::hudPool.FreePool();
@@ -66,8 +77,13 @@ void ChitBag::DeleteAll()
 		Chit* block = blocks.Pop();
 		delete [] block;
 	}
+	memRoot = 0;
 	GameItem::trackWallet = true;
 	bolts.Clear();
+	tickWheel.Clear(bagTime);
+	for (int i = 0; i < NUM_LOD; ++i) {
+		lodCount[i] = 0;
+	}
 }
 
 
@@ -75,19 +91,66 @@ void ChitBag::Serialize(XStream* xs)
 {
 	XarcOpen(xs, "ChitBag");
 	XARC_SER(xs, bagTime);
+	if (xs->Loading()) {
+		GLASSERT(tickWheel.Size() == 0);
+		tickWheel.Clear(bagTime);
+	}
+	// Saved, rather than only recovered from the loaded chits:
+	// chits that are paged out still hold their ids.
+	if (xs->Loading()) idPool = 0;
+	XARC_SER(xs, idPool);
 	newsHistory->Serialize(xs);
 
 	if (xs->Saving()) {
+		StreamWriter* writer = xs->Saving();
 		XarcOpen(xs, "Chits");
 		for (int i = 0; i < chitID.Size(); ++i) {
 			Chit* chit = chitID.GetValue(i);
+			U32 baseChecksum = 0, lastChecksum = 0;
+			if (   saveBase && saveLast && !chit->saveDirty
+				&& saveLast->Query(chit->ID(), &lastChecksum)
+				&& saveBase->Query(chit->ID(), &baseChecksum)
+				&& lastChecksum == baseChecksum)
+			{
+				// Not touched since the last save, and the same as the base then.
+				saveChecksums->Add(chit->ID(), lastChecksum);
+				continue;
+			}
+
+			int position = writer->Position();
+			if (saveChecksums) {
+				writer->BeginChecksum();
+			}
 			XarcOpen(xs, "id");
 			xs->Saving()->Set("id", chit->ID());
 			XarcClose(xs);
 			chit->Serialize(xs);
+
+			if (saveChecksums) {
+				U32 checksum = writer->EndChecksum();
+				saveChecksums->Add(chit->ID(), checksum);
+				chit->saveDirty = false;
+				if (saveBase && saveBase->Query(chit->ID(), &baseChecksum) && baseChecksum == checksum) {
+					// Unchanged since the base save.
+					writer->Truncate(position);
+				}
+			}
 		}
 		XarcClose(xs);
 
+		if (saveBase) {
+			CDynArray<int> deleted;
+			for (int i = 0; i < saveBase->Size(); ++i) {
+				int id = saveBase->GetKey(i);
+				if (!chitID.Query(id, 0)) {
+					deleted.Push(id);
+				}
+			}
+			XarcOpen(xs, "Deleted");
+			XARC_SER_VAL_CARRAY(xs, deleted);
+			XarcClose(xs);
+		}
+
 		XarcOpen(xs, "Bolts");
 		for (int i = 0; i < bolts.Size(); ++i) {
 			bolts[i].Serialize(xs);
@@ -95,8 +158,6 @@ void ChitBag::Serialize(XStream* xs)
 		XarcClose(xs);
 	}
 	else {
-		idPool = 0;
-
 		XarcOpen(xs, "Chits");
 		while (xs->Loading()->HasChild()) {
 
@@ -112,6 +173,21 @@ void ChitBag::Serialize(XStream* xs)
 		}
 		XarcClose(xs);
 
+		if (xs->Loading()->HasChild() && StrEqual(xs->Loading()->PeekElement(), "Deleted")) {
+			CDynArray<int> deleted;
+			XarcOpen(xs, "Deleted");
+			XARC_SER_VAL_CARRAY(xs, deleted);
+			XarcClose(xs);
+
+			if (loadBase) {
+				HashTable<int, bool> deletedID;
+				for (int i = 0; i < deleted.Size(); ++i) {
+					deletedID.Add(deleted[i], true);
+				}
+				LoadBaseChits(loadBase, &deletedID);
+			}
+		}
+
 		XarcOpen(xs, "Bolts");
 		while (xs->Loading()->HasChild()) {
 			Bolt* b = bolts.PushArr(1);
@@ -123,8 +199,37 @@ void ChitBag::Serialize(XStream* xs)
 }
 
 
+void ChitBag::LoadBaseChits(StreamReader* base, HashTable<int, bool>* deleted)
+{
+	// The delta has the chits that changed (already loaded) and
+	// the ones that were deleted. Everything else is in the base.
+	if (!base->SkipTo("ChitBag")) return;
+	XarcOpen(base, "ChitBag");
+	if (!base->SkipTo("Chits")) return;
+	XarcOpen(base, "Chits");
+
+	while (base->HasChild()) {
+		int id = 0;
+		XarcOpen(base, "id");
+		XARC_SER_KEY(base, "id", id);
+		XarcClose(base);
+
+		if (chitID.Query(id, 0) || deleted->Query(id, 0)) {
+			base->SkipElement();
+		}
+		else {
+			idPool = Max(id, idPool);
+			Chit* c = this->NewChit(id);
+			c->Serialize(base);
+		}
+	}
+	// The rest of the base isn't needed.
+}
+
+
 Chit* ChitBag::NewChit( int id )
 {
+	GLASSERT(!tickCommands);	// not from a parallel tick
 	if ( !memRoot ) {
 		// Allocate a new block.
 		Chit* block = new Chit[BLOCK_SIZE];
@@ -144,6 +249,9 @@ Chit* ChitBag::NewChit( int id )
 	GLASSERT( chitID.Query( c->ID(), 0 ) == false );
 
 	chitID.Add( c->ID(), c );
+	++lodCount[c->lod];
+	c->lastTick = bagTime;
+	tickWheel.Schedule(c, bagTime);
 	return c;
 }
 
@@ -152,6 +260,8 @@ void ChitBag::DeleteChit( Chit* chit )
 {
 	GLASSERT( chitID.Query( chit->ID(), 0 ));
 	chitID.Remove( chit->ID() );
+	tickWheel.Remove(chit);
+	--lodCount[chit->lod];
 	chit->Free();
 	// Link back in to free pool.
 	chit->next = memRoot;
@@ -179,19 +289,24 @@ void ChitBag::QueueDelete( Chit* chit )
 		}
 	}
 #endif
-	deleteList.Push( chit->ID() );
+	if (tickCommands)
+		tickCommands->deleteList.Push(chit->ID());
+	else
+		deleteList.Push( chit->ID() );
 }
 
 
 bool ChitBag::IsQueuedForDelete(Chit* chit)
 {
+	if (tickCommands && tickCommands->deleteList.Find(chit->ID()) >= 0)
+		return true;
 	return deleteList.Find(chit->ID()) >= 0;
 }
 
 
 void ChitBag::QueueRemoveAndDeleteComponent( Component* comp )
 {
-	CompID* c = compDeleteList.PushArr(1);
+	CompID* c = tickCommands ? tickCommands->compDeleteList.PushArr(1) : compDeleteList.PushArr(1);
 	c->chitID = comp->ParentChit()->ID();
 	c->compID = comp->ID();
 }
@@ -200,6 +315,7 @@ void ChitBag::QueueRemoveAndDeleteComponent( Component* comp )
 void ChitBag::DeferredDelete( Component* comp )
 {
 	GLASSERT( comp->ParentChit() == 0 );	// already removed. Did you mean QueueRemoveAndDeleteComponent()?
+	GLASSERT( !tickCommands );
 	zombieDeleteList.Push( comp );
 }
 
@@ -207,7 +323,7 @@ void ChitBag::DeferredDelete( Component* comp )
 Bolt* ChitBag::NewBolt()
 {
 	Bolt bolt;
-	Bolt* b = bolts.PushArr(1);
+	Bolt* b = tickCommands ? tickCommands->bolts.PushArr(1) : bolts.PushArr(1);
 	*b = bolt;
 	return b;
 }
@@ -277,6 +393,10 @@ void ChitBag::ProcessDeleteList()
 
 void ChitBag::PushCurrentNews(const CurrentNews& news)
 {
+	if (tickCommands) {
+		tickCommands->news.Push(news);
+		return;
+	}
 	if (currentNews.Size() > 40) {
 		currentNews.PopFront();
 	}
@@ -295,6 +415,15 @@ void ChitBag::DoTick( U32 delta )
 	newsHistory->DoTick(delta);
 	bool useAOI = areaOfInterest.Volume() > 0;
 
+	// Each tier gets its share of ticks for this frame: enough to
+	// tick all of its chits once per interval.
+	for (int i = 0; i < NUM_LOD; ++i) {
+		if (LOD_INTERVAL[i]) {
+			float perFrame = float(lodCount[i]) * float(delta) / float(LOD_INTERVAL[i]);
+			lodBudget[i] = Min(lodBudget[i] + perFrame, perFrame * 2.0f + 1.0f);
+		}
+	}
+
 	// Events.
 	// Ticks.
 	// Bolts.
@@ -313,43 +442,37 @@ void ChitBag::DoTick( U32 delta )
 
 	Chit* cameraChit = GetNamedChit(StringPool::Intern("Camera"));
 
-	for( int i=0; i<blocks.Size(); ++i ) {
-		Chit* block = blocks[i];
-		for( int j=0; j<BLOCK_SIZE; ++j ) {
-			Chit* c = block + j;
-			int id = c->ID();
-			if (id && (c != cameraChit)) {
-
-				c->timeToTick -= delta;
-				c->timeSince += delta;
-
-				if (useAOI) {
-					// The big challenged is "clumping", where 2000 chits get
-					// processed one frame, and then 500 the next. Tried
-					// different time strategies and don't yet have a fix.
-					// However using IDs and just processing alternating
-					// halves outside the AOI seems to be very stable. 
-					if (((id + frame) & 1) && !areaOfInterest.Contains(c->Position())) {
-						continue;
-					}
-				}
+	// Everything that is due, in the order it came due. A chit
+	// can be deleted (and its memory re-used) by an earlier tick,
+	// so the ids are checked.
+	dueChits.Clear();
+	dueTick.Clear();
+	tickWheel.Advance(bagTime, &dueChits);
+	for (int i = 0; i < dueChits.Size(); ++i) {
+		SerialTick st = { dueChits[i], dueChits[i]->ID() };
+		dueTick.Push(st);
+	}
 
-				if (c->timeToTick <= 0) {
-					++nTicked;
-					// Performance note: disabling the DoTick drops the 
-					// time of this function to 0.3ms, about 1% of the
-					// time. So the memory walk and blocks are fast.
-					// It's all in the DoTick() itself.
-					c->DoTick();
-					GLASSERT( c->timeToTick >= 0 );
-				}
-				// Clear out anything deleted by calling
-				// the components. Can't clear out
-				// while handling the components - could
-				// delete something being Ticked
-				ProcessDeleteList();
-			}
+	if (parallelTick) {
+		ParallelDoTick(useAOI, cameraChit);
+	}
+	else for( int i=0; i<dueTick.Size(); ++i ) {
+		Chit* c = dueTick[i].chit;
+		if (c->ID() != dueTick[i].id) continue;
+		// The camera ticks last, below.
+		if (c == cameraChit) continue;
+
+		if (TimeToTick(c, useAOI)) {
+			++nTicked;
+			c->DoTick();
+			GLASSERT( c->timeToTick >= 0 );
+			Reschedule(c);
 		}
+		// Clear out anything deleted by calling
+		// the components. Can't clear out
+		// while handling the components - could
+		// delete something being Ticked
+		ProcessDeleteList();
 	}
 
 	if ( chitContext.engine ) {
@@ -363,6 +486,7 @@ void ChitBag::DoTick( U32 delta )
 		cameraChit->timeToTick = 0;
 		cameraChit->timeSince = delta;
 		cameraChit->DoTick();
+		Reschedule(cameraChit);
 	}
 
 	// Final flush, just to be sure.
@@ -376,16 +500,247 @@ void ChitBag::DoTick( U32 delta )
 
 	if (debugTick.Delta(delta)) {
 		GLString str;
-		str.Format("Spatial Hash: %d nAlloc=%d nBuck=%d probe=%d eff=%.2f den=%.2f",
-				   spatialHash.NumItems(), spatialHash.NumAlloc(),
-				   spatialHash.NumAllocated(), spatialHash.NumProbes(), spatialHash.Efficiency(), spatialHash.Density());
+		str.Format("Spatial Grid: %d cells=%d nAlloc=%d probe=%d scan=%d eff=%.2f",
+				   spatialGrid.NumItems(), spatialGrid.NumCellsUsed(), spatialGrid.NumAlloc(),
+				   spatialGrid.NumProbes(), spatialGrid.NumScanned(), spatialGrid.Efficiency());
 		//GLOUTPUT(("%s\n", str.safe_str()));
 		static int count = 0;
 		if (count >= 10 && count < 20) {
 			GLOUTPUT_REL(("%s\n", str.safe_str()));
 		}
 		++count;
-		spatialHash.ClearMetrics();
+		spatialGrid.ClearMetrics();
+	}
+}
+
+
+bool ChitBag::TimeToTick(Chit* c, bool useAOI)
+{
+	c->timeSince = int(bagTime - c->lastTick);
+
+	// The tier is only worked out for the chits that are due.
+	SetLOD(c, useAOI ? ChitLOD(c) : LOD_FULL);
+	if (c->lod == LOD_FULL) {
+		return true;
+	}
+
+	// Ticked too recently for the tier: wait for the interval.
+	if (c->timeSince < LOD_INTERVAL[c->lod]) {
+		tickWheel.Schedule(c, c->lastTick + LOD_INTERVAL[c->lod]);
+		return false;
+	}
+	// The big challenge is "clumping", where 2000 chits get
+	// processed one frame, and then 500 the next. The budget
+	// caps the ticks per frame; the chits over budget wait
+	// (and keep their timeSince) for the next frame.
+	if (lodBudget[c->lod] < 1.0f) {
+		tickWheel.Schedule(c, bagTime);
+		return false;
+	}
+	lodBudget[c->lod] -= 1.0f;
+	return true;
+}
+
+
+void ChitBag::SetLOD(Chit* c, int lod)
+{
+	if (c->lod != lod) {
+		--lodCount[c->lod];
+		++lodCount[lod];
+		c->lod = lod;
+	}
+}
+
+
+void ChitBag::WakeChit(Chit* c)
+{
+	if (tickCommands) {
+		// From a parallel tick: the chit may be ticking on another thread.
+		tickCommands->wake.Push(c->ID());
+		return;
+	}
+	c->timeToTick = 0;
+	// If it isn't in the wheel, it is due (or ticking) right now,
+	// and is rescheduled from its timeToTick afterwards.
+	if (TickWheel::Scheduled(c)) {
+		tickWheel.Schedule(c, bagTime);
+	}
+}
+
+
+int ChitBag::ChitLOD(Chit* c)
+{
+	return areaOfInterest.Contains(c->Position()) ? LOD_FULL : LOD_COARSE;
+}
+
+
+void ChitBag::TickCommands::Clear()
+{
+	nTicked = 0;
+	chits.Clear();
+	moves.Clear();
+	deleteList.Clear();
+	compDeleteList.Clear();
+	wake.Clear();
+	spatialFlags.Clear();
+	messages.Clear();
+	bolts.Clear();
+	news.Clear();
+	events.Clear();
+	deferred.Clear();
+}
+
+
+void ChitBag::TickBucketJob(void* data, int start, int end)
+{
+	ChitBag* bag = (ChitBag*)data;
+	for (int i = start; i < end; ++i) {
+		TickCommands* cmd = &bag->tickBuckets[bag->activeBuckets[i]];
+		tickCommands = cmd;
+		for (int j = 0; j < cmd->chits.Size(); ++j) {
+			Chit* c = cmd->chits[j].chit;
+			// A chit earlier in the bucket may have deleted it; 
+			// it is still in memory until the commands are applied.
+			if (cmd->deleteList.Find(c->ID()) >= 0)
+				continue;
+			++cmd->nTicked;
+			c->DoTick();
+			GLASSERT(c->timeToTick >= 0);
+		}
+		tickCommands = 0;
+	}
+}
+
+
+void ChitBag::ApplyTickCommands(TickCommands* cmd)
+{
+	for (int i = 0; i < cmd->moves.Size(); ++i) {
+		const TickCommands::Move& m = cmd->moves[i];
+		UpdateSpatialHash(m.chit, m.x0, m.y0, m.x1, m.y1);
+	}
+	for (int i = 0; i < cmd->messages.Size(); ++i) {
+		SendMessage(cmd->messages[i].chit, cmd->messages[i].msg);
+	}
+	for (int i = 0; i < cmd->bolts.Size(); ++i) {
+		bolts.Push(cmd->bolts[i]);
+	}
+	for (int i = 0; i < cmd->news.Size(); ++i) {
+		PushCurrentNews(cmd->news[i]);
+	}
+	for (int i = 0; i < cmd->events.Size(); ++i) {
+		events.Push(cmd->events[i]);
+	}
+	for (int i = 0; i < cmd->spatialFlags.Size(); ++i) {
+		Chit* c = GetChit(cmd->spatialFlags[i]);
+		if (c) UpdateSpatialFlags(c);
+	}
+	for (int i = 0; i < cmd->wake.Size(); ++i) {
+		Chit* c = GetChit(cmd->wake[i]);
+		if (c) WakeChit(c);
+	}
+	// The deferred ticks see everything above. The bucket's own
+	// deletes are done after them: a chit that queued its delete
+	// still finishes its tick, as it would ticking serially.
+	RunDeferredTicks(cmd);
+	for (int i = 0; i < cmd->deleteList.Size(); ++i) {
+		deleteList.Push(cmd->deleteList[i]);
+	}
+	for (int i = 0; i < cmd->compDeleteList.Size(); ++i) {
+		compDeleteList.Push(cmd->compDeleteList[i]);
+	}
+	nTicked += cmd->nTicked;
+	cmd->Clear();
+}
+
+
+void ChitBag::DeferTick(Component* comp, U32 delta)
+{
+	GLASSERT(tickCommands);
+	GLASSERT(comp->ParentChit());
+	TickCommands::Deferred d = { comp->ParentChit()->ID(), comp->ID(), delta };
+	tickCommands->deferred.Push(d);
+}
+
+
+void ChitBag::RunDeferredTicks(TickCommands* cmd)
+{
+	for (int i = 0; i < cmd->deferred.Size(); ++i) {
+		const TickCommands::Deferred& d = cmd->deferred[i];
+		Chit* c = GetChit(d.chitID);
+		Component* comp = c ? c->GetComponent(d.compID) : 0;
+		if (comp) {
+			int t = comp->DoTick(d.delta);
+			c->timeToTick = Min(c->timeToTick, t);
+			GLASSERT(c->timeToTick >= 0);
+			Reschedule(c);
+		}
+		// As in the serial tick, deletes are processed between chits.
+		if (i + 1 == cmd->deferred.Size() || cmd->deferred[i + 1].chitID != d.chitID) {
+			ProcessDeleteList();
+		}
+	}
+}
+
+
+void ChitBag::ParallelDoTick(bool useAOI, Chit* cameraChit)
+{
+	if (!tickBuckets) {
+		tickBuckets = new TickCommands[NUM_TICK_BUCKETS];
+	}
+	activeBuckets.Clear();
+	serialTick.Clear();
+
+	// Nothing has ticked yet, so nothing has been deleted.
+	for (int i = 0; i < dueChits.Size(); ++i) {
+		Chit* c = dueChits[i];
+		if ((c != cameraChit) && TimeToTick(c, useAOI)) {
+			if (c->ParallelTickSafe()) {
+				int x = Clamp(int(c->Position().x) >> TICK_BUCKET_SHIFT, 0, TICK_BUCKET_SIZE - 1);
+				int y = Clamp(int(c->Position().z) >> TICK_BUCKET_SHIFT, 0, TICK_BUCKET_SIZE - 1);
+				int b = y * TICK_BUCKET_SIZE + x;
+				if (tickBuckets[b].chits.Empty()) {
+					activeBuckets.Push(b);
+				}
+				SerialTick st = { c, c->ID() };
+				tickBuckets[b].chits.Push(st);
+			}
+			else {
+				SerialTick st = { c, c->ID() };
+				serialTick.Push(st);
+			}
+		}
+	}
+
+	if (!activeBuckets.Empty()) {
+		JobSystem::Instance()->ParallelFor(activeBuckets.Size(), 1, TickBucketJob, this);
+
+		// Apply in bucket order, not the order the buckets were
+		// found or finished, so that the result is reproducible.
+		activeBuckets.Sort();
+		for (int i = 0; i < activeBuckets.Size(); ++i) {
+			TickCommands* cmd = &tickBuckets[activeBuckets[i]];
+			for (int j = 0; j < cmd->chits.Size(); ++j) {
+				// An earlier bucket's commands may have deleted the
+				// chit (and the memory may have been re-used.)
+				Chit* c = cmd->chits[j].chit;
+				if (c->ID() == cmd->chits[j].id && cmd->deleteList.Find(c->ID()) < 0)
+					Reschedule(c);
+			}
+			ApplyTickCommands(cmd);
+		}
+		ProcessDeleteList();
+	}
+
+	for (int i = 0; i < serialTick.Size(); ++i) {
+		Chit* c = serialTick[i].chit;
+		// May have been deleted (and the memory re-used) by an earlier tick.
+		if (c->ID() == serialTick[i].id) {
+			++nTicked;
+			c->DoTick();
+			GLASSERT(c->timeToTick >= 0);
+			Reschedule(c);
+			ProcessDeleteList();
+		}
 	}
 }
 
@@ -407,6 +762,39 @@ bool ChitHasAIComponent::Accept( Chit* chit )
 }
 
 
+U32 MultiFilter::SpatialFlags() const
+{
+	// All: needs all the flags. Any: only the ones they share.
+	U32 flags = (anyAll == MATCH_ANY && filters.Size()) ? ~0U : 0;
+	for (int i = 0; i < filters.Size(); ++i) {
+		if (anyAll == MATCH_ANY)
+			flags &= filters[i]->SpatialFlags();
+		else
+			flags |= filters[i]->SpatialFlags();
+	}
+	return flags;
+}
+
+
+bool MultiFilter::AcceptTeam(int team) const
+{
+	if (anyAll == MATCH_ANY) {
+		for (int i = 0; i < filters.Size(); ++i) {
+			if (filters[i]->AcceptTeam(team)) {
+				return true;
+			}
+		}
+		return filters.Empty();
+	}
+	for (int i = 0; i < filters.Size(); ++i) {
+		if (!filters[i]->AcceptTeam(team)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
 bool MultiFilter::Accept( Chit* chit ) 
 {
 	if ( anyAll == MATCH_ANY ) {
@@ -434,14 +822,7 @@ void ChitBag::AddToSpatialHash(Chit* chit, int x, int y)
 	if (x == 0 && y == 0) return;	// sentinel
 	//GLOUTPUT(("Add %x at %d,%d\n", chit, x, y));
 
-#ifdef USE_SPACIAL_HASH
-	Vector2I pos = { x >> SHIFT, y >> SHIFT };
-	spatialHash.Add(pos, chit);
-#else
-	U32 index = HashIndex(x, y);
-	chit->next = spatialHash[index];
-	spatialHash[index] = chit;
-#endif
+	spatialGrid.Add(chit, SpatialGrid::ToCell(x, y), ToWorld2F(chit->Position()), SpatialFlags(chit), chit->Team());
 }
 
 
@@ -452,42 +833,55 @@ void ChitBag::RemoveFromSpatialHash(Chit* chit, int x, int y)
 
 	//GLOUTPUT(("Rmv %x at %d,%d\n", chit, x, y));
 
-#ifdef USE_SPACIAL_HASH
-	Vector2I pos = { x >> SHIFT, y >> SHIFT };
-	spatialHash.Remove(pos, chit);
-#else
-	U32 index = HashIndex(x, y);
-	Chit* prev = 0;
-	for (Chit* it = spatialHash[index]; it; prev = it, it = it->next) {
-		if (it == chit) {
-			if (prev) {
-				prev->next = it->next;
-				it->next = 0;
-				return;
-			}
-			else {
-				spatialHash[index] = it->next;
-				it->next = 0;
-				return;
-			}
-		}
-	}
-	GLASSERT(0);
-#endif
+	spatialGrid.Remove(chit, SpatialGrid::ToCell(x, y));
 }
 
 
 void ChitBag::UpdateSpatialHash(Chit* c, int x0, int y0, int x1, int y1)
 {
-	if (   (x0>>SHIFT) != (x1>>SHIFT) 
-		|| (y0>>SHIFT) != (y1>>SHIFT)) 
-	{
+	if (tickCommands) {
+		// Other threads are reading the grid.
+		TickCommands::Move m = { c, x0, y0, x1, y1 };
+		tickCommands->moves.Push(m);
+		return;
+	}
+	bool in0 = x0 || y0;	// (0,0) is the sentinel for "not in the grid"
+	bool in1 = x1 || y1;
+	Vector2I cell0 = SpatialGrid::ToCell(x0, y0);
+	Vector2I cell1 = SpatialGrid::ToCell(x1, y1);
+	if (in0 && in1 && cell0 == cell1) {
+		spatialGrid.Move(c, cell1, ToWorld2F(c->Position()));
+	}
+	else {
 		RemoveFromSpatialHash(c, x0, y0);
 		AddToSpatialHash(c, x1, y1);
 	}
 }
 
 
+U32 ChitBag::SpatialFlags(Chit* chit)
+{
+	U32 flags = 0;
+	if (chit->GetMoveComponent()) flags |= SPATIAL_MOVE;
+	if (chit->GetAIComponent()) flags |= SPATIAL_AI;
+	if (chit->GetItemComponent()) flags |= SPATIAL_ITEM;
+	return flags;
+}
+
+
+void ChitBag::UpdateSpatialFlags(Chit* chit)
+{
+	if (tickCommands) {
+		tickCommands->spatialFlags.Push(chit->ID());
+		return;
+	}
+	Vector2I pos = ToWorld2I(chit->Position());
+	if (pos.x || pos.y) {
+		spatialGrid.SetFlags(chit, SpatialGrid::ToCell(pos.x, pos.y), SpatialFlags(chit), chit->Team());
+	}
+}
+
+
 void ChitBag::QuerySpatialHash(grinliz::CDynArray<Chit*>* array,
 							   const grinliz::Rectangle2F& searchBounds,
 							   const Chit* ignore,
@@ -505,10 +899,11 @@ void ChitBag::QuerySpatialHash(	CChitArray* arr,
 								const Chit* ignoreMe,
 								IChitAccept* accept )
 {
-	QuerySpatialHash( &cachedQuery, r, ignoreMe, accept );
+	CDynArray<Chit*>* query = tickCommands ? &tickCommands->cachedQuery : &cachedQuery;
+	QuerySpatialHash( query, r, ignoreMe, accept );
 	arr->Clear();
-	for( int i=0; i<cachedQuery.Size() && arr->HasCap(); ++i ) {
-		arr->Push( cachedQuery[i] );
+	for( int i=0; i<query->Size() && arr->HasCap(); ++i ) {
+		arr->Push( (*query)[i] );
 	}
 }
 
@@ -533,10 +928,11 @@ void ChitBag::QuerySpatialHash(CChitArray* arr,
 							   const Chit* ignoreMe,
 							   IChitAccept* filter)
 {
-	QuerySpatialHash(&cachedQuery, queryBounds, ignoreMe, filter);
+	CDynArray<Chit*>* query = tickCommands ? &tickCommands->cachedQuery : &cachedQuery;
+	QuerySpatialHash(query, queryBounds, ignoreMe, filter);
 	arr->Clear();
-	for( int i=0; i<cachedQuery.Size() && arr->HasCap(); ++i ) {
-		arr->Push( cachedQuery[i] );
+	for( int i=0; i<query->Size() && arr->HasCap(); ++i ) {
+		arr->Push( (*query)[i] );
 	}
 }
 
@@ -551,23 +947,16 @@ void ChitBag::InnerQuerySpatialHash(grinliz::CDynArray<Chit*>* array,
 	GLASSERT(array);
 	array->Clear();
 
-	U32 i0 = queryBounds.min.x >> SHIFT;
-	U32 j0 = queryBounds.min.y >> SHIFT;
-	U32 i1 = queryBounds.max.x >> SHIFT;
-	U32 j1 = queryBounds.max.y >> SHIFT;
+	// The grid checks the bounds, flags and team; only what
+	// passes is handed to the filter.
+	U32 required = accept->SpatialFlags();
+	if (tickCommands)
+		spatialGrid.Find(queryBounds, searchBounds, required, accept, ignoreMe, array);
+	else
+		spatialGrid.Query(queryBounds, searchBounds, required, accept, ignoreMe, array);
 
-	for (U32 j = j0; j <= j1; ++j) {
-		for (U32 i = i0; i <= i1; ++i) {
-			Vector2I pos = { int(i), int(j) };
-			spatialHash.Query(pos, array);
-		}
-	}
 	for (int i = 0; i < array->Size(); ++i) {
-		Chit* chit = (*array)[i];
-		if (chit != ignoreMe && searchBounds.Contains(ToWorld2F(chit->Position())) && accept->Accept(chit)) {
-			// Do nothing. This is valid.
-		}
-		else {
+		if (!accept->Accept((*array)[i])) {
 			array->SwapRemove(i);
 			--i;
 		}
@@ -577,6 +966,7 @@ void ChitBag::InnerQuerySpatialHash(grinliz::CDynArray<Chit*>* array,
 
 void ChitBag::SetTickNeeded(const grinliz::Rectangle2F& bounds)
 {
+	GLASSERT(!tickCommands);	// writes to other chits
 	ChitAcceptAll all;
 	QuerySpatialHash(&cachedQuery, bounds, 0, &all);
 	for (int i = 0; i < cachedQuery.Size(); ++i) {
@@ -621,11 +1011,102 @@ void ChitBag::SetTickNeeded(const grinliz::Rectangle2F& bounds)
 	chitBag->QuerySpatialHash(&arr, center, 2.0f, 0, &all);
 	GLTEST(arr.Size() == 4);
 
+	// Moving within a grid cell is tracked.
+	r.Set(12.4f, 12.4f, 13, 13);
+	chitBag->QuerySpatialHash(&arr, r, 0, &all);
+	GLTEST(arr.Size() == 0);
+	chit3->SetPosition(12.5f, 0, 12.5f);
+	chitBag->QuerySpatialHash(&arr, r, 0, &all);
+	GLTEST(arr.Size() == 1);
+	chitBag->QuerySpatialHash(&arr, r, chit3, &all);
+	GLTEST(arr.Size() == 0);
+
+	// The grid checks the team it keeps (0: no item) before Accept().
+	class TeamedFilter : public ChitAcceptAll {
+	public:
+		virtual bool AcceptTeam(int team) const { return team != 0; }
+	};
+	TeamedFilter teamed;
+	chitBag->QuerySpatialHash(&arr, center, 2.0f, 0, &teamed);
+	GLTEST(arr.Size() == 0);
+
+	// Parallel tick: the deferred part of each tick runs once, serially,
+	// in bucket order.
+	{
+		class DeferComponent : public Component {
+		public:
+			DeferComponent(ChitBag* _bag, CDynArray<int>* _order) : bag(_bag), order(_order), nParallel(0), nSerial(0) {}
+			virtual void Serialize(XStream* xs)		{}
+			virtual const char* Name() const		{ return "DeferComponent"; }
+			virtual bool ParallelTickSafe() const	{ return true; }
+			virtual int DoTick(U32 delta) {
+				if (ChitBag::ParallelTicking()) {
+					++nParallel;
+					bag->DeferTick(this, delta);
+					return VERY_LONG_TICK;
+				}
+				++nSerial;
+				order->Push(parentChit->ID());
+				return VERY_LONG_TICK;
+			}
+			ChitBag* bag;
+			CDynArray<int>* order;
+			int nParallel, nSerial;
+		};
+		CDynArray<int> order;
+		DeferComponent* dc0 = new DeferComponent(chitBag, &order);
+		DeferComponent* dc2 = new DeferComponent(chitBag, &order);
+		chit2->SetPosition(200, 0, 200);	// a bucket after chit0's
+		chit2->Add(dc2);
+		chit0->Add(dc0);
+
+		chitBag->SetParallelTick(true);
+		chitBag->DoTick(30);
+		chitBag->SetParallelTick(false);
+		GLTEST(dc0->nParallel == 1 && dc0->nSerial == 1);
+		GLTEST(dc2->nParallel == 1 && dc2->nSerial == 1);
+		GLTEST(order.Size() == 2 && order[0] == chit0->ID() && order[1] == chit2->ID());
+	}
+
 	chitBag->DeleteChit(chit0);
 	chitBag->DeleteChit(chit1);
 	chitBag->DeleteChit(chit2);
 	chitBag->DeleteChit(chit3);
 	delete chitBag;
+
+	// The tick wheel, across its levels and a cascade.
+	{
+		Chit c[4];
+		CDynArray<Chit*> due;
+		TickWheel wheel;
+		wheel.Clear(1000);
+
+		wheel.Schedule(&c[0], 900);		// in the past: next ms
+		wheel.Schedule(&c[1], 1300);
+		wheel.Schedule(&c[2], 70000);
+		wheel.Schedule(&c[3], 2000000);
+		GLTEST(wheel.Size() == 4);
+
+		wheel.Advance(1001, &due);
+		GLTEST(due.Size() == 1 && due[0] == &c[0]);
+		due.Clear();
+		wheel.Advance(1299, &due);
+		GLTEST(due.Empty());
+		wheel.Advance(1300, &due);
+		GLTEST(due.Size() == 1 && due[0] == &c[1]);
+		due.Clear();
+
+		wheel.Schedule(&c[1], 1400);
+		wheel.Schedule(&c[2], 1500);	// moved up
+		wheel.Advance(69999, &due);
+		GLTEST(due.Size() == 2 && due[0] == &c[1] && due[1] == &c[2]);
+		due.Clear();
+
+		wheel.Remove(&c[1]);			// not scheduled; no-op
+		wheel.Advance(2000000, &due);
+		GLTEST(due.Size() == 1 && due[0] == &c[3]);
+		GLTEST(wheel.Size() == 0);
+	}
 	GLOUTPUT(("ChitBag test done."));
 }
 
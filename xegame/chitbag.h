@@ -19,7 +19,6 @@
 #include "../grinliz/gldebug.h"
 #include "../grinliz/gltypes.h"
 #include "../grinliz/glrandom.h"
-#include "../grinliz/glspatialhash.h"
 
 #include "cticker.h"
 
@@ -27,6 +26,8 @@
 #include "../engine/bolt.h"
 
 #include "chit.h"
+#include "tickwheel.h"
+#include "spatialgrid.h"
 #include "xegamelimits.h"
 #include "../game/news.h"
 #include "chitevent.h"
@@ -34,26 +35,37 @@
 class Engine;
 class ComponentFactory;
 class XStream;
+class StreamReader;
 class CameraComponent;
 
-#define USE_SPACIAL_HASH
-
 #define CChitArray grinliz::CArray<Chit*, 32 >
 
-// Controls tuning of spatial hash. Helps, but 
-// still spending way too much time finding out 
-// what is around a given chit.
-#define SPATIAL_VAR
-
 // This ticks per-component instead of per-chit.
 // Rather expected this to make a difference
 // (cache use) but doesn't.
 //#define OUTER_TICK
 
+// Flags kept with each chit in the spatial grid. ChitBag::SpatialFlags()
+// works them out; the game sets the ones past SPATIAL_ITEM.
+enum {
+	SPATIAL_MOVE		= 0x01,		// has a MoveComponent
+	SPATIAL_AI			= 0x02,		// has an AIComponent
+	SPATIAL_ITEM		= 0x04,		// has an ItemComponent
+	SPATIAL_MOB			= 0x08,		// item has a "mob" key
+	SPATIAL_BUILDING	= 0x10		// has a MapSpatialComponent
+};
+
 class IChitAccept
 {
 public:
 	virtual bool Accept( Chit* chit ) = 0;
+	// The SPATIAL_ flags a chit needs to be accepted. The spatial
+	// query checks them before calling Accept(), without having
+	// to touch the Chit.
+	virtual U32 SpatialFlags() const { return 0; }
+	// Checked by the spatial query against the team it keeps
+	// for the chit, also before Accept().
+	virtual bool AcceptTeam(int team) const { return true; }
 };
 
 
@@ -67,12 +79,14 @@ class ChitHasMoveComponent : public IChitAccept
 {
 public:
 	virtual bool Accept( Chit* chit );
+	virtual U32 SpatialFlags() const { return SPATIAL_MOVE; }
 };
 
 class ChitHasAIComponent : public IChitAccept
 {
 public:
 	virtual bool Accept( Chit* chit );
+	virtual U32 SpatialFlags() const { return SPATIAL_AI; }
 };
 
 class MultiFilter : public IChitAccept
@@ -84,6 +98,8 @@ public:
 	};
 	MultiFilter( int anyAllMatch ) : anyAll(anyAllMatch) {}
 	virtual bool Accept( Chit* chit );
+	virtual U32 SpatialFlags() const;
+	virtual bool AcceptTeam(int team) const;
 
 	// Remember: Up to 4 filters causes no memory allocation.
 	grinliz::CDynArray< IChitAccept* > filters;
@@ -110,7 +126,36 @@ public:
 
 	virtual void Serialize( XStream* xs );
 
+	// Delta saves. While set, Serialize() records a checksum of every
+	// chit in 'checksums', and clears the chits' save flags. If 'base'
+	// (the checksums from the last full save) is set, only the chits
+	// that are new or changed since then are written, along with the
+	// ids of the base chits that are gone. A chit that wasn't touched
+	// since the save that wrote 'last', and matched the base then,
+	// isn't serialized at all.
+	void SetSaveDelta(	grinliz::HashTable<int, U32>* base,
+						grinliz::HashTable<int, U32>* last,
+						grinliz::HashTable<int, U32>* checksums ) 
+	{
+		saveBase = base;
+		saveLast = last;
+		saveChecksums = checksums;
+	}
+	// Loading a delta save: the chits that aren't in the delta come
+	// from 'base', a reader with the base save's top element open.
+	void SetLoadBase( StreamReader* base )	{ loadBase = base; }
+
 	void SetAreaOfInterest(const grinliz::Rectangle3F& aoi) { areaOfInterest = aoi; }
+	const grinliz::Rectangle3F& AreaOfInterest() const		{ return areaOfInterest; }
+
+	// Simulation LOD. With an area of interest, chits outside of it
+	// are given a tier by ChitLOD() when they are due to tick. The
+	// lower tiers tick no more often than LOD_INTERVAL, and each
+	// tier has a budget of ticks per frame so the load is spread
+	// evenly over the frames instead of clumping. NumLOD() counts
+	// the tier the chits were in when they last came due.
+	virtual int ChitLOD(Chit* chit);
+	int NumLOD(int tier) const	{ GLASSERT(tier >= 0 && tier < NUM_LOD); return lodCount[tier]; }
 
 	// Bolts are a special kind of chit. Just easier
 	// and faster to treat them as a 2nd stage.
@@ -118,8 +163,27 @@ public:
 	const Bolt* BoltMem() const { return bolts.Mem(); }
 	int NumBolts() const { return bolts.Size(); }
 
-	// Calls every chit that has a tick.
+	// Ticks the chits that are due. The chits wait in a TickWheel
+	// for the time their components asked for (timeToTick), so
+	// the ones that aren't due aren't touched.
 	virtual void DoTick( U32 delta );	
+	// The chit needs to tick next frame. Use Chit::SetTickNeeded()
+	void WakeChit( Chit* chit );
+
+	// Parallel tick: chits whose components are all ParallelTickSafe()
+	// are bucketed by sector and ticked on the JobSystem. What they do
+	// to the bag is recorded per bucket and applied in bucket order
+	// when they are all done, so the result doesn't depend on the
+	// number of threads. Every other chit ticks serially, after.
+	void SetParallelTick(bool p)	{ parallelTick = p; }
+	bool ParallelTick() const		{ return parallelTick; }
+	// True while this thread is ticking a bucket of the parallel tick.
+	static bool ParallelTicking()	{ return tickCommands != 0; }
+	// For a ParallelTickSafe() component, from its DoTick() on the
+	// parallel tick: the part of the tick that can't run concurrently.
+	// DoTick(delta) is called again, serially, once the bucket's
+	// commands are applied, in the order the deferrals were made.
+	void DeferTick(Component* comp, U32 delta);
 	U32 AbsTime() const { return bagTime; }
 
 	int NumChits() const { return chitID.Size(); }
@@ -133,13 +197,17 @@ public:
 	bool IsQueuedForDelete(Chit* chit);
 
 	// passes ownership
-	void QueueEvent( const ChitEvent& event )			{ events.Push( event ); }
+	void QueueEvent( const ChitEvent& event )			{ if (tickCommands) tickCommands->events.Push(event); else events.Push( event ); }
 
-	// Hashes based on integer coordinates. No need to call
-	// if they don't change.
+	// Hashes based on integer coordinates. Update is called for
+	// every move, since the grid keeps the position.
 	void AddToSpatialHash( Chit*, int x, int y );
 	void RemoveFromSpatialHash( Chit*, int x, int y );
 	void UpdateSpatialHash( Chit*, int x0, int y0, int x1, int y1 );
+	// The components or the team changed: re-compute the flags
+	// and team in the grid.
+	void UpdateSpatialFlags( Chit* );
+	virtual U32 SpatialFlags( Chit* );
 
 	void QuerySpatialHash(	grinliz::CDynArray<Chit*>* array, 
 							const grinliz::Rectangle2F& r, 
@@ -235,6 +303,12 @@ public:
 	}
 
 	void SendMessage(Chit* chit, const ChitMsg& msg) {
+		if (tickCommands) {
+			TickCommands::Msg* m = tickCommands->messages.PushArr(1);
+			m->chit = chit;
+			m->msg = msg;
+			return;
+		}
 		for (int i = 0; i < listeners.Size(); ++i) {
 			listeners[i]->OnChitMsg(chit, msg);
 		}
@@ -252,24 +326,32 @@ private:
 							   const Chit* ignoreMe,
 							   IChitAccept* accept);
 
+	void LoadBaseChits( StreamReader* base, grinliz::HashTable<int, bool>* deleted );
 	void ProcessDeleteList();
+	// Called for a chit that is due; returns true if it should tick
+	// now, else puts it back in the wheel.
+	bool TimeToTick(Chit* c, bool useAOI);
+	// Back in the wheel after a tick.
+	void Reschedule(Chit* c) {
+		c->lastTick = bagTime;
+		tickWheel.Schedule(c, bagTime + U32(c->timeToTick));
+	}
+	void SetLOD(Chit* c, int lod);
+	void ParallelDoTick(bool useAOI, Chit* cameraChit);
 
 	grinliz::CDynArray< IChitListener* > listeners;
 
-	enum {
-		SIZE = 256,
-		SIZE2 = SIZE*SIZE,
-		SHIFT = 2
-	};
-
-	U32 HashIndex( U32 x, U32 y ) const {
-		return (y >> SHIFT)*SIZE + (x >> SHIFT);
-	}
-
 	int idPool;
 	U32 bagTime;
+	grinliz::HashTable<int, U32>* saveBase;
+	grinliz::HashTable<int, U32>* saveLast;
+	grinliz::HashTable<int, U32>* saveChecksums;
+	StreamReader* loadBase;
 	int nTicked;
 	int frame;
+	int lodCount[NUM_LOD];			// chits in each tier
+	float lodBudget[NUM_LOD];		// ticks allowed this frame
+	static const int LOD_INTERVAL[NUM_LOD];
 //	int activeCamera;
 	NewsHistory* newsHistory;
 	grinliz::Rectangle3F areaOfInterest;
@@ -299,12 +381,65 @@ private:
 	grinliz::CDynArray<CurrentNews> currentNews;
 	grinliz::HashTable<grinliz::IString, int, grinliz::CompValueString>	namedChits;	// not serialized; generated by OnAdd
 
-#ifdef USE_SPACIAL_HASH
-	grinliz::SpatialHash<Chit*> spatialHash;
+	// A chit, and its id when it was queued: if the chit is
+	// deleted (and the memory re-used) the ids won't match.
+	struct SerialTick {
+		Chit* chit;
+		int id;
+	};
+	// The deferred side effects of one bucket of the parallel tick.
+	struct TickCommands {
+		struct Move {
+			Chit* chit;
+			int x0, y0, x1, y1;
+		};
+		struct Msg {
+			Chit* chit;
+			ChitMsg msg = ChitMsg(0);
+		};
+		struct Deferred {
+			int chitID;
+			int compID;
+			U32 delta;
+		};
+		void Clear();
+
+		int nTicked = 0;
+		grinliz::CDynArray<SerialTick>	chits;		// to tick
+		grinliz::CDynArray<Move>		moves;
+		grinliz::CDynArray<int>			deleteList;
+		grinliz::CDynArray<CompID>		compDeleteList;
+		grinliz::CDynArray<int>			wake;		// SetTickNeeded()
+		grinliz::CDynArray<int>			spatialFlags;
+		grinliz::CDynArray<Msg>			messages;
+		grinliz::CDynArray<Bolt>		bolts;
+		grinliz::CDynArray<CurrentNews>	news;
+		grinliz::CDynArray<ChitEvent>	events;
+		grinliz::CDynArray<Chit*>		cachedQuery;
+		grinliz::CDynArray<Deferred>	deferred;
+	};
+	enum {
+		TICK_BUCKET_SHIFT = 6,		// sector size
+		TICK_BUCKET_SIZE = MAX_MAP_SIZE >> TICK_BUCKET_SHIFT,
+		NUM_TICK_BUCKETS = TICK_BUCKET_SIZE * TICK_BUCKET_SIZE
+	};
+	static void TickBucketJob(void* data, int start, int end);
+	void ApplyTickCommands(TickCommands* cmd);
+	void RunDeferredTicks(TickCommands* cmd);
+
+	// Non-null while a bucket is ticking on this thread.
+	static thread_local TickCommands* tickCommands;
+	bool parallelTick;
+	TickCommands* tickBuckets;				// NUM_TICK_BUCKETS, allocated on first use
+	grinliz::CDynArray<int>			activeBuckets;
+	grinliz::CDynArray<SerialTick>	serialTick;
+
+	TickWheel						tickWheel;
+	grinliz::CDynArray<Chit*>		dueChits;
+	grinliz::CDynArray<SerialTick>	dueTick;	// dueChits, with the ids to catch deletes
+
+	SpatialGrid spatialGrid;
 	CTicker debugTick;
-#else
-	Chit* spatialHash[SIZE2];
-#endif
 };
 
 
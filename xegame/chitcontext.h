@@ -10,12 +10,14 @@ class WorldMap;
 class LumosGame;
 class LumosChitBag;
 class PhysicsSims;
+namespace gamedb { class Reader; }
 
 class ChitContext
 {
 public:
 	// cross-engine
 	Engine*		engine = 0;
+	const gamedb::Reader* database = 0;
 
 	// game specific
 	WorldMap*	worldMap = 0;
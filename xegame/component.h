@@ -62,6 +62,15 @@ public:
 	void SetSerialize( bool s )							{ willSerialize = s; }
 
 	virtual int DoTick( U32 delta )						{ return VERY_LONG_TICK; }
+	// Return true if DoTick() can run concurrently with other chits'
+	// ticks. It may read anything, but may only write to its own chit,
+	// and may only change the ChitBag through QueueDelete(),
+	// SendMessage(), NewBolt(), QueueEvent() and PushCurrentNews(),
+	// which are deferred. No NewChit(), no engine, no WorldMap.
+	// Anything else waits for ChitBag::DeferTick(): when
+	// ChitBag::ParallelTicking(), do the safe part, defer, and do
+	// the rest when DoTick() is called again.
+	virtual bool ParallelTickSafe() const				{ return false; }
 	virtual void DoUpdate()								{}
 	virtual void DebugStr(grinliz::GLString* str)		{
 		str->AppendFormat("[%s] ", Name());
@@ -20,12 +20,15 @@
 
 #include "../engine/text.h"
 #include "../engine/model.h"
+#include "../engine/loosequadtree.h"
 #include "../engine/uirendering.h"
 #include "../engine/particle.h"
 #include "../engine/gpustatemanager.h"
 #include "../engine/renderqueue.h"
 #include "../engine/shadermanager.h"
 #include "../engine/animation.h"
+#include "../engine/animationbatch.h"
+#include "../engine/assetloader.h"
 #include "../engine/settings.h"
 #include "../engine/platformgl.h"
 
@@ -33,6 +36,7 @@
 #include "../grinliz/glutil.h"
 #include "../Shiny/include/Shiny.h"
 #include "../grinliz/glstringutil.h"
+#include "../grinliz/gljobsystem.h"
 
 #include "../audio/xenoaudio.h"
 #include "../tinyxml2/tinyxml2.h"
@@ -43,6 +47,7 @@
 #include "../script/itemscript.h"
 
 #include "../xegame/chitbag.h"
+#include "../xarchive/glstreamer.h"
 
 #include <time.h>
 #include "../game/layout.h"
@@ -74,6 +79,8 @@ Game::Game( int width, int height, int rotation, int uiHeight ) :
 
 #ifdef DEBUG
 	Matrix4::Test();
+	XStream::Test();
+	AnimationBatch::Test();
 	ChitBag::Test();
 	NewsEvent::Test();
 #endif
@@ -98,6 +105,9 @@ Game::Game( int width, int height, int rotation, int uiHeight ) :
 	ImageManager::Create( database0 );
 	ModelResourceManager::Create();
 	AnimationResourceManager::Create();
+#ifdef DEBUG
+	SpaceTree::Test();
+#endif
 
 	GLString settingsPath;
 	GetSystemPath(GAME_SAVE_DIR, "settings2.xml", &settingsPath );
@@ -106,13 +116,14 @@ Game::Game( int width, int height, int rotation, int uiHeight ) :
 	debugUI = settings->DebugUI();
 
 	LoadTextures();
-	modelLoader = new ModelLoader();
-	LoadModels();
+	{
+		AssetLoader loader( database0 );
+		loader.Load();
+		if ( AssetLoader::ProfileStartup() ) {
+			loader.Report();
+		}
+	}
 	LoadPalettes();
-	AnimationResourceManager::Instance()->Load( database0 );
-
-	delete modelLoader;
-	modelLoader = 0;
 
 	// Load font:
 	GLString fontPath = "./res/";
@@ -174,6 +185,7 @@ Game::~Game()
 
 	delete ShaderManager::Instance();	// handles device loss - should be near the end.
 	delete GPUDevice::Instance();
+	delete JobSystem::Instance();
 	delete itemDefDB;
 	delete xenoAudio;
 	delete database0;
@@ -205,33 +217,6 @@ void Game::CreateTexture( Texture* t )
 }
 
 
-void Game::LoadModel( const char* name )
-{
-	GLASSERT( modelLoader );
-
-	const gamedb::Item* item = GetDatabase()->Root()->Child( "models" )->Child( name );
-	GLASSERT( item );
-
-	ModelResource* res = new ModelResource();
-	modelLoader->Load( item, res );
-	ModelResourceManager::Instance()->AddModelResource( res );
-}
-
-
-void Game::LoadModels()
-{
-	// Run through the database, and load all the models.
-	const gamedb::Item* parent = database0->Root()->Child( "models" );
-	GLASSERT( parent );
-
-	for( int i=0; i<parent->NumChildren(); ++i )
-	{
-		const gamedb::Item* node = parent->ChildAt( i );
-		LoadModel( node->Name() );
-	}
-}
-
-
 bool Game::HasFile( const char* path ) const
 {
 	bool result = false;
@@ -45,7 +45,6 @@ class Research;
 class ItemDefDB;
 class LumosGame;
 class XenoAudio;
-class ModelLoader;
 class Model;
 
 enum SavePathMode {
@@ -166,8 +165,6 @@ protected:
 	bool scenePopQueued;
 
 	void LoadTextures();
-	void LoadModels();
-	void LoadModel( const char* name );
 	void LoadPalettes();
 
 	bool aiDebugLog;
@@ -182,7 +179,6 @@ protected:
 	bool renderUI;
 	//bool alsoPan;
 
-	ModelLoader* modelLoader;
 	gamedb::Reader* database0;		// the basic, complete database
 	ItemDefDB*		itemDefDB;		// the definitions of items
 	XenoAudio*		xenoAudio;
@@ -648,6 +648,10 @@ void ItemComponent::DoSlowTick()
 
 int ItemComponent::DoTick( U32 delta )
 {
+	if (ChitBag::ParallelTicking()) {
+		Context()->chitBag->DeferTick(this, delta);
+		return VERY_LONG_TICK;
+	}
 	if ( hardpointsModified && parentChit->GetRenderComponent() ) {
 		SetHardpoints();
 		hardpointsModified = false;
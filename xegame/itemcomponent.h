@@ -47,6 +47,8 @@ public:
 	virtual void Serialize(XStream* xs);
 
 	virtual int DoTick(U32 delta);
+	// Effects and items reach other chits: the whole tick is deferred.
+	virtual bool ParallelTickSafe() const { return true; }
 	virtual void OnChitEvent(const ChitEvent& event);
 
 	int NumItems() const							{ return itemArr.Size(); }
@@ -31,6 +31,7 @@
 #include "../script/procedural.h"
 
 #include "../game/lumosgame.h"
+#include "../game/lumoschitbag.h"
 
 #include "../xegame/chitbag.h"
 
@@ -48,6 +49,8 @@ RenderComponent::RenderComponent( const char* asset )
 	}
 	radiusOfBase = 0;
 	groundMark = 0;
+	animationTicked = false;
+	animationMeta = 0;
 	hud = 0;
 
 	mainAsset = StringPool::Intern( asset );
@@ -309,35 +312,66 @@ void RenderComponent::Detach( int metaData )
 }
 
 
+void RenderComponent::TickAnimation( U32 deltaTime )
+{
+	animationMeta = 0;
+	if ( model[0] && model[0]->GetAnimationResource() ) {
+		// Update to the current, correct animation if we are
+		// in a slice we can change
+		if ( AnimationReady() ) {
+			int n = this->CalcAnimation();
+			model[0]->SetAnimation( n, CROSS_FADE_TIME, false );
+		}
+		model[0]->DeltaAnimation( deltaTime, &animationMeta, 0 );
+
+		// The attachments need the bones.
+		if ( model[0]->HasAnimation() ) {
+			for( int i=1; i<NUM_MODELS; ++i ) {
+				if ( model[i] ) {
+					model[0]->CalcAnimation();
+					break;
+				}
+			}
+		}
+	}
+}
+
+
 int RenderComponent::DoTick( U32 deltaTime )
 {
+	if ( ChitBag::ParallelTicking() ) {
+		// Moving models in the engine, particles and the impact
+		// message wait for DoTick() to be called again, serially.
+		// (No PROFILE_FUNC here: the profiler isn't thread safe.)
+		TickAnimation( deltaTime );
+		animationTicked = true;
+		Context()->chitBag->DeferTick( this, deltaTime );
+		return VERY_LONG_TICK;
+	}
+
 	//GRINLIZ_PERFTRACK;
 	PROFILE_FUNC();
 
 	int tick = VERY_LONG_TICK;
 
+	if ( !animationTicked ) {
+		TickAnimation( deltaTime );
+	}
+	animationTicked = false;
+
 	// Animate the primary model.
 	if ( model[0] && model[0]->GetAnimationResource() ) {
 		tick = 0;	
 
-		// Update to the current, correct animation if we are
-		// in a slice we can change
-		if ( AnimationReady() ) {
-			int n = this->CalcAnimation();
-			model[0]->SetAnimation( n, CROSS_FADE_TIME, false );
-		}
-
-		int metaData=0;
-		model[0]->DeltaAnimation( deltaTime, &metaData, 0 );
-
-		if ( metaData ) {
-			if ( metaData == ANIM_META_IMPACT ) {
+		if ( animationMeta ) {
+			if ( animationMeta == ANIM_META_IMPACT ) {
 				//GLOUTPUT(( "Sending impact.\n" ));
 				parentChit->SendMessage( ChitMsg( ChitMsg::RENDER_IMPACT ), this );
 			}
 			else {
 				GLASSERT( 0 );	// event not recognized
 			}
+			animationMeta = 0;
 		}
 	}
 
@@ -61,6 +61,8 @@ public:
 	virtual void OnRemove();
 
 	virtual int DoTick( U32 deltaTime );
+	// Animates on the parallel tick; the rest is done serially.
+	virtual bool ParallelTickSafe() const { return true; }
 	virtual void OnChitMsg( Chit* chit, const ChitMsg& msg );
 
 	// ------ Additional --------
@@ -121,6 +123,9 @@ public:
 
 private:
 	int CalcAnimation() const;
+	// Advances the animation of the main model and computes its
+	// bones. Only writes to this component's models.
+	void TickAnimation( U32 deltaTime );
 	void SyncToSpatial();	// this a scary function: location is stored in both the model and the spatialcomponent
 	void ProcessIcons( int time );
 
@@ -129,6 +134,8 @@ private:
 
 	Model*					model[ NUM_MODELS ];
 	Model*					groundMark;
+	bool					animationTicked;	// by the parallel part of this tick
+	int						animationMeta;		// from the last TickAnimation()
 
 	struct HUD {
 		struct Icon {
@@ -0,0 +1,160 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spatialgrid.h"
+#include "chit.h"
+#include "chitbag.h"
+
+#include <string.h>
+
+using namespace grinliz;
+
+SpatialGrid::SpatialGrid() : nItems(0), nCellsUsed(0), nAlloc(0), nProbes(0), nScanned(0), nHits(0)
+{
+	cells = new Cell[SIZE*SIZE];
+	memset(cells, 0, sizeof(Cell)*SIZE*SIZE);
+}
+
+
+SpatialGrid::~SpatialGrid()
+{
+	for (int i = 0; i < SIZE*SIZE; ++i) {
+		delete[] cells[i].mem;
+	}
+	delete[] cells;
+}
+
+
+void SpatialGrid::Add(Chit* chit, const Vector2I& c, const Vector2F& pos, U32 flags, int team)
+{
+	Cell* cell = GetCell(c);
+	if (cell->size == cell->cap) {
+		// Cells are re-used as chits move around, so
+		// the memory is kept once allocated.
+		int cap = cell->cap ? cell->cap * 2 : 4;
+		Entry* mem = new Entry[cap];
+		if (cell->size) {
+			memcpy(mem, cell->mem, sizeof(Entry)*cell->size);
+		}
+		delete[] cell->mem;
+		cell->mem = mem;
+		cell->cap = cap;
+		++nAlloc;
+	}
+	if (cell->size == 0) {
+		++nCellsUsed;
+	}
+	Entry* e = &cell->mem[cell->size++];
+	e->chit = chit;
+	e->pos = pos;
+	e->flags = flags;
+	e->team = team;
+	++nItems;
+}
+
+
+SpatialGrid::Entry* SpatialGrid::FindEntry(Chit* chit, const Vector2I& c)
+{
+	Cell* cell = GetCell(c);
+	for (int i = 0; i < cell->size; ++i) {
+		if (cell->mem[i].chit == chit) {
+			return &cell->mem[i];
+		}
+	}
+	return 0;
+}
+
+
+void SpatialGrid::Remove(Chit* chit, const Vector2I& c)
+{
+	Cell* cell = GetCell(c);
+	Entry* e = FindEntry(chit, c);
+	GLASSERT(e);	// not found
+	if (e) {
+		*e = cell->mem[cell->size - 1];
+		--cell->size;
+		--nItems;
+		if (cell->size == 0) {
+			--nCellsUsed;
+		}
+	}
+}
+
+
+void SpatialGrid::Move(Chit* chit, const Vector2I& c, const Vector2F& pos)
+{
+	Entry* e = FindEntry(chit, c);
+	GLASSERT(e);
+	if (e) {
+		e->pos = pos;
+	}
+}
+
+
+bool SpatialGrid::SetFlags(Chit* chit, const Vector2I& c, U32 flags, int team)
+{
+	Entry* e = FindEntry(chit, c);
+	if (e) {
+		e->flags = flags;
+		e->team = team;
+	}
+	return e != 0;
+}
+
+
+int SpatialGrid::Find(const Rectangle2I& query, const Rectangle2F& bounds, U32 required,
+					  const IChitAccept* accept, const Chit* ignore, CDynArray<Chit*>* arr, int* scanned) const
+{
+	int hits = 0;
+	int n = 0;
+	Vector2I c0 = ToCell(query.min.x, query.min.y);
+	Vector2I c1 = ToCell(query.max.x, query.max.y);
+
+	for (int y = c0.y; y <= c1.y; ++y) {
+		const Cell* cell = &cells[y * SIZE + c0.x];
+		for (int x = c0.x; x <= c1.x; ++x, ++cell) {
+			const Entry* e = cell->mem;
+			const Entry* end = e + cell->size;
+			n += cell->size;
+			for (; e < end; ++e) {
+				if (   (e->flags & required) == required
+					&& bounds.Contains(e->pos)
+					&& e->chit != ignore
+					&& (!accept || accept->AcceptTeam(e->team)))
+				{
+					arr->Push(e->chit);
+					++hits;
+				}
+			}
+		}
+	}
+	if (scanned) *scanned = n;
+	return hits;
+}
+
+
+int SpatialGrid::Query(const Rectangle2I& query, const Rectangle2F& bounds, U32 required,
+					   const IChitAccept* accept, const Chit* ignore, CDynArray<Chit*>* arr)
+{
+	int scanned = 0;
+	int hits = Find(query, bounds, required, accept, ignore, arr, &scanned);
+
+	Vector2I c0 = ToCell(query.min.x, query.min.y);
+	Vector2I c1 = ToCell(query.max.x, query.max.y);
+	nProbes += (c1.x - c0.x + 1) * (c1.y - c0.y + 1);
+	nScanned += scanned;
+	nHits += hits;
+	return hits;
+}
@@ -0,0 +1,113 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef XENOENGINE_SPATIALGRID_INCLUDED
+#define XENOENGINE_SPATIALGRID_INCLUDED
+
+#include "../grinliz/gltypes.h"
+#include "../grinliz/gldebug.h"
+#include "../grinliz/glcontainer.h"
+#include "../grinliz/glvector.h"
+#include "../grinliz/glrectangle.h"
+#include "../grinliz/glutil.h"
+
+#include "xegamelimits.h"
+
+class Chit;
+class IChitAccept;
+
+/*	Dense uniform grid of the chits on the map, for the
+	ChitBag's spatial queries. Each cell (SHIFT: 4x4 world
+	units) has a compact array of entries, and each entry
+	keeps the position, some flags and the team next to the
+	chit pointer, so a query scans contiguous memory and only
+	touches the Chits that pass the bounds, flag and team
+	checks.
+
+	The entries are kept current by the ChitBag: the position
+	whenever the chit moves, the flags and team when its
+	components or team change.
+*/
+class SpatialGrid
+{
+public:
+	SpatialGrid();
+	~SpatialGrid();
+
+	enum {
+		SHIFT = 2,
+		SIZE = MAX_MAP_SIZE >> SHIFT
+	};
+
+	struct Entry {
+		Chit* chit;
+		grinliz::Vector2F pos;
+		U32 flags;
+		int team;
+	};
+
+	static grinliz::Vector2I ToCell(int x, int y) {
+		grinliz::Vector2I c = { grinliz::Clamp(x >> SHIFT, 0, SIZE - 1), grinliz::Clamp(y >> SHIFT, 0, SIZE - 1) };
+		return c;
+	}
+
+	void Add(Chit* chit, const grinliz::Vector2I& cell, const grinliz::Vector2F& pos, U32 flags, int team);
+	void Remove(Chit* chit, const grinliz::Vector2I& cell);
+	// The chit moved, but stayed in the cell.
+	void Move(Chit* chit, const grinliz::Vector2I& cell, const grinliz::Vector2F& pos);
+	// Returns false if the chit isn't in the cell.
+	bool SetFlags(Chit* chit, const grinliz::Vector2I& cell, U32 flags, int team);
+
+	// Appends the chits in 'cells' that are in 'bounds', have
+	// all the 'required' flags, and whose team passes
+	// accept->AcceptTeam() (if 'accept' isn't null). Updates the metrics.
+	int Query(const grinliz::Rectangle2I& cells, const grinliz::Rectangle2F& bounds, U32 required,
+			  const IChitAccept* accept, const Chit* ignore, grinliz::CDynArray<Chit*>* arr);
+	// Query() without the metrics: doesn't write to the
+	// grid, so it is safe to call from several threads.
+	int Find(const grinliz::Rectangle2I& cells, const grinliz::Rectangle2F& bounds, U32 required,
+			 const IChitAccept* accept, const Chit* ignore, grinliz::CDynArray<Chit*>* arr, int* scanned = 0) const;
+
+	int NumItems() const		{ return nItems; }
+	int NumCellsUsed() const	{ return nCellsUsed; }
+	int NumAlloc() const		{ return nAlloc; }
+	int NumProbes() const		{ return nProbes; }		// cells visited by queries
+	int NumScanned() const		{ return nScanned; }	// entries looked at
+	// Fraction of the entries looked at that were returned. Higher is better.
+	float Efficiency() const	{ return nScanned ? float(nHits) / float(nScanned) : 1.0f; }
+	void ClearMetrics()			{ nProbes = nScanned = nHits = nAlloc = 0; }
+
+private:
+	struct Cell {
+		Entry* mem;
+		int size;
+		int cap;
+	};
+	Cell* GetCell(const grinliz::Vector2I& c) {
+		GLASSERT(c.x >= 0 && c.x < SIZE && c.y >= 0 && c.y < SIZE);
+		return &cells[c.y * SIZE + c.x];
+	}
+	Entry* FindEntry(Chit* chit, const grinliz::Vector2I& cell);
+
+	int nItems;
+	int nCellsUsed;
+	int nAlloc;
+	int nProbes;
+	int nScanned;
+	int nHits;
+	Cell* cells;		// SIZE*SIZE
+};
+
+#endif // XENOENGINE_SPATIALGRID_INCLUDED
@@ -0,0 +1,133 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tickwheel.h"
+#include "chit.h"
+
+using namespace grinliz;
+
+TickWheel::TickWheel()
+{
+	Clear(0);
+}
+
+
+void TickWheel::Clear(U32 time)
+{
+	next = time + 1;
+	count = 0;
+	for (int i = 0; i < NUM_LEVELS * NUM_SLOTS; ++i) {
+		slots[i] = 0;
+	}
+}
+
+
+bool TickWheel::Scheduled(const Chit* chit)
+{
+	return chit->wheelSlot >= 0;
+}
+
+
+void TickWheel::Link(Chit* chit, int slot)
+{
+	chit->wheelSlot = slot;
+	chit->wheelPrev = 0;
+	chit->wheelNext = slots[slot];
+	if (slots[slot]) {
+		slots[slot]->wheelPrev = chit;
+	}
+	slots[slot] = chit;
+	++count;
+}
+
+
+void TickWheel::Remove(Chit* chit)
+{
+	if (chit->wheelSlot < 0) return;
+
+	if (chit->wheelPrev)
+		chit->wheelPrev->wheelNext = chit->wheelNext;
+	else
+		slots[chit->wheelSlot] = chit->wheelNext;
+	if (chit->wheelNext)
+		chit->wheelNext->wheelPrev = chit->wheelPrev;
+
+	chit->wheelSlot = -1;
+	chit->wheelNext = chit->wheelPrev = 0;
+	--count;
+	GLASSERT(count >= 0);
+}
+
+
+void TickWheel::Schedule(Chit* chit, U32 due)
+{
+	Remove(chit);
+
+	// Unsigned math, so that the time can wrap.
+	if (S32(due - next) < 0) {
+		due = next;
+	}
+	U32 delta = due - next;
+	if (delta > MAX_DELTA) {
+		delta = MAX_DELTA;
+		due = next + delta;
+	}
+	chit->dueTime = due;
+
+	int level = 0;
+	while (delta >= NUM_SLOTS) {
+		delta >>= SLOT_BITS;
+		++level;
+	}
+	GLASSERT(level < NUM_LEVELS);
+	int index = (due >> (SLOT_BITS * level)) & SLOT_MASK;
+	Link(chit, level * NUM_SLOTS + index);
+}
+
+
+void TickWheel::Cascade(int level, int index)
+{
+	Chit* chit = slots[level * NUM_SLOTS + index];
+	while (chit) {
+		Chit* n = chit->wheelNext;
+		// Everything in the slot is now close enough
+		// to go down a level (or more).
+		Schedule(chit, chit->dueTime);
+		chit = n;
+	}
+}
+
+
+void TickWheel::Advance(U32 time, CDynArray<Chit*>* due)
+{
+	while (S32(time - next) >= 0) {
+		int index = next & SLOT_MASK;
+		if (index == 0) {
+			int index1 = (next >> SLOT_BITS) & SLOT_MASK;
+			if (index1 == 0) {
+				Cascade(2, (next >> (SLOT_BITS * 2)) & SLOT_MASK);
+			}
+			Cascade(1, index1);
+		}
+
+		while (slots[index]) {
+			Chit* chit = slots[index];
+			GLASSERT(chit->dueTime == next);
+			Remove(chit);
+			due->Push(chit);
+		}
+		++next;
+	}
+}
@@ -0,0 +1,76 @@
+/*
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef XENOENGINE_TICKWHEEL_INCLUDED
+#define XENOENGINE_TICKWHEEL_INCLUDED
+
+#include "../grinliz/gltypes.h"
+#include "../grinliz/gldebug.h"
+#include "../grinliz/glcontainer.h"
+
+class Chit;
+
+/*	Hierarchical timing wheel, with a resolution of 1ms. The
+	ChitBag keeps every chit in it, at the time the chit next
+	needs to tick, so that a frame only touches the chits
+	that are due instead of walking all of them.
+
+	Three levels of 256 slots: the first covers the next 256ms,
+	one ms per slot; the second 65s, and the third 4.6 hours.
+	When the first level wraps around, a slot of the second
+	is "cascaded" down into it, and the same for the third.
+
+	The lists are intrusive (the wheel fields in Chit) so
+	(re)scheduling and removing are O(1) with no allocation.
+*/
+class TickWheel
+{
+public:
+	TickWheel();
+
+	// Empties the wheel (without touching the chits, which may
+	// already be gone) and sets the time.
+	void Clear(U32 time);
+	U32 Time() const	{ return next - 1; }
+	int Size() const	{ return count; }
+
+	// Schedules, or reschedules, a chit. A time that isn't
+	// in the future goes in the next ms.
+	void Schedule(Chit* chit, U32 due);
+	void Remove(Chit* chit);
+	static bool Scheduled(const Chit* chit);
+
+	// Moves the time forward, and appends the chits that
+	// came due, in order.
+	void Advance(U32 time, grinliz::CDynArray<Chit*>* due);
+
+private:
+	enum {
+		SLOT_BITS = 8,
+		NUM_SLOTS = 1 << SLOT_BITS,
+		SLOT_MASK = NUM_SLOTS - 1,
+		NUM_LEVELS = 3,
+		MAX_DELTA = (1 << (SLOT_BITS*NUM_LEVELS)) - 1
+	};
+
+	void Link(Chit* chit, int slot);
+	void Cascade(int level, int index);
+
+	U32 next;		// the next ms to process
+	int count;
+	Chit* slots[NUM_LEVELS * NUM_SLOTS];
+};
+
+#endif // XENOENGINE_TICKWHEEL_INCLUDED
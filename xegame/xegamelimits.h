@@ -24,16 +24,21 @@
 // stuck in hallways.
 static const float	MAX_BASE_RADIUS = 0.4f;
 
-// What is the maximum map size? Used to allocate
-// the spatial cache. Power of 2, of course.
+// What is the maximum map size? Sets the index layout,
+// (y << MAP_Y_SHIFT) | x, and the size of the per-sector
+// tables. Power of 2, of course. The map itself is picked
+// when the world is created (512, 1024, or 2048; see
+// MapSize()) and the WorldMap grid is allocated by sector,
+// so a smaller map only costs the sectors in use.
+static const int	MAX_MAP_SIZE	= 2048;
+static const int	MAP_Y_SHIFT		= 11;
+static const int	MAP_X_MASK		= 2047;
+
+// The size of a new world, if the settings don't pick one.
 #ifdef ALTERA_MICRO
-static const int	MAX_MAP_SIZE	= 512;
-static const int	MAP_Y_SHIFT		= 9;
-static const int	MAP_X_MASK		= 511;
+static const int	DEFAULT_MAP_SIZE = 512;
 #else
-static const int	MAX_MAP_SIZE    = 1024;
-static const int	MAP_Y_SHIFT		= 10;
-static const int	MAP_X_MASK		= 1023;	
+static const int	DEFAULT_MAP_SIZE = 1024;
 #endif
 
 inline int IndexToMapX(int index) {